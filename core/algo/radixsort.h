@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string.h>
+
+#include "../math/math.h"
+#include "../job/jobsystem.h"
+#include "../memory/framearena.h"
+
+/**
+ * Stable LSD radix sort of 64 bit keys with a 32 bit value each, 8 bits per pass.
+ *
+ * Passes over digits that are the same in every key are skipped, sort keys usually leave most of
+ * their high bits constant within a frame. The parallel version cuts the input in blocks: every
+ * block counts its digits, a prefix sum over (digit, block) gives each block its own output
+ * ranges, and the blocks scatter independently. Blocks are in input order, so the result is the
+ * same as the serial sort. Scratch memory comes from the scratch arena of the calling thread.
+ */
+
+struct FRadixSort
+{
+    /**
+     * @brief Sort Keys ascending, Values are moved along. Equal keys keep their order.
+     */
+    static inline void Sort(uint64* Keys, uint32* Values, int32 Num);
+
+    /**
+     * @brief Sort over the job system, for large inputs.
+     */
+    static inline void SortParallel(uint64* Keys, uint32* Values, int32 Num);
+
+private:
+    enum { RadixBits = 8, RadixSize = 1 << RadixBits, NumPasses = 64 / RadixBits };
+
+    /** Inputs smaller than this per block are not worth a job. */
+    enum { MinBlockSize = 16 * 1024 };
+
+    static inline void SortBlocks(uint64* Keys, uint32* Values, int32 Num, int32 NumBlocks);
+
+    /** Call Function(Block, Begin, End) for every block, on the job system when there are several. */
+    template<typename FunctionType>
+    static inline void ForEachBlock(int32 Num, int32 NumBlocks, const FunctionType& Function);
+};
+
+template<typename FunctionType>
+inline void FRadixSort::ForEachBlock(int32 Num, int32 NumBlocks, const FunctionType& Function)
+{
+    int32 BlockSize = (Num + NumBlocks - 1) / NumBlocks;
+
+    auto Range = [&](int32 BlockBegin, int32 BlockEnd)
+    {
+        for (int32 Block = BlockBegin; Block < BlockEnd; Block++)
+        {
+            int32 Begin = Block * BlockSize;
+            Function(Block, Begin, FMath::Min(Begin + BlockSize, Num));
+        }
+    };
+
+    if (NumBlocks > 1)
+    {
+        FJobSystem::Get().ParallelFor(NumBlocks, Range);
+    }
+    else
+    {
+        Range(0, 1);
+    }
+}
+
+inline void FRadixSort::Sort(uint64* Keys, uint32* Values, int32 Num)
+{
+    SortBlocks(Keys, Values, Num, 1);
+}
+
+inline void FRadixSort::SortParallel(uint64* Keys, uint32* Values, int32 Num)
+{
+    int32 NumBlocks = FMath::Min(FJobSystem::Get().GetNumThreads() * 4, Num / MinBlockSize);
+    SortBlocks(Keys, Values, Num, FMath::Max(NumBlocks, 1));
+}
+
+inline void FRadixSort::SortBlocks(uint64* Keys, uint32* Values, int32 Num, int32 NumBlocks)
+{
+    if (Num <= 1)
+    {
+        return;
+    }
+
+    FLinearArena& Arena = FScratchArena::Get();
+    FArenaScope Scope(Arena);
+
+    uint64* TempKeys = Arena.AllocArray<uint64>(Num);
+    uint32* TempValues = Arena.AllocArray<uint32>(Num);
+    uint32* Offsets = Arena.AllocArray<uint32>((size_t)NumBlocks * RadixSize);
+    uint64* BlockDiffs = Arena.AllocArray<uint64>(NumBlocks);
+
+    // Bits that differ from the first key in any key, the digits without any are skipped.
+    const uint64 FirstKey = Keys[0];
+    ForEachBlock(Num, NumBlocks, [&](int32 Block, int32 Begin, int32 End)
+    {
+        uint64 Diff = 0;
+        for (int32 i=Begin; i<End; i++)
+        {
+            Diff |= Keys[i] ^ FirstKey;
+        }
+        BlockDiffs[Block] = Diff;
+    });
+
+    uint64 Diff = 0;
+    for (int32 Block=0; Block<NumBlocks; Block++)
+    {
+        Diff |= BlockDiffs[Block];
+    }
+
+    uint64* SrcKeys = Keys;
+    uint32* SrcValues = Values;
+    uint64* DstKeys = TempKeys;
+    uint32* DstValues = TempValues;
+
+    for (int32 Pass=0; Pass<NumPasses; Pass++)
+    {
+        const uint32 Shift = Pass * RadixBits;
+        if (((Diff >> Shift) & (RadixSize - 1)) == 0)
+        {
+            continue;
+        }
+
+        ForEachBlock(Num, NumBlocks, [&](int32 Block, int32 Begin, int32 End)
+        {
+            uint32* Count = Offsets + (size_t)Block * RadixSize;
+            memset(Count, 0, RadixSize * sizeof(uint32));
+            for (int32 i=Begin; i<End; i++)
+            {
+                Count[(SrcKeys[i] >> Shift) & (RadixSize - 1)]++;
+            }
+        });
+
+        // Digit major, block minor: the blocks of a digit write one after the other.
+        uint32 Sum = 0;
+        for (int32 Digit=0; Digit<RadixSize; Digit++)
+        {
+            for (int32 Block=0; Block<NumBlocks; Block++)
+            {
+                uint32& Offset = Offsets[(size_t)Block * RadixSize + Digit];
+                uint32 Count = Offset;
+                Offset = Sum;
+                Sum += Count;
+            }
+        }
+
+        ForEachBlock(Num, NumBlocks, [&](int32 Block, int32 Begin, int32 End)
+        {
+            uint32* Offset = Offsets + (size_t)Block * RadixSize;
+            for (int32 i=Begin; i<End; i++)
+            {
+                uint32 Index = Offset[(SrcKeys[i] >> Shift) & (RadixSize - 1)]++;
+                DstKeys[Index] = SrcKeys[i];
+                DstValues[Index] = SrcValues[i];
+            }
+        });
+
+        uint64* SwapKeys = SrcKeys;
+        SrcKeys = DstKeys;
+        DstKeys = SwapKeys;
+
+        uint32* SwapValues = SrcValues;
+        SrcValues = DstValues;
+        DstValues = SwapValues;
+    }
+
+    // An odd number of passes leaves the result in the scratch arrays.
+    if (SrcKeys != Keys)
+    {
+        ForEachBlock(Num, NumBlocks, [&](int32, int32 Begin, int32 End)
+        {
+            memcpy(Keys + Begin, SrcKeys + Begin, (End - Begin) * sizeof(uint64));
+            memcpy(Values + Begin, SrcValues + Begin, (End - Begin) * sizeof(uint32));
+        });
+    }
+}
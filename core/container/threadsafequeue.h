@@ -0,0 +1,453 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "../math/math.h"
+
+/**
+ * Lock free queues.
+ *
+ * TMPMCQueue is a bounded ring for any number of producers and consumers (Vyukov): every cell
+ * carries a sequence number telling whether it is free for the producer of a position or holds
+ * the value for its consumer, so a single compare-and-swap on the position claims a cell and no
+ * thread ever waits for another to make progress. The batch variants claim a whole range with one
+ * compare-and-swap instead, and may spin briefly on a cell whose previous value is still being
+ * moved. TMPSCQueue is unbounded for any number of producers and one consumer, values go into
+ * linked segments that the consumer frees once it read them.
+ *
+ * The positions producers and consumers race on live on cache lines of their own.
+ */
+
+#define QUEUE_CACHE_LINE_SIZE 64
+
+template<typename T>
+class TMPMCQueue
+{
+public:
+    /**
+     * @param InCapacity Maximum number of values in the queue, rounded up to a power of two.
+     */
+    explicit TMPMCQueue(uint32 InCapacity = 1024)
+    {
+        Capacity = 2;
+        while (Capacity < InCapacity)
+        {
+            Capacity *= 2;
+        }
+        Mask = Capacity - 1;
+
+        Cells = new FCell[Capacity];
+        for (uint32 i=0; i<Capacity; i++)
+        {
+            Cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+        EnqueuePos.store(0, std::memory_order_relaxed);
+        DequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~TMPMCQueue()
+    {
+        delete[] Cells;
+    }
+
+    TMPMCQueue(const TMPMCQueue&) = delete;
+    TMPMCQueue& operator=(const TMPMCQueue&) = delete;
+
+    /**
+     * @brief Returns false when the queue is full.
+     */
+    template<typename U>
+    inline bool Enqueue(U&& Value);
+
+    /**
+     * @brief Returns false when the queue is empty.
+     */
+    inline bool Dequeue(T& OutValue);
+
+    /**
+     * @brief Enqueue up to Num values with a single claim of the position.
+     *
+     * @return The number of values enqueued, less than Num when the queue ran full.
+     */
+    inline int32 EnqueueBatch(const T* Values, int32 Num);
+
+    /**
+     * @brief Dequeue up to Num values with a single claim of the position.
+     *
+     * @return The number of values dequeued.
+     */
+    inline int32 DequeueBatch(T* OutValues, int32 Num);
+
+    /**
+     * @brief Number of values, only a hint while other threads use the queue.
+     */
+    inline uint32 Num() const
+    {
+        uint64 Dequeued = DequeuePos.load(std::memory_order_relaxed);
+        uint64 Enqueued = EnqueuePos.load(std::memory_order_relaxed);
+        return Enqueued > Dequeued ? (uint32)(Enqueued - Dequeued) : 0;
+    }
+
+    inline uint32 GetCapacity() const { return Capacity; }
+
+private:
+    struct FCell
+    {
+        std::atomic<uint64> Sequence;
+        T Value;
+    };
+
+    static inline void WaitForSequence(const FCell& Cell, uint64 Sequence)
+    {
+        // A batch claimed the position ahead of the thread still moving the last value in or out
+        // of this cell, that thread is past its claim and done within a few instructions.
+        while (Cell.Sequence.load(std::memory_order_acquire) != Sequence)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint64> EnqueuePos;
+    alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint64> DequeuePos;
+    alignas(QUEUE_CACHE_LINE_SIZE) FCell* Cells;
+    uint32 Capacity;
+    uint32 Mask;
+};
+
+/**
+ * @brief Unbounded queue for many producers and a single consumer, Enqueue never fails.
+ */
+template<typename T>
+class TMPSCQueue
+{
+public:
+    TMPSCQueue()
+    {
+        FSegment* Segment = new FSegment();
+        HeadSegment = Segment;
+        Head = 0;
+        TailSegment.store(Segment, std::memory_order_relaxed);
+        Tail.store(0, std::memory_order_relaxed);
+    }
+
+    ~TMPSCQueue()
+    {
+        T Value;
+        while (Dequeue(Value))
+        {
+        }
+        delete HeadSegment;
+    }
+
+    TMPSCQueue(const TMPSCQueue&) = delete;
+    TMPSCQueue& operator=(const TMPSCQueue&) = delete;
+
+    /**
+     * @brief Any thread.
+     */
+    template<typename U>
+    inline void Enqueue(U&& Value)
+    {
+        T* Slot;
+        int32 Count;
+        FSegment* Segment = Claim(1, Slot, Count);
+        *Slot = std::forward<U>(Value);
+        Publish(Segment, Slot, 1);
+    }
+
+    /**
+     * @brief Any thread, the values of one claim are taken from a single segment.
+     */
+    inline void EnqueueBatch(const T* Values, int32 Num)
+    {
+        while (Num > 0)
+        {
+            T* Slots;
+            int32 NumClaimed;
+            FSegment* Segment = Claim(Num, Slots, NumClaimed);
+            for (int32 i=0; i<NumClaimed; i++)
+            {
+                Slots[i] = Values[i];
+            }
+            Publish(Segment, Slots, NumClaimed);
+            Values += NumClaimed;
+            Num -= NumClaimed;
+        }
+    }
+
+    /**
+     * @brief Consumer thread only, never waits for a producer. Returns false when the queue is
+     *        empty or the next value is still being written.
+     */
+    inline bool Dequeue(T& OutValue)
+    {
+        return DequeueBatch(&OutValue, 1) == 1;
+    }
+
+    /**
+     * @brief Consumer thread only.
+     *
+     * @return The number of values dequeued.
+     */
+    inline int32 DequeueBatch(T* OutValues, int32 Num);
+
+    /**
+     * @brief Consumer thread only, true when nothing was enqueued that has not been dequeued.
+     */
+    inline bool IsEmpty() const
+    {
+        return Head == Tail.load(std::memory_order_acquire);
+    }
+
+private:
+    /**
+     * Positions count SegmentLap per segment, the last one is never a value: a producer that
+     * takes the last slot moves Tail onto it while it links the next segment, which tells the
+     * other producers to wait instead of claiming slots behind the end.
+     */
+    enum { SegmentLap = 64, SegmentSize = SegmentLap - 1 };
+
+    struct FSegment
+    {
+        std::atomic<FSegment*> Next;
+        std::atomic<uint8> Ready[SegmentSize];
+        T Values[SegmentSize];
+
+        FSegment() : Next(nullptr)
+        {
+            for (int32 i=0; i<SegmentSize; i++)
+            {
+                Ready[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    inline FSegment* Claim(int32 Num, T*& OutSlots, int32& OutCount);
+
+    inline void Publish(FSegment* Segment, T* Slots, int32 Num)
+    {
+        int32 Offset = (int32)(Slots - Segment->Values);
+        for (int32 i=0; i<Num; i++)
+        {
+            Segment->Ready[Offset + i].store(1, std::memory_order_release);
+        }
+    }
+
+    // Written by the producers.
+    alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint64> Tail;
+    std::atomic<FSegment*> TailSegment;
+
+    // Owned by the consumer.
+    alignas(QUEUE_CACHE_LINE_SIZE) uint64 Head;
+    FSegment* HeadSegment;
+};
+
+template<typename T>
+template<typename U>
+inline bool TMPMCQueue<T>::Enqueue(U&& Value)
+{
+    uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        FCell& Cell = Cells[Pos & Mask];
+        uint64 Sequence = Cell.Sequence.load(std::memory_order_acquire);
+        int64 Diff = (int64)Sequence - (int64)Pos;
+
+        if (Diff == 0)
+        {
+            if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+            {
+                Cell.Value = std::forward<U>(Value);
+                Cell.Sequence.store(Pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (Diff < 0)
+        {
+            // The cell still holds the value of the previous lap.
+            return false;
+        }
+        else
+        {
+            Pos = EnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+inline bool TMPMCQueue<T>::Dequeue(T& OutValue)
+{
+    uint64 Pos = DequeuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        FCell& Cell = Cells[Pos & Mask];
+        uint64 Sequence = Cell.Sequence.load(std::memory_order_acquire);
+        int64 Diff = (int64)Sequence - (int64)(Pos + 1);
+
+        if (Diff == 0)
+        {
+            if (DequeuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+            {
+                OutValue = std::move(Cell.Value);
+                Cell.Sequence.store(Pos + Capacity, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (Diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            Pos = DequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+inline int32 TMPMCQueue<T>::EnqueueBatch(const T* Values, int32 Num)
+{
+    uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+    int32 Count;
+    for (;;)
+    {
+        // Free cells are the ones every consumer of the previous lap claimed.
+        uint64 Dequeued = DequeuePos.load(std::memory_order_acquire);
+        int64 Free = (int64)Capacity - (int64)(Pos - Dequeued);
+        Count = (int32)FMath::Min<int64>(Num, Free);
+        if (Count <= 0)
+        {
+            return 0;
+        }
+
+        if (EnqueuePos.compare_exchange_weak(Pos, Pos + Count, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    for (int32 i=0; i<Count; i++)
+    {
+        FCell& Cell = Cells[(Pos + i) & Mask];
+        WaitForSequence(Cell, Pos + i);
+        Cell.Value = Values[i];
+        Cell.Sequence.store(Pos + i + 1, std::memory_order_release);
+    }
+    return Count;
+}
+
+template<typename T>
+inline int32 TMPMCQueue<T>::DequeueBatch(T* OutValues, int32 Num)
+{
+    uint64 Pos = DequeuePos.load(std::memory_order_relaxed);
+    int32 Count;
+    for (;;)
+    {
+        uint64 Enqueued = EnqueuePos.load(std::memory_order_acquire);
+        int64 Available = (int64)(Enqueued - Pos);
+        Count = (int32)FMath::Min<int64>(Num, Available);
+        if (Count <= 0)
+        {
+            return 0;
+        }
+
+        if (DequeuePos.compare_exchange_weak(Pos, Pos + Count, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    for (int32 i=0; i<Count; i++)
+    {
+        FCell& Cell = Cells[(Pos + i) & Mask];
+        WaitForSequence(Cell, Pos + i + 1);
+        OutValues[i] = std::move(Cell.Value);
+        Cell.Sequence.store(Pos + i + Capacity, std::memory_order_release);
+    }
+    return Count;
+}
+
+template<typename T>
+inline typename TMPSCQueue<T>::FSegment* TMPSCQueue<T>::Claim(int32 Num, T*& OutSlots, int32& OutCount)
+{
+    FSegment* NewSegment = nullptr;
+
+    for (;;)
+    {
+        uint64 Pos = Tail.load(std::memory_order_acquire);
+        int32 Offset = (int32)(Pos % SegmentLap);
+
+        if (Offset == SegmentSize)
+        {
+            // Another producer is linking the next segment.
+            std::this_thread::yield();
+            continue;
+        }
+
+        FSegment* Segment = TailSegment.load(std::memory_order_acquire);
+        int32 Count = FMath::Min(Num, SegmentSize - Offset);
+        bool bLast = Offset + Count == SegmentSize;
+
+        if (bLast && NewSegment == nullptr)
+        {
+            NewSegment = new FSegment();
+        }
+
+        // Segment is only used once the claim proves it is still the tail segment: the
+        // consumer frees a segment after every position in it was claimed and published.
+        if (Tail.compare_exchange_weak(Pos, Pos + Count, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            if (bLast)
+            {
+                TailSegment.store(NewSegment, std::memory_order_release);
+                Tail.fetch_add(1, std::memory_order_release);
+                Segment->Next.store(NewSegment, std::memory_order_release);
+            }
+            else if (NewSegment != nullptr)
+            {
+                delete NewSegment;
+            }
+
+            OutCount = Count;
+            OutSlots = Segment->Values + Offset;
+            return Segment;
+        }
+    }
+}
+
+template<typename T>
+inline int32 TMPSCQueue<T>::DequeueBatch(T* OutValues, int32 Num)
+{
+    uint64 End = Tail.load(std::memory_order_acquire);
+    int32 Count = 0;
+
+    while (Count < Num && Head != End)
+    {
+        int32 Offset = (int32)(Head % SegmentLap);
+        if (Offset == SegmentSize)
+        {
+            // Every slot of the segment was read, its last producer links the next one.
+            FSegment* Next = HeadSegment->Next.load(std::memory_order_acquire);
+            if (Next == nullptr)
+            {
+                break;
+            }
+            delete HeadSegment;
+            HeadSegment = Next;
+            Head++;
+            continue;
+        }
+
+        // Claimed but the producer is still writing, values stay in order so stop here.
+        if (HeadSegment->Ready[Offset].load(std::memory_order_acquire) == 0)
+        {
+            break;
+        }
+
+        OutValues[Count++] = std::move(HeadSegment->Values[Offset]);
+        Head++;
+    }
+    return Count;
+}
@@ -0,0 +1,620 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <assert.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../math/math.h"
+#include "../memory/framearena.h"
+
+/**
+ * Work stealing job system.
+ *
+ * Every worker owns a Chase-Lev deque: it pushes and pops jobs at the bottom, idle workers steal
+ * from the top of a random victim. Threads that are not workers push into a shared injection
+ * queue and help executing jobs while they wait, so nested ParallelFor calls and waits inside
+ * jobs never block a worker. Completion is tracked with FJobCounter, which also serves as the
+ * dependency of jobs that must not start before other jobs finished.
+ */
+
+class FJobSystem;
+class FJobCounter;
+
+struct FJob
+{
+    void (*Execute)(FJob* Job);
+    /** Decremented after the job ran, may be null. */
+    FJobCounter* Counter;
+};
+
+/**
+ * @brief Number of unfinished jobs, and the jobs waiting for that number to reach zero.
+ *        A counter must outlive its jobs and must not be reused while jobs depend on it.
+ */
+class FJobCounter
+{
+public:
+    FJobCounter() : Count(0) {}
+
+    inline bool IsDone() const { return Count.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class FJobSystem;
+
+    std::atomic<int32> Count;
+
+    std::mutex Mutex;
+    std::vector<FJob*> Waiting;
+};
+
+/**
+ * @brief Chase-Lev work stealing deque of fixed capacity, Le et al. 2013 memory orders.
+ *        Push and Pop are called by the owner only, Steal by any thread.
+ */
+class FJobDeque
+{
+public:
+    enum { Capacity = 4096 };
+
+    FJobDeque() : Top(0), Bottom(0)
+    {
+        for (int32 i=0; i<Capacity; i++)
+        {
+            Jobs[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /** Returns false when the deque is full. */
+    inline bool Push(FJob* Job)
+    {
+        int64 B = Bottom.load(std::memory_order_relaxed);
+        int64 T = Top.load(std::memory_order_acquire);
+        if (B - T >= Capacity)
+        {
+            return false;
+        }
+
+        Jobs[B & (Capacity - 1)].store(Job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Bottom.store(B + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    inline FJob* Pop()
+    {
+        int64 B = Bottom.load(std::memory_order_relaxed) - 1;
+        Bottom.store(B, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 T = Top.load(std::memory_order_relaxed);
+
+        if (T > B)
+        {
+            Bottom.store(B + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        FJob* Job = Jobs[B & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (T == B)
+        {
+            // Last job, race the thieves for it.
+            if (!Top.compare_exchange_strong(T, T + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                Job = nullptr;
+            }
+            Bottom.store(B + 1, std::memory_order_relaxed);
+        }
+        return Job;
+    }
+
+    inline FJob* Steal()
+    {
+        int64 T = Top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 B = Bottom.load(std::memory_order_acquire);
+
+        if (T >= B)
+        {
+            return nullptr;
+        }
+
+        FJob* Job = Jobs[T & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (!Top.compare_exchange_strong(T, T + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return Job;
+    }
+
+private:
+    alignas(64) std::atomic<int64> Top;
+    alignas(64) std::atomic<int64> Bottom;
+    alignas(64) std::atomic<FJob*> Jobs[Capacity];
+};
+
+struct FJobSystemConfig
+{
+    /** Background workers, 0 for one per hardware thread minus the calling thread. */
+    int32 NumWorkers = 0;
+    /** Pin worker i to core i + 1, core 0 is left to the main thread. */
+    bool  bPinThreads = false;
+};
+
+class FJobSystem
+{
+public:
+    /**
+     * @brief The job system, started with the default config on first use.
+     */
+    static inline FJobSystem& Get();
+
+    /**
+     * @brief Start with a custom config, must be called before the first Get. Asserts when the
+     *        job system already runs, the config could not be applied any more.
+     */
+    static inline void Startup(const FJobSystemConfig& Config);
+
+    /**
+     * @brief Threads executing jobs, the workers plus the thread waiting for them.
+     */
+    inline int32 GetNumThreads() const { return (int32)Workers.size() + 1; }
+
+    /**
+     * @brief Run Function() as a job.
+     *
+     * @param Function The job, copied.
+     * @param Counter Incremented now and decremented when the job finished, may be null.
+     * @param DependsOn The job starts once this counter reached zero, may be null.
+     */
+    template<typename FunctionType>
+    inline void Run(FunctionType Function, FJobCounter* Counter = nullptr, FJobCounter* DependsOn = nullptr);
+
+    /**
+     * @brief Call Function(int32 Begin, int32 End) over [0, Num) split in ranges and wait for all
+     *        of them. The range is split in halves on demand, so an idle worker steals the largest
+     *        remaining piece. The grain is picked to give every thread a few ranges, rounded up to
+     *        a multiple of MinGrain, so range boundaries are always multiples of MinGrain.
+     *
+     * @param Num Number of elements.
+     * @param Function The range function, called concurrently.
+     * @param MinGrain Smallest range worth a job.
+     */
+    template<typename FunctionType>
+    inline void ParallelFor(int32 Num, const FunctionType& Function, int32 MinGrain = 1);
+
+    /**
+     * @brief Execute jobs until the counter reached zero. A counter must not be destroyed
+     *        before a Wait on it returned.
+     */
+    inline void Wait(FJobCounter& Counter);
+
+    ~FJobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> Lock(SleepMutex);
+            bStop = true;
+        }
+        WakeCondition.notify_all();
+
+        for (std::unique_ptr<FWorker>& Worker : Workers)
+        {
+            Worker->Thread.join();
+        }
+    }
+
+private:
+    struct FWorker
+    {
+        FJobDeque Deque;
+        std::thread Thread;
+        uint32 RandomState;
+    };
+
+    template<typename FunctionType>
+    struct TFunctionJob : public FJob
+    {
+        FunctionType Function;
+
+        TFunctionJob(const FunctionType& InFunction) : Function(InFunction) {}
+
+        static void ExecuteFunction(FJob* Job)
+        {
+            TFunctionJob* Self = static_cast<TFunctionJob*>(Job);
+            Self->Function();
+            delete Self;
+        }
+    };
+
+    /** Chunks [ChunkBegin, ChunkEnd) of a ParallelFor. */
+    template<typename FunctionType>
+    struct TRangeJob : public FJob
+    {
+        const FunctionType* Function;
+        TRangeJob* Jobs;
+        int32 ChunkBegin;
+        int32 ChunkEnd;
+        int32 Grain;
+        int32 Num;
+
+        static void ExecuteRange(FJob* Job);
+    };
+
+    inline FJobSystem(const FJobSystemConfig& Config);
+
+    static inline FJobSystem& GetInstance(const FJobSystemConfig* Config)
+    {
+        static FJobSystem Instance(Config != nullptr ? *Config : FJobSystemConfig());
+        return Instance;
+    }
+
+    /** Set by the constructor, Startup checks it was not started by an earlier Get. */
+    static inline std::atomic<bool>& IsCreated()
+    {
+        static std::atomic<bool> bCreated(false);
+        return bCreated;
+    }
+
+    /** Index of the calling thread in Workers, -1 for other threads. */
+    static inline int32& CurrentWorker()
+    {
+        thread_local int32 Index = -1;
+        return Index;
+    }
+
+    inline void Push(FJob* Job);
+    inline FJob* FindJob();
+    inline void ExecuteJob(FJob* Job);
+    inline void Finish(FJobCounter* Counter);
+    inline void WorkerMain(int32 Index);
+
+    static inline void PinThread(std::thread& Thread, int32 Core);
+
+    std::vector<std::unique_ptr<FWorker>> Workers;
+
+    std::mutex InjectionMutex;
+    std::deque<FJob*> InjectionQueue;
+    std::atomic<int32> NumInjected;
+
+    // Pushed jobs not yet taken, sleeping workers are woken when it becomes positive.
+    std::atomic<int32> NumPending;
+    std::atomic<int32> NumSleeping;
+    std::mutex SleepMutex;
+    std::condition_variable WakeCondition;
+    bool bStop;
+};
+
+inline FJobSystem& FJobSystem::Get()
+{
+    return GetInstance(nullptr);
+}
+
+inline void FJobSystem::Startup(const FJobSystemConfig& Config)
+{
+    assert(!IsCreated().load() && "FJobSystem::Startup called after the first FJobSystem::Get");
+    GetInstance(&Config);
+}
+
+inline FJobSystem::FJobSystem(const FJobSystemConfig& Config)
+: NumInjected(0), NumPending(0), NumSleeping(0), bStop(false)
+{
+    IsCreated().store(true);
+
+    int32 NumWorkers = Config.NumWorkers;
+    if (NumWorkers <= 0)
+    {
+        NumWorkers = (int32)std::thread::hardware_concurrency() - 1;
+        NumWorkers = NumWorkers > 1 ? NumWorkers : 1;
+    }
+
+    // Every deque exists before the first worker starts stealing.
+    for (int32 i=0; i<NumWorkers; i++)
+    {
+        Workers.emplace_back(new FWorker());
+        Workers[i]->RandomState = 0x9E3779B9u * (uint32)(i + 1);
+    }
+
+    for (int32 i=0; i<NumWorkers; i++)
+    {
+        Workers[i]->Thread = std::thread([this, i]() { WorkerMain(i); });
+        if (Config.bPinThreads)
+        {
+            PinThread(Workers[i]->Thread, i + 1);
+        }
+    }
+}
+
+template<typename FunctionType>
+inline void FJobSystem::Run(FunctionType Function, FJobCounter* Counter, FJobCounter* DependsOn)
+{
+    TFunctionJob<FunctionType>* Job = new TFunctionJob<FunctionType>(Function);
+    Job->Execute = &TFunctionJob<FunctionType>::ExecuteFunction;
+    Job->Counter = Counter;
+
+    if (Counter != nullptr)
+    {
+        Counter->Count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (DependsOn != nullptr)
+    {
+        std::lock_guard<std::mutex> Lock(DependsOn->Mutex);
+        if (!DependsOn->IsDone())
+        {
+            DependsOn->Waiting.push_back(Job);
+            return;
+        }
+    }
+
+    Push(Job);
+}
+
+template<typename FunctionType>
+inline void FJobSystem::TRangeJob<FunctionType>::ExecuteRange(FJob* Job)
+{
+    TRangeJob* Self = static_cast<TRangeJob*>(Job);
+    int32 ChunkEnd = Self->ChunkEnd;
+
+    // Hand out the upper half until a single chunk is left. Split points are unique, so the
+    // job of a half lives in the slot of its first chunk.
+    while (ChunkEnd - Self->ChunkBegin > 1)
+    {
+        int32 Mid = (Self->ChunkBegin + ChunkEnd) / 2;
+
+        TRangeJob& Half = Self->Jobs[Mid];
+        Half = *Self;
+        Half.ChunkBegin = Mid;
+        Half.ChunkEnd = ChunkEnd;
+
+        Self->Counter->Count.fetch_add(1, std::memory_order_relaxed);
+        FJobSystem::Get().Push(&Half);
+
+        ChunkEnd = Mid;
+    }
+
+    int32 Begin = Self->ChunkBegin * Self->Grain;
+    int32 End = Begin + Self->Grain < Self->Num ? Begin + Self->Grain : Self->Num;
+    (*Self->Function)(Begin, End);
+}
+
+template<typename FunctionType>
+inline void FJobSystem::ParallelFor(int32 Num, const FunctionType& Function, int32 MinGrain)
+{
+    if (Num <= 0)
+    {
+        return;
+    }
+
+    MinGrain = MinGrain > 1 ? MinGrain : 1;
+
+    // About 4 ranges per thread balances uneven ranges, splitting on demand keeps the cost of
+    // the extra ranges low.
+    int32 Target = GetNumThreads() * 4;
+    int32 Grain = (Num + Target - 1) / Target;
+    Grain = (Grain + MinGrain - 1) / MinGrain * MinGrain;
+
+    int32 NumChunks = (Num + Grain - 1) / Grain;
+    if (NumChunks <= 1)
+    {
+        Function(0, Num);
+        return;
+    }
+
+    // The jobs only live until Wait returns, scratch of the calling thread.
+    FArenaScope Scope(FScratchArena::Get());
+    TRangeJob<FunctionType>* Jobs = FScratchArena::Get().AllocArray<TRangeJob<FunctionType>>(NumChunks);
+    FJobCounter Counter;
+
+    TRangeJob<FunctionType>& Root = Jobs[0];
+    Root.Execute = &TRangeJob<FunctionType>::ExecuteRange;
+    Root.Counter = &Counter;
+    Root.Function = &Function;
+    Root.Jobs = Jobs;
+    Root.ChunkBegin = 0;
+    Root.ChunkEnd = NumChunks;
+    Root.Grain = Grain;
+    Root.Num = Num;
+
+    // The calling thread runs the root itself, its counter reference is implicit.
+    TRangeJob<FunctionType>::ExecuteRange(&Root);
+
+    Wait(Counter);
+}
+
+inline void FJobSystem::Wait(FJobCounter& Counter)
+{
+    while (!Counter.IsDone())
+    {
+        FJob* Job = FindJob();
+        if (Job != nullptr)
+        {
+            ExecuteJob(Job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // The last job may still be releasing the lock, the counter can go away once it did.
+    std::lock_guard<std::mutex> Lock(Counter.Mutex);
+}
+
+inline void FJobSystem::Push(FJob* Job)
+{
+    int32 Worker = CurrentWorker();
+    if (Worker >= 0)
+    {
+        if (!Workers[Worker]->Deque.Push(Job))
+        {
+            // Full, running it right away is still correct.
+            ExecuteJob(Job);
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> Lock(InjectionMutex);
+        InjectionQueue.push_back(Job);
+        NumInjected.fetch_add(1, std::memory_order_release);
+    }
+
+    NumPending.fetch_add(1, std::memory_order_seq_cst);
+    if (NumSleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        // Taking the lock orders the notify after a sleeper checked NumPending.
+        std::lock_guard<std::mutex> Lock(SleepMutex);
+        WakeCondition.notify_one();
+    }
+}
+
+inline FJob* FJobSystem::FindJob()
+{
+    int32 Worker = CurrentWorker();
+    FJob* Job = nullptr;
+
+    if (Worker >= 0)
+    {
+        Job = Workers[Worker]->Deque.Pop();
+    }
+
+    if (Job == nullptr && NumInjected.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard<std::mutex> Lock(InjectionMutex);
+        if (!InjectionQueue.empty())
+        {
+            Job = InjectionQueue.front();
+            InjectionQueue.pop_front();
+            NumInjected.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (Job == nullptr)
+    {
+        // Xorshift victim selection, threads that are not workers start at a fixed victim.
+        uint32 Random = 0;
+        if (Worker >= 0)
+        {
+            uint32& State = Workers[Worker]->RandomState;
+            State ^= State << 13; State ^= State >> 17; State ^= State << 5;
+            Random = State;
+        }
+
+        int32 NumWorkers = (int32)Workers.size();
+        for (int32 i=0; i<NumWorkers && Job == nullptr; i++)
+        {
+            int32 Victim = (int32)((Random + i) % NumWorkers);
+            if (Victim != Worker)
+            {
+                Job = Workers[Victim]->Deque.Steal();
+            }
+        }
+    }
+
+    if (Job != nullptr)
+    {
+        NumPending.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return Job;
+}
+
+inline void FJobSystem::ExecuteJob(FJob* Job)
+{
+    // The job may delete itself.
+    FJobCounter* Counter = Job->Counter;
+    Job->Execute(Job);
+    Finish(Counter);
+}
+
+inline void FJobSystem::Finish(FJobCounter* Counter)
+{
+    if (Counter == nullptr)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        int32 Count = Counter->Count.load(std::memory_order_acquire);
+        if (Count > 1)
+        {
+            if (Counter->Count.compare_exchange_weak(Count, Count - 1, std::memory_order_acq_rel))
+            {
+                return;
+            }
+            continue;
+        }
+
+        // The last job reaches zero under the lock, so no dependent job can be added after the
+        // waiting list was taken.
+        std::vector<FJob*> Ready;
+        {
+            std::lock_guard<std::mutex> Lock(Counter->Mutex);
+            if (!Counter->Count.compare_exchange_strong(Count, 0, std::memory_order_acq_rel))
+            {
+                continue;
+            }
+            Ready.swap(Counter->Waiting);
+        }
+
+        for (FJob* Job : Ready)
+        {
+            Push(Job);
+        }
+        return;
+    }
+}
+
+inline void FJobSystem::WorkerMain(int32 Index)
+{
+    CurrentWorker() = Index;
+
+    for (;;)
+    {
+        FJob* Job = FindJob();
+        if (Job != nullptr)
+        {
+            ExecuteJob(Job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock(SleepMutex);
+        NumSleeping.fetch_add(1, std::memory_order_seq_cst);
+        WakeCondition.wait(Lock, [this]() { return bStop || NumPending.load(std::memory_order_seq_cst) > 0; });
+        NumSleeping.fetch_sub(1, std::memory_order_relaxed);
+
+        if (bStop)
+        {
+            return;
+        }
+    }
+}
+
+inline void FJobSystem::PinThread(std::thread& Thread, int32 Core)
+{
+    int32 NumCores = (int32)std::thread::hardware_concurrency();
+    if (NumCores <= 0)
+    {
+        return;
+    }
+    Core %= NumCores;
+
+#if defined(_WIN32)
+    SetThreadAffinityMask(Thread.native_handle(), (DWORD_PTR)1 << Core);
+#elif defined(__linux__)
+    cpu_set_t Set;
+    CPU_ZERO(&Set);
+    CPU_SET(Core, &Set);
+    pthread_setaffinity_np(Thread.native_handle(), sizeof(cpu_set_t), &Set);
+#endif
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "vector.h"
+#include "sphere.h"
+
+/**
+ * @brief Axis aligned bounding box.
+ */
+struct FBox
+{
+    /** Minimum corner. */
+    FVector Min;
+    /** Maximum corner. */
+    FVector Max;
+
+public:
+    /** Empty box, grows with the first point added. */
+    FBox();
+    FBox(const FVector& _Min, const FVector& _Max);
+
+    /**
+     * @brief Build a box from its center and half size.
+     */
+    inline static FBox BuildAABB(const FVector& Center, const FVector& Extent);
+
+public:
+    /**
+     * @brief Grow the box to contain a point.
+     */
+    inline FBox& operator+=(const FVector& P);
+    /**
+     * @brief Grow the box to contain another box.
+     */
+    inline FBox& operator+=(const FBox& Other);
+    inline FBox  operator+(const FBox& Other) const;
+
+    /**
+     * @brief Is the box non-empty.
+     */
+    inline bool IsValid() const;
+
+    inline FVector GetCenter() const;
+    /**
+     * @brief Get the half size of the box.
+     */
+    inline FVector GetExtent() const;
+    inline FVector GetSize() const;
+
+    /**
+     * @brief Surface area, used as the cost metric of the SAH builder.
+     */
+    inline float GetSurfaceArea() const;
+
+    /**
+     * @brief Test if a point is inside the box.
+     */
+    inline bool IsInside(const FVector& P) const;
+
+    /**
+     * @brief Test if two boxes overlap, touching boxes overlap.
+     */
+    inline bool Intersects(const FBox& Other) const;
+
+    /**
+     * @brief Test if a sphere overlaps the box.
+     */
+    inline bool Intersects(const FSphere& Sphere) const;
+
+    /**
+     * @brief The sphere enclosing the box.
+     */
+    inline FSphere GetBoundingSphere() const;
+};
+
+inline FBox::FBox()
+: Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX)
+{
+
+}
+
+inline FBox::FBox(const FVector& _Min, const FVector& _Max)
+: Min(_Min), Max(_Max)
+{
+
+}
+
+inline FBox FBox::BuildAABB(const FVector& Center, const FVector& Extent)
+{
+    return FBox(Center - Extent, Center + Extent);
+}
+
+inline FBox& FBox::operator+=(const FVector& P)
+{
+    Min.X = FMath::Min(Min.X, P.X); Min.Y = FMath::Min(Min.Y, P.Y); Min.Z = FMath::Min(Min.Z, P.Z);
+    Max.X = FMath::Max(Max.X, P.X); Max.Y = FMath::Max(Max.Y, P.Y); Max.Z = FMath::Max(Max.Z, P.Z);
+    return *this;
+}
+
+inline FBox& FBox::operator+=(const FBox& Other)
+{
+    Min.X = FMath::Min(Min.X, Other.Min.X); Min.Y = FMath::Min(Min.Y, Other.Min.Y); Min.Z = FMath::Min(Min.Z, Other.Min.Z);
+    Max.X = FMath::Max(Max.X, Other.Max.X); Max.Y = FMath::Max(Max.Y, Other.Max.Y); Max.Z = FMath::Max(Max.Z, Other.Max.Z);
+    return *this;
+}
+
+inline FBox FBox::operator+(const FBox& Other) const
+{
+    FBox Result = *this;
+    Result += Other;
+    return Result;
+}
+
+inline bool FBox::IsValid() const
+{
+    return Min.X <= Max.X && Min.Y <= Max.Y && Min.Z <= Max.Z;
+}
+
+inline FVector FBox::GetCenter() const
+{
+    return (Min + Max) * 0.5f;
+}
+
+inline FVector FBox::GetExtent() const
+{
+    return (Max - Min) * 0.5f;
+}
+
+inline FVector FBox::GetSize() const
+{
+    return Max - Min;
+}
+
+inline float FBox::GetSurfaceArea() const
+{
+    FVector Size = Max - Min;
+    return 2.0f * (Size.X*Size.Y + Size.Y*Size.Z + Size.Z*Size.X);
+}
+
+inline bool FBox::IsInside(const FVector& P) const
+{
+    return P.X >= Min.X && P.X <= Max.X
+        && P.Y >= Min.Y && P.Y <= Max.Y
+        && P.Z >= Min.Z && P.Z <= Max.Z;
+}
+
+inline bool FBox::Intersects(const FBox& Other) const
+{
+    return Min.X <= Other.Max.X && Max.X >= Other.Min.X
+        && Min.Y <= Other.Max.Y && Max.Y >= Other.Min.Y
+        && Min.Z <= Other.Max.Z && Max.Z >= Other.Min.Z;
+}
+
+inline bool FBox::Intersects(const FSphere& Sphere) const
+{
+    // Distance from the center to the closest point of the box.
+    float DX = Sphere.Center.X - FMath::Min(FMath::Max(Sphere.Center.X, Min.X), Max.X);
+    float DY = Sphere.Center.Y - FMath::Min(FMath::Max(Sphere.Center.Y, Min.Y), Max.Y);
+    float DZ = Sphere.Center.Z - FMath::Min(FMath::Max(Sphere.Center.Z, Min.Z), Max.Z);
+
+    return DX*DX + DY*DY + DZ*DZ <= Sphere.W * Sphere.W;
+}
+
+inline FSphere FBox::GetBoundingSphere() const
+{
+    return FSphere(GetCenter(), GetExtent().Size());
+}
@@ -0,0 +1,793 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <string.h>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "box.h"
+#include "../job/jobsystem.h"
+#include "../memory/framearena.h"
+
+/**
+ * @brief Binary BVH node, 32 bytes. A leaf (Count > 0) references primitives
+ *        [LeftFirst, LeftFirst + Count) of FBVH::PrimitiveIndices, an inner node has its two
+ *        children at LeftFirst and LeftFirst + 1.
+ */
+struct FBVHNode
+{
+    float   MinX, MinY, MinZ;
+    uint32  LeftFirst;
+    float   MaxX, MaxY, MaxZ;
+    uint32  Count;
+
+    inline bool IsLeaf() const { return Count > 0; }
+    inline FBox GetBounds() const { return FBox(FVector(MinX, MinY, MinZ), FVector(MaxX, MaxY, MaxZ)); }
+    inline void SetBounds(const FBox& Box)
+    {
+        MinX = Box.Min.X; MinY = Box.Min.Y; MinZ = Box.Min.Z;
+        MaxX = Box.Max.X; MaxY = Box.Max.Y; MaxZ = Box.Max.Z;
+    }
+};
+
+static_assert(sizeof(FBVHNode) == 32, "FBVHNode must stay 32 bytes.");
+
+/**
+ * @brief Four children per node with their bounds in SoA so one node is tested with one SSE
+ *        slab test. Child >= 0 is a node index, otherwise ~Child is the first primitive and
+ *        Count the number of primitives. Empty slots have Count 0 and Child -1.
+ */
+struct FBVH4Node
+{
+    float   MinX[4], MinY[4], MinZ[4];
+    float   MaxX[4], MaxY[4], MaxZ[4];
+    int32   Child[4];
+    uint32  Count[4];
+};
+
+struct FBVHHit
+{
+    int32 PrimitiveIndex;
+    float T;
+};
+
+/**
+ * @brief Bounding volume hierarchy over axis aligned boxes.
+ *
+ * Built top-down with binned SAH, subtrees below the first levels are built in parallel.
+ * Primitives are only known by their bounds, ray casts and overlap queries call back into the
+ * caller for the exact test.
+ */
+class FBVH
+{
+public:
+    enum { NumBins = 16, MaxLeafSize = 4, MaxSAHDepth = 48 };
+
+    std::vector<FBVHNode>  Nodes;
+    std::vector<uint32>    PrimitiveIndices;
+    std::vector<FBVH4Node> Nodes4;
+
+public:
+    /**
+     * @brief Build the tree.
+     *
+     * @param Bounds Bounds of every primitive.
+     * @param Num Number of primitives.
+     * @param NumThreads Subtrees built concurrently as jobs, 1 builds on the calling thread only
+     *        and 0 uses one per job system thread.
+     */
+    inline void Build(const FBox* Bounds, int32 Num, int32 NumThreads = 1);
+
+    /**
+     * @brief Update node bounds after primitives moved, the topology is kept. Cheaper than a
+     *        rebuild but the tree quality degrades when objects move far.
+     */
+    inline void Refit(const FBox* Bounds);
+
+    /**
+     * @brief Build the 4-wide layout from the binary tree, call again after Refit.
+     */
+    inline void BuildWide();
+
+    /**
+     * @brief Find the nearest primitive hit by the line Start + Dir * t, t in [0, MaxT].
+     *
+     * @param IntersectPrimitive bool(int32 PrimitiveIndex, float& InOutT), returns true and
+     *        lowers InOutT when the primitive is hit closer than InOutT.
+     * @return true Something was hit, OutHit holds the nearest hit.
+     */
+    template<typename FunctionType>
+    inline bool RayCast(const FVector& Start, const FVector& Dir, float MaxT, FunctionType IntersectPrimitive, FBVHHit& OutHit) const;
+
+    /**
+     * @brief RayCast over the 4-wide layout, BuildWide must have been called.
+     */
+    template<typename FunctionType>
+    inline bool RayCast4(const FVector& Start, const FVector& Dir, float MaxT, FunctionType IntersectPrimitive, FBVHHit& OutHit) const;
+
+    /**
+     * @brief Call Visit(int32 PrimitiveIndex) for every primitive of the leaves overlapping Box,
+     *        the caller does the exact test.
+     */
+    template<typename FunctionType>
+    inline void Overlap(const FBox& Box, FunctionType Visit) const;
+
+private:
+    struct FBuildContext
+    {
+        FBuildContext() : Centroids(TArenaAllocator<FVector>(FScratchArena::Get())) {}
+
+        const FBox* Bounds;
+        TArenaVector<FVector> Centroids;
+        std::atomic<uint32> NodeCount;
+        int32 ParallelDepth;
+    };
+
+    struct FBin
+    {
+        FBox   Bounds;
+        uint32 Count;
+    };
+
+    /** Primitives per block of the parallel passes over a node near the root. */
+    enum { MinBlockSize = 16 * 1024 };
+
+    inline void BuildRecursive(FBuildContext& Context, uint32 NodeIndex, uint32 First, uint32 Count, int32 Depth);
+
+    inline void ComputeBounds(const FBuildContext& Context, uint32 First, uint32 Count, int32 NumBlocks, FBox& OutBounds, FBox& OutCentroidBounds) const;
+    inline void BinCentroids(const FBuildContext& Context, uint32 First, uint32 Count, int32 NumBlocks, const FBox& CentroidBounds, FBin (*OutBins)[NumBins]) const;
+    inline uint32 Partition(const FBuildContext& Context, uint32 First, uint32 Count, int32 NumBlocks, int32 Axis, int32 Split, const FBox& CentroidBounds);
+
+    template<typename FunctionType>
+    static inline void ForEachBlock(uint32 First, uint32 Count, int32 NumBlocks, const FunctionType& Function);
+
+    static inline int32 GetBin(const FVector& Centroid, int32 Axis, float CMin, float Scale)
+    {
+        int32 BinIndex = (int32)(((&Centroid.X)[Axis] - CMin) * Scale);
+        return BinIndex < NumBins - 1 ? BinIndex : NumBins - 1;
+    }
+
+    static inline bool IntersectSlab(const FVector& Start, const FVector& InvDir, float MaxT, const FBVHNode& Node, float& OutTMin);
+};
+
+inline void FBVH::Build(const FBox* Bounds, int32 Num, int32 NumThreads)
+{
+    Nodes.clear();
+    Nodes4.clear();
+    PrimitiveIndices.resize(Num);
+    if (Num == 0)
+    {
+        return;
+    }
+
+    // A binary tree with single primitive leaves has at most 2N - 1 nodes.
+    Nodes.resize(2 * Num - 1);
+
+    // Centroids are build scratch, taken from the scratch arena of the calling thread.
+    FArenaScope Scope(FScratchArena::Get());
+    FBuildContext Context;
+    Context.Bounds = Bounds;
+    Context.Centroids.resize(Num);
+    Context.NodeCount = 1;
+
+    // Each level below the root doubles the number of concurrent subtrees.
+    if (NumThreads < 1)
+    {
+        NumThreads = FJobSystem::Get().GetNumThreads();
+    }
+    Context.ParallelDepth = 0;
+    while ((1 << Context.ParallelDepth) < NumThreads)
+    {
+        Context.ParallelDepth++;
+    }
+
+    for (int32 i=0; i<Num; i++)
+    {
+        PrimitiveIndices[i] = i;
+        Context.Centroids[i] = Bounds[i].GetCenter();
+    }
+
+    BuildRecursive(Context, 0, 0, Num, 0);
+
+    Nodes.resize(Context.NodeCount);
+}
+
+inline void FBVH::BuildRecursive(FBuildContext& Context, uint32 NodeIndex, uint32 First, uint32 Count, int32 Depth)
+{
+    // Near the root the passes over the primitives are split in blocks run as jobs, otherwise the
+    // root alone is a serial pass over all of them before the first subtree job starts.
+    int32 NumBlocks = 1;
+    if (Depth < Context.ParallelDepth)
+    {
+        NumBlocks = FMath::Max(FMath::Min(FJobSystem::Get().GetNumThreads() * 4, (int32)(Count / MinBlockSize)), 1);
+    }
+
+    FBox NodeBounds;
+    FBox CentroidBounds;
+    ComputeBounds(Context, First, Count, NumBlocks, NodeBounds, CentroidBounds);
+
+    FBVHNode& Node = Nodes[NodeIndex];
+    Node.SetBounds(NodeBounds);
+    Node.LeftFirst = First;
+    Node.Count = Count;
+
+    if (Count <= 1)
+    {
+        return;
+    }
+
+    // Binned SAH on all three axes.
+    FBin Bins[3][NumBins];
+    BinCentroids(Context, First, Count, NumBlocks, CentroidBounds, Bins);
+
+    int32 BestAxis = -1;
+    int32 BestSplit = 0;
+    float BestCost = FLT_MAX;
+
+    for (int32 Axis=0; Axis<3; Axis++)
+    {
+        if ((&CentroidBounds.Max.X)[Axis] - (&CentroidBounds.Min.X)[Axis] <= FLT_TOLERANCE)
+        {
+            continue;
+        }
+
+        // Sweep from the right to get the cost of every right side, then from the left.
+        float RightArea[NumBins];
+        uint32 RightCount[NumBins];
+        FBox Accumulated;
+        uint32 AccumulatedCount = 0;
+        for (int32 i=NumBins-1; i>0; i--)
+        {
+            Accumulated += Bins[Axis][i].Bounds;
+            AccumulatedCount += Bins[Axis][i].Count;
+            RightArea[i] = AccumulatedCount ? Accumulated.GetSurfaceArea() : 0.0f;
+            RightCount[i] = AccumulatedCount;
+        }
+
+        Accumulated = FBox();
+        AccumulatedCount = 0;
+        for (int32 i=0; i<NumBins-1; i++)
+        {
+            Accumulated += Bins[Axis][i].Bounds;
+            AccumulatedCount += Bins[Axis][i].Count;
+
+            float LeftArea = AccumulatedCount ? Accumulated.GetSurfaceArea() : 0.0f;
+            float Cost = LeftArea * AccumulatedCount + RightArea[i + 1] * RightCount[i + 1];
+            if (AccumulatedCount > 0 && RightCount[i + 1] > 0 && Cost < BestCost)
+            {
+                BestCost = Cost;
+                BestAxis = Axis;
+                BestSplit = i + 1;
+            }
+        }
+    }
+
+    // Small nodes stay leaves when splitting does not pay off. Costs are in units of one
+    // primitive test, visiting the extra node is counted as one more.
+    float NodeArea = NodeBounds.GetSurfaceArea();
+    float LeafCost = NodeArea * Count;
+    if (Count <= MaxLeafSize && (BestAxis < 0 || NodeArea + BestCost >= LeafCost))
+    {
+        return;
+    }
+
+    // Coincident centroids, or a tree getting too deep for the traversal stacks: split in the
+    // middle, which bounds the remaining depth to log2(Count).
+    if (BestAxis < 0 || Depth >= MaxSAHDepth)
+    {
+        BestSplit = -1;
+    }
+
+    uint32 Mid = BestSplit < 0 ? First + Count / 2 : Partition(Context, First, Count, NumBlocks, BestAxis, BestSplit, CentroidBounds);
+
+    // Children are always allocated after their parent, Refit relies on it.
+    uint32 LeftChild = Context.NodeCount.fetch_add(2);
+    Node.LeftFirst = LeftChild;
+    Node.Count = 0;
+
+    if (Depth < Context.ParallelDepth && Count > 4096)
+    {
+        FJobCounter LeftDone;
+        FJobSystem::Get().Run([this, &Context, LeftChild, First, Mid, Depth]()
+        {
+            BuildRecursive(Context, LeftChild, First, Mid - First, Depth + 1);
+        }, &LeftDone);
+        BuildRecursive(Context, LeftChild + 1, Mid, First + Count - Mid, Depth + 1);
+        FJobSystem::Get().Wait(LeftDone);
+    }
+    else
+    {
+        BuildRecursive(Context, LeftChild, First, Mid - First, Depth + 1);
+        BuildRecursive(Context, LeftChild + 1, Mid, First + Count - Mid, Depth + 1);
+    }
+}
+
+template<typename FunctionType>
+inline void FBVH::ForEachBlock(uint32 First, uint32 Count, int32 NumBlocks, const FunctionType& Function)
+{
+    uint32 BlockSize = (Count + NumBlocks - 1) / NumBlocks;
+
+    auto Range = [&](int32 BlockBegin, int32 BlockEnd)
+    {
+        for (int32 Block = BlockBegin; Block < BlockEnd; Block++)
+        {
+            uint32 Begin = First + Block * BlockSize;
+            Function(Block, Begin, FMath::Min(Begin + BlockSize, First + Count));
+        }
+    };
+
+    if (NumBlocks > 1)
+    {
+        FJobSystem::Get().ParallelFor(NumBlocks, Range);
+    }
+    else
+    {
+        Range(0, 1);
+    }
+}
+
+inline void FBVH::ComputeBounds(const FBuildContext& Context, uint32 First, uint32 Count, int32 NumBlocks, FBox& OutBounds, FBox& OutCentroidBounds) const
+{
+    FLinearArena& Arena = FScratchArena::Get();
+    FArenaScope Scope(Arena);
+    FBox* BlockBounds = Arena.AllocArray<FBox>(2 * NumBlocks);
+
+    ForEachBlock(First, Count, NumBlocks, [&](int32 Block, uint32 Begin, uint32 End)
+    {
+        FBox Bounds;
+        FBox CentroidBounds;
+        for (uint32 i=Begin; i<End; i++)
+        {
+            Bounds += Context.Bounds[PrimitiveIndices[i]];
+            CentroidBounds += Context.Centroids[PrimitiveIndices[i]];
+        }
+        BlockBounds[2 * Block] = Bounds;
+        BlockBounds[2 * Block + 1] = CentroidBounds;
+    });
+
+    OutBounds = FBox();
+    OutCentroidBounds = FBox();
+    for (int32 Block=0; Block<NumBlocks; Block++)
+    {
+        OutBounds += BlockBounds[2 * Block];
+        OutCentroidBounds += BlockBounds[2 * Block + 1];
+    }
+}
+
+inline void FBVH::BinCentroids(const FBuildContext& Context, uint32 First, uint32 Count, int32 NumBlocks, const FBox& CentroidBounds, FBin (*OutBins)[NumBins]) const
+{
+    // Axes whose centroids coincide are not split, their bins stay empty.
+    float CMin[3], Scale[3];
+    bool bAxis[3];
+    for (int32 Axis=0; Axis<3; Axis++)
+    {
+        CMin[Axis] = (&CentroidBounds.Min.X)[Axis];
+        float Extent = (&CentroidBounds.Max.X)[Axis] - CMin[Axis];
+        bAxis[Axis] = Extent > FLT_TOLERANCE;
+        Scale[Axis] = bAxis[Axis] ? NumBins / Extent : 0.0f;
+    }
+
+    FLinearArena& Arena = FScratchArena::Get();
+    FArenaScope Scope(Arena);
+    FBin* BlockBins = Arena.AllocArray<FBin>((size_t)NumBlocks * 3 * NumBins);
+
+    ForEachBlock(First, Count, NumBlocks, [&](int32 Block, uint32 Begin, uint32 End)
+    {
+        FBin* Bins = BlockBins + (size_t)Block * 3 * NumBins;
+        for (int32 b=0; b<3*NumBins; b++)
+        {
+            Bins[b].Bounds = FBox();
+            Bins[b].Count = 0;
+        }
+
+        for (uint32 i=Begin; i<End; i++)
+        {
+            uint32 Primitive = PrimitiveIndices[i];
+            for (int32 Axis=0; Axis<3; Axis++)
+            {
+                if (bAxis[Axis])
+                {
+                    FBin& Bin = Bins[Axis * NumBins + GetBin(Context.Centroids[Primitive], Axis, CMin[Axis], Scale[Axis])];
+                    Bin.Bounds += Context.Bounds[Primitive];
+                    Bin.Count++;
+                }
+            }
+        }
+    });
+
+    for (int32 Axis=0; Axis<3; Axis++)
+    {
+        for (int32 b=0; b<NumBins; b++)
+        {
+            OutBins[Axis][b] = BlockBins[Axis * NumBins + b];
+            for (int32 Block=1; Block<NumBlocks; Block++)
+            {
+                const FBin& Bin = BlockBins[((size_t)Block * 3 + Axis) * NumBins + b];
+                OutBins[Axis][b].Bounds += Bin.Bounds;
+                OutBins[Axis][b].Count += Bin.Count;
+            }
+        }
+    }
+}
+
+inline uint32 FBVH::Partition(const FBuildContext& Context, uint32 First, uint32 Count, int32 NumBlocks, int32 Axis, int32 Split, const FBox& CentroidBounds)
+{
+    float CMin = (&CentroidBounds.Min.X)[Axis];
+    float Scale = NumBins / ((&CentroidBounds.Max.X)[Axis] - CMin);
+
+    if (NumBlocks <= 1)
+    {
+        uint32* Left = &PrimitiveIndices[First];
+        uint32* Right = Left + Count - 1;
+        while (Left <= Right)
+        {
+            if (GetBin(Context.Centroids[*Left], Axis, CMin, Scale) < Split)
+            {
+                Left++;
+            }
+            else
+            {
+                uint32 Temp = *Left; *Left = *Right; *Right = Temp;
+                Right--;
+            }
+        }
+        return (uint32)(Left - &PrimitiveIndices[0]);
+    }
+
+    // Count the left side of every block, scan, then scatter both sides into scratch and copy
+    // back. Stable, unlike the in place swap, the node gets the same two sets either way.
+    FLinearArena& Arena = FScratchArena::Get();
+    FArenaScope Scope(Arena);
+    uint32* LeftOffsets = Arena.AllocArray<uint32>(NumBlocks);
+    uint32* RightOffsets = Arena.AllocArray<uint32>(NumBlocks);
+    uint32* Sorted = Arena.AllocArray<uint32>(Count);
+
+    ForEachBlock(First, Count, NumBlocks, [&](int32 Block, uint32 Begin, uint32 End)
+    {
+        uint32 NumLeft = 0;
+        for (uint32 i=Begin; i<End; i++)
+        {
+            NumLeft += GetBin(Context.Centroids[PrimitiveIndices[i]], Axis, CMin, Scale) < Split ? 1 : 0;
+        }
+        LeftOffsets[Block] = NumLeft;
+        RightOffsets[Block] = (End - Begin) - NumLeft;
+    });
+
+    uint32 NumLeft = 0;
+    for (int32 Block=0; Block<NumBlocks; Block++)
+    {
+        NumLeft += LeftOffsets[Block];
+    }
+    uint32 LeftSum = 0;
+    uint32 RightSum = NumLeft;
+    for (int32 Block=0; Block<NumBlocks; Block++)
+    {
+        uint32 BlockLeft = LeftOffsets[Block];
+        uint32 BlockRight = RightOffsets[Block];
+        LeftOffsets[Block] = LeftSum;
+        RightOffsets[Block] = RightSum;
+        LeftSum += BlockLeft;
+        RightSum += BlockRight;
+    }
+
+    ForEachBlock(First, Count, NumBlocks, [&](int32 Block, uint32 Begin, uint32 End)
+    {
+        uint32 Left = LeftOffsets[Block];
+        uint32 Right = RightOffsets[Block];
+        for (uint32 i=Begin; i<End; i++)
+        {
+            uint32 Primitive = PrimitiveIndices[i];
+            Sorted[GetBin(Context.Centroids[Primitive], Axis, CMin, Scale) < Split ? Left++ : Right++] = Primitive;
+        }
+    });
+
+    ForEachBlock(First, Count, NumBlocks, [&](int32, uint32 Begin, uint32 End)
+    {
+        memcpy(&PrimitiveIndices[Begin], Sorted + (Begin - First), (End - Begin) * sizeof(uint32));
+    });
+
+    return First + NumLeft;
+}
+
+inline void FBVH::Refit(const FBox* Bounds)
+{
+    // Children have higher indices than their parent, so a reverse sweep is bottom-up.
+    for (int32 i=(int32)Nodes.size()-1; i>=0; i--)
+    {
+        FBVHNode& Node = Nodes[i];
+        FBox NodeBounds;
+
+        if (Node.IsLeaf())
+        {
+            for (uint32 p=Node.LeftFirst; p<Node.LeftFirst+Node.Count; p++)
+            {
+                NodeBounds += Bounds[PrimitiveIndices[p]];
+            }
+        }
+        else
+        {
+            NodeBounds = Nodes[Node.LeftFirst].GetBounds() + Nodes[Node.LeftFirst + 1].GetBounds();
+        }
+
+        Node.SetBounds(NodeBounds);
+    }
+
+    if (!Nodes4.empty())
+    {
+        BuildWide();
+    }
+}
+
+inline void FBVH::BuildWide()
+{
+    Nodes4.clear();
+    if (Nodes.empty())
+    {
+        return;
+    }
+
+    // Every wide node takes the grandchildren of a binary node, leaves are kept as they are.
+    struct FPending
+    {
+        uint32 BinaryNode;
+        uint32 WideNode;
+    };
+    std::vector<FPending> Stack;
+    Nodes4.push_back(FBVH4Node());
+    Stack.push_back({ 0, 0 });
+
+    while (!Stack.empty())
+    {
+        FPending Pending = Stack.back();
+        Stack.pop_back();
+
+        uint32 Children[4];
+        int32 NumChildren = 0;
+
+        const FBVHNode& Root = Nodes[Pending.BinaryNode];
+        if (Root.IsLeaf())
+        {
+            Children[NumChildren++] = Pending.BinaryNode;
+        }
+        else
+        {
+            for (int32 c=0; c<2; c++)
+            {
+                const FBVHNode& Child = Nodes[Root.LeftFirst + c];
+                if (Child.IsLeaf())
+                {
+                    Children[NumChildren++] = Root.LeftFirst + c;
+                }
+                else
+                {
+                    Children[NumChildren++] = Child.LeftFirst;
+                    Children[NumChildren++] = Child.LeftFirst + 1;
+                }
+            }
+        }
+
+        FBVH4Node Wide;
+        for (int32 c=0; c<4; c++)
+        {
+            if (c >= NumChildren)
+            {
+                // Skipped by traversal because of Count 0 and Child -1, not by its bounds: the slab
+                // test orders the two planes of every axis, inverted bounds become the widest
+                // interval and pass it.
+                Wide.MinX[c] = Wide.MinY[c] = Wide.MinZ[c] = FLT_MAX;
+                Wide.MaxX[c] = Wide.MaxY[c] = Wide.MaxZ[c] = -FLT_MAX;
+                Wide.Child[c] = -1;
+                Wide.Count[c] = 0;
+                continue;
+            }
+
+            const FBVHNode& Child = Nodes[Children[c]];
+            Wide.MinX[c] = Child.MinX; Wide.MinY[c] = Child.MinY; Wide.MinZ[c] = Child.MinZ;
+            Wide.MaxX[c] = Child.MaxX; Wide.MaxY[c] = Child.MaxY; Wide.MaxZ[c] = Child.MaxZ;
+
+            if (Child.IsLeaf())
+            {
+                Wide.Child[c] = ~(int32)Child.LeftFirst;
+                Wide.Count[c] = Child.Count;
+            }
+            else
+            {
+                Wide.Child[c] = (int32)Nodes4.size();
+                Wide.Count[c] = 0;
+                Nodes4.push_back(FBVH4Node());
+                Stack.push_back({ Children[c], (uint32)Wide.Child[c] });
+            }
+        }
+        Nodes4[Pending.WideNode] = Wide;
+    }
+}
+
+inline bool FBVH::IntersectSlab(const FVector& Start, const FVector& InvDir, float MaxT, const FBVHNode& Node, float& OutTMin)
+{
+    float TX1 = (Node.MinX - Start.X) * InvDir.X, TX2 = (Node.MaxX - Start.X) * InvDir.X;
+    float TY1 = (Node.MinY - Start.Y) * InvDir.Y, TY2 = (Node.MaxY - Start.Y) * InvDir.Y;
+    float TZ1 = (Node.MinZ - Start.Z) * InvDir.Z, TZ2 = (Node.MaxZ - Start.Z) * InvDir.Z;
+
+    float TMin = FMath::Max(FMath::Max(FMath::Min(TX1, TX2), FMath::Min(TY1, TY2)), FMath::Max(FMath::Min(TZ1, TZ2), 0.0f));
+    float TMax = FMath::Min(FMath::Min(FMath::Max(TX1, TX2), FMath::Max(TY1, TY2)), FMath::Min(FMath::Max(TZ1, TZ2), MaxT));
+
+    OutTMin = TMin;
+    return TMin <= TMax;
+}
+
+template<typename FunctionType>
+inline bool FBVH::RayCast(const FVector& Start, const FVector& Dir, float MaxT, FunctionType IntersectPrimitive, FBVHHit& OutHit) const
+{
+    if (Nodes.empty())
+    {
+        return false;
+    }
+
+    FVector InvDir(1.0f / Dir.X, 1.0f / Dir.Y, 1.0f / Dir.Z);
+
+    OutHit.PrimitiveIndex = -1;
+    OutHit.T = MaxT;
+
+    uint32 Stack[128];
+    int32 StackSize = 0;
+    Stack[StackSize++] = 0;
+
+    while (StackSize > 0)
+    {
+        const FBVHNode& Node = Nodes[Stack[--StackSize]];
+
+        float TNode;
+        if (!IntersectSlab(Start, InvDir, OutHit.T, Node, TNode))
+        {
+            continue;
+        }
+
+        if (Node.IsLeaf())
+        {
+            for (uint32 p=Node.LeftFirst; p<Node.LeftFirst+Node.Count; p++)
+            {
+                if (IntersectPrimitive((int32)PrimitiveIndices[p], OutHit.T))
+                {
+                    OutHit.PrimitiveIndex = (int32)PrimitiveIndices[p];
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so OutHit.T shrinks early.
+        float TLeft, TRight;
+        bool bLeft = IntersectSlab(Start, InvDir, OutHit.T, Nodes[Node.LeftFirst], TLeft);
+        bool bRight = IntersectSlab(Start, InvDir, OutHit.T, Nodes[Node.LeftFirst + 1], TRight);
+
+        if (bLeft && bRight)
+        {
+            uint32 Near = TLeft <= TRight ? Node.LeftFirst : Node.LeftFirst + 1;
+            Stack[StackSize++] = Near == Node.LeftFirst ? Node.LeftFirst + 1 : Node.LeftFirst;
+            Stack[StackSize++] = Near;
+        }
+        else if (bLeft)
+        {
+            Stack[StackSize++] = Node.LeftFirst;
+        }
+        else if (bRight)
+        {
+            Stack[StackSize++] = Node.LeftFirst + 1;
+        }
+    }
+
+    return OutHit.PrimitiveIndex >= 0;
+}
+
+template<typename FunctionType>
+inline bool FBVH::RayCast4(const FVector& Start, const FVector& Dir, float MaxT, FunctionType IntersectPrimitive, FBVHHit& OutHit) const
+{
+    if (Nodes4.empty())
+    {
+        return false;
+    }
+
+    OutHit.PrimitiveIndex = -1;
+    OutHit.T = MaxT;
+
+    FVector InvDir(1.0f / Dir.X, 1.0f / Dir.Y, 1.0f / Dir.Z);
+
+    int32 Stack[256];
+    int32 StackSize = 0;
+    Stack[StackSize++] = 0;
+
+    while (StackSize > 0)
+    {
+        const FBVH4Node& Node = Nodes4[Stack[--StackSize]];
+
+        int32 HitMask = 0;
+#if defined(__SSE__) || defined(_M_X64)
+        __m128 SX = _mm_set1_ps(Start.X), SY = _mm_set1_ps(Start.Y), SZ = _mm_set1_ps(Start.Z);
+        __m128 IX = _mm_set1_ps(InvDir.X), IY = _mm_set1_ps(InvDir.Y), IZ = _mm_set1_ps(InvDir.Z);
+
+        __m128 TX1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Node.MinX), SX), IX);
+        __m128 TX2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Node.MaxX), SX), IX);
+        __m128 TY1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Node.MinY), SY), IY);
+        __m128 TY2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Node.MaxY), SY), IY);
+        __m128 TZ1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Node.MinZ), SZ), IZ);
+        __m128 TZ2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Node.MaxZ), SZ), IZ);
+
+        __m128 TMin = _mm_max_ps(_mm_max_ps(_mm_min_ps(TX1, TX2), _mm_min_ps(TY1, TY2)), _mm_max_ps(_mm_min_ps(TZ1, TZ2), _mm_setzero_ps()));
+        __m128 TMax = _mm_min_ps(_mm_min_ps(_mm_max_ps(TX1, TX2), _mm_max_ps(TY1, TY2)), _mm_min_ps(_mm_max_ps(TZ1, TZ2), _mm_set1_ps(OutHit.T)));
+
+        HitMask = _mm_movemask_ps(_mm_cmple_ps(TMin, TMax));
+#else
+        for (int32 c=0; c<4; c++)
+        {
+            FBVHNode Child;
+            Child.MinX = Node.MinX[c]; Child.MinY = Node.MinY[c]; Child.MinZ = Node.MinZ[c];
+            Child.MaxX = Node.MaxX[c]; Child.MaxY = Node.MaxY[c]; Child.MaxZ = Node.MaxZ[c];
+            float TChild;
+            HitMask |= IntersectSlab(Start, InvDir, OutHit.T, Child, TChild) ? (1 << c) : 0;
+        }
+#endif
+
+        for (int32 c=0; c<4; c++)
+        {
+            if (!(HitMask & (1 << c)))
+            {
+                continue;
+            }
+
+            if (Node.Count[c] > 0)
+            {
+                uint32 FirstPrimitive = (uint32)~Node.Child[c];
+                for (uint32 p=FirstPrimitive; p<FirstPrimitive+Node.Count[c]; p++)
+                {
+                    if (IntersectPrimitive((int32)PrimitiveIndices[p], OutHit.T))
+                    {
+                        OutHit.PrimitiveIndex = (int32)PrimitiveIndices[p];
+                    }
+                }
+            }
+            else if (Node.Child[c] >= 0)
+            {
+                Stack[StackSize++] = Node.Child[c];
+            }
+        }
+    }
+
+    return OutHit.PrimitiveIndex >= 0;
+}
+
+template<typename FunctionType>
+inline void FBVH::Overlap(const FBox& Box, FunctionType Visit) const
+{
+    if (Nodes.empty())
+    {
+        return;
+    }
+
+    uint32 Stack[128];
+    int32 StackSize = 0;
+    Stack[StackSize++] = 0;
+
+    while (StackSize > 0)
+    {
+        const FBVHNode& Node = Nodes[Stack[--StackSize]];
+
+        if (!Box.Intersects(Node.GetBounds()))
+        {
+            continue;
+        }
+
+        if (Node.IsLeaf())
+        {
+            for (uint32 p=Node.LeftFirst; p<Node.LeftFirst+Node.Count; p++)
+            {
+                Visit((int32)PrimitiveIndices[p]);
+            }
+        }
+        else
+        {
+            Stack[StackSize++] = Node.LeftFirst;
+            Stack[StackSize++] = Node.LeftFirst + 1;
+        }
+    }
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "matrix.h"
+#include "plane.h"
+#include "box.h"
+#include "sphere.h"
+#include "../job/jobsystem.h"
+#include "../memory/framearena.h"
+
+/**
+ * @brief Bounds stored as separate arrays per component, the layout the batch culler reads.
+ *        For spheres only ExtentX is used and holds the radius.
+ */
+struct FCullingBoundsSoA
+{
+    const float* CenterX;
+    const float* CenterY;
+    const float* CenterZ;
+    const float* ExtentX;
+    const float* ExtentY;
+    const float* ExtentZ;
+};
+
+/**
+ * @brief The six planes of a view frustum, normals pointing inside.
+ */
+struct FFrustum
+{
+    enum { Left, Right, Bottom, Top, Near, Far, NumPlanes };
+
+    FPlane Planes[NumPlanes];
+
+    /** Planes transposed for the batch culler, one array per component. */
+    float PlaneX[NumPlanes];
+    float PlaneY[NumPlanes];
+    float PlaneZ[NumPlanes];
+    float PlaneW[NumPlanes];
+    float PlaneAbsX[NumPlanes];
+    float PlaneAbsY[NumPlanes];
+    float PlaneAbsZ[NumPlanes];
+
+public:
+    FFrustum();
+
+    /**
+     * @brief Extract the planes of a view-projection matrix (Gribb-Hartmann). The matrix
+     *        transforms row vectors and clip space depth is in [0, W].
+     *
+     * @param ViewProjection The view-projection matrix.
+     */
+    explicit FFrustum(const FMatrix& ViewProjection);
+
+public:
+    inline bool IntersectBox(const FBox& Box) const;
+    inline bool IntersectSphere(const FSphere& Sphere) const;
+
+    /**
+     * @brief Test boxes [Begin, End) against the frustum and write one visibility bit per box to
+     *        OutVisibility (bit i%8 of byte i/8). Begin must be a multiple of 8 so ranges handed
+     *        to different threads never share an output byte.
+     *
+     * @param Bounds Box centers and extents.
+     * @param Begin First box to test.
+     * @param End One past the last box to test.
+     * @param OutVisibility Visibility bitmask.
+     */
+    inline void CullBoxes(const FCullingBoundsSoA& Bounds, int32 Begin, int32 End, uint8* OutVisibility) const;
+
+    /**
+     * @brief Same as CullBoxes for spheres, the radius is read from Bounds.ExtentX.
+     */
+    inline void CullSpheres(const FCullingBoundsSoA& Bounds, int32 Begin, int32 End, uint8* OutVisibility) const;
+
+    /**
+     * @brief Cull Num boxes with FJobSystem::ParallelFor, ranges are multiples of 8.
+     */
+    inline void CullBoxesParallel(const FCullingBoundsSoA& Bounds, int32 Num, uint8* OutVisibility) const;
+
+    /**
+     * @brief Cull Num spheres with FJobSystem::ParallelFor, ranges are multiples of 8.
+     */
+    inline void CullSpheresParallel(const FCullingBoundsSoA& Bounds, int32 Num, uint8* OutVisibility) const;
+
+    /**
+     * @brief CullBoxesParallel into a bitmask from the frame arena of the calling thread, valid
+     *        until FFrameArena::EndFrame.
+     */
+    inline const uint8* CullBoxesParallel(const FCullingBoundsSoA& Bounds, int32 Num) const;
+
+private:
+    inline void UpdateSoA();
+
+    template<bool bSpheres>
+    inline void CullRange(const FCullingBoundsSoA& Bounds, int32 Begin, int32 End, uint8* OutVisibility) const;
+};
+
+inline FFrustum::FFrustum()
+{
+
+}
+
+inline FFrustum::FFrustum(const FMatrix& ViewProjection)
+{
+    const float (&M)[4][4] = ViewProjection.M;
+
+    // Clip space X = P|Column0, the plane of -W <= X is then P|(Column3 + Column0) >= 0.
+    Planes[Left]   = FPlane(M[0][3] + M[0][0], M[1][3] + M[1][0], M[2][3] + M[2][0], -(M[3][3] + M[3][0]));
+    Planes[Right]  = FPlane(M[0][3] - M[0][0], M[1][3] - M[1][0], M[2][3] - M[2][0], -(M[3][3] - M[3][0]));
+    Planes[Bottom] = FPlane(M[0][3] + M[0][1], M[1][3] + M[1][1], M[2][3] + M[2][1], -(M[3][3] + M[3][1]));
+    Planes[Top]    = FPlane(M[0][3] - M[0][1], M[1][3] - M[1][1], M[2][3] - M[2][1], -(M[3][3] - M[3][1]));
+    Planes[Near]   = FPlane(M[0][2], M[1][2], M[2][2], -M[3][2]);
+    Planes[Far]    = FPlane(M[0][3] - M[0][2], M[1][3] - M[1][2], M[2][3] - M[2][2], -(M[3][3] - M[3][2]));
+
+    for (int32 i=0; i<NumPlanes; i++)
+    {
+        Planes[i].Normalize();
+    }
+
+    UpdateSoA();
+}
+
+inline void FFrustum::UpdateSoA()
+{
+    for (int32 i=0; i<NumPlanes; i++)
+    {
+        PlaneX[i] = Planes[i].X;
+        PlaneY[i] = Planes[i].Y;
+        PlaneZ[i] = Planes[i].Z;
+        PlaneW[i] = Planes[i].W;
+        PlaneAbsX[i] = fabsf(Planes[i].X);
+        PlaneAbsY[i] = fabsf(Planes[i].Y);
+        PlaneAbsZ[i] = fabsf(Planes[i].Z);
+    }
+}
+
+inline bool FFrustum::IntersectBox(const FBox& Box) const
+{
+    FVector Center = Box.GetCenter();
+    FVector Extent = Box.GetExtent();
+
+    for (int32 i=0; i<NumPlanes; i++)
+    {
+        float Distance = Planes[i].PlaneDot(Center);
+        float PushOut  = PlaneAbsX[i] * Extent.X + PlaneAbsY[i] * Extent.Y + PlaneAbsZ[i] * Extent.Z;
+
+        if (Distance < -PushOut)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool FFrustum::IntersectSphere(const FSphere& Sphere) const
+{
+    for (int32 i=0; i<NumPlanes; i++)
+    {
+        if (Planes[i].PlaneDot(Sphere.Center) < -Sphere.W)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<bool bSpheres>
+inline void FFrustum::CullRange(const FCullingBoundsSoA& Bounds, int32 Begin, int32 End, uint8* OutVisibility) const
+{
+    int32 i = Begin;
+
+#if defined(__AVX__)
+    // 8 bounds per iteration, all 6 planes, the lane mask becomes one output byte.
+    for (; i + 8 <= End; i += 8)
+    {
+        __m256 CX = _mm256_loadu_ps(Bounds.CenterX + i);
+        __m256 CY = _mm256_loadu_ps(Bounds.CenterY + i);
+        __m256 CZ = _mm256_loadu_ps(Bounds.CenterZ + i);
+        __m256 EX = _mm256_loadu_ps(Bounds.ExtentX + i);
+        __m256 EY, EZ;
+        if (!bSpheres)
+        {
+            EY = _mm256_loadu_ps(Bounds.ExtentY + i);
+            EZ = _mm256_loadu_ps(Bounds.ExtentZ + i);
+        }
+
+        __m256 Visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (int32 p=0; p<NumPlanes; p++)
+        {
+            __m256 Distance = _mm256_sub_ps(
+                _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(CX, _mm256_set1_ps(PlaneX[p])), _mm256_mul_ps(CY, _mm256_set1_ps(PlaneY[p]))),
+                    _mm256_mul_ps(CZ, _mm256_set1_ps(PlaneZ[p]))),
+                _mm256_set1_ps(PlaneW[p]));
+
+            __m256 PushOut;
+            if (bSpheres)
+            {
+                PushOut = EX;
+            }
+            else
+            {
+                PushOut = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(EX, _mm256_set1_ps(PlaneAbsX[p])), _mm256_mul_ps(EY, _mm256_set1_ps(PlaneAbsY[p]))),
+                    _mm256_mul_ps(EZ, _mm256_set1_ps(PlaneAbsZ[p])));
+            }
+
+            // Distance + PushOut >= 0
+            Visible = _mm256_and_ps(Visible, _mm256_cmp_ps(_mm256_add_ps(Distance, PushOut), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        OutVisibility[i >> 3] = (uint8)_mm256_movemask_ps(Visible);
+    }
+#endif
+
+    // Remainder, or everything without AVX.
+    for (; i < End; i++)
+    {
+        bool bVisible = true;
+
+        for (int32 p=0; p<NumPlanes && bVisible; p++)
+        {
+            float Distance = PlaneX[p] * Bounds.CenterX[i] + PlaneY[p] * Bounds.CenterY[i] + PlaneZ[p] * Bounds.CenterZ[i] - PlaneW[p];
+            float PushOut  = bSpheres ? Bounds.ExtentX[i]
+                : PlaneAbsX[p] * Bounds.ExtentX[i] + PlaneAbsY[p] * Bounds.ExtentY[i] + PlaneAbsZ[p] * Bounds.ExtentZ[i];
+
+            bVisible = Distance + PushOut >= 0.0f;
+        }
+
+        uint8 Bit = (uint8)(1 << (i & 7));
+        if (bVisible)
+        {
+            OutVisibility[i >> 3] |= Bit;
+        }
+        else
+        {
+            OutVisibility[i >> 3] &= ~Bit;
+        }
+    }
+}
+
+inline void FFrustum::CullBoxes(const FCullingBoundsSoA& Bounds, int32 Begin, int32 End, uint8* OutVisibility) const
+{
+    CullRange<false>(Bounds, Begin, End, OutVisibility);
+}
+
+inline void FFrustum::CullSpheres(const FCullingBoundsSoA& Bounds, int32 Begin, int32 End, uint8* OutVisibility) const
+{
+    CullRange<true>(Bounds, Begin, End, OutVisibility);
+}
+
+inline void FFrustum::CullBoxesParallel(const FCullingBoundsSoA& Bounds, int32 Num, uint8* OutVisibility) const
+{
+    // A multiple of 8 so no two ranges write the same byte, and large enough that a range
+    // costs a few microseconds.
+    FJobSystem::Get().ParallelFor(Num, [this, &Bounds, OutVisibility](int32 Begin, int32 End)
+    {
+        CullBoxes(Bounds, Begin, End, OutVisibility);
+    }, 1024);
+}
+
+inline void FFrustum::CullSpheresParallel(const FCullingBoundsSoA& Bounds, int32 Num, uint8* OutVisibility) const
+{
+    FJobSystem::Get().ParallelFor(Num, [this, &Bounds, OutVisibility](int32 Begin, int32 End)
+    {
+        CullSpheres(Bounds, Begin, End, OutVisibility);
+    }, 1024);
+}
+
+inline const uint8* FFrustum::CullBoxesParallel(const FCullingBoundsSoA& Bounds, int32 Num) const
+{
+    uint8* Visibility = FFrameArena::Get().AllocArray<uint8>((Num + 7) / 8);
+    CullBoxesParallel(Bounds, Num, Visibility);
+    return Visibility;
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "vector2D.h"
+#include "../algo/radixsort.h"
+#include "../job/jobsystem.h"
+#include "../memory/framearena.h"
+
+/** Points stored as separate X and Y arrays. */
+struct FPoints2DSoA
+{
+    const float* X;
+    const float* Y;
+};
+
+/** Segments from (StartX, StartY) to (EndX, EndY). */
+struct FSegments2DSoA
+{
+    const float* StartX;
+    const float* StartY;
+    const float* EndX;
+    const float* EndY;
+};
+
+/**
+ * Batch versions of the FVector2D operations used by layout and navigation. Masks are one bit per
+ * element (bit i%8 of byte i/8), AVX processes 8 elements per iteration and a scalar loop the rest.
+ */
+struct FGeometry2D
+{
+    /**
+     * @brief Rotate Num points around the origin, same result as FVector2D::GetRotated but with a
+     *        single SinCos for the whole batch. In and Out may be the same array.
+     */
+    static inline void RotatePoints(const FVector2D* In, FVector2D* Out, int32 Num, float Degree);
+
+    /**
+     * @brief Even-odd point in polygon test of Num points against one simple polygon.
+     *
+     * @param Polygon The polygon vertices, in either winding.
+     * @param NumVertices Number of vertices.
+     * @param Points The points to test.
+     * @param Num Number of points.
+     * @param OutInsideMask Inside bits, (Num + 7) / 8 bytes.
+     */
+    static inline void PointsInPolygon(const FVector2D* Polygon, int32 NumVertices, const FPoints2DSoA& Points, int32 Num, uint8* OutInsideMask);
+
+    /**
+     * @brief Intersect segment [Start, End] with Num segments.
+     *
+     * @param OutT Position of the intersection on [Start, End] in [0, 1], only written on hits.
+     */
+    static inline void SegmentIntersections(const FVector2D& Start, const FVector2D& End, const FSegments2DSoA& Segments, int32 Num, uint8* OutHitMask, float* OutT);
+
+    /**
+     * @brief Convex hull with Andrew's monotone chain, counter clockwise without collinear points.
+     *        Above a few thousand points the input is sorted with the parallel radix sort and split
+     *        in NumThreads slices run as jobs, each computes the hull chains of its slice and the
+     *        chains are merged with one more pass. NumThreads 0 uses one slice per job system
+     *        thread. Input where all points are the same gives a single point.
+     */
+    static inline void ConvexHull(const FVector2D* Points, int32 Num, std::vector<FVector2D>& OutHull, int32 NumThreads = 1);
+
+private:
+    /** Positive when A, B, C turn counter clockwise. */
+    static inline float Orient(const FVector2D& A, const FVector2D& B, const FVector2D& C)
+    {
+        return (B.X - A.X) * (C.Y - A.Y) - (B.Y - A.Y) * (C.X - A.X);
+    }
+
+    /** Radix sort key ordering points by X, then Y. */
+    static inline uint64 GetSortKey(const FVector2D& P)
+    {
+        return ((uint64)GetSortableBits(P.X) << 32) | GetSortableBits(P.Y);
+    }
+
+    /** Float bits that compare like the floats as unsigned integers, -0 and 0 are the same. */
+    static inline uint32 GetSortableBits(float F)
+    {
+        F += 0.0f;
+        uint32 Bits;
+        memcpy(&Bits, &F, sizeof(Bits));
+        return (Bits & 0x80000000u) ? ~Bits : (Bits | 0x80000000u);
+    }
+
+    /** Append the points of a sorted range to a lower (Sign 1) or upper (Sign -1) chain. */
+    static inline void BuildChain(const FVector2D* Sorted, int32 Num, float Sign, std::vector<FVector2D>& Chain);
+
+    static inline void SetBit(uint8* Mask, int32 Index, bool bSet)
+    {
+        uint8 Bit = (uint8)(1 << (Index & 7));
+        Mask[Index >> 3] = bSet ? (Mask[Index >> 3] | Bit) : (Mask[Index >> 3] & ~Bit);
+    }
+};
+
+inline void FGeometry2D::RotatePoints(const FVector2D* In, FVector2D* Out, int32 Num, float Degree)
+{
+    float S, C;
+    FMath::SinCos(Degree * (PI / 180.f), &S, &C);
+
+    int32 i = 0;
+
+#if defined(__AVX__)
+    // 4 interleaved points per register: (X, Y) * (C, C) + (Y, X) * (-S, S).
+    __m256 CC = _mm256_set1_ps(C);
+    __m256 SS = _mm256_setr_ps(-S, S, -S, S, -S, S, -S, S);
+
+    for (; i + 4 <= Num; i += 4)
+    {
+        __m256 XY = _mm256_loadu_ps(&In[i].X);
+        __m256 YX = _mm256_permute_ps(XY, 0xB1);
+        _mm256_storeu_ps(&Out[i].X, _mm256_add_ps(_mm256_mul_ps(XY, CC), _mm256_mul_ps(YX, SS)));
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        FVector2D P = In[i];
+        Out[i] = FVector2D(C*P.X - S*P.Y, S*P.X + C*P.Y);
+    }
+}
+
+inline void FGeometry2D::PointsInPolygon(const FVector2D* Polygon, int32 NumVertices, const FPoints2DSoA& Points, int32 Num, uint8* OutInsideMask)
+{
+    // Per edge the crossing test only needs Xi + (Py - Yi) * Slope, precompute the slopes.
+    // Horizontal edges get an infinite slope, they never straddle Py so the result is masked out.
+    std::vector<float> Slopes(NumVertices);
+    for (int32 v=0, Prev=NumVertices-1; v<NumVertices; Prev=v++)
+    {
+        Slopes[v] = (Polygon[Prev].X - Polygon[v].X) / (Polygon[Prev].Y - Polygon[v].Y);
+    }
+
+    int32 i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256 PX = _mm256_loadu_ps(Points.X + i);
+        __m256 PY = _mm256_loadu_ps(Points.Y + i);
+        __m256 Inside = _mm256_setzero_ps();
+
+        for (int32 v=0, Prev=NumVertices-1; v<NumVertices; Prev=v++)
+        {
+            __m256 YI = _mm256_set1_ps(Polygon[v].Y);
+            __m256 YJ = _mm256_set1_ps(Polygon[Prev].Y);
+
+            __m256 Straddles = _mm256_xor_ps(_mm256_cmp_ps(YI, PY, _CMP_GT_OQ), _mm256_cmp_ps(YJ, PY, _CMP_GT_OQ));
+            __m256 XCross = _mm256_add_ps(_mm256_set1_ps(Polygon[v].X), _mm256_mul_ps(_mm256_sub_ps(PY, YI), _mm256_set1_ps(Slopes[v])));
+
+            Inside = _mm256_xor_ps(Inside, _mm256_and_ps(Straddles, _mm256_cmp_ps(PX, XCross, _CMP_LT_OQ)));
+        }
+
+        OutInsideMask[i >> 3] = (uint8)_mm256_movemask_ps(Inside);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        bool bInside = false;
+
+        for (int32 v=0, Prev=NumVertices-1; v<NumVertices; Prev=v++)
+        {
+            const FVector2D& VI = Polygon[v];
+            const FVector2D& VJ = Polygon[Prev];
+
+            if ((VI.Y > Points.Y[i]) != (VJ.Y > Points.Y[i]) && Points.X[i] < VI.X + (Points.Y[i] - VI.Y) * Slopes[v])
+            {
+                bInside = !bInside;
+            }
+        }
+
+        SetBit(OutInsideMask, i, bInside);
+    }
+}
+
+inline void FGeometry2D::SegmentIntersections(const FVector2D& Start, const FVector2D& End, const FSegments2DSoA& Segments, int32 Num, uint8* OutHitMask, float* OutT)
+{
+    // P + R*t = Q + S*u, with Cross(A, B) = A.X*B.Y - A.Y*B.X:
+    // t = Cross(Q - P, S) / Cross(R, S), u = Cross(Q - P, R) / Cross(R, S).
+    FVector2D R = End - Start;
+    int32 i = 0;
+
+#if defined(__AVX__)
+    __m256 PX = _mm256_set1_ps(Start.X), PY = _mm256_set1_ps(Start.Y);
+    __m256 RX = _mm256_set1_ps(R.X), RY = _mm256_set1_ps(R.Y);
+    __m256 Zero = _mm256_setzero_ps(), One = _mm256_set1_ps(1.0f);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256 QX = _mm256_loadu_ps(Segments.StartX + i);
+        __m256 QY = _mm256_loadu_ps(Segments.StartY + i);
+        __m256 SX = _mm256_sub_ps(_mm256_loadu_ps(Segments.EndX + i), QX);
+        __m256 SY = _mm256_sub_ps(_mm256_loadu_ps(Segments.EndY + i), QY);
+        __m256 DX = _mm256_sub_ps(QX, PX);
+        __m256 DY = _mm256_sub_ps(QY, PY);
+
+        __m256 Denominator = _mm256_sub_ps(_mm256_mul_ps(RX, SY), _mm256_mul_ps(RY, SX));
+        __m256 InvDenominator = _mm256_div_ps(One, Denominator);
+        __m256 T = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(DX, SY), _mm256_mul_ps(DY, SX)), InvDenominator);
+        __m256 U = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(DX, RY), _mm256_mul_ps(DY, RX)), InvDenominator);
+
+        __m256 Hit = _mm256_cmp_ps(Denominator, Zero, _CMP_NEQ_OQ);
+        Hit = _mm256_and_ps(Hit, _mm256_and_ps(_mm256_cmp_ps(T, Zero, _CMP_GE_OQ), _mm256_cmp_ps(T, One, _CMP_LE_OQ)));
+        Hit = _mm256_and_ps(Hit, _mm256_and_ps(_mm256_cmp_ps(U, Zero, _CMP_GE_OQ), _mm256_cmp_ps(U, One, _CMP_LE_OQ)));
+
+        int32 Mask = _mm256_movemask_ps(Hit);
+        if (Mask != 0)
+        {
+            _mm256_maskstore_ps(OutT + i, _mm256_castps_si256(Hit), T);
+        }
+        OutHitMask[i >> 3] = (uint8)Mask;
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        FVector2D Q(Segments.StartX[i], Segments.StartY[i]);
+        FVector2D S(Segments.EndX[i] - Q.X, Segments.EndY[i] - Q.Y);
+        FVector2D D = Q - Start;
+
+        float Denominator = R.X * S.Y - R.Y * S.X;
+        bool bHit = false;
+
+        if (Denominator != 0.0f)
+        {
+            float T = (D.X * S.Y - D.Y * S.X) / Denominator;
+            float U = (D.X * R.Y - D.Y * R.X) / Denominator;
+
+            bHit = T >= 0.0f && T <= 1.0f && U >= 0.0f && U <= 1.0f;
+            if (bHit)
+            {
+                OutT[i] = T;
+            }
+        }
+
+        SetBit(OutHitMask, i, bHit);
+    }
+}
+
+inline void FGeometry2D::BuildChain(const FVector2D* Sorted, int32 Num, float Sign, std::vector<FVector2D>& Chain)
+{
+    size_t Base = Chain.size();
+
+    for (int32 i=0; i<Num; i++)
+    {
+        while (Chain.size() >= Base + 2 && Sign * Orient(Chain[Chain.size() - 2], Chain.back(), Sorted[i]) <= 0.0f)
+        {
+            Chain.pop_back();
+        }
+        Chain.push_back(Sorted[i]);
+    }
+}
+
+inline void FGeometry2D::ConvexHull(const FVector2D* Points, int32 Num, std::vector<FVector2D>& OutHull, int32 NumThreads)
+{
+    OutHull.clear();
+    if (Num <= 0)
+    {
+        return;
+    }
+
+    if (NumThreads < 1)
+    {
+        NumThreads = FJobSystem::Get().GetNumThreads();
+    }
+    int32 NumSlices = Num >= 4096 ? NumThreads : 1;
+
+    // Temporaries come from the scratch arena of the calling thread, the slice chains are built
+    // by jobs on other threads and stay on the heap.
+    FLinearArena& Scratch = FScratchArena::Get();
+    FArenaScope Scope(Scratch);
+    TArenaVector<FVector2D> Sorted(Num, TArenaAllocator<FVector2D>(Scratch));
+    if (NumSlices > 1)
+    {
+        // The sort is the bulk of the work, (X, Y) packed in one 64 bit key for the parallel radix sort.
+        TArenaVector<uint64> Keys(Num, TArenaAllocator<uint64>(Scratch));
+        TArenaVector<uint32> Indices(Num, TArenaAllocator<uint32>(Scratch));
+        FJobSystem::Get().ParallelFor(Num, [Points, &Keys, &Indices](int32 Begin, int32 End)
+        {
+            for (int32 i=Begin; i<End; i++)
+            {
+                Keys[i] = GetSortKey(Points[i]);
+                Indices[i] = i;
+            }
+        });
+
+        FRadixSort::SortParallel(Keys.data(), Indices.data(), Num);
+
+        FJobSystem::Get().ParallelFor(Num, [Points, &Sorted, &Indices](int32 Begin, int32 End)
+        {
+            for (int32 i=Begin; i<End; i++)
+            {
+                Sorted[i] = Points[Indices[i]];
+            }
+        });
+    }
+    else
+    {
+        Sorted.assign(Points, Points + Num);
+        std::sort(Sorted.begin(), Sorted.end(), [](const FVector2D& A, const FVector2D& B)
+        {
+            return A.X < B.X || (A.X == B.X && A.Y < B.Y);
+        });
+    }
+
+    // First and last sorted point are the same only when all points are, the chains below would
+    // return that point twice.
+    if (Sorted.front().X == Sorted.back().X && Sorted.front().Y == Sorted.back().Y)
+    {
+        OutHull.push_back(Sorted.front());
+        return;
+    }
+
+    // Every vertex of the hull is a vertex of the chains of the slice it falls in, and the
+    // chains of consecutive slices stay sorted, so one more chain pass over them gives the hull.
+    std::vector<FVector2D> Lower, Upper;
+
+    if (NumSlices > 1)
+    {
+        std::vector<std::vector<FVector2D>> SliceLower(NumSlices), SliceUpper(NumSlices);
+        int32 PerSlice = (Num + NumSlices - 1) / NumSlices;
+
+        FJobSystem::Get().ParallelFor(NumSlices, [&Sorted, &SliceLower, &SliceUpper, PerSlice, Num](int32 SliceBegin, int32 SliceEnd)
+        {
+            for (int32 s=SliceBegin; s<SliceEnd; s++)
+            {
+                int32 Begin = s * PerSlice;
+                int32 End = Begin + PerSlice < Num ? Begin + PerSlice : Num;
+                if (Begin < End)
+                {
+                    BuildChain(&Sorted[Begin], End - Begin, 1.0f, SliceLower[s]);
+                    BuildChain(&Sorted[Begin], End - Begin, -1.0f, SliceUpper[s]);
+                }
+            }
+        });
+
+        TArenaVector<FVector2D> Candidates{TArenaAllocator<FVector2D>(Scratch)};
+        for (int32 s=0; s<NumSlices; s++)
+        {
+            Candidates.insert(Candidates.end(), SliceLower[s].begin(), SliceLower[s].end());
+        }
+        BuildChain(Candidates.data(), (int32)Candidates.size(), 1.0f, Lower);
+
+        Candidates.clear();
+        for (int32 s=0; s<NumSlices; s++)
+        {
+            Candidates.insert(Candidates.end(), SliceUpper[s].begin(), SliceUpper[s].end());
+        }
+        BuildChain(Candidates.data(), (int32)Candidates.size(), -1.0f, Upper);
+    }
+    else
+    {
+        BuildChain(Sorted.data(), Num, 1.0f, Lower);
+        BuildChain(Sorted.data(), Num, -1.0f, Upper);
+    }
+
+    // Lower chain left to right, then the upper chain right to left, without the shared ends.
+    OutHull.assign(Lower.begin(), Lower.end() - 1);
+    OutHull.insert(OutHull.end(), Upper.rbegin(), Upper.rend() - 1);
+}
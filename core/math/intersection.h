@@ -0,0 +1,331 @@
+#pragma once
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "vector.h"
+
+/**
+ * Batch ray casts against spheres and planes, the ray versions of FVector::LinePlaneIntersection
+ * and FVector::LineSphereIntersection.
+ *
+ * Rays use the parametrization of the scalar functions, P(t) = Start + (End - Start) * t, limited
+ * to t >= 0: intersections behind the start are not hits, and a ray starting inside a sphere hits
+ * where it leaves it. Every kernel writes one hit bit per element (bit i%8 of byte i/8) and the t
+ * of the nearest intersection in front of the start, which is left untouched for elements without
+ * a hit. 8 elements per AVX iteration, a scalar loop handles the remainder.
+ */
+
+struct FLinesSoA
+{
+    const float* StartX;
+    const float* StartY;
+    const float* StartZ;
+    /** End - Start. */
+    const float* DirX;
+    const float* DirY;
+    const float* DirZ;
+};
+
+struct FSpheresSoA
+{
+    const float* CenterX;
+    const float* CenterY;
+    const float* CenterZ;
+    const float* Radius;
+};
+
+/** Planes in the FPlane form, Normal|P == W. */
+struct FPlanesSoA
+{
+    const float* NormalX;
+    const float* NormalY;
+    const float* NormalZ;
+    const float* W;
+};
+
+struct FIntersection
+{
+    /**
+     * @brief One ray against Num spheres.
+     *
+     * @param Start The start point of the ray.
+     * @param End A second point on the ray, t = 1.
+     * @param Spheres The spheres.
+     * @param Num Number of spheres.
+     * @param OutHitMask Hit bits, (Num + 7) / 8 bytes.
+     * @param OutNearestT Smallest root not below 0 per sphere.
+     */
+    static inline void LineSpheres(const FVector& Start, const FVector& End, const FSpheresSoA& Spheres, int32 Num, uint8* OutHitMask, float* OutNearestT);
+
+    /**
+     * @brief Num rays against one sphere.
+     */
+    static inline void LinesSphere(const FLinesSoA& Lines, int32 Num, const FVector& Origin, float Radius, uint8* OutHitMask, float* OutNearestT);
+
+    /**
+     * @brief One ray against Num planes. A ray parallel to a plane does not hit it.
+     */
+    static inline void LinePlanes(const FVector& Start, const FVector& End, const FPlanesSoA& Planes, int32 Num, uint8* OutHitMask, float* OutT);
+
+    /**
+     * @brief Num rays against one plane.
+     */
+    static inline void LinesPlane(const FLinesSoA& Lines, int32 Num, const FVector& PlaneOrigin, const FVector& PlaneNormal, uint8* OutHitMask, float* OutT);
+
+    /**
+     * @brief Index of the hit with the smallest t not less than MinT, -1 without one.
+     */
+    static inline int32 FindNearestHit(const uint8* HitMask, const float* T, int32 Num, float MinT = 0.0f);
+
+private:
+    static inline void SetHitBit(uint8* HitMask, int32 Index, bool bHit)
+    {
+        uint8 Bit = (uint8)(1 << (Index & 7));
+        HitMask[Index >> 3] = bHit ? (HitMask[Index >> 3] | Bit) : (HitMask[Index >> 3] & ~Bit);
+    }
+
+    /** Shared scalar path, same math as FVector::LineSphereIntersection. */
+    static inline bool SolveLineSphere(float a, float HalfB, float c, float* OutT)
+    {
+        float Discriminant = HalfB * HalfB - a * c;
+
+        if (a == 0.0f || Discriminant < 0.0f)
+        {
+            return false;
+        }
+
+        // a > 0, so Near <= Far. A negative Near is a start inside the sphere.
+        float Root = FMath::Sqrt(Discriminant);
+        float Near = (-HalfB - Root) / a;
+        float Far = (-HalfB + Root) / a;
+        if (Far < 0.0f)
+        {
+            return false;
+        }
+
+        *OutT = Near >= 0.0f ? Near : Far;
+        return true;
+    }
+
+    static inline bool SolveLinePlane(float Numerator, float Denominator, float* OutT)
+    {
+        if (Denominator == 0.0f)
+        {
+            return false;
+        }
+
+        float T = Numerator / Denominator;
+        if (T < 0.0f)
+        {
+            return false;
+        }
+
+        *OutT = T;
+        return true;
+    }
+};
+
+#if defined(__AVX__)
+/** Lanes where the quadratic has a root not below 0, the smallest such root goes to OutT. */
+static inline int32 SolveLineSphere8(__m256 a, __m256 HalfB, __m256 c, float* OutT)
+{
+    __m256 Zero = _mm256_setzero_ps();
+    __m256 Discriminant = _mm256_sub_ps(_mm256_mul_ps(HalfB, HalfB), _mm256_mul_ps(a, c));
+    __m256 Real = _mm256_and_ps(_mm256_cmp_ps(Discriminant, Zero, _CMP_GE_OQ), _mm256_cmp_ps(a, Zero, _CMP_NEQ_OQ));
+    if (_mm256_movemask_ps(Real) == 0)
+    {
+        return 0;
+    }
+
+    __m256 Root = _mm256_sqrt_ps(_mm256_max_ps(Discriminant, Zero));
+    __m256 MinusHalfB = _mm256_sub_ps(Zero, HalfB);
+    __m256 Near = _mm256_div_ps(_mm256_sub_ps(MinusHalfB, Root), a);
+    __m256 Far = _mm256_div_ps(_mm256_add_ps(MinusHalfB, Root), a);
+
+    __m256 Hit = _mm256_and_ps(Real, _mm256_cmp_ps(Far, Zero, _CMP_GE_OQ));
+    int32 Mask = _mm256_movemask_ps(Hit);
+    if (Mask != 0)
+    {
+        __m256 T = _mm256_blendv_ps(Far, Near, _mm256_cmp_ps(Near, Zero, _CMP_GE_OQ));
+        _mm256_maskstore_ps(OutT, _mm256_castps_si256(Hit), T);
+    }
+    return Mask;
+}
+
+/** Lanes where the ray is not parallel to the plane and meets it at t >= 0. */
+static inline int32 SolveLinePlane8(__m256 Numerator, __m256 Denominator, float* OutT)
+{
+    __m256 Zero = _mm256_setzero_ps();
+    __m256 T = _mm256_div_ps(Numerator, Denominator);
+    __m256 Hit = _mm256_and_ps(_mm256_cmp_ps(Denominator, Zero, _CMP_NEQ_OQ), _mm256_cmp_ps(T, Zero, _CMP_GE_OQ));
+
+    int32 Mask = _mm256_movemask_ps(Hit);
+    if (Mask != 0)
+    {
+        _mm256_maskstore_ps(OutT, _mm256_castps_si256(Hit), T);
+    }
+    return Mask;
+}
+#endif
+
+inline void FIntersection::LineSpheres(const FVector& Start, const FVector& End, const FSpheresSoA& Spheres, int32 Num, uint8* OutHitMask, float* OutNearestT)
+{
+    // With D = End - Start and PO = Start - Center: a = D|D, b/2 = PO|D, c = PO|PO - R*R.
+    FVector D = End - Start;
+    float a = D | D;
+    int32 i = 0;
+
+#if defined(__AVX__)
+    __m256 A8 = _mm256_set1_ps(a);
+    __m256 DX = _mm256_set1_ps(D.X), DY = _mm256_set1_ps(D.Y), DZ = _mm256_set1_ps(D.Z);
+    __m256 SX = _mm256_set1_ps(Start.X), SY = _mm256_set1_ps(Start.Y), SZ = _mm256_set1_ps(Start.Z);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256 POX = _mm256_sub_ps(SX, _mm256_loadu_ps(Spheres.CenterX + i));
+        __m256 POY = _mm256_sub_ps(SY, _mm256_loadu_ps(Spheres.CenterY + i));
+        __m256 POZ = _mm256_sub_ps(SZ, _mm256_loadu_ps(Spheres.CenterZ + i));
+        __m256 R   = _mm256_loadu_ps(Spheres.Radius + i);
+
+        __m256 HalfB = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(POX, DX), _mm256_mul_ps(POY, DY)), _mm256_mul_ps(POZ, DZ));
+        __m256 c = _mm256_sub_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(POX, POX), _mm256_mul_ps(POY, POY)), _mm256_mul_ps(POZ, POZ)),
+            _mm256_mul_ps(R, R));
+
+        OutHitMask[i >> 3] = (uint8)SolveLineSphere8(A8, HalfB, c, OutNearestT + i);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        FVector PO = Start - FVector(Spheres.CenterX[i], Spheres.CenterY[i], Spheres.CenterZ[i]);
+        float c = (PO | PO) - Spheres.Radius[i] * Spheres.Radius[i];
+
+        SetHitBit(OutHitMask, i, SolveLineSphere(a, PO | D, c, OutNearestT + i));
+    }
+}
+
+inline void FIntersection::LinesSphere(const FLinesSoA& Lines, int32 Num, const FVector& Origin, float Radius, uint8* OutHitMask, float* OutNearestT)
+{
+    float RadiusSquared = Radius * Radius;
+    int32 i = 0;
+
+#if defined(__AVX__)
+    __m256 OX = _mm256_set1_ps(Origin.X), OY = _mm256_set1_ps(Origin.Y), OZ = _mm256_set1_ps(Origin.Z);
+    __m256 R2 = _mm256_set1_ps(RadiusSquared);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256 DX = _mm256_loadu_ps(Lines.DirX + i);
+        __m256 DY = _mm256_loadu_ps(Lines.DirY + i);
+        __m256 DZ = _mm256_loadu_ps(Lines.DirZ + i);
+        __m256 POX = _mm256_sub_ps(_mm256_loadu_ps(Lines.StartX + i), OX);
+        __m256 POY = _mm256_sub_ps(_mm256_loadu_ps(Lines.StartY + i), OY);
+        __m256 POZ = _mm256_sub_ps(_mm256_loadu_ps(Lines.StartZ + i), OZ);
+
+        __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY)), _mm256_mul_ps(DZ, DZ));
+        __m256 HalfB = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(POX, DX), _mm256_mul_ps(POY, DY)), _mm256_mul_ps(POZ, DZ));
+        __m256 c = _mm256_sub_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(POX, POX), _mm256_mul_ps(POY, POY)), _mm256_mul_ps(POZ, POZ)),
+            R2);
+
+        OutHitMask[i >> 3] = (uint8)SolveLineSphere8(a, HalfB, c, OutNearestT + i);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        FVector D(Lines.DirX[i], Lines.DirY[i], Lines.DirZ[i]);
+        FVector PO = FVector(Lines.StartX[i], Lines.StartY[i], Lines.StartZ[i]) - Origin;
+
+        SetHitBit(OutHitMask, i, SolveLineSphere(D | D, PO | D, (PO | PO) - RadiusSquared, OutNearestT + i));
+    }
+}
+
+inline void FIntersection::LinePlanes(const FVector& Start, const FVector& End, const FPlanesSoA& Planes, int32 Num, uint8* OutHitMask, float* OutT)
+{
+    // t = (W - N|Start) / (N|D)
+    FVector D = End - Start;
+    int32 i = 0;
+
+#if defined(__AVX__)
+    __m256 DX = _mm256_set1_ps(D.X), DY = _mm256_set1_ps(D.Y), DZ = _mm256_set1_ps(D.Z);
+    __m256 SX = _mm256_set1_ps(Start.X), SY = _mm256_set1_ps(Start.Y), SZ = _mm256_set1_ps(Start.Z);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256 NX = _mm256_loadu_ps(Planes.NormalX + i);
+        __m256 NY = _mm256_loadu_ps(Planes.NormalY + i);
+        __m256 NZ = _mm256_loadu_ps(Planes.NormalZ + i);
+
+        __m256 Denominator = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(NX, DX), _mm256_mul_ps(NY, DY)), _mm256_mul_ps(NZ, DZ));
+        __m256 Numerator = _mm256_sub_ps(_mm256_loadu_ps(Planes.W + i),
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(NX, SX), _mm256_mul_ps(NY, SY)), _mm256_mul_ps(NZ, SZ)));
+
+        OutHitMask[i >> 3] = (uint8)SolveLinePlane8(Numerator, Denominator, OutT + i);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        FVector N(Planes.NormalX[i], Planes.NormalY[i], Planes.NormalZ[i]);
+        SetHitBit(OutHitMask, i, SolveLinePlane(Planes.W[i] - (N | Start), N | D, OutT + i));
+    }
+}
+
+inline void FIntersection::LinesPlane(const FLinesSoA& Lines, int32 Num, const FVector& PlaneOrigin, const FVector& PlaneNormal, uint8* OutHitMask, float* OutT)
+{
+    float W = PlaneOrigin | PlaneNormal;
+    int32 i = 0;
+
+#if defined(__AVX__)
+    __m256 NX = _mm256_set1_ps(PlaneNormal.X), NY = _mm256_set1_ps(PlaneNormal.Y), NZ = _mm256_set1_ps(PlaneNormal.Z);
+    __m256 W8 = _mm256_set1_ps(W);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256 Denominator = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(NX, _mm256_loadu_ps(Lines.DirX + i)),
+            _mm256_mul_ps(NY, _mm256_loadu_ps(Lines.DirY + i))),
+            _mm256_mul_ps(NZ, _mm256_loadu_ps(Lines.DirZ + i)));
+        __m256 Numerator = _mm256_sub_ps(W8, _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(NX, _mm256_loadu_ps(Lines.StartX + i)),
+            _mm256_mul_ps(NY, _mm256_loadu_ps(Lines.StartY + i))),
+            _mm256_mul_ps(NZ, _mm256_loadu_ps(Lines.StartZ + i))));
+
+        OutHitMask[i >> 3] = (uint8)SolveLinePlane8(Numerator, Denominator, OutT + i);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        float Denominator = PlaneNormal.X * Lines.DirX[i] + PlaneNormal.Y * Lines.DirY[i] + PlaneNormal.Z * Lines.DirZ[i];
+        float Numerator = W - (PlaneNormal.X * Lines.StartX[i] + PlaneNormal.Y * Lines.StartY[i] + PlaneNormal.Z * Lines.StartZ[i]);
+
+        SetHitBit(OutHitMask, i, SolveLinePlane(Numerator, Denominator, OutT + i));
+    }
+}
+
+inline int32 FIntersection::FindNearestHit(const uint8* HitMask, const float* T, int32 Num, float MinT)
+{
+    int32 Nearest = -1;
+    float NearestT = FLT_MAX;
+
+    for (int32 Byte = 0; Byte < (Num + 7) / 8; Byte++)
+    {
+        // Skip 8 misses at once.
+        for (uint32 Bits = HitMask[Byte]; Bits != 0; Bits &= Bits - 1)
+        {
+            int32 i = Byte * 8 + (int32)FMath::CountTrailingZeros(Bits);
+            if (i < Num && T[i] >= MinT && T[i] < NearestT)
+            {
+                NearestT = T[i];
+                Nearest = i;
+            }
+        }
+    }
+
+    return Nearest;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "vector.h"
+#include "matrix.h"
+
+/**
+ * Large world coordinates.
+ *
+ * Gameplay keeps positions and transforms in double precision (FVector3d, FMatrix44d). Before
+ * rendering they are rebased to a render origin near the camera and converted to float, so the
+ * float pipeline only ever sees small, camera relative values. Matrices use the row vector
+ * convention of FMatrix, the translation lives in M[3][0..2].
+ */
+
+struct FPositionsSoA3d
+{
+    const double* X;
+    const double* Y;
+    const double* Z;
+};
+
+struct FLargeWorld
+{
+    /**
+     * @brief Transform Num double positions by a double matrix, w is assumed to be 1.
+     *
+     * @param M The transform, affine.
+     * @param Positions The input positions.
+     * @param Num Number of positions.
+     * @param OutX, OutY, OutZ The transformed positions, may alias the input.
+     */
+    static inline void TransformPositions(const FMatrix44d& M, const FPositionsSoA3d& Positions, int32 Num, double* OutX, double* OutY, double* OutZ);
+
+    /**
+     * @brief Subtract the render origin from Num double positions and convert them to float.
+     */
+    static inline void RebasePositions(const FPositionsSoA3d& Positions, int32 Num, const FVector3d& Origin, float* OutX, float* OutY, float* OutZ);
+
+    /**
+     * @brief Convert Num local to world matrices to local to render space matrices.
+     *
+     * Each matrix is post multiplied by a translation of -Origin before the conversion, so
+     * the precision loss happens after the large translation has been cancelled.
+     */
+    static inline void RebaseMatrices(const FMatrix44d* Matrices, int32 Num, const FVector3d& Origin, FMatrix* OutMatrices);
+
+    /**
+     * @brief Convert a world to view matrix to a render space to view matrix.
+     *
+     * The result is the translation by Origin followed by the view transform, so it maps the
+     * rebased positions to the same view space positions as the original matrix.
+     */
+    static inline FMatrix RebaseViewMatrix(const FMatrix44d& ViewMatrix, const FVector3d& Origin);
+
+    /**
+     * @brief Snap the camera position to a grid, used to pick a render origin that only moves
+     * occasionally so cached render space data stays valid between frames.
+     */
+    static inline FVector3d GetRenderOrigin(const FVector3d& CameraPosition, double GridSize);
+};
+
+inline void FLargeWorld::TransformPositions(const FMatrix44d& M, const FPositionsSoA3d& Positions, int32 Num, double* OutX, double* OutY, double* OutZ)
+{
+    int32 i = 0;
+
+#if defined(__AVX__)
+    const __m256d M00 = _mm256_set1_pd(M.M[0][0]), M01 = _mm256_set1_pd(M.M[0][1]), M02 = _mm256_set1_pd(M.M[0][2]);
+    const __m256d M10 = _mm256_set1_pd(M.M[1][0]), M11 = _mm256_set1_pd(M.M[1][1]), M12 = _mm256_set1_pd(M.M[1][2]);
+    const __m256d M20 = _mm256_set1_pd(M.M[2][0]), M21 = _mm256_set1_pd(M.M[2][1]), M22 = _mm256_set1_pd(M.M[2][2]);
+    const __m256d M30 = _mm256_set1_pd(M.M[3][0]), M31 = _mm256_set1_pd(M.M[3][1]), M32 = _mm256_set1_pd(M.M[3][2]);
+
+    for (; i + 4 <= Num; i += 4)
+    {
+        __m256d X = _mm256_loadu_pd(Positions.X + i);
+        __m256d Y = _mm256_loadu_pd(Positions.Y + i);
+        __m256d Z = _mm256_loadu_pd(Positions.Z + i);
+
+        __m256d RX = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(X, M00), _mm256_mul_pd(Y, M10)), _mm256_add_pd(_mm256_mul_pd(Z, M20), M30));
+        __m256d RY = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(X, M01), _mm256_mul_pd(Y, M11)), _mm256_add_pd(_mm256_mul_pd(Z, M21), M31));
+        __m256d RZ = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(X, M02), _mm256_mul_pd(Y, M12)), _mm256_add_pd(_mm256_mul_pd(Z, M22), M32));
+
+        _mm256_storeu_pd(OutX + i, RX);
+        _mm256_storeu_pd(OutY + i, RY);
+        _mm256_storeu_pd(OutZ + i, RZ);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        double X = Positions.X[i];
+        double Y = Positions.Y[i];
+        double Z = Positions.Z[i];
+
+        OutX[i] = (X * M.M[0][0] + Y * M.M[1][0]) + (Z * M.M[2][0] + M.M[3][0]);
+        OutY[i] = (X * M.M[0][1] + Y * M.M[1][1]) + (Z * M.M[2][1] + M.M[3][1]);
+        OutZ[i] = (X * M.M[0][2] + Y * M.M[1][2]) + (Z * M.M[2][2] + M.M[3][2]);
+    }
+}
+
+inline void FLargeWorld::RebasePositions(const FPositionsSoA3d& Positions, int32 Num, const FVector3d& Origin, float* OutX, float* OutY, float* OutZ)
+{
+    int32 i = 0;
+
+#if defined(__AVX__)
+    const __m256d OX = _mm256_set1_pd(Origin.X);
+    const __m256d OY = _mm256_set1_pd(Origin.Y);
+    const __m256d OZ = _mm256_set1_pd(Origin.Z);
+
+    for (; i + 4 <= Num; i += 4)
+    {
+        _mm_storeu_ps(OutX + i, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(Positions.X + i), OX)));
+        _mm_storeu_ps(OutY + i, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(Positions.Y + i), OY)));
+        _mm_storeu_ps(OutZ + i, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(Positions.Z + i), OZ)));
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        OutX[i] = (float)(Positions.X[i] - Origin.X);
+        OutY[i] = (float)(Positions.Y[i] - Origin.Y);
+        OutZ[i] = (float)(Positions.Z[i] - Origin.Z);
+    }
+}
+
+inline void FLargeWorld::RebaseMatrices(const FMatrix44d* Matrices, int32 Num, const FVector3d& Origin, FMatrix* OutMatrices)
+{
+    // M * Translation(-Origin): every row loses its w component times the origin.
+#if defined(__AVX__)
+    const __m256d O = _mm256_set_pd(0.0, Origin.Z, Origin.Y, Origin.X);
+
+    for (int32 i = 0; i < Num; i++)
+    {
+        const FMatrix44d& M = Matrices[i];
+
+        for (int32 Row = 0; Row < 4; Row++)
+        {
+            __m256d R = _mm256_loadu_pd(M.M[Row]);
+            R = _mm256_sub_pd(R, _mm256_mul_pd(_mm256_set1_pd(M.M[Row][3]), O));
+            _mm_storeu_ps(OutMatrices[i].M[Row], _mm256_cvtpd_ps(R));
+        }
+    }
+#else
+    for (int32 i = 0; i < Num; i++)
+    {
+        const FMatrix44d& M = Matrices[i];
+
+        for (int32 Row = 0; Row < 4; Row++)
+        {
+            OutMatrices[i].M[Row][0] = (float)(M.M[Row][0] - M.M[Row][3] * Origin.X);
+            OutMatrices[i].M[Row][1] = (float)(M.M[Row][1] - M.M[Row][3] * Origin.Y);
+            OutMatrices[i].M[Row][2] = (float)(M.M[Row][2] - M.M[Row][3] * Origin.Z);
+            OutMatrices[i].M[Row][3] = (float)M.M[Row][3];
+        }
+    }
+#endif
+}
+
+inline FMatrix FLargeWorld::RebaseViewMatrix(const FMatrix44d& ViewMatrix, const FVector3d& Origin)
+{
+    // Translation(Origin) * View: only the translation row changes.
+    FMatrix44d Result = ViewMatrix;
+
+    for (int32 j = 0; j < 4; j++)
+    {
+        Result.M[3][j] = Origin.X * ViewMatrix.M[0][j] + Origin.Y * ViewMatrix.M[1][j] + Origin.Z * ViewMatrix.M[2][j] + ViewMatrix.M[3][j];
+    }
+
+    return FMatrix(Result);
+}
+
+inline FVector3d FLargeWorld::GetRenderOrigin(const FVector3d& CameraPosition, double GridSize)
+{
+    return FVector3d(FMath::FloorToDouble(CameraPosition.X / GridSize) * GridSize,
+                     FMath::FloorToDouble(CameraPosition.Y / GridSize) * GridSize,
+                     FMath::FloorToDouble(CameraPosition.Z / GridSize) * GridSize);
+}
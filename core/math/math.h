@@ -1,7 +1,13 @@
+#pragma once
 
 #include <new>
 #include <wchar.h>
 #include <math.h>
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #define PI                  3.1415926535897932f
 #define INV_PI              0.31830988618f
@@ -11,7 +17,7 @@
 #define FLT_TOLERANCE_SMALL (1.e-4f)
 #define FLT_MAX             (3.402823466e+38F)
 
-#define RND_MAX             0x7fff;
+#define RND_MAX             0x7fff
 
 typedef signed char         int8;
 typedef unsigned char       uint8;
@@ -132,6 +138,7 @@ struct FMath
     static inline float Tan(float Value)  { return tanf(Value); }
     static inline float Atan(float Value) { return atanf(Value); }
     static inline float Sqrt(float Value) { return sqrtf(Value); }
+    static inline double Sqrt(double Value) { return sqrt(Value); }
     static inline float Pow(float A, float B)  { return powf(A, B); }
 
     static inline float InvSqrt(float F)
@@ -139,6 +146,46 @@ struct FMath
         return 1.0f / sqrtf(F);
     }
 
+    static inline double InvSqrt(double F)
+    {
+        return 1.0 / sqrt(F);
+    }
+
+    /**
+     * @brief A * B + C with a single rounding when the target has FMA.
+     */
+    static inline float MulAdd(float A, float B, float C)
+    {
+#if defined(__FMA__)
+        return fmaf(A, B, C);
+#else
+        return A * B + C;
+#endif
+    }
+
+    static inline double MulAdd(double A, double B, double C)
+    {
+#if defined(__FMA__)
+        return fma(A, B, C);
+#else
+        return A * B + C;
+#endif
+    }
+
+    /**
+     * @brief Index of the lowest set bit, Value must not be 0.
+     */
+    static inline uint32 CountTrailingZeros(uint32 Value)
+    {
+#if defined(_MSC_VER)
+        unsigned long Index;
+        _BitScanForward(&Index, Value);
+        return (uint32)Index;
+#else
+        return (uint32)__builtin_ctz(Value);
+#endif
+    }
+
     static inline int32 Rand()              { return rand(); }
     static inline void RandInit(int32 Seed) { srand(Seed); }
     static inline float FRand()
@@ -150,11 +197,15 @@ struct FMath
     static int32 RandRange(int32 Min, int32 Max)
     {
         int32 Range = (Max - Min) + 1;
+        // FRand can return 1, which would land one past Max.
+        int32 Offset = TruncToInt(FRand() * (float)Range);
+        return Min + (Offset < Range ? Offset : Range - 1);
     }
     static int64 RandRange(int64 Min, int64 Max)
     {
         int64 Range = (Max - Min) + 1;
-
+        int64 Offset = (int64)(FRand() * (double)Range);
+        return Min + (Offset < Range ? Offset : Range - 1);
     }
     static float RandRange(float Min, float Max)
     {
@@ -174,7 +225,7 @@ struct FMath
     }
 
     template <class T>
-    static constexpr inline T Max(const T A, const T B)
+    static constexpr inline T Min(const T A, const T B)
     {
         return (A<=B) ? A : B;
     }
@@ -183,11 +234,37 @@ struct FMath
     template <class T>
     static inline T Clamp(const T Value, const T Min, const T Max)
     {
-        return Value < Min ? Min : X < Max ? Value : Max;
+        return Value < Min ? Min : Value < Max ? Value : Max;
+    }
+
+    /**
+     * @brief Wraps Value into [Min, Max] by whole periods of Max - Min.
+     */
+    template <class T>
+    static inline T Wrap(const T Value, const T Min, const T Max)
+    {
+        const T Size = Max - Min;
+        if (Size == (T)0)
+        {
+            return Max;
+        }
+        T Result = Value;
+        while (Result < Min)
+        {
+            Result += Size;
+        }
+        while (Result > Max)
+        {
+            Result -= Size;
+        }
+        return Result;
+    }
+
+    template <class T, class U>
+    static inline T Lerp(const T& A, const T& B, const U& Alpha)
+    {
+        return (T)(A + Alpha * (B - A));
     }
-    static inline Wrap();
-    
-    static inline Lerp();
 
     static inline void SinCos(float Value, float* OutSin, float* OutCos);
 
@@ -204,4 +281,10 @@ template <>
 inline float FMath::Abs( const float A )
 {
     return fabsf(A);
+}
+
+inline void FMath::SinCos(float Value, float* OutSin, float* OutCos)
+{
+    *OutSin = sinf(Value);
+    *OutCos = cosf(Value);
 }
\ No newline at end of file
@@ -1,67 +1,85 @@
+#pragma once
 
 #include "math.h"
 #include "vector.h"
 #include "vector4.h"
 
-struct FMatrix
+template<typename T>
+struct TMatrix
 {
     union 
     {
-        float M[4][4];
+        T M[4][4];
     };
 
 
 public:
-    FMatrix();
-    FMatrix(const FVector& XAxis, const FVector& YAxis, const FVector& ZAxis, const FVector& WAxis);
+    TMatrix();
+    TMatrix(const TVector<T>& XAxis, const TVector<T>& YAxis, const TVector<T>& ZAxis, const TVector<T>& WAxis);
+
+    /**
+     * @brief Convert between float and double precision matrices.
+     */
+    template<typename U>
+    explicit TMatrix(const TMatrix<U>& Other);
 
     inline void SetIndentity();
 
-    inline FMatrix operator *(const FMatrix& Other) const;
-    inline void operator *=(const FMatrix& Other);
+    inline TMatrix<T> operator *(const TMatrix<T>& Other) const;
+    inline void operator *=(const TMatrix<T>& Other);
 
-    inline FMatrix operator*(float Scale) const;
-    inline void operator*=(float Scale);
+    inline TMatrix<T> operator*(T Scale) const;
+    inline void operator*=(T Scale);
 
-    inline bool operator ==(const FMatrix& Other) const;
+    inline bool operator ==(const TMatrix<T>& Other) const;
 
 public:
-    inline FVector4 TransformVector(const FVector4& V) const;
-    inline FVector4 TransformVector(const FVector& V) const;
-    inline FVector  InverseTransformVector(const FVector& V) const;
-    inline FVector4 TransformPosition(const FVector& V) const;
-    inline FVector  InverseTransfromPosition(const FVector& V) const;
+    inline TVector4<T> TransformVector(const TVector4<T>& V) const;
+    inline TVector4<T> TransformVector(const TVector<T>& V) const;
+    inline TVector<T>  InverseTransformVector(const TVector<T>& V) const;
+    inline TVector4<T> TransformPosition(const TVector<T>& V) const;
+    inline TVector<T>  InverseTransfromPosition(const TVector<T>& V) const;
 
-    inline float Determinant() const;
-    inline FMatrix Inverse() const;
-    inline FMatrix Transposed() const;
+    inline T Determinant() const;
+    inline TMatrix<T> Inverse() const;
+    inline TMatrix<T> Transposed() const;
 
     inline void RemovingScaling();
-    inline FMatrix RemovingTranslation() const;
+    inline TMatrix<T> RemovingTranslation() const;
 
-    inline FMatrix ApplyScale(float Scale) const;
-    inline FVector GetScale() const;
+    inline TMatrix<T> ApplyScale(T Scale) const;
+    inline TVector<T> GetScale() const;
 
-    inline FVector GetTranslation() const;
-    inline void SetTranslation(const FVector& Position);
+    inline TVector<T> GetTranslation() const;
+    inline void SetTranslation(const TVector<T>& Position);
 
-    inline FVector GetAxis(int32 Axis);
-    inline void GetAxis(FVector& OutXAxis, FVector& OutYAxis, FVector& OutZAxis) const;
-    inline FVector GetAxisNormalized() const;
+    inline TVector<T> GetAxis(int32 Axis);
+    inline void GetAxis(TVector<T>& OutXAxis, TVector<T>& OutYAxis, TVector<T>& OutZAxis) const;
+    inline TVector<T> GetAxisNormalized() const;
     inline void GetAxisNormalized();
 
 public:
-    inline static void MatrixMultipy(FMatrix& Result, const FMatrix& A, const FMatrix& B);
-    inline static void MatrixInverse(FMatrix& Result, FMatrix* SrcMatrix);
-    inline static void MatrixTransformVector(FVector4& Result, const FVector4& V, const FMatrix& M);
+    inline static void MatrixMultipy(TMatrix<T>& Result, const TMatrix<T>& A, const TMatrix<T>& B);
+    inline static void MatrixInverse(TMatrix<T>& Result, const TMatrix<T>* SrcMatrix);
+    inline static void MatrixTransformVector(TVector4<T>& Result, const TVector4<T>& V, const TMatrix<T>& M);
+
+private:
+    inline bool IsAffine() const;
+    /** Solve X * [3x3 part] = V with Cramer's rule. */
+    inline TVector<T> InverseTransform3x3(const TVector<T>& V) const;
 };
 
-inline FMatrix::FMatrix()
+typedef TMatrix<float>  FMatrix;
+typedef TMatrix<double> FMatrix44d;
+
+template<typename T>
+inline TMatrix<T>::TMatrix()
 {
 
 }
 
-inline FMatrix::FMatrix(const FVector& XAxis, const FVector& YAxis, const FVector& ZAxis, const FVector& WAxis)
+template<typename T>
+inline TMatrix<T>::TMatrix(const TVector<T>& XAxis, const TVector<T>& YAxis, const TVector<T>& ZAxis, const TVector<T>& WAxis)
 {
     M[0][0] = XAxis.X; M[0][1] = XAxis.Y; M[0][2] = XAxis.Z; M[0][3] = 0;
     M[1][0] = YAxis.X; M[1][1] = YAxis.Y; M[1][2] = YAxis.Z; M[1][3] = 0;
@@ -69,7 +87,21 @@ inline FMatrix::FMatrix(const FVector& XAxis, const FVector& YAxis, const FVecto
     M[3][0] = WAxis.X; M[3][1] = WAxis.Y; M[3][2] = WAxis.Z; M[3][3] = 0;
 }
 
-inline void FMatrix::SetIndentity()
+template<typename T>
+template<typename U>
+inline TMatrix<T>::TMatrix(const TMatrix<U>& Other)
+{
+    for (int32 i=0; i<4; i++)
+    {
+        for (int32 j=0; j<4; j++)
+        {
+            M[i][j] = (T)Other.M[i][j];
+        }
+    }
+}
+
+template<typename T>
+inline void TMatrix<T>::SetIndentity()
 {
     M[0][0] = 1; M[0][1] = 0; M[0][2] = 0; M[0][3] = 0;
     M[1][0] = 0; M[1][1] = 1; M[1][2] = 0; M[1][3] = 0;
@@ -79,22 +111,24 @@ inline void FMatrix::SetIndentity()
 }
 
 
-inline FMatrix FMatrix::operator*(float Scale) const
+template<typename T>
+inline TMatrix<T> TMatrix<T>::operator*(T Scale) const
 {
-    FMatrix Result;
+    TMatrix<T> Result;
 
     for (int32 i=0; i<4; i++)
     {
         for (int32 j=0; j<4; j++)
         {
-            Result.M[i][j] *= Scale;
+            Result.M[i][j] = M[i][j] * Scale;
         }
     }
 
     return Result;
 }
 
-inline void FMatrix::operator*=(float Scale)
+template<typename T>
+inline void TMatrix<T>::operator*=(T Scale)
 {
     for (int32 i=0; i<4; i++)
     {
@@ -105,7 +139,8 @@ inline void FMatrix::operator*=(float Scale)
     }
 }
 
-inline void FMatrix::MatrixMultipy(FMatrix& Result, const FMatrix& A, const FMatrix& B)
+template<typename T>
+inline void TMatrix<T>::MatrixMultipy(TMatrix<T>& Result, const TMatrix<T>& A, const TMatrix<T>& B)
 {
     Result.M[0][0] = A.M[0][0] * B.M[0][0] + A.M[0][1] * B.M[1][0] + A.M[0][2] * B.M[2][0] + A.M[0][3] * B.M[3][0];       
     Result.M[0][1] = A.M[0][0] * B.M[0][1] + A.M[0][1] * B.M[1][1] + A.M[0][2] * B.M[2][1] + A.M[0][3] * B.M[3][1];       
@@ -129,113 +164,177 @@ inline void FMatrix::MatrixMultipy(FMatrix& Result, const FMatrix& A, const FMat
 }
 
 
-inline FMatrix FMatrix::operator*(const FMatrix& Other) const
+template<typename T>
+inline TMatrix<T> TMatrix<T>::operator*(const TMatrix<T>& Other) const
 {
-    FMatrix Result;
+    TMatrix<T> Result;
 
-    FMatrix::MatrixMultipy(&Result, *this, Other);
+    TMatrix<T>::MatrixMultipy(Result, *this, Other);
 
     return Result;
 }
 
-inline void FMatrix::operator*=(const FMatrix& Other)
+template<typename T>
+inline void TMatrix<T>::operator*=(const TMatrix<T>& Other)
 {
-    FMatrix Result;
+    TMatrix<T> Result;
 
-    FMatrix::MatrixMultipy(&Result, *this, Other);
+    TMatrix<T>::MatrixMultipy(Result, *this, Other);
 
     *this = Result;
 }
 
-inline void FMatrix::MatrixInverse(FMatrix& Result, FMatrix* SrcMatrix)
+template<typename T>
+inline void TMatrix<T>::MatrixInverse(TMatrix<T>& Result, const TMatrix<T>* SrcMatrix)
 {
-    FMatrix Result;
-
-    typedef float Float4x4[4][4];
-    float Det[4];
-
-    const Float4x4& M = *((const Float4x4*)SrcMatrix);
-
-    float m00 = M[2][2] * M[3][3] - M[2][3] * M[3][2];
-    float m01 = M[1][2] * M[3][3] - M[1][3] * M[3][2];
-    float m02 = M[1][2] * M[2][3] - M[1][3] * M[2][2];
-
-    float m10 = M[2][2] * M[3][3] - M[2][3] * M[3][2];
-    float m11 = M[0][2] * M[3][3] - M[0][3] * M[3][2];
-    float m12 = M[0][2] * M[2][3] - M[0][3] * M[2][2];
-
-    float m20 = M[1][2] * M[3][3] - M[1][3] * M[3][2];
-    float m21 = M[0][2] * M[3][3] - M[0][3] * M[3][2];
-    float m22 = M[0][2] * M[1][3] - M[0][3] * M[1][2];
-
-    float m30 = M[1][2] * M[2][3] - M[1][3] * M[2][2];
-    float m31 = M[0][2] * M[2][3] - M[0][3] * M[2][2];
-    float m32 = M[0][2] * M[1][3] - M[0][3] * M[1][2];
-
-    Det[0] = M[1][1] * m00 - M[2][1] * m01 + M[3][1] * m02;
-    Det[1] = M[0][1] * m10 - M[2][1] * m11 + M[3][1] * m12;
-    Det[2] = M[0][1] * m20 - M[1][1] * m21 + M[3][1] * m22;
-    Det[3] = M[0][1] * m30 - M[1][1] * m31 + M[2][1] * m32;
-
-    float Determinant = m00 * Det[0] - m10  * Det[1] + m20 * Det[2] - m30 * Det[3];
-    float RDet = 1.0f / Determinant;
+    const T (&M)[4][4] = SrcMatrix->M;
+
+    // 2x2 sub determinants of the two lower rows and of the two upper rows.
+    T s0 = M[0][0] * M[1][1] - M[1][0] * M[0][1];
+    T s1 = M[0][0] * M[1][2] - M[1][0] * M[0][2];
+    T s2 = M[0][0] * M[1][3] - M[1][0] * M[0][3];
+    T s3 = M[0][1] * M[1][2] - M[1][1] * M[0][2];
+    T s4 = M[0][1] * M[1][3] - M[1][1] * M[0][3];
+    T s5 = M[0][2] * M[1][3] - M[1][2] * M[0][3];
+
+    T c5 = M[2][2] * M[3][3] - M[3][2] * M[2][3];
+    T c4 = M[2][1] * M[3][3] - M[3][1] * M[2][3];
+    T c3 = M[2][1] * M[3][2] - M[3][1] * M[2][2];
+    T c2 = M[2][0] * M[3][3] - M[3][0] * M[2][3];
+    T c1 = M[2][0] * M[3][2] - M[3][0] * M[2][2];
+    T c0 = M[2][0] * M[3][1] - M[3][0] * M[2][1];
+
+    T Determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    T RDet = T(1) / Determinant;
+
+    Result.M[0][0] = ( M[1][1] * c5 - M[1][2] * c4 + M[1][3] * c3) * RDet;
+    Result.M[0][1] = (-M[0][1] * c5 + M[0][2] * c4 - M[0][3] * c3) * RDet;
+    Result.M[0][2] = ( M[3][1] * s5 - M[3][2] * s4 + M[3][3] * s3) * RDet;
+    Result.M[0][3] = (-M[2][1] * s5 + M[2][2] * s4 - M[2][3] * s3) * RDet;
+
+    Result.M[1][0] = (-M[1][0] * c5 + M[1][2] * c2 - M[1][3] * c1) * RDet;
+    Result.M[1][1] = ( M[0][0] * c5 - M[0][2] * c2 + M[0][3] * c1) * RDet;
+    Result.M[1][2] = (-M[3][0] * s5 + M[3][2] * s2 - M[3][3] * s1) * RDet;
+    Result.M[1][3] = ( M[2][0] * s5 - M[2][2] * s2 + M[2][3] * s1) * RDet;
+
+    Result.M[2][0] = ( M[1][0] * c4 - M[1][1] * c2 + M[1][3] * c0) * RDet;
+    Result.M[2][1] = (-M[0][0] * c4 + M[0][1] * c2 - M[0][3] * c0) * RDet;
+    Result.M[2][2] = ( M[3][0] * s4 - M[3][1] * s2 + M[3][3] * s0) * RDet;
+    Result.M[2][3] = (-M[2][0] * s4 + M[2][1] * s2 - M[2][3] * s0) * RDet;
+
+    Result.M[3][0] = (-M[1][0] * c3 + M[1][1] * c1 - M[1][2] * c0) * RDet;
+    Result.M[3][1] = ( M[0][0] * c3 - M[0][1] * c1 + M[0][2] * c0) * RDet;
+    Result.M[3][2] = (-M[3][0] * s3 + M[3][1] * s1 - M[3][2] * s0) * RDet;
+    Result.M[3][3] = ( M[2][0] * s3 - M[2][1] * s1 + M[2][2] * s0) * RDet;
+}
 
-    Result.M[0][0] =  RDet * Det[0];
-    Result.M[0][1] = -RDet * Det[1];
-    Result.M[0][2] =  RDet * Det[2];
-    Result.M[0][3] = -RDet * Det[3];
+template<typename T>
+inline T TMatrix<T>::Determinant() const
+{
+    T s0 = M[0][0] * M[1][1] - M[1][0] * M[0][1];
+    T s1 = M[0][0] * M[1][2] - M[1][0] * M[0][2];
+    T s2 = M[0][0] * M[1][3] - M[1][0] * M[0][3];
+    T s3 = M[0][1] * M[1][2] - M[1][1] * M[0][2];
+    T s4 = M[0][1] * M[1][3] - M[1][1] * M[0][3];
+    T s5 = M[0][2] * M[1][3] - M[1][2] * M[0][3];
+
+    T c5 = M[2][2] * M[3][3] - M[3][2] * M[2][3];
+    T c4 = M[2][1] * M[3][3] - M[3][1] * M[2][3];
+    T c3 = M[2][1] * M[3][2] - M[3][1] * M[2][2];
+    T c2 = M[2][0] * M[3][3] - M[3][0] * M[2][3];
+    T c1 = M[2][0] * M[3][2] - M[3][0] * M[2][2];
+    T c0 = M[2][0] * M[3][1] - M[3][0] * M[2][1];
+
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
 
-    Result.M[1][0] = -RDet * M[1][0] * m00 - M[2][0] * m01 + M[3][0] * m02;
-    Result.M[1][1] =  RDet * M[0][0] * m10 - M[2][0] * m11 + M[3][0] * m12;
-    Result.M[1][2] = -RDet * M[0][0] * m20 - M[1][0] * m21 + M[3][0] * m22;
-    Result.M[1][3] =  RDet * M[0][0] * m30 - M[1][0] * m31 + M[2][0] * m32;
+template<typename T>
+inline TMatrix<T> TMatrix<T>::Inverse() const
+{
+    TMatrix<T> Result;
 
-    Result.M[2][0] =  RDet * (M[1][0] * (M[2][1] * M[3][3] - M[2][3] * M[3][1]) - M[2][0] * (M[1][1] * M[3][3] - M[1][3] * M[3][1]) +  M[3][0] * (M[1][1] * M[2][3] - M[1][3] * M[2][1]));
-    Result.M[2][1] = -RDet * (M[0][0] * (M[2][1] * M[3][3] - M[2][3] * M[3][1]) - M[2][0] * (M[0][1] * M[3][3] - M[0][3] * M[3][1]) +  M[3][0] * (M[0][1] * M[2][3] - M[0][3] * M[2][1]));
-    Result.M[2][2] =  RDet * (M[0][0] * (M[1][1] * M[3][3] - M[2][3] * M[3][1]) - M[1][0] * (M[0][1] * M[3][3] - M[0][3] * M[3][1]) +  M[3][0] * (M[0][1] * M[1][3] - M[0][3] * M[1][1]));
-    Result.M[2][3] = -RDet * (M[0][0] * (M[1][1] * M[2][3] - M[1][3] * M[2][1]) - M[1][0] * (M[0][1] * M[2][3] - M[0][3] * M[2][1]) +  M[2][0] * (M[0][1] * M[1][3] - M[0][3] * M[1][1]));
+    TMatrix<T>::MatrixInverse(Result, this);
 
-    Result.M[3][0] = -RDet * (M[1][0] * (M[2][1] * M[3][2] - M[2][2] * M[3][1]) - M[2][0] * (M[1][1] * M[3][2] - M[1][2] * M[3][1]) +  M[3][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1]));
-    Result.M[3][1] =  RDet * (M[0][0] * (M[2][1] * M[3][2] - M[2][2] * M[3][1]) - M[2][0] * (M[0][1] * M[3][2] - M[0][2] * M[3][1]) +  M[3][0] * (M[0][1] * M[2][2] - M[0][2] * M[2][1]));
-    Result.M[3][2] = -RDet * (M[0][0] * (M[1][1] * M[3][2] - M[1][2] * M[3][1]) - M[1][0] * (M[0][1] * M[3][2] - M[0][2] * M[3][1]) +  M[3][0] * (M[0][1] * M[1][2] - M[0][2] * M[1][1]));
-    Result.M[3][3] =  RDet * (M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1]) - M[1][0] * (M[0][1] * M[2][2] - M[0][2] * M[2][1]) +  M[2][0] * (M[0][1] * M[1][2] - M[0][2] * M[1][1]));
+    return Result;
 }
 
-inline void FMatrix::MatrixTransformVector(FVector4& Result, const FVector4& V, const FMatrix& M)
+template<typename T>
+inline void TMatrix<T>::MatrixTransformVector(TVector4<T>& Result, const TVector4<T>& V, const TMatrix<T>& M)
 {
-    Result.X = M.M[0][0] * V.X + M.M[1][0] * V.Y + M.M[2][0] * V.Z + M.M[3][3] * V.W;
-    Result.Y = M.M[0][1] * V.X + M.M[1][1] * V.Y + M.M[2][1] * V.Z + M.M[3][3] * V.W;
-    Result.Z = M.M[0][2] * V.X + M.M[1][2] * V.Y + M.M[2][2] * V.Z + M.M[3][3] * V.W;
+    Result.X = M.M[0][0] * V.X + M.M[1][0] * V.Y + M.M[2][0] * V.Z + M.M[3][0] * V.W;
+    Result.Y = M.M[0][1] * V.X + M.M[1][1] * V.Y + M.M[2][1] * V.Z + M.M[3][1] * V.W;
+    Result.Z = M.M[0][2] * V.X + M.M[1][2] * V.Y + M.M[2][2] * V.Z + M.M[3][2] * V.W;
     Result.W = M.M[0][3] * V.X + M.M[1][3] * V.Y + M.M[2][3] * V.Z + M.M[3][3] * V.W;
 }
 
-inline FVector4 FMatrix::TransformVector(const FVector4& V) const
+template<typename T>
+inline TVector4<T> TMatrix<T>::TransformVector(const TVector4<T>& V) const
 {
-    FVector4 Result;
+    TVector4<T> Result;
 
-    FMatrix::MatrixTransformVector(Result, V, *this);
+    TMatrix<T>::MatrixTransformVector(Result, V, *this);
 
     return Result;
 }
 
-inline FVector4 FMatrix::TransformPosition(const FVector& V) const
+template<typename T>
+inline TVector4<T> TMatrix<T>::TransformPosition(const TVector<T>& V) const
 {
-    return TransformVector(FVector4(V, 1.0f));
+    return TransformVector(TVector4<T>(V, T(1)));
 }
 
-inline FVector4 FMatrix::TransformVector(const FVector& V) const
+template<typename T>
+inline TVector4<T> TMatrix<T>::TransformVector(const TVector<T>& V) const
 {
-    return TransformVector(FVector4(V, 0.0f));
+    return TransformVector(TVector4<T>(V, T(0)));
 }
 
-inline FVector4 FMatrix::InverseTransformVector(const FVector& V) const
+template<typename T>
+inline TVector<T> TMatrix<T>::InverseTransformVector(const TVector<T>& V) const
 {
-    FMatrix InverseMatrix = FMatrix::Inverse();
-    return InverseMatrix.TransformVector(V);
+    // Affine matrices skip building the full inverse.
+    if (IsAffine())
+    {
+        return InverseTransform3x3(V);
+    }
+
+    TMatrix<T> InverseMatrix = Inverse();
+    TVector4<T> Result = InverseMatrix.TransformVector(V);
+    return TVector<T>(Result.X, Result.Y, Result.Z);
 }
 
-inline FVector4 FMatrix::InverseTransfromPosition(const FVector& V) const
+template<typename T>
+inline TVector<T> TMatrix<T>::InverseTransfromPosition(const TVector<T>& V) const
 {
-    FMatrix InverseMatrix = FMatrix::Inverse();
-    return InverseMatrix.TransformPosition(V);
-}
\ No newline at end of file
+    // Affine matrices skip building the full inverse.
+    if (IsAffine())
+    {
+        return InverseTransform3x3(TVector<T>(V.X - M[3][0], V.Y - M[3][1], V.Z - M[3][2]));
+    }
+
+    TMatrix<T> InverseMatrix = Inverse();
+    TVector4<T> Result = InverseMatrix.TransformPosition(V);
+    return TVector<T>(Result.X, Result.Y, Result.Z);
+}
+
+template<typename T>
+inline bool TMatrix<T>::IsAffine() const
+{
+    return M[0][3] == T(0) && M[1][3] == T(0) && M[2][3] == T(0) && M[3][3] == T(1);
+}
+
+template<typename T>
+inline TVector<T> TMatrix<T>::InverseTransform3x3(const TVector<T>& V) const
+{
+    // V = X.X * Row0 + X.Y * Row1 + X.Z * Row2.
+    const TVector<T> Row0(M[0][0], M[0][1], M[0][2]);
+    const TVector<T> Row1(M[1][0], M[1][1], M[1][2]);
+    const TVector<T> Row2(M[2][0], M[2][1], M[2][2]);
+
+    const TVector<T> C0 = Row1 ^ Row2;
+    const TVector<T> C1 = Row2 ^ Row0;
+    const TVector<T> C2 = Row0 ^ Row1;
+
+    const T RDet = T(1) / (Row0 | C0);
+    return TVector<T>((V | C0) * RDet, (V | C1) * RDet, (V | C2) * RDet);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "vector.h"
+
+/**
+ * @brief A plane in 3D space, stored as the normal (X, Y, Z) and W so that Normal|P == W
+ *        for every point P on the plane.
+ */
+struct FPlane : public FVector
+{
+    /** Distance from the origin along the normal. */
+    float W;
+
+public:
+    FPlane();
+    FPlane(float _X, float _Y, float _Z, float _W);
+    FPlane(const FVector& Normal, float _W);
+    FPlane(const FVector& Origin, const FVector& Normal);
+
+public:
+    /**
+     * @brief Signed distance of a point to the plane, positive on the side the normal points to.
+     *        Only a distance if the plane is normalized.
+     *
+     * @param P The point.
+     * @return The signed distance.
+     */
+    inline float PlaneDot(const FVector& P) const;
+
+    /**
+     * @brief Normalize the normal and scale W accordingly.
+     *
+     * @return false The normal is nearly zero, the plane is left unchanged.
+     */
+    inline bool Normalize();
+
+    /**
+     * @brief The plane with the normal pointing to the other side.
+     */
+    inline FPlane Flip() const;
+};
+
+inline FPlane::FPlane()
+{
+
+}
+
+inline FPlane::FPlane(float _X, float _Y, float _Z, float _W)
+: FVector(_X, _Y, _Z), W(_W)
+{
+
+}
+
+inline FPlane::FPlane(const FVector& Normal, float _W)
+: FVector(Normal), W(_W)
+{
+
+}
+
+inline FPlane::FPlane(const FVector& Origin, const FVector& Normal)
+: FVector(Normal), W(Origin | Normal)
+{
+
+}
+
+inline float FPlane::PlaneDot(const FVector& P) const
+{
+    return X*P.X + Y*P.Y + Z*P.Z - W;
+}
+
+inline bool FPlane::Normalize()
+{
+    float Square = X*X + Y*Y + Z*Z;
+
+    if ( Square > FLT_TOLERANCE )
+    {
+        float InvSize = FMath::InvSqrt(Square);
+
+        X *= InvSize;
+        Y *= InvSize;
+        Z *= InvSize;
+        W *= InvSize;
+
+        return true;
+    }
+
+    return false;
+}
+
+inline FPlane FPlane::Flip() const
+{
+    return FPlane(-X, -Y, -Z, -W);
+}
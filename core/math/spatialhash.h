@@ -0,0 +1,493 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "vector.h"
+#include "vector2D.h"
+#include "../job/jobsystem.h"
+
+/**
+ * @brief Uniform grid hashed into a fixed number of buckets, for radius queries over FVector or
+ *        FVector2D points.
+ *
+ * Points are counting-sorted by bucket into flat arrays: BucketStart gives the range of every
+ * bucket in SortedIndices and in the sorted SoA positions, so a query reads each touched bucket as
+ * one contiguous run and tests 8 points per AVX iteration.
+ */
+template<typename VectorType>
+class TSpatialHashGrid
+{
+public:
+    enum { Dim = sizeof(VectorType) / sizeof(float) };
+
+    static_assert(Dim == 2 || Dim == 3, "TSpatialHashGrid supports FVector2D and FVector.");
+
+    /** Range of every bucket, NumBuckets + 1 entries. */
+    std::vector<uint32> BucketStart;
+    /** Point indices ordered by bucket. */
+    std::vector<uint32> SortedIndices;
+    /** Point positions ordered by bucket, one array per component. */
+    std::vector<float>  SortedPositions[Dim];
+
+public:
+    /**
+     * @param InCellSize Edge length of a cell, usually the typical query radius.
+     * @param InNumThreads Ranges the build is split in, 0 for one per job system thread.
+     */
+    TSpatialHashGrid(float InCellSize, int32 InNumThreads = 0);
+
+    /**
+     * @brief Sort all points into the grid.
+     */
+    inline void Build(const VectorType* Points, int32 Num);
+
+    /**
+     * @brief Rebuild for the next frame. Buffers are reused and only the points that changed bucket
+     *        are re-bucketed: they are sorted on their own and merged into the existing order. When
+     *        a large part of the points moved everything is sorted again.
+     *
+     * @return Number of points whose cell changed.
+     */
+    inline int32 Update(const VectorType* Points, int32 Num);
+
+    /**
+     * @brief Call Visit(uint32 PointIndex, float DistanceSquared) for every point within Radius.
+     */
+    template<typename FunctionType>
+    inline void QueryRadius(const VectorType& Center, float Radius, FunctionType Visit) const;
+
+    /**
+     * @brief Append the indices of the points within Radius to OutIndices.
+     */
+    inline void QueryRadius(const VectorType& Center, float Radius, std::vector<uint32>& OutIndices) const;
+
+private:
+    inline uint32 GetBucket(const int32* Cell) const;
+    inline void GetCell(const VectorType& P, int32* OutCell) const;
+
+    template<typename FunctionType>
+    inline void ParallelRange(int32 Num, FunctionType Function);
+
+    inline void ComputeKeys(const VectorType* Points, int32 Num, std::vector<uint32>& OutKeys);
+    inline void Sort(const VectorType* Points, int32 Num);
+    inline void Rebucket(int32 Num);
+    inline void RefreshPositions(const VectorType* Points, int32 Num);
+
+    /** Blocks of buckets the first pass of Sort splits the points in. */
+    enum { MaxSortBlocks = 1024 };
+
+    float  CellSize;
+    float  InvCellSize;
+    uint32 NumBuckets;
+    int32  NumThreads;
+
+    std::vector<uint32> Keys;
+    std::vector<uint32> NewKeys;
+    std::vector<uint32> ThreadCounts;
+    std::vector<uint32> BlockStart;
+    std::vector<uint32> BlockIndices;
+    std::vector<uint32> Moved;
+};
+
+typedef TSpatialHashGrid<FVector>   FSpatialHashGrid;
+typedef TSpatialHashGrid<FVector2D> FSpatialHashGrid2D;
+
+template<typename VectorType>
+TSpatialHashGrid<VectorType>::TSpatialHashGrid(float InCellSize, int32 InNumThreads)
+: CellSize(InCellSize), InvCellSize(1.0f / InCellSize), NumBuckets(0), NumThreads(InNumThreads < 1 ? FJobSystem::Get().GetNumThreads() : InNumThreads)
+{
+
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::GetCell(const VectorType& P, int32* OutCell) const
+{
+    for (int32 Axis=0; Axis<Dim; Axis++)
+    {
+        OutCell[Axis] = FMath::FloorToInt((&P.X)[Axis] * InvCellSize);
+    }
+}
+
+template<typename VectorType>
+inline uint32 TSpatialHashGrid<VectorType>::GetBucket(const int32* Cell) const
+{
+    // Teschner et al. spatial hash.
+    static const uint32 Primes[3] = { 73856093u, 19349663u, 83492791u };
+
+    uint32 Hash = 0;
+    for (int32 Axis=0; Axis<Dim; Axis++)
+    {
+        Hash ^= (uint32)Cell[Axis] * Primes[Axis];
+    }
+    return Hash & (NumBuckets - 1);
+}
+
+template<typename VectorType>
+template<typename FunctionType>
+inline void TSpatialHashGrid<VectorType>::ParallelRange(int32 Num, FunctionType Function)
+{
+    // One job per slot, the per slot histograms of the sort need a fixed split.
+    int32 Used = NumThreads < Num ? NumThreads : (Num > 0 ? Num : 1);
+    int32 PerThread = (Num + Used - 1) / Used;
+
+    FJobSystem::Get().ParallelFor(Used, [&Function, PerThread, Num](int32 SlotBegin, int32 SlotEnd)
+    {
+        for (int32 t=SlotBegin; t<SlotEnd; t++)
+        {
+            int32 Begin = t * PerThread;
+            int32 End = Begin + PerThread < Num ? Begin + PerThread : Num;
+            Function(Begin < End ? Begin : End, End, t);
+        }
+    });
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::ComputeKeys(const VectorType* Points, int32 Num, std::vector<uint32>& OutKeys)
+{
+    OutKeys.resize(Num);
+    ParallelRange(Num, [this, Points, &OutKeys](int32 Begin, int32 End, int32)
+    {
+        int32 Cell[Dim];
+        for (int32 i=Begin; i<End; i++)
+        {
+            GetCell(Points[i], Cell);
+            OutKeys[i] = GetBucket(Cell);
+        }
+    });
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::Build(const VectorType* Points, int32 Num)
+{
+    // About two buckets per point keeps collisions rare.
+    uint32 WantedBuckets = 64;
+    while (WantedBuckets < 2 * (uint32)Num)
+    {
+        WantedBuckets <<= 1;
+    }
+    NumBuckets = WantedBuckets;
+
+    ComputeKeys(Points, Num, Keys);
+    Sort(Points, Num);
+}
+
+template<typename VectorType>
+inline int32 TSpatialHashGrid<VectorType>::Update(const VectorType* Points, int32 Num)
+{
+    if ((int32)Keys.size() != Num || NumBuckets < 2 * (uint32)Num)
+    {
+        Build(Points, Num);
+        return Num;
+    }
+
+    ComputeKeys(Points, Num, NewKeys);
+
+    Moved.clear();
+    for (int32 i=0; i<Num; i++)
+    {
+        if (NewKeys[i] != Keys[i])
+        {
+            Moved.push_back(i);
+        }
+    }
+    int32 NumChanged = (int32)Moved.size();
+
+    // Past about an eighth of the points the merge costs as much as the parallel sort.
+    if (NumChanged * 8 > Num)
+    {
+        Keys.swap(NewKeys);
+        Sort(Points, Num);
+        return NumChanged;
+    }
+
+    if (NumChanged > 0)
+    {
+        Rebucket(Num);
+        Keys.swap(NewKeys);
+    }
+
+    // Points that kept their bucket still moved inside it.
+    RefreshPositions(Points, Num);
+    return NumChanged;
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::Rebucket(int32 Num)
+{
+    // Moved by new bucket, then one pass over the buckets that drops the moved points from their
+    // old run and appends them to the new one. Keys still holds the old buckets.
+    std::sort(Moved.begin(), Moved.end(), [this](uint32 A, uint32 B)
+    {
+        return NewKeys[A] != NewKeys[B] ? NewKeys[A] < NewKeys[B] : A < B;
+    });
+
+    BlockIndices.resize(Num);
+
+    uint32 Out = 0;
+    uint32 OldBegin = BucketStart[0];
+    size_t NextMoved = 0;
+    for (uint32 Bucket=0; Bucket<NumBuckets; Bucket++)
+    {
+        uint32 OldEnd = BucketStart[Bucket + 1];
+        BucketStart[Bucket] = Out;
+
+        for (uint32 i=OldBegin; i<OldEnd; i++)
+        {
+            uint32 PointIndex = SortedIndices[i];
+            if (NewKeys[PointIndex] == Keys[PointIndex])
+            {
+                BlockIndices[Out++] = PointIndex;
+            }
+        }
+        for (; NextMoved < Moved.size() && NewKeys[Moved[NextMoved]] == Bucket; NextMoved++)
+        {
+            BlockIndices[Out++] = Moved[NextMoved];
+        }
+
+        OldBegin = OldEnd;
+    }
+    BucketStart[NumBuckets] = Out;
+
+    SortedIndices.swap(BlockIndices);
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::RefreshPositions(const VectorType* Points, int32 Num)
+{
+    ParallelRange(Num, [this, Points](int32 Begin, int32 End, int32)
+    {
+        for (int32 i=Begin; i<End; i++)
+        {
+            const VectorType& P = Points[SortedIndices[i]];
+            for (int32 Axis=0; Axis<Dim; Axis++)
+            {
+                SortedPositions[Axis][i] = (&P.X)[Axis];
+            }
+        }
+    });
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::Sort(const VectorType* Points, int32 Num)
+{
+    // Two pass parallel counting sort. The first pass splits the points by the high bits of their
+    // bucket into at most MaxSortBlocks blocks: per thread histograms of the blocks, an exclusive
+    // scan over (block, thread), then a stable scatter. The histograms and the serial scan stay
+    // small however many buckets there are. The second pass counting sorts every block by bucket,
+    // blocks are independent and run in parallel.
+    int32 Used = NumThreads < Num ? NumThreads : (Num > 0 ? Num : 1);
+
+    uint32 NumBlocks = NumBuckets < (uint32)MaxSortBlocks ? NumBuckets : (uint32)MaxSortBlocks;
+    uint32 BlockShift = 0;
+    while ((NumBlocks << BlockShift) < NumBuckets)
+    {
+        BlockShift++;
+    }
+    uint32 BucketsPerBlock = NumBuckets / NumBlocks;
+
+    ThreadCounts.assign((size_t)Used * NumBlocks, 0);
+    BlockStart.resize(NumBlocks + 1);
+    BlockIndices.resize(Num);
+    BucketStart.resize(NumBuckets + 1);
+    SortedIndices.resize(Num);
+    for (int32 Axis=0; Axis<Dim; Axis++)
+    {
+        SortedPositions[Axis].resize(Num);
+    }
+
+    ParallelRange(Num, [this, NumBlocks, BlockShift](int32 Begin, int32 End, int32 Thread)
+    {
+        uint32* Counts = &ThreadCounts[(size_t)Thread * NumBlocks];
+        for (int32 i=Begin; i<End; i++)
+        {
+            Counts[Keys[i] >> BlockShift]++;
+        }
+    });
+
+    uint32 Offset = 0;
+    for (uint32 Block=0; Block<NumBlocks; Block++)
+    {
+        BlockStart[Block] = Offset;
+        for (int32 t=0; t<Used; t++)
+        {
+            uint32& Count = ThreadCounts[(size_t)t * NumBlocks + Block];
+            uint32 ThreadCount = Count;
+            Count = Offset;
+            Offset += ThreadCount;
+        }
+    }
+    BlockStart[NumBlocks] = Offset;
+
+    ParallelRange(Num, [this, NumBlocks, BlockShift](int32 Begin, int32 End, int32 Thread)
+    {
+        uint32* Cursors = &ThreadCounts[(size_t)Thread * NumBlocks];
+        for (int32 i=Begin; i<End; i++)
+        {
+            BlockIndices[Cursors[Keys[i] >> BlockShift]++] = i;
+        }
+    });
+
+    FJobSystem::Get().ParallelFor((int32)NumBlocks, [this, Points, BlockShift, BucketsPerBlock](int32 BlockBegin, int32 BlockEnd)
+    {
+        std::vector<uint32> Cursors(BucketsPerBlock);
+        for (int32 Block=BlockBegin; Block<BlockEnd; Block++)
+        {
+            uint32 FirstBucket = (uint32)Block << BlockShift;
+            uint32 Begin = BlockStart[Block];
+            uint32 End = BlockStart[Block + 1];
+
+            std::fill(Cursors.begin(), Cursors.end(), 0u);
+            for (uint32 j=Begin; j<End; j++)
+            {
+                Cursors[Keys[BlockIndices[j]] - FirstBucket]++;
+            }
+
+            uint32 BucketOffset = Begin;
+            for (uint32 b=0; b<BucketsPerBlock; b++)
+            {
+                BucketStart[FirstBucket + b] = BucketOffset;
+                uint32 Count = Cursors[b];
+                Cursors[b] = BucketOffset;
+                BucketOffset += Count;
+            }
+
+            // Indices within a block are ascending, so the point reads stay in order.
+            for (uint32 j=Begin; j<End; j++)
+            {
+                uint32 PointIndex = BlockIndices[j];
+                uint32 Slot = Cursors[Keys[PointIndex] - FirstBucket]++;
+                SortedIndices[Slot] = PointIndex;
+                for (int32 Axis=0; Axis<Dim; Axis++)
+                {
+                    SortedPositions[Axis][Slot] = (&Points[PointIndex].X)[Axis];
+                }
+            }
+        }
+    });
+    BucketStart[NumBuckets] = Offset;
+}
+
+template<typename VectorType>
+template<typename FunctionType>
+inline void TSpatialHashGrid<VectorType>::QueryRadius(const VectorType& Center, float Radius, FunctionType Visit) const
+{
+    if (NumBuckets == 0)
+    {
+        return;
+    }
+
+    float RadiusSquared = Radius * Radius;
+
+    int32 MinCell[3] = {}, MaxCell[3] = {};
+    for (int32 Axis=0; Axis<Dim; Axis++)
+    {
+        MinCell[Axis] = FMath::FloorToInt(((&Center.X)[Axis] - Radius) * InvCellSize);
+        MaxCell[Axis] = FMath::FloorToInt(((&Center.X)[Axis] + Radius) * InvCellSize);
+    }
+
+    // Two cells can hash to the same bucket, visit each bucket once. Counted in 64 bit and only up
+    // to NumBuckets: a radius covering that many cells reads every bucket anyway, walking them all
+    // once is cheaper than hashing and deduplicating the cells.
+    uint64 NumCells = 1;
+    for (int32 Axis=0; Axis<Dim && NumCells < NumBuckets; Axis++)
+    {
+        NumCells *= (uint64)((int64)MaxCell[Axis] - MinCell[Axis] + 1);
+    }
+
+    uint32 LocalBuckets[64];
+    std::vector<uint32> HeapBuckets;
+    uint32* Buckets = LocalBuckets;
+    uint32 NumQueryBuckets = 0;
+    if (NumCells >= NumBuckets)
+    {
+        NumQueryBuckets = NumBuckets;
+        Buckets = nullptr;
+    }
+    else
+    {
+        if (NumCells > 64)
+        {
+            HeapBuckets.resize((size_t)NumCells);
+            Buckets = HeapBuckets.data();
+        }
+
+        int32 Cell[3];
+        for (Cell[2] = MinCell[2]; Cell[2] <= MaxCell[2]; Cell[2]++)
+        for (Cell[1] = MinCell[1]; Cell[1] <= MaxCell[1]; Cell[1]++)
+        for (Cell[0] = MinCell[0]; Cell[0] <= MaxCell[0]; Cell[0]++)
+        {
+            Buckets[NumQueryBuckets++] = GetBucket(Cell);
+        }
+
+        // Sorting drops the duplicates in O(n log n) and reads BucketStart in order.
+        std::sort(Buckets, Buckets + NumQueryBuckets);
+        NumQueryBuckets = (uint32)(std::unique(Buckets, Buckets + NumQueryBuckets) - Buckets);
+    }
+
+    for (uint32 b=0; b<NumQueryBuckets; b++)
+    {
+        uint32 Bucket = Buckets != nullptr ? Buckets[b] : b;
+
+        // Points of other cells sharing the bucket are rejected by the distance test.
+        uint32 i = BucketStart[Bucket];
+        uint32 End = BucketStart[Bucket + 1];
+
+#if defined(__AVX__)
+        __m256 C[Dim];
+        for (int32 Axis=0; Axis<Dim; Axis++)
+        {
+            C[Axis] = _mm256_set1_ps((&Center.X)[Axis]);
+        }
+        __m256 R2 = _mm256_set1_ps(RadiusSquared);
+
+        for (; i + 8 <= End; i += 8)
+        {
+            __m256 D2 = _mm256_setzero_ps();
+            for (int32 Axis=0; Axis<Dim; Axis++)
+            {
+                __m256 D = _mm256_sub_ps(_mm256_loadu_ps(&SortedPositions[Axis][i]), C[Axis]);
+                D2 = _mm256_add_ps(D2, _mm256_mul_ps(D, D));
+            }
+
+            int32 Mask = _mm256_movemask_ps(_mm256_cmp_ps(D2, R2, _CMP_LE_OQ));
+            if (Mask != 0)
+            {
+                alignas(32) float Distances[8];
+                _mm256_store_ps(Distances, D2);
+                for (; Mask != 0; Mask &= Mask - 1)
+                {
+                    int32 Lane = (int32)FMath::CountTrailingZeros((uint32)Mask);
+                    Visit(SortedIndices[i + Lane], Distances[Lane]);
+                }
+            }
+        }
+#endif
+
+        for (; i < End; i++)
+        {
+            float D2 = 0.0f;
+            for (int32 Axis=0; Axis<Dim; Axis++)
+            {
+                float D = SortedPositions[Axis][i] - (&Center.X)[Axis];
+                D2 += D * D;
+            }
+            if (D2 <= RadiusSquared)
+            {
+                Visit(SortedIndices[i], D2);
+            }
+        }
+    }
+}
+
+template<typename VectorType>
+inline void TSpatialHashGrid<VectorType>::QueryRadius(const VectorType& Center, float Radius, std::vector<uint32>& OutIndices) const
+{
+    QueryRadius(Center, Radius, [&OutIndices](uint32 PointIndex, float)
+    {
+        OutIndices.push_back(PointIndex);
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "vector.h"
+
+struct FSphere
+{
+    /** Center of the sphere. */
+    FVector Center;
+    /** Radius of the sphere. */
+    float W;
+
+public:
+    FSphere();
+    FSphere(const FVector& _Center, float _W);
+
+public:
+    /**
+     * @brief Test if a point is inside the sphere.
+     *
+     * @param P The point.
+     * @param Tolerance Added to the radius.
+     * @return true The point is inside or on the sphere.
+     */
+    inline bool IsInside(const FVector& P, float Tolerance = FLT_TOLERANCE_SMALL) const;
+
+    /**
+     * @brief Test if two spheres overlap.
+     *
+     * @param Other The other sphere.
+     * @return true The spheres overlap.
+     */
+    inline bool Intersects(const FSphere& Other) const;
+
+    /**
+     * @brief The smallest sphere containing both spheres.
+     *
+     * @param Other The other sphere.
+     * @return The enclosing sphere.
+     */
+    inline FSphere operator+(const FSphere& Other) const;
+};
+
+inline FSphere::FSphere()
+{
+
+}
+
+inline FSphere::FSphere(const FVector& _Center, float _W)
+: Center(_Center), W(_W)
+{
+
+}
+
+inline bool FSphere::IsInside(const FVector& P, float Tolerance) const
+{
+    FVector D = P - Center;
+    return (D | D) <= (W + Tolerance) * (W + Tolerance);
+}
+
+inline bool FSphere::Intersects(const FSphere& Other) const
+{
+    FVector D = Other.Center - Center;
+    return (D | D) <= (W + Other.W) * (W + Other.W);
+}
+
+inline FSphere FSphere::operator+(const FSphere& Other) const
+{
+    FVector D = Other.Center - Center;
+    float Distance = D.Size();
+
+    // One sphere contains the other.
+    if (Distance + Other.W <= W)
+    {
+        return *this;
+    }
+    if (Distance + W <= Other.W)
+    {
+        return Other;
+    }
+
+    float Radius = (Distance + W + Other.W) * 0.5f;
+    return FSphere(Center + D * ((Radius - W) / Distance), Radius);
+}
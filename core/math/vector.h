@@ -1,17 +1,26 @@
+#pragma once
+
 #include "math.h"
 
-struct FVector
+template<typename T>
+struct TVector
  {
     /** X Component of Vector. */
-    float X;
+    T X;
     /** Y Component of Vector. */
-    float Y;
+    T Y;
     /** Z Component of Vector. */
-    float Z;
+    T Z;
 
 public:
-    FVector();
-    FVector(float _X, float _Y, float _Z);
+    TVector();
+    TVector(T _X, T _Y, T _Z);
+
+    /**
+     * @brief Convert from another precision.
+     */
+    template<typename U>
+    explicit TVector(const TVector<U>& V);
 
 public:
     /**
@@ -20,19 +29,44 @@ public:
      * @param V The other vector.
      * @return Result of the dot product. 
      */
-    inline float    operator|(const FVector& V) const;
+    inline T    operator|(const TVector& V) const;
     /**
      * @brief Calculate the cross product. 
      * 
      * @param V The other vector.  
      * @return Result vector of the cross product.
      */
-    inline FVector  operator^(const FVector& V) const; 
+    inline TVector  operator^(const TVector& V) const; 
+
+    inline TVector  operator+(const TVector& V) const;
+    inline TVector  operator-(const TVector& V) const;
+    inline TVector  operator*(T V) const;
+    inline TVector  operator/(T V) const;
+
+    inline TVector& operator+=(const TVector& V);
+    inline TVector& operator-=(const TVector& V);
+    inline TVector& operator*=(T V);
+    inline TVector& operator/=(T V);
+
+    /**
+     * @brief Calculate A * S + B in one pass, fused when the target has FMA.
+     * 
+     * @param A The scaled vector.
+     * @param S The scale.
+     * @param B The added vector.
+     * @return Result vector.
+     */
+    inline static TVector MulAdd(const TVector& A, T S, const TVector& B);
+
+    /**
+     * @brief Calculate the component wise A * B + C.
+     */
+    inline static TVector MulAdd(const TVector& A, const TVector& B, const TVector& C);
 
-    inline FVector  operator+(const FVector& V) const;
-    inline FVector  operator-(const FVector& V) const;
-    inline FVector  operator*(float V) const;
-    inline FVector  operator/(float V) const;
+    /**
+     * @brief Linear interpolation, A at Alpha 0 and B at Alpha 1.
+     */
+    inline static TVector Lerp(const TVector& A, const TVector& B, T Alpha);
 
     /**
      * @brief Normailize this vector.
@@ -53,17 +87,17 @@ public:
      * 
      * @return The length of this vector.
      */
-    inline float Size() const;
+    inline T Size() const;
 
     /**
      * @brief Get the squared length of this vector. 
      * 
      * @return The squared length of this vector. 
      */
-    inline float SizeSquared() const;
+    inline T SizeSquared() const;
 
-    inline static float Distance(const FVector& A, const FVector& B);
-    inline static float DistanceSquared(const FVector& A, const FVector& B);
+    inline static T Distance(const TVector& A, const TVector& B);
+    inline static T DistanceSquared(const TVector& A, const TVector& B);
 
     /**
      * @brief Calculate dot product of two vectors.
@@ -72,7 +106,7 @@ public:
      * @param B Second vector.
      * @return Result of the dot product.
      */
-    inline static float DotProduct(const FVector& A, const FVector& B);
+    inline static T DotProduct(const TVector& A, const TVector& B);
 
     /**
      * @brief Calculate cross product of two vectors. 
@@ -81,11 +115,11 @@ public:
      * @param B Second vector.
      * @return Result vector of the cross product.
      */
-    inline static FVector CrossProduct(const FVector& A, const FVector& B);
+    inline static TVector CrossProduct(const TVector& A, const TVector& B);
 
 
 public:
-    FVector RotateAngleAxis();
+    TVector RotateAngleAxis();
 
     /**
      * @brief Project the vector to another vector.
@@ -93,14 +127,14 @@ public:
      * @param V The another vector. 
      * @return Result vector of projected vector.
      */
-    inline FVector ProjectOn(const FVector& V);
+    inline TVector ProjectOn(const TVector& V);
     /**
      * @brief Project the vector to another normalized vector.
      * 
      * @param VN The another normalized vector. 
      * @return Result vector of projected vector.
      */
-    inline FVector ProjectOnNormal(const FVector& VN);
+    inline TVector ProjectOnNormal(const TVector& VN);
 
     /**
      * @brief Test if the another point on the left side.
@@ -109,7 +143,7 @@ public:
      * @return true The point is on the left side.
      * @return false The point is not on the left side.
      */
-    bool    ToLeft(const FVector& point);
+    bool    ToLeft(const TVector& point);
     /**
      * @brief Get the intersection point of a line and a plane. 
      * 
@@ -119,7 +153,7 @@ public:
      * @param PlaneNormal The normal of the the plane.
      * @return Result the point of intersection.
      */
-    static FVector LinePlaneIntersection(const FVector& PointStart, const FVector& PointEnd, const FVector& PlaneOrigin, const FVector& PlaneNormal);
+    static TVector LinePlaneIntersection(const TVector& PointStart, const TVector& PointEnd, const TVector& PlaneOrigin, const TVector& PlaneNormal);
     /**
      * @brief Get the intersection point of a line and a shpere.
      * 
@@ -132,115 +166,199 @@ public:
      * @return true Intersection exists.
      * @return false Intersection not exists.
      */
-    static bool    LineSphereIntersection(const FVector& PointStart, const FVector& PointEnd, const FVector& Origin, float Radius, float *const Result1, float *const Result2);
+    static bool    LineSphereIntersection(const TVector& PointStart, const TVector& PointEnd, const TVector& Origin, T Radius, T *const Result1, T *const Result2);
 };
 
-inline FVector::FVector()
+typedef TVector<float>  FVector;
+typedef TVector<double> FVector3d;
+
+template<typename T>
+inline TVector<T>::TVector()
 {
 
 }
 
-inline FVector::FVector(float _X, float _Y, float _Z) 
+template<typename T>
+inline TVector<T>::TVector(T _X, T _Y, T _Z) 
 : X(_X), Y(_Y), Z(_Z)
 {
 
 }
 
-inline float FVector::operator|(const FVector& V) const
+template<typename T>
+template<typename U>
+inline TVector<T>::TVector(const TVector<U>& V)
+: X((T)V.X), Y((T)V.Y), Z((T)V.Z)
+{
+
+}
+
+template<typename T>
+inline T TVector<T>::operator|(const TVector<T>& V) const
 {
     return (X*V.X + Y*V.Y + Z*V.Z);    
 }
 
-inline float FVector::DotProduct(const FVector& A, const FVector& B)
+template<typename T>
+inline T TVector<T>::DotProduct(const TVector<T>& A, const TVector<T>& B)
 {
     return A|B;
 }
 
-inline FVector FVector::operator^(const FVector& V) const
+template<typename T>
+inline TVector<T> TVector<T>::operator^(const TVector<T>& V) const
 {
-    return FVector(
+    return TVector<T>(
         Y*V.Z - Z*V.Y,
         Z*V.X - X*V.Z,
         X*V.Y - Y*V.X
     );
 }
 
-inline FVector  FVector::operator+(const FVector& V) const
+template<typename T>
+inline TVector<T>  TVector<T>::operator+(const TVector<T>& V) const
 {
-    return FVector(
+    return TVector<T>(
         X + V.X, 
         Y + V.Y,
         Z + V.Z
     );
 }
 
-inline FVector  FVector::operator-(const FVector& V) const
+template<typename T>
+inline TVector<T>  TVector<T>::operator-(const TVector<T>& V) const
 {
-    return FVector(
+    return TVector<T>(
         X - V.X, 
         Y - V.Y,
         Z - V.Z
     );
 }
     
-inline FVector  FVector::operator*(float V) const
+template<typename T>
+inline TVector<T>  TVector<T>::operator*(T V) const
 {
-     return FVector(
+     return TVector<T>(
         X * V, 
         Y * V,
         Z * V
     );   
 }
 
-inline FVector  FVector::operator/(float V) const
+template<typename T>
+inline TVector<T>  TVector<T>::operator/(T V) const
 {
-    return FVector(
-        X / V, 
-        Y / V,
-        Z / V
+    const T RV = T(1) / V;
+    return TVector<T>(
+        X * RV, 
+        Y * RV,
+        Z * RV
     );
 }
 
+template<typename T>
+inline TVector<T>& TVector<T>::operator+=(const TVector<T>& V)
+{
+    X += V.X; Y += V.Y; Z += V.Z;
+    return *this;
+}
+
+template<typename T>
+inline TVector<T>& TVector<T>::operator-=(const TVector<T>& V)
+{
+    X -= V.X; Y -= V.Y; Z -= V.Z;
+    return *this;
+}
+
+template<typename T>
+inline TVector<T>& TVector<T>::operator*=(T V)
+{
+    X *= V; Y *= V; Z *= V;
+    return *this;
+}
+
+template<typename T>
+inline TVector<T>& TVector<T>::operator/=(T V)
+{
+    const T RV = T(1) / V;
+    X *= RV; Y *= RV; Z *= RV;
+    return *this;
+}
+
+template<typename T>
+inline TVector<T> TVector<T>::MulAdd(const TVector<T>& A, T S, const TVector<T>& B)
+{
+    return TVector<T>(
+        FMath::MulAdd(A.X, S, B.X),
+        FMath::MulAdd(A.Y, S, B.Y),
+        FMath::MulAdd(A.Z, S, B.Z)
+    );
+}
+
+template<typename T>
+inline TVector<T> TVector<T>::MulAdd(const TVector<T>& A, const TVector<T>& B, const TVector<T>& C)
+{
+    return TVector<T>(
+        FMath::MulAdd(A.X, B.X, C.X),
+        FMath::MulAdd(A.Y, B.Y, C.Y),
+        FMath::MulAdd(A.Z, B.Z, C.Z)
+    );
+}
+
+template<typename T>
+inline TVector<T> TVector<T>::Lerp(const TVector<T>& A, const TVector<T>& B, T Alpha)
+{
+    return TVector<T>::MulAdd(B - A, Alpha, A);
+}
+
 
-inline FVector FVector::CrossProduct(const FVector& A, const FVector& B)
+template<typename T>
+inline TVector<T> TVector<T>::CrossProduct(const TVector<T>& A, const TVector<T>& B)
 {
     return A^B;
 }
 
-inline float FVector::Size() const
+template<typename T>
+inline T TVector<T>::Size() const
 {
     return FMath::Sqrt(X*X + Y*Y + Z*Z);
 }
 
-inline float FVector::SizeSquared() const
+template<typename T>
+inline T TVector<T>::SizeSquared() const
 {
     return X*X + Y*Y + Z*Z;
 }
 
-inline float FVector::Distance(const FVector& A, const FVector& B)
+template<typename T>
+inline T TVector<T>::Distance(const TVector<T>& A, const TVector<T>& B)
 {
-    return FMath::Sqrt(FVector::DistanceSquared(A, B));
+    return FMath::Sqrt(TVector<T>::DistanceSquared(A, B));
 }
 
-inline float FVector::DistanceSquared(const FVector& A, const FVector& B)
+template<typename T>
+inline T TVector<T>::DistanceSquared(const TVector<T>& A, const TVector<T>& B)
 {
-    return (B.X*B.X-A.X*A.X)*(B.X*B.X-A.X*A.X)+(B.Y*B.Y-A.Y*A.Y)*(B.Y*B.Y-A.Y*A.Y)+(B.Z*B.Z-A.Z*A.Z)*(B.Z*B.Z-A.Z*A.Z);
+    return (B.X-A.X)*(B.X-A.X) + (B.Y-A.Y)*(B.Y-A.Y) + (B.Z-A.Z)*(B.Z-A.Z);
 }
 
-inline FVector FVector::ProjectOn(const FVector& V)
+template<typename T>
+inline TVector<T> TVector<T>::ProjectOn(const TVector<T>& V)
 {
     return (V*((*this|V)/(V|V)));
 }
 
-inline FVector FVector::ProjectOnNormal(const FVector& VN)
+template<typename T>
+inline TVector<T> TVector<T>::ProjectOnNormal(const TVector<T>& VN)
 {
     return (VN*(*this|VN));
 }
 
-inline bool FVector::ToLeft(const FVector& pointToTest)
+template<typename T>
+inline bool TVector<T>::ToLeft(const TVector<T>& pointToTest)
 {
     // normal of the two vectors.
-    FVector N = *this ^ pointToTest;
+    TVector<T> N = *this ^ pointToTest;
 
     if (N.Z > 0) 
         return true;
@@ -248,23 +366,25 @@ inline bool FVector::ToLeft(const FVector& pointToTest)
     return false;
 }
 
-FVector FVector::LinePlaneIntersection(const FVector& PointStart, const FVector& PointEnd, const FVector& PlaneOrigin, const FVector& PlaneNormal)
+template<typename T>
+TVector<T> TVector<T>::LinePlaneIntersection(const TVector<T>& PointStart, const TVector<T>& PointEnd, const TVector<T>& PlaneOrigin, const TVector<T>& PlaneNormal)
 {
-    FVector LineDirection = PointEnd - PointStart;
+    TVector<T> LineDirection = PointEnd - PointStart;
 
     return PointStart + LineDirection * ((PlaneOrigin - PointStart) | PlaneNormal) / (PlaneNormal | LineDirection); 
 }
 
-bool FVector::LineSphereIntersection(const FVector&PointStart, const FVector& PointEnd, const FVector& Origin, float Radius, float *const Result1, float *const Result2)
+template<typename T>
+bool TVector<T>::LineSphereIntersection(const TVector<T>&PointStart, const TVector<T>& PointEnd, const TVector<T>& Origin, T Radius, T *const Result1, T *const Result2)
 {
-    FVector LineNormal = PointEnd - PointStart;
-    FVector PO = PointStart  - Origin;
+    TVector<T> LineNormal = PointEnd - PointStart;
+    TVector<T> PO = PointStart  - Origin;
 
-    float a = LineNormal | LineNormal;
-    float b = (PO * 2.0f) | LineNormal;
-    float c = (PO | PO) - Radius * Radius;
+    T a = LineNormal | LineNormal;
+    T b = (PO * 2.0f) | LineNormal;
+    T c = (PO | PO) - Radius * Radius;
 
-    float B = b * b - 4 * a * c;
+    T B = b * b - 4 * a * c;
 
     if (FMath::Abs(a) == 0 || B < 0)
     {
@@ -274,7 +394,7 @@ bool FVector::LineSphereIntersection(const FVector&PointStart, const FVector& Po
     if (Result1 != nullptr)
         *Result1 = (-b + FMath::Sqrt(B)) / (2 * a);
     if (Result2 != nullptr)
-        *Result1 = (-b - FMath::Sqrt(B)) / (2 * a);
+        *Result2 = (-b - FMath::Sqrt(B)) / (2 * a);
 
     return true;
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#pragma once
 
 #include "vector.h"
 
@@ -10,8 +11,8 @@ public:
     inline FVector2D(float _X, float _Y);
 
     inline FVector2D    operator/(float Scale) const;
-    inline FVector2D    operator+(const FVector& V) const;
-    inline FVector2D    operator-(const FVector& V) const;
+    inline FVector2D    operator+(const FVector2D& V) const;
+    inline FVector2D    operator-(const FVector2D& V) const;
     inline FVector2D    operator*(float F) const;
     /**
      * @brief Calculates dot product with another vector.
@@ -39,11 +40,49 @@ public:
 
     inline void Normalize();
 
+    /**
+     * @brief Rotate around the origin, counter clockwise for positive angles.
+     *
+     * @param Degree The angle in degrees.
+     * @return The rotated vector.
+     */
     inline FVector2D GetRotated(float Degree) const;
 
     inline bool  IsNearlyZero(float Tolerance);
 };
 
+inline FVector2D::FVector2D()
+{
+
+}
+
+inline FVector2D::FVector2D(float _X, float _Y)
+: X(_X), Y(_Y)
+{
+
+}
+
+inline FVector2D FVector2D::operator/(float Scale) const
+{
+    const float RScale = 1.f / Scale;
+    return FVector2D(X * RScale, Y * RScale);
+}
+
+inline FVector2D FVector2D::operator+(const FVector2D& V) const
+{
+    return FVector2D(X + V.X, Y + V.Y);
+}
+
+inline FVector2D FVector2D::operator-(const FVector2D& V) const
+{
+    return FVector2D(X - V.X, Y - V.Y);
+}
+
+inline FVector2D FVector2D::operator*(float F) const
+{
+    return FVector2D(X * F, Y * F);
+}
+
 inline float FVector2D::operator|(const FVector2D& V) const
 {
     return (X*V.X + Y*V.Y);
@@ -92,3 +131,15 @@ inline void FVector2D::Normalize()
     Y = 0.f;
 }
 
+inline FVector2D FVector2D::GetRotated(float Degree) const
+{
+    float S, C;
+    FMath::SinCos(Degree * (PI / 180.f), &S, &C);
+
+    return FVector2D(C*X - S*Y, S*X + C*Y);
+}
+
+inline bool FVector2D::IsNearlyZero(float Tolerance)
+{
+    return FMath::Abs(X) <= Tolerance && FMath::Abs(Y) <= Tolerance;
+}
@@ -1,26 +1,33 @@
+#pragma once
 
 #include "vector.h"
 
-struct FVector4
+template<typename T>
+struct TVector4
 {
-    float X;
-    float Y;
-    float Z;
-    float W;
+    T X;
+    T Y;
+    T Z;
+    T W;
 
 public:
-    FVector4();
-    FVector4(const FVector& V, float W);
-    FVector4(float X, float Y, float Z, float W);
+    TVector4();
+    TVector4(const TVector<T>& V, T W);
+    TVector4(T X, T Y, T Z, T W);
 };
 
+typedef TVector4<float>  FVector4;
+typedef TVector4<double> FVector4d;
 
-inline FVector4::FVector4()
+
+template<typename T>
+inline TVector4<T>::TVector4()
 {
 
 }
 
-inline FVector4::FVector4(const FVector& V, float _W)
+template<typename T>
+inline TVector4<T>::TVector4(const TVector<T>& V, T _W)
 {
     X = V.X;
     Y = V.Y;
@@ -28,7 +35,8 @@ inline FVector4::FVector4(const FVector& V, float _W)
     W = _W;
 }
 
-inline FVector4::FVector4(float _X, float _Y, float _Z, float _W)
+template<typename T>
+inline TVector4<T>::TVector4(T _X, T _Y, T _Z, T _W)
 {
     X = _X;
     Y = _Y;
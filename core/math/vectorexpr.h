@@ -0,0 +1,410 @@
+#pragma once
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "vector.h"
+#include "../job/jobsystem.h"
+
+/**
+ * Expression templates for batches of vectors.
+ *
+ * Operators on the expression types below only build a small tree of nodes, nothing is computed
+ * until FVectorExpr::Evaluate walks the batch once and evaluates the whole tree per element:
+ *
+ *     FVectorExpr::Evaluate(Out, Num, FVectorExpr::Batch(A) + FVectorExpr::Batch(B) * Scale - FVectorExpr::Constant(C));
+ *
+ * runs as one loop with no intermediate batches. A scaled operand of + or - becomes a multiply
+ * add node, which is a single FMA instruction on targets that have it. 8 elements per AVX
+ * iteration, a scalar loop handles the remainder. Nodes are stored by value, leaves only hold
+ * pointers, so an expression can be built from temporaries.
+ */
+
+struct FVectorSoA
+{
+    float* X;
+    float* Y;
+    float* Z;
+};
+
+template<typename Derived>
+struct TVectorExpr
+{
+    inline const Derived& Get() const { return static_cast<const Derived&>(*this); }
+};
+
+/** Expression yielding one float per element. */
+template<typename Derived>
+struct TScalarExpr
+{
+    inline const Derived& Get() const { return static_cast<const Derived&>(*this); }
+};
+
+/** Leaf reading a batch. */
+struct FVectorExprBatch : public TVectorExpr<FVectorExprBatch>
+{
+    const float* Data[3];
+
+    inline float Scalar(int32 Axis, int32 i) const { return Data[Axis][i]; }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32 i) const { return _mm256_loadu_ps(Data[Axis] + i); }
+#endif
+};
+
+/** Leaf repeating one vector for every element. */
+struct FVectorExprConstant : public TVectorExpr<FVectorExprConstant>
+{
+    float V[3];
+
+    inline float Scalar(int32 Axis, int32) const { return V[Axis]; }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32) const { return _mm256_set1_ps(V[Axis]); }
+#endif
+};
+
+template<typename E>
+struct TVectorExprScale : public TVectorExpr<TVectorExprScale<E>>
+{
+    E Expr;
+    float S;
+
+    TVectorExprScale(const E& _Expr, float _S) : Expr(_Expr), S(_S) {}
+
+    inline float Scalar(int32 Axis, int32 i) const { return Expr.Scalar(Axis, i) * S; }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32 i) const { return _mm256_mul_ps(Expr.Packet(Axis, i), _mm256_set1_ps(S)); }
+#endif
+};
+
+template<typename L, typename R>
+struct TVectorExprAdd : public TVectorExpr<TVectorExprAdd<L, R>>
+{
+    L Left;
+    R Right;
+
+    TVectorExprAdd(const L& _Left, const R& _Right) : Left(_Left), Right(_Right) {}
+
+    inline float Scalar(int32 Axis, int32 i) const { return Left.Scalar(Axis, i) + Right.Scalar(Axis, i); }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32 i) const { return _mm256_add_ps(Left.Packet(Axis, i), Right.Packet(Axis, i)); }
+#endif
+};
+
+template<typename L, typename R>
+struct TVectorExprSub : public TVectorExpr<TVectorExprSub<L, R>>
+{
+    L Left;
+    R Right;
+
+    TVectorExprSub(const L& _Left, const R& _Right) : Left(_Left), Right(_Right) {}
+
+    inline float Scalar(int32 Axis, int32 i) const { return Left.Scalar(Axis, i) - Right.Scalar(Axis, i); }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32 i) const { return _mm256_sub_ps(Left.Packet(Axis, i), Right.Packet(Axis, i)); }
+#endif
+};
+
+/**
+ * Sign * (A * S) + B, created by the operators when one side of + or - is scaled.
+ */
+template<typename A, typename B, int32 Sign>
+struct TVectorExprMulAdd : public TVectorExpr<TVectorExprMulAdd<A, B, Sign>>
+{
+    A Mul;
+    B Add;
+    float S;
+
+    TVectorExprMulAdd(const A& _Mul, float _S, const B& _Add) : Mul(_Mul), Add(_Add), S(_S) {}
+
+    inline float Scalar(int32 Axis, int32 i) const
+    {
+        return FMath::MulAdd(Mul.Scalar(Axis, i), Sign > 0 ? S : -S, Add.Scalar(Axis, i));
+    }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32 i) const
+    {
+#if defined(__FMA__)
+        if (Sign > 0)
+        {
+            return _mm256_fmadd_ps(Mul.Packet(Axis, i), _mm256_set1_ps(S), Add.Packet(Axis, i));
+        }
+        return _mm256_fnmadd_ps(Mul.Packet(Axis, i), _mm256_set1_ps(S), Add.Packet(Axis, i));
+#else
+        __m256 Product = _mm256_mul_ps(Mul.Packet(Axis, i), _mm256_set1_ps(S));
+        return Sign > 0 ? _mm256_add_ps(Product, Add.Packet(Axis, i)) : _mm256_sub_ps(Add.Packet(Axis, i), Product);
+#endif
+    }
+#endif
+};
+
+/**
+ * A * S - B, the remaining combination of a scaled operand and a subtraction.
+ */
+template<typename A, typename B>
+struct TVectorExprMulSub : public TVectorExpr<TVectorExprMulSub<A, B>>
+{
+    A Mul;
+    B Sub;
+    float S;
+
+    TVectorExprMulSub(const A& _Mul, float _S, const B& _Sub) : Mul(_Mul), Sub(_Sub), S(_S) {}
+
+    inline float Scalar(int32 Axis, int32 i) const
+    {
+        return FMath::MulAdd(Mul.Scalar(Axis, i), S, -Sub.Scalar(Axis, i));
+    }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 Axis, int32 i) const
+    {
+#if defined(__FMA__)
+        return _mm256_fmsub_ps(Mul.Packet(Axis, i), _mm256_set1_ps(S), Sub.Packet(Axis, i));
+#else
+        return _mm256_sub_ps(_mm256_mul_ps(Mul.Packet(Axis, i), _mm256_set1_ps(S)), Sub.Packet(Axis, i));
+#endif
+    }
+#endif
+};
+
+template<typename L, typename R>
+struct TScalarExprDot : public TScalarExpr<TScalarExprDot<L, R>>
+{
+    L Left;
+    R Right;
+
+    TScalarExprDot(const L& _Left, const R& _Right) : Left(_Left), Right(_Right) {}
+
+    inline float Scalar(int32 i) const
+    {
+        float Result = Left.Scalar(0, i) * Right.Scalar(0, i);
+        Result = FMath::MulAdd(Left.Scalar(1, i), Right.Scalar(1, i), Result);
+        return FMath::MulAdd(Left.Scalar(2, i), Right.Scalar(2, i), Result);
+    }
+#if defined(__AVX__)
+    inline __m256 Packet(int32 i) const
+    {
+        __m256 Result = _mm256_mul_ps(Left.Packet(0, i), Right.Packet(0, i));
+#if defined(__FMA__)
+        Result = _mm256_fmadd_ps(Left.Packet(1, i), Right.Packet(1, i), Result);
+        return _mm256_fmadd_ps(Left.Packet(2, i), Right.Packet(2, i), Result);
+#else
+        Result = _mm256_add_ps(Result, _mm256_mul_ps(Left.Packet(1, i), Right.Packet(1, i)));
+        return _mm256_add_ps(Result, _mm256_mul_ps(Left.Packet(2, i), Right.Packet(2, i)));
+#endif
+    }
+#endif
+};
+
+template<typename E>
+inline TVectorExprScale<E> operator*(const TVectorExpr<E>& A, float S)
+{
+    return TVectorExprScale<E>(A.Get(), S);
+}
+
+template<typename E>
+inline TVectorExprScale<E> operator*(float S, const TVectorExpr<E>& A)
+{
+    return TVectorExprScale<E>(A.Get(), S);
+}
+
+template<typename E>
+inline TVectorExprScale<E> operator/(const TVectorExpr<E>& A, float S)
+{
+    return TVectorExprScale<E>(A.Get(), 1.0f / S);
+}
+
+template<typename L, typename R>
+inline TVectorExprAdd<L, R> operator+(const TVectorExpr<L>& A, const TVectorExpr<R>& B)
+{
+    return TVectorExprAdd<L, R>(A.Get(), B.Get());
+}
+
+template<typename L, typename R>
+inline TVectorExprMulAdd<L, R, 1> operator+(const TVectorExprScale<L>& A, const TVectorExpr<R>& B)
+{
+    return TVectorExprMulAdd<L, R, 1>(A.Expr, A.S, B.Get());
+}
+
+template<typename L, typename R>
+inline TVectorExprMulAdd<R, L, 1> operator+(const TVectorExpr<L>& A, const TVectorExprScale<R>& B)
+{
+    return TVectorExprMulAdd<R, L, 1>(B.Expr, B.S, A.Get());
+}
+
+template<typename L, typename R>
+inline TVectorExprMulAdd<R, TVectorExprScale<L>, 1> operator+(const TVectorExprScale<L>& A, const TVectorExprScale<R>& B)
+{
+    return TVectorExprMulAdd<R, TVectorExprScale<L>, 1>(B.Expr, B.S, A);
+}
+
+template<typename L, typename R>
+inline TVectorExprSub<L, R> operator-(const TVectorExpr<L>& A, const TVectorExpr<R>& B)
+{
+    return TVectorExprSub<L, R>(A.Get(), B.Get());
+}
+
+template<typename L, typename R>
+inline TVectorExprMulSub<L, R> operator-(const TVectorExprScale<L>& A, const TVectorExpr<R>& B)
+{
+    return TVectorExprMulSub<L, R>(A.Expr, A.S, B.Get());
+}
+
+template<typename L, typename R>
+inline TVectorExprMulAdd<R, L, -1> operator-(const TVectorExpr<L>& A, const TVectorExprScale<R>& B)
+{
+    return TVectorExprMulAdd<R, L, -1>(B.Expr, B.S, A.Get());
+}
+
+template<typename L, typename R>
+inline TVectorExprMulAdd<R, TVectorExprScale<L>, -1> operator-(const TVectorExprScale<L>& A, const TVectorExprScale<R>& B)
+{
+    return TVectorExprMulAdd<R, TVectorExprScale<L>, -1>(B.Expr, B.S, A);
+}
+
+struct FVectorExpr
+{
+    /**
+     * @brief Wrap a batch as an expression leaf.
+     */
+    static inline FVectorExprBatch Batch(const float* X, const float* Y, const float* Z);
+    static inline FVectorExprBatch Batch(const FVectorSoA& Vectors);
+
+    /**
+     * @brief Wrap a single vector used for every element.
+     */
+    static inline FVectorExprConstant Constant(const FVector& V);
+
+    /**
+     * @brief Per element dot product.
+     */
+    template<typename L, typename R>
+    static inline TScalarExprDot<L, R> Dot(const TVectorExpr<L>& A, const TVectorExpr<R>& B);
+
+    /**
+     * @brief Evaluate an expression for Num elements in a single pass.
+     *
+     * @param Out The output batch, may alias the leaves of the expression as every element
+     * only reads its own inputs.
+     * @param Num Number of elements.
+     * @param Expr The expression.
+     */
+    template<typename E>
+    static inline void Evaluate(const FVectorSoA& Out, int32 Num, const TVectorExpr<E>& Expr);
+
+    /**
+     * @brief Evaluate a scalar expression for Num elements in a single pass.
+     */
+    template<typename E>
+    static inline void Evaluate(float* Out, int32 Num, const TScalarExpr<E>& Expr);
+
+    /**
+     * @brief Evaluate split in ranges over the job system, for large transform updates.
+     */
+    template<typename E>
+    static inline void EvaluateParallel(const FVectorSoA& Out, int32 Num, const TVectorExpr<E>& Expr);
+
+private:
+    template<typename E>
+    static inline void EvaluateRange(const FVectorSoA& Out, int32 Begin, int32 End, const E& Tree);
+};
+
+inline FVectorExprBatch FVectorExpr::Batch(const float* X, const float* Y, const float* Z)
+{
+    FVectorExprBatch Result;
+    Result.Data[0] = X;
+    Result.Data[1] = Y;
+    Result.Data[2] = Z;
+    return Result;
+}
+
+inline FVectorExprBatch FVectorExpr::Batch(const FVectorSoA& Vectors)
+{
+    return FVectorExpr::Batch(Vectors.X, Vectors.Y, Vectors.Z);
+}
+
+inline FVectorExprConstant FVectorExpr::Constant(const FVector& V)
+{
+    FVectorExprConstant Result;
+    Result.V[0] = V.X;
+    Result.V[1] = V.Y;
+    Result.V[2] = V.Z;
+    return Result;
+}
+
+template<typename L, typename R>
+inline TScalarExprDot<L, R> FVectorExpr::Dot(const TVectorExpr<L>& A, const TVectorExpr<R>& B)
+{
+    return TScalarExprDot<L, R>(A.Get(), B.Get());
+}
+
+template<typename E>
+inline void FVectorExpr::Evaluate(const FVectorSoA& Out, int32 Num, const TVectorExpr<E>& Expr)
+{
+    // Copy the tree so the compiler can keep the leaves in registers, the stores to Out
+    // cannot alias a local.
+    const E Tree = Expr.Get();
+    EvaluateRange(Out, 0, Num, Tree);
+}
+
+template<typename E>
+inline void FVectorExpr::EvaluateParallel(const FVectorSoA& Out, int32 Num, const TVectorExpr<E>& Expr)
+{
+    const E Tree = Expr.Get();
+    FJobSystem::Get().ParallelFor(Num, [&Out, &Tree](int32 Begin, int32 End)
+    {
+        EvaluateRange(Out, Begin, End, Tree);
+    }, 4096);
+}
+
+template<typename E>
+inline void FVectorExpr::EvaluateRange(const FVectorSoA& Out, int32 Begin, int32 End, const E& Tree)
+{
+    float* const Dst[3] = { Out.X, Out.Y, Out.Z };
+
+    int32 i = Begin;
+
+#if defined(__AVX__)
+    for (; i + 8 <= End; i += 8)
+    {
+        // Evaluate all three axes before storing, the output may alias an input.
+        __m256 RX = Tree.Packet(0, i);
+        __m256 RY = Tree.Packet(1, i);
+        __m256 RZ = Tree.Packet(2, i);
+
+        _mm256_storeu_ps(Dst[0] + i, RX);
+        _mm256_storeu_ps(Dst[1] + i, RY);
+        _mm256_storeu_ps(Dst[2] + i, RZ);
+    }
+#endif
+
+    for (; i < End; i++)
+    {
+        float RX = Tree.Scalar(0, i);
+        float RY = Tree.Scalar(1, i);
+        float RZ = Tree.Scalar(2, i);
+
+        Dst[0][i] = RX;
+        Dst[1][i] = RY;
+        Dst[2][i] = RZ;
+    }
+}
+
+template<typename E>
+inline void FVectorExpr::Evaluate(float* Out, int32 Num, const TScalarExpr<E>& Expr)
+{
+    const E Tree = Expr.Get();
+
+    int32 i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= Num; i += 8)
+    {
+        _mm256_storeu_ps(Out + i, Tree.Packet(i));
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        Out[i] = Tree.Scalar(i);
+    }
+}
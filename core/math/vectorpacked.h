@@ -0,0 +1,524 @@
+#pragma once
+
+#include <string.h>
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "vector.h"
+
+/**
+ * Compact storage formats for FVector. Every format has scalar Pack/Unpack and batch kernels
+ * over arrays, the batch kernels use F16C/AVX2 when compiled with them and fall back to the
+ * scalar path otherwise. FVector arrays are a plain stream of 3 * Num floats, the component wise
+ * formats keep that layout so the batch kernels treat them as one stream.
+ */
+
+/**
+ * @brief IEEE 754 half precision float.
+ */
+struct FFloat16
+{
+    uint16 Encoded;
+
+public:
+    FFloat16();
+    FFloat16(float F);
+
+    inline operator float() const;
+
+    /**
+     * @brief Round to nearest even, out of range values become infinity.
+     */
+    static inline uint16 FromFloat(float F);
+    static inline float  ToFloat(uint16 H);
+
+    /**
+     * @brief Convert Num floats to halves.
+     */
+    static inline void Pack(const float* In, uint16* Out, int32 Num);
+    /**
+     * @brief Convert Num halves to floats.
+     */
+    static inline void Unpack(const uint16* In, float* Out, int32 Num);
+};
+
+/**
+ * @brief FVector stored as three half floats, 6 bytes.
+ */
+struct FVectorHalf
+{
+    FFloat16 X, Y, Z;
+
+public:
+    FVectorHalf();
+    explicit FVectorHalf(const FVector& V);
+
+    inline FVector ToFVector() const;
+
+    static inline void Pack(const FVector* In, FVectorHalf* Out, int32 Num);
+    static inline void Unpack(const FVectorHalf* In, FVector* Out, int32 Num);
+};
+
+/**
+ * @brief Unit vector in 32 bits, octahedral projection with two snorm16 components.
+ *        The error is below 0.0001 radians.
+ */
+struct FPackedOctahedralNormal
+{
+    uint32 Packed;
+
+public:
+    FPackedOctahedralNormal();
+    explicit FPackedOctahedralNormal(const FVector& N);
+
+    inline FVector ToFVector() const;
+
+    static inline uint32  Encode(const FVector& N);
+    static inline FVector Decode(uint32 Packed);
+
+    static inline void Pack(const FVector* In, FPackedOctahedralNormal* Out, int32 Num);
+    static inline void Unpack(const FPackedOctahedralNormal* In, FVector* Out, int32 Num);
+};
+
+/**
+ * @brief FVector quantized to 8 or 16 bit integers. Signed types store snorm, [-1, 1], unsigned
+ *        types store unorm, [0, 1]. Values outside the range are clamped, scale positions into
+ *        the range before packing.
+ */
+template<typename IntType>
+struct TQuantizedVector
+{
+    IntType X, Y, Z;
+
+    static constexpr bool  bSigned  = (IntType)-1 < (IntType)0;
+    static constexpr float MaxValue = bSigned ? (float)((1 << (sizeof(IntType) * 8 - 1)) - 1) : (float)((1 << (sizeof(IntType) * 8)) - 1);
+    static constexpr float MinValue = bSigned ? -MaxValue : 0.0f;
+
+public:
+    TQuantizedVector() {}
+    explicit TQuantizedVector(const FVector& V) : X(Quantize(V.X)), Y(Quantize(V.Y)), Z(Quantize(V.Z)) {}
+
+    inline FVector ToFVector() const
+    {
+        return FVector(Dequantize(X), Dequantize(Y), Dequantize(Z));
+    }
+
+    static inline IntType Quantize(float F)
+    {
+        float Scaled = F * MaxValue;
+        Scaled = Scaled < MinValue ? MinValue : (Scaled > MaxValue ? MaxValue : Scaled);
+        return (IntType)FMath::FloorToInt(Scaled + 0.5f);
+    }
+
+    static inline float Dequantize(IntType I)
+    {
+        // The most negative snorm value maps to -1 as well.
+        float F = (float)I * (1.0f / MaxValue);
+        return F < -1.0f ? -1.0f : F;
+    }
+
+    static inline void Pack(const FVector* In, TQuantizedVector* Out, int32 Num);
+    static inline void Unpack(const TQuantizedVector* In, FVector* Out, int32 Num);
+};
+
+typedef TQuantizedVector<int8>   FVectorSnorm8;
+typedef TQuantizedVector<uint8>  FVectorUnorm8;
+typedef TQuantizedVector<int16>  FVectorSnorm16;
+typedef TQuantizedVector<uint16> FVectorUnorm16;
+
+static_assert(sizeof(FVectorHalf) == 6, "FVectorHalf must stay 6 bytes.");
+static_assert(sizeof(FVectorSnorm8) == 3, "FVectorSnorm8 must stay 3 bytes.");
+static_assert(sizeof(FVectorSnorm16) == 6, "FVectorSnorm16 must stay 6 bytes.");
+
+//----------------------------------------------------------------------------------------------
+// FFloat16
+//----------------------------------------------------------------------------------------------
+
+inline FFloat16::FFloat16()
+{
+
+}
+
+inline FFloat16::FFloat16(float F)
+: Encoded(FromFloat(F))
+{
+
+}
+
+inline FFloat16::operator float() const
+{
+    return ToFloat(Encoded);
+}
+
+inline uint16 FFloat16::FromFloat(float F)
+{
+    uint32 Bits;
+    memcpy(&Bits, &F, 4);
+
+    uint32 Sign = (Bits >> 16) & 0x8000;
+    Bits &= 0x7fffffff;
+
+    uint32 Result;
+    if (Bits >= 0x47800000)
+    {
+        // Too large for a half, or Inf / NaN.
+        Result = Bits > 0x7f800000 ? 0x7e00 : 0x7c00;
+    }
+    else if (Bits < 0x38800000)
+    {
+        // Denormal or zero, let the FPU round by adding 0.5 which aligns the mantissa.
+        float Value;
+        memcpy(&Value, &Bits, 4);
+        Value += 0.5f;
+        memcpy(&Result, &Value, 4);
+        Result -= 0x3f000000;
+    }
+    else
+    {
+        // Rebias the exponent and round the mantissa to nearest even.
+        uint32 MantissaOdd = (Bits >> 13) & 1;
+        Bits += ((uint32)(15 - 127) << 23) + 0xfff;
+        Bits += MantissaOdd;
+        Result = Bits >> 13;
+    }
+
+    return (uint16)(Result | Sign);
+}
+
+inline float FFloat16::ToFloat(uint16 H)
+{
+    const uint32 ShiftedExponent = 0x7c00 << 13;
+
+    uint32 Bits = (uint32)(H & 0x7fff) << 13;
+    uint32 Exponent = ShiftedExponent & Bits;
+    Bits += (uint32)(127 - 15) << 23;
+
+    float Result;
+    if (Exponent == ShiftedExponent)
+    {
+        // Inf / NaN.
+        Bits += (uint32)(128 - 16) << 23;
+        memcpy(&Result, &Bits, 4);
+    }
+    else if (Exponent == 0)
+    {
+        // Denormal, renormalize through the FPU.
+        Bits += 1 << 23;
+        const uint32 MagicBits = 113 << 23;
+        float Magic;
+        memcpy(&Result, &Bits, 4);
+        memcpy(&Magic, &MagicBits, 4);
+        Result -= Magic;
+    }
+    else
+    {
+        memcpy(&Result, &Bits, 4);
+    }
+
+    uint32 SignedBits;
+    memcpy(&SignedBits, &Result, 4);
+    SignedBits |= (uint32)(H & 0x8000) << 16;
+    memcpy(&Result, &SignedBits, 4);
+    return Result;
+}
+
+inline void FFloat16::Pack(const float* In, uint16* Out, int32 Num)
+{
+    int32 i = 0;
+
+#if defined(__F16C__)
+    for (; i + 8 <= Num; i += 8)
+    {
+        _mm_storeu_si128((__m128i*)(Out + i), _mm256_cvtps_ph(_mm256_loadu_ps(In + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        Out[i] = FromFloat(In[i]);
+    }
+}
+
+inline void FFloat16::Unpack(const uint16* In, float* Out, int32 Num)
+{
+    int32 i = 0;
+
+#if defined(__F16C__)
+    for (; i + 8 <= Num; i += 8)
+    {
+        _mm256_storeu_ps(Out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(In + i))));
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        Out[i] = ToFloat(In[i]);
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// FVectorHalf
+//----------------------------------------------------------------------------------------------
+
+inline FVectorHalf::FVectorHalf()
+{
+
+}
+
+inline FVectorHalf::FVectorHalf(const FVector& V)
+: X(V.X), Y(V.Y), Z(V.Z)
+{
+
+}
+
+inline FVector FVectorHalf::ToFVector() const
+{
+    return FVector(X, Y, Z);
+}
+
+inline void FVectorHalf::Pack(const FVector* In, FVectorHalf* Out, int32 Num)
+{
+    FFloat16::Pack(&In->X, &Out->X.Encoded, Num * 3);
+}
+
+inline void FVectorHalf::Unpack(const FVectorHalf* In, FVector* Out, int32 Num)
+{
+    FFloat16::Unpack(&In->X.Encoded, &Out->X, Num * 3);
+}
+
+//----------------------------------------------------------------------------------------------
+// FPackedOctahedralNormal
+//----------------------------------------------------------------------------------------------
+
+inline FPackedOctahedralNormal::FPackedOctahedralNormal()
+{
+
+}
+
+inline FPackedOctahedralNormal::FPackedOctahedralNormal(const FVector& N)
+: Packed(Encode(N))
+{
+
+}
+
+inline FVector FPackedOctahedralNormal::ToFVector() const
+{
+    return Decode(Packed);
+}
+
+inline uint32 FPackedOctahedralNormal::Encode(const FVector& N)
+{
+    // Project on the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals.
+    float InvL1 = 1.0f / (FMath::Abs(N.X) + FMath::Abs(N.Y) + FMath::Abs(N.Z));
+    float U = N.X * InvL1;
+    float V = N.Y * InvL1;
+
+    if (N.Z < 0.0f)
+    {
+        float FoldedU = (1.0f - FMath::Abs(V)) * (U >= 0.0f ? 1.0f : -1.0f);
+        float FoldedV = (1.0f - FMath::Abs(U)) * (V >= 0.0f ? 1.0f : -1.0f);
+        U = FoldedU;
+        V = FoldedV;
+    }
+
+    return (uint32)(uint16)FVectorSnorm16::Quantize(U) | ((uint32)(uint16)FVectorSnorm16::Quantize(V) << 16);
+}
+
+inline FVector FPackedOctahedralNormal::Decode(uint32 Packed)
+{
+    float U = FVectorSnorm16::Dequantize((int16)(Packed & 0xffff));
+    float V = FVectorSnorm16::Dequantize((int16)(Packed >> 16));
+
+    FVector N(U, V, 1.0f - FMath::Abs(U) - FMath::Abs(V));
+    float T = N.Z < 0.0f ? -N.Z : 0.0f;
+    N.X += N.X >= 0.0f ? -T : T;
+    N.Y += N.Y >= 0.0f ? -T : T;
+
+    // Spelled out in the operation order of the AVX2 path in Unpack, MulAdd fuses exactly where
+    // that path does so both stay bit identical with and without FMA.
+    float LengthSquared = FMath::MulAdd(N.X, N.X, FMath::MulAdd(N.Y, N.Y, N.Z * N.Z));
+    return N * FMath::InvSqrt(LengthSquared);
+}
+
+inline void FPackedOctahedralNormal::Pack(const FVector* In, FPackedOctahedralNormal* Out, int32 Num)
+{
+    int32 i = 0;
+
+#if defined(__AVX2__)
+    // Gather 8 normals into SoA, the same math as Encode in lanes.
+    const __m256i Stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256 SignMask = _mm256_set1_ps(-0.0f);
+    const __m256 One = _mm256_set1_ps(1.0f);
+    const __m256 Zero = _mm256_setzero_ps();
+    const __m256 Scale = _mm256_set1_ps(FVectorSnorm16::MaxValue);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        const float* Base = &In[i].X;
+        __m256 X = _mm256_i32gather_ps(Base, Stride, 4);
+        __m256 Y = _mm256_i32gather_ps(Base + 1, Stride, 4);
+        __m256 Z = _mm256_i32gather_ps(Base + 2, Stride, 4);
+
+        __m256 AbsX = _mm256_andnot_ps(SignMask, X);
+        __m256 AbsY = _mm256_andnot_ps(SignMask, Y);
+        __m256 AbsZ = _mm256_andnot_ps(SignMask, Z);
+        __m256 InvL1 = _mm256_div_ps(One, _mm256_add_ps(_mm256_add_ps(AbsX, AbsY), AbsZ));
+
+        __m256 U = _mm256_mul_ps(X, InvL1);
+        __m256 V = _mm256_mul_ps(Y, InvL1);
+
+        // Sign of +0 is positive like the scalar path, so use U >= 0 rather than the sign bit.
+        __m256 SignU = _mm256_blendv_ps(One, _mm256_set1_ps(-1.0f), _mm256_cmp_ps(U, Zero, _CMP_LT_OQ));
+        __m256 SignV = _mm256_blendv_ps(One, _mm256_set1_ps(-1.0f), _mm256_cmp_ps(V, Zero, _CMP_LT_OQ));
+        __m256 FoldedU = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_andnot_ps(SignMask, V)), SignU);
+        __m256 FoldedV = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_andnot_ps(SignMask, U)), SignV);
+
+        __m256 Lower = _mm256_cmp_ps(Z, Zero, _CMP_LT_OQ);
+        U = _mm256_blendv_ps(U, FoldedU, Lower);
+        V = _mm256_blendv_ps(V, FoldedV, Lower);
+
+        // Quantize like FVectorSnorm16::Quantize, round half up then clamp.
+        __m256 QU = _mm256_floor_ps(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(U, Scale), _mm256_sub_ps(Zero, Scale)), Scale), _mm256_set1_ps(0.5f)));
+        __m256 QV = _mm256_floor_ps(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(V, Scale), _mm256_sub_ps(Zero, Scale)), Scale), _mm256_set1_ps(0.5f)));
+
+        __m256i Packed = _mm256_or_si256(
+            _mm256_and_si256(_mm256_cvtps_epi32(QU), _mm256_set1_epi32(0xffff)),
+            _mm256_slli_epi32(_mm256_cvtps_epi32(QV), 16));
+        _mm256_storeu_si256((__m256i*)&Out[i].Packed, Packed);
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        Out[i].Packed = Encode(In[i]);
+    }
+}
+
+inline void FPackedOctahedralNormal::Unpack(const FPackedOctahedralNormal* In, FVector* Out, int32 Num)
+{
+    int32 i = 0;
+
+#if defined(__AVX2__)
+    const __m256 SignMask = _mm256_set1_ps(-0.0f);
+    const __m256 One = _mm256_set1_ps(1.0f);
+    const __m256 Zero = _mm256_setzero_ps();
+    const __m256 MinusOne = _mm256_set1_ps(-1.0f);
+    const __m256 InvScale = _mm256_set1_ps(1.0f / FVectorSnorm16::MaxValue);
+
+    for (; i + 8 <= Num; i += 8)
+    {
+        __m256i Packed = _mm256_loadu_si256((const __m256i*)&In[i].Packed);
+        // Sign extend the low and high halves, -32768 maps to -1 like FVectorSnorm16::Dequantize.
+        __m256 U = _mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(Packed, 16), 16)), InvScale), MinusOne);
+        __m256 V = _mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(Packed, 16)), InvScale), MinusOne);
+
+        __m256 Z = _mm256_sub_ps(_mm256_sub_ps(One, _mm256_andnot_ps(SignMask, U)), _mm256_andnot_ps(SignMask, V));
+        __m256 T = _mm256_max_ps(_mm256_sub_ps(Zero, Z), Zero);
+
+        __m256 X = _mm256_add_ps(U, _mm256_blendv_ps(_mm256_sub_ps(Zero, T), T, _mm256_cmp_ps(U, Zero, _CMP_LT_OQ)));
+        __m256 Y = _mm256_add_ps(V, _mm256_blendv_ps(_mm256_sub_ps(Zero, T), T, _mm256_cmp_ps(V, Zero, _CMP_LT_OQ)));
+
+#if defined(__FMA__)
+        __m256 LengthSquared = _mm256_fmadd_ps(X, X, _mm256_fmadd_ps(Y, Y, _mm256_mul_ps(Z, Z)));
+#else
+        __m256 LengthSquared = _mm256_add_ps(_mm256_mul_ps(X, X), _mm256_add_ps(_mm256_mul_ps(Y, Y), _mm256_mul_ps(Z, Z)));
+#endif
+        __m256 InvLength = _mm256_div_ps(One, _mm256_sqrt_ps(LengthSquared));
+
+        alignas(32) float SX[8], SY[8], SZ[8];
+        _mm256_store_ps(SX, _mm256_mul_ps(X, InvLength));
+        _mm256_store_ps(SY, _mm256_mul_ps(Y, InvLength));
+        _mm256_store_ps(SZ, _mm256_mul_ps(Z, InvLength));
+
+        for (int32 Lane=0; Lane<8; Lane++)
+        {
+            Out[i + Lane] = FVector(SX[Lane], SY[Lane], SZ[Lane]);
+        }
+    }
+#endif
+
+    for (; i < Num; i++)
+    {
+        Out[i] = Decode(In[i].Packed);
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// TQuantizedVector
+//----------------------------------------------------------------------------------------------
+
+template<typename IntType>
+inline void TQuantizedVector<IntType>::Pack(const FVector* In, TQuantizedVector* Out, int32 Num)
+{
+    const float* Src = &In->X;
+    IntType* Dst = &Out->X;
+    int32 Count = Num * 3;
+    int32 i = 0;
+
+#if defined(__AVX2__)
+    const __m256 Scale = _mm256_set1_ps(MaxValue);
+    const __m256 Low = _mm256_set1_ps(MinValue);
+    const __m256 Half = _mm256_set1_ps(0.5f);
+
+    for (; i + 8 <= Count; i += 8)
+    {
+        __m256 Scaled = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(Src + i), Scale), Low), Scale);
+        __m256i Ints = _mm256_cvtps_epi32(_mm256_floor_ps(_mm256_add_ps(Scaled, Half)));
+
+        // Values are already in range, so the saturating packs only narrow.
+        __m128i Lo = _mm256_castsi256_si128(Ints);
+        __m128i Hi = _mm256_extracti128_si256(Ints, 1);
+        __m128i Words = bSigned ? _mm_packs_epi32(Lo, Hi) : _mm_packus_epi32(Lo, Hi);
+
+        if (sizeof(IntType) == 2)
+        {
+            _mm_storeu_si128((__m128i*)(Dst + i), Words);
+        }
+        else
+        {
+            __m128i Bytes = bSigned ? _mm_packs_epi16(Words, Words) : _mm_packus_epi16(Words, Words);
+            _mm_storel_epi64((__m128i*)(Dst + i), Bytes);
+        }
+    }
+#endif
+
+    for (; i < Count; i++)
+    {
+        Dst[i] = Quantize(Src[i]);
+    }
+}
+
+template<typename IntType>
+inline void TQuantizedVector<IntType>::Unpack(const TQuantizedVector* In, FVector* Out, int32 Num)
+{
+    const IntType* Src = &In->X;
+    float* Dst = &Out->X;
+    int32 Count = Num * 3;
+    int32 i = 0;
+
+#if defined(__AVX2__)
+    const __m256 InvScale = _mm256_set1_ps(1.0f / MaxValue);
+
+    for (; i + 8 <= Count; i += 8)
+    {
+        __m256i Ints;
+        if (sizeof(IntType) == 2)
+        {
+            __m128i Words = _mm_loadu_si128((const __m128i*)(Src + i));
+            Ints = bSigned ? _mm256_cvtepi16_epi32(Words) : _mm256_cvtepu16_epi32(Words);
+        }
+        else
+        {
+            __m128i Bytes = _mm_loadl_epi64((const __m128i*)(Src + i));
+            Ints = bSigned ? _mm256_cvtepi8_epi32(Bytes) : _mm256_cvtepu8_epi32(Bytes);
+        }
+        _mm256_storeu_ps(Dst + i, _mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(Ints), InvScale), _mm256_set1_ps(-1.0f)));
+    }
+#endif
+
+    for (; i < Count; i++)
+    {
+        Dst[i] = Dequantize(Src[i]);
+    }
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <type_traits>
+#include <assert.h>
+
+#include "../math/math.h"
+
+/**
+ * Linear (bump) allocation for short lived scratch data.
+ *
+ * An allocation is a pointer increment inside a block, nothing is freed individually. The whole
+ * arena is reset at once, or rewound to a mark taken earlier, and keeps its blocks for reuse, so
+ * a steady state frame never touches the global heap. Destructors are never called, only
+ * trivially destructible data or containers using TArenaAllocator belong in an arena.
+ *
+ * Two arenas per thread: FFrameArena for results that live until the end of the frame, never
+ * rewound by library code, and FScratchArena for temporaries of a single call, always used with
+ * an FArenaScope. Rewinding the frame arena would also release what code running inside the
+ * scope allocated for the rest of the frame, jobs executed while waiting included.
+ *
+ * Without NDEBUG every arena asserts that no two threads are inside Alloc, Rewind or Reset at
+ * once, which catches a FFrameArena::EndFrame racing a thread still allocating.
+ */
+
+#ifndef NDEBUG
+#define LINEAR_ARENA_CHECK_USE() FDebugUse DebugUse(bDebugInUse)
+#else
+#define LINEAR_ARENA_CHECK_USE()
+#endif
+
+/** A position in an arena, see FLinearArena::Rewind. */
+struct FArenaMark
+{
+    void*  Block;
+    uint8* Cursor;
+};
+
+class FLinearArena
+{
+public:
+    /**
+     * @param InBlockSize Size of a block, larger allocations get a block of their own.
+     */
+    explicit FLinearArena(size_t InBlockSize = 256 * 1024)
+    : BlockSize(InBlockSize), First(nullptr), Current(nullptr), Cursor(nullptr), End(nullptr)
+    {
+#ifndef NDEBUG
+        bDebugInUse.store(false, std::memory_order_relaxed);
+#endif
+    }
+
+    ~FLinearArena()
+    {
+        while (First != nullptr)
+        {
+            FBlock* Next = First->Next;
+            ::operator delete(First);
+            First = Next;
+        }
+    }
+
+    FLinearArena(const FLinearArena&) = delete;
+    FLinearArena& operator=(const FLinearArena&) = delete;
+
+    /**
+     * @brief Allocate Size bytes, Alignment must be a power of two.
+     */
+    inline void* Alloc(size_t Size, size_t Alignment = 16);
+
+    /**
+     * @brief Allocate an uninitialized array.
+     */
+    template<typename T>
+    inline T* AllocArray(size_t Num)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena memory is never destructed.");
+        return (T*)Alloc(Num * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+    }
+
+    inline FArenaMark GetMark() const
+    {
+        FArenaMark Mark = { Current, Cursor };
+        return Mark;
+    }
+
+    /**
+     * @brief Release everything allocated after Mark was taken.
+     */
+    inline void Rewind(const FArenaMark& Mark);
+
+    /**
+     * @brief Release everything, the blocks are kept.
+     */
+    inline void Reset();
+
+    /**
+     * @brief Bytes allocated since the last reset, including the unused tails of full blocks.
+     */
+    inline size_t GetBytesUsed() const;
+
+private:
+    struct FBlock
+    {
+        FBlock* Next;
+        size_t  Size;
+
+        uint8* GetData() { return (uint8*)(this + 1); }
+    };
+
+    inline FBlock* AllocBlock(size_t Size);
+
+    size_t  BlockSize;
+    FBlock* First;
+    FBlock* Current;
+    uint8*  Cursor;
+    uint8*  End;
+
+#ifndef NDEBUG
+    /** Marks the arena busy for the duration of a call, a second thread entering asserts. */
+    struct FDebugUse
+    {
+        std::atomic<bool>& bInUse;
+
+        explicit FDebugUse(std::atomic<bool>& InUse) : bInUse(InUse)
+        {
+            bool bWasInUse = bInUse.exchange(true, std::memory_order_acquire);
+            assert(!bWasInUse && "FLinearArena used by two threads at once, EndFrame while its owner still allocates?");
+            (void)bWasInUse;
+        }
+
+        ~FDebugUse() { bInUse.store(false, std::memory_order_release); }
+    };
+
+    std::atomic<bool> bDebugInUse;
+#endif
+};
+
+/**
+ * @brief Rewinds an arena to where it was when the scope started.
+ */
+class FArenaScope
+{
+public:
+    explicit FArenaScope(FLinearArena& InArena) : Arena(InArena), Mark(InArena.GetMark()) {}
+    ~FArenaScope() { Arena.Rewind(Mark); }
+
+private:
+    FLinearArena& Arena;
+    FArenaMark    Mark;
+};
+
+/**
+ * @brief One arena per thread, all reset together at the end of the frame.
+ */
+class FFrameArena
+{
+public:
+    /**
+     * @brief The arena of the calling thread, created on first use.
+     */
+    static inline FLinearArena& Get();
+
+    /**
+     * @brief Reset the arenas of all threads. Call at the frame boundary, when no thread uses
+     *        scratch memory of the finished frame any more.
+     */
+    static inline void EndFrame();
+
+private:
+    struct FThreadArena
+    {
+        FLinearArena Arena;
+
+        FThreadArena()
+        {
+            std::lock_guard<std::mutex> Lock(GetMutex());
+            GetArenas().push_back(&Arena);
+        }
+
+        ~FThreadArena()
+        {
+            std::lock_guard<std::mutex> Lock(GetMutex());
+            std::vector<FLinearArena*>& Arenas = GetArenas();
+            for (size_t i=0; i<Arenas.size(); i++)
+            {
+                if (Arenas[i] == &Arena)
+                {
+                    Arenas[i] = Arenas.back();
+                    Arenas.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    static inline std::mutex& GetMutex()
+    {
+        static std::mutex Mutex;
+        return Mutex;
+    }
+
+    static inline std::vector<FLinearArena*>& GetArenas()
+    {
+        static std::vector<FLinearArena*> Arenas;
+        return Arenas;
+    }
+};
+
+/**
+ * @brief One arena per thread for temporaries of a single call: ParallelFor jobs, sort buffers,
+ *        build scratch. Every use takes an FArenaScope, allocations are released in stack order.
+ */
+class FScratchArena
+{
+public:
+    /**
+     * @brief The scratch arena of the calling thread, created on first use.
+     */
+    static inline FLinearArena& Get();
+};
+
+/**
+ * @brief STL allocator over an arena, deallocate does nothing. Defaults to the frame arena of
+ *        the constructing thread, a container must only grow on the thread owning its arena.
+ */
+template<typename T>
+struct TArenaAllocator
+{
+    typedef T value_type;
+
+    FLinearArena* Arena;
+
+    TArenaAllocator() : Arena(&FFrameArena::Get()) {}
+    explicit TArenaAllocator(FLinearArena& InArena) : Arena(&InArena) {}
+
+    template<typename U>
+    TArenaAllocator(const TArenaAllocator<U>& Other) : Arena(Other.Arena) {}
+
+    inline T* allocate(size_t Num)
+    {
+        return (T*)Arena->Alloc(Num * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+    }
+
+    inline void deallocate(T*, size_t) {}
+
+    template<typename U>
+    inline bool operator==(const TArenaAllocator<U>& Other) const { return Arena == Other.Arena; }
+    template<typename U>
+    inline bool operator!=(const TArenaAllocator<U>& Other) const { return Arena != Other.Arena; }
+};
+
+/**
+ * A vector in the frame arena of the constructing thread, or in the arena passed to its
+ * allocator: TArenaVector<T>(TArenaAllocator<T>(Arena)).
+ */
+template<typename T>
+using TArenaVector = std::vector<T, TArenaAllocator<T>>;
+
+inline void* FLinearArena::Alloc(size_t Size, size_t Alignment)
+{
+    LINEAR_ARENA_CHECK_USE();
+
+    uint8* Result = (uint8*)(((size_t)Cursor + Alignment - 1) & ~(Alignment - 1));
+    if (Cursor != nullptr && Result + Size <= End)
+    {
+        Cursor = Result + Size;
+        return Result;
+    }
+
+    // Move on to the next kept block when it is large enough, otherwise insert a new one after
+    // the current block so the blocks behind it stay available.
+    size_t Needed = Size + Alignment;
+    FBlock* Block = Current != nullptr ? Current->Next : First;
+    if (Block == nullptr || Block->Size < Needed)
+    {
+        FBlock* NewBlock = AllocBlock(Needed > BlockSize ? Needed : BlockSize);
+        NewBlock->Next = Block;
+        if (Current != nullptr)
+        {
+            Current->Next = NewBlock;
+        }
+        else
+        {
+            First = NewBlock;
+        }
+        Block = NewBlock;
+    }
+
+    Current = Block;
+    End = Block->GetData() + Block->Size;
+
+    Result = (uint8*)(((size_t)Block->GetData() + Alignment - 1) & ~(Alignment - 1));
+    Cursor = Result + Size;
+    return Result;
+}
+
+inline void FLinearArena::Rewind(const FArenaMark& Mark)
+{
+    LINEAR_ARENA_CHECK_USE();
+
+    Current = (FBlock*)Mark.Block;
+    Cursor = Mark.Cursor;
+    End = Current != nullptr ? Current->GetData() + Current->Size : nullptr;
+}
+
+inline void FLinearArena::Reset()
+{
+    LINEAR_ARENA_CHECK_USE();
+
+    Current = nullptr;
+    Cursor = nullptr;
+    End = nullptr;
+}
+
+inline size_t FLinearArena::GetBytesUsed() const
+{
+    if (Current == nullptr)
+    {
+        return 0;
+    }
+
+    size_t Bytes = 0;
+    for (FBlock* Block = First; Block != Current; Block = Block->Next)
+    {
+        Bytes += Block->Size;
+    }
+    return Bytes + (size_t)(Cursor - Current->GetData());
+}
+
+inline FLinearArena::FBlock* FLinearArena::AllocBlock(size_t Size)
+{
+    FBlock* Block = (FBlock*)::operator new(sizeof(FBlock) + Size);
+    Block->Next = nullptr;
+    Block->Size = Size;
+    return Block;
+}
+
+inline FLinearArena& FFrameArena::Get()
+{
+    thread_local FThreadArena ThreadArena;
+    return ThreadArena.Arena;
+}
+
+inline FLinearArena& FScratchArena::Get()
+{
+    thread_local FLinearArena Arena;
+    return Arena;
+}
+
+inline void FFrameArena::EndFrame()
+{
+    std::lock_guard<std::mutex> Lock(GetMutex());
+    for (FLinearArena* Arena : GetArenas())
+    {
+        Arena->Reset();
+    }
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../math/math.h"
+
+/**
+ * CPU scope timers and per frame counters.
+ *
+ * A scope reads the time stamp counter on entry and exit and writes one event into the ring
+ * buffer of its thread; the buffer has a single writer, so recording takes no lock and no atomic
+ * read-modify-write. Counters are per thread too and only ever grow, a frame's value is the
+ * difference of the sums at two frame ends. ExportChromeTrace writes the buffered events as
+ * Chrome trace JSON (chrome://tracing, Perfetto).
+ *
+ * Everything is compiled out unless CPU_TRACE_ENABLED is 1, the macros then expand to nothing.
+ * The counter is calibrated against the steady clock over the time since the first use, at every
+ * EndFrame and export, so nothing on the recording path ever waits for it.
+ */
+
+#ifndef CPU_TRACE_ENABLED
+#define CPU_TRACE_ENABLED 0
+#endif
+
+#define CPU_TRACE_CONCAT_INNER(A, B) A##B
+#define CPU_TRACE_CONCAT(A, B) CPU_TRACE_CONCAT_INNER(A, B)
+
+#if CPU_TRACE_ENABLED
+/** Time the rest of the enclosing scope, Name must be a string literal. */
+#define CPU_TRACE_SCOPE(Name) FCpuTraceScope CPU_TRACE_CONCAT(CpuTraceScope_, __LINE__)(Name)
+#define CPU_TRACE_COUNTER(Counter, Amount) FCpuTrace::AddCounter(ECpuTraceCounter::Counter, Amount)
+#define CPU_TRACE_END_FRAME() FCpuTrace::EndFrame()
+#define CPU_TRACE_STARTUP() FCpuTrace::Startup()
+#else
+#define CPU_TRACE_SCOPE(Name)
+#define CPU_TRACE_COUNTER(Counter, Amount)
+#define CPU_TRACE_END_FRAME()
+#define CPU_TRACE_STARTUP()
+#endif
+
+enum class ECpuTraceCounter : uint8
+{
+    DrawCalls,
+    Dispatches,
+    Binds,
+    Allocations,
+
+    Num
+};
+
+struct FCpuTraceEvent
+{
+    const char* Name;
+    uint64 StartCycles;
+    uint64 EndCycles;
+};
+
+struct FCpuTraceFrame
+{
+    uint64 StartCycles;
+    uint64 EndCycles;
+    uint64 Counters[(int32)ECpuTraceCounter::Num];
+};
+
+class FCpuTrace
+{
+public:
+    /** Events kept per thread, older events are overwritten. */
+    enum { RingCapacity = 64 * 1024 };
+    /** Frames whose counters are kept for the export, older frames are overwritten. */
+    enum { FrameCapacity = 1024 };
+    /** Exported thread id of the frame counters, thread indices never reach it. */
+    enum { FrameCounterThreadId = 0x7fffffff };
+
+    static inline uint64 ReadCycles()
+    {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /**
+     * @brief Create the global state and the calling thread's buffer ahead of the first scope.
+     *        Optional, otherwise the first scope of every thread pays for its registration.
+     */
+    static inline void Startup();
+
+    static inline void AddEvent(const char* Name, uint64 StartCycles, uint64 EndCycles);
+    static inline void AddCounter(ECpuTraceCounter Counter, uint64 Amount);
+
+    /**
+     * @brief Name the calling thread in the exported trace, Name is copied.
+     */
+    static inline void SetThreadName(const char* Name);
+
+    /**
+     * @brief Close the current frame, its counter totals are kept for the export. Only the last
+     *        FrameCapacity frames are kept.
+     */
+    static inline void EndFrame();
+
+    /**
+     * @brief Counter totals of the last finished frame.
+     */
+    static inline FCpuTraceFrame GetLastFrame();
+
+    /**
+     * @brief Write the buffered events of all threads and the frame counters as Chrome trace
+     *        JSON. Threads may keep recording, events they overwrite meanwhile are skipped.
+     *
+     * @return false The file could not be opened.
+     */
+    static inline bool ExportChromeTrace(const char* Path);
+
+private:
+    struct FThread
+    {
+        std::atomic<uint64> Head;
+        std::atomic<uint64> Counters[(int32)ECpuTraceCounter::Num];
+        uint32 ThreadIndex;
+        char Name[32];
+        FCpuTraceEvent Events[RingCapacity];
+    };
+
+    struct FGlobal
+    {
+        std::mutex Mutex;
+        // Thread buffers are never freed so the events of finished threads can still be exported.
+        std::vector<FThread*> Threads;
+        // Ring of the last FrameCapacity frames, frame i is in slot i % FrameCapacity.
+        std::vector<FCpuTraceFrame> Frames;
+        uint64 NumFrames;
+        uint64 FrameStartCycles;
+        uint64 LastTotals[(int32)ECpuTraceCounter::Num];
+        double CyclesPerMicrosecond;
+        uint64 BaseCycles;
+        std::chrono::steady_clock::time_point BaseClock;
+
+        inline FGlobal();
+    };
+
+    static inline FGlobal& GetGlobal()
+    {
+        static FGlobal Global;
+        return Global;
+    }
+
+    static inline FThread* GetThread()
+    {
+        // A trivially initialized pointer, the access needs no guard.
+        static thread_local FThread* Thread = nullptr;
+        if (Thread == nullptr)
+        {
+            Thread = RegisterThread();
+        }
+        return Thread;
+    }
+
+    static inline FThread* RegisterThread();
+    static inline void Calibrate(FGlobal& Global);
+    static inline void WriteEscaped(FILE* File, const char* String);
+};
+
+class FCpuTraceScope
+{
+public:
+    explicit FCpuTraceScope(const char* InName) : Name(InName), StartCycles(FCpuTrace::ReadCycles()) {}
+    ~FCpuTraceScope() { FCpuTrace::AddEvent(Name, StartCycles, FCpuTrace::ReadCycles()); }
+
+private:
+    const char* Name;
+    uint64 StartCycles;
+};
+
+inline FCpuTrace::FGlobal::FGlobal()
+{
+    memset(LastTotals, 0, sizeof(LastTotals));
+    Frames.resize(FrameCapacity);
+    NumFrames = 0;
+
+    // Often created inside the first traced scope, only take the reference points here.
+    BaseClock = std::chrono::steady_clock::now();
+    BaseCycles = ReadCycles();
+    FrameStartCycles = BaseCycles;
+    CyclesPerMicrosecond = 0.0;
+}
+
+/**
+ * Rate of the counter over everything since the first use, the longer the interval the smaller the
+ * error of the two reads. Called with the mutex held.
+ */
+inline void FCpuTrace::Calibrate(FGlobal& Global)
+{
+    double Microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Global.BaseClock).count();
+    uint64 Cycles = ReadCycles() - Global.BaseCycles;
+    if (Microseconds >= 1000.0 || Global.CyclesPerMicrosecond == 0.0)
+    {
+        Global.CyclesPerMicrosecond = Microseconds > 0.0 && Cycles > 0 ? (double)Cycles / Microseconds : 1.0;
+    }
+}
+
+inline void FCpuTrace::Startup()
+{
+    GetThread();
+}
+
+inline void FCpuTrace::AddEvent(const char* Name, uint64 StartCycles, uint64 EndCycles)
+{
+    FThread* Thread = GetThread();
+    uint64 Head = Thread->Head.load(std::memory_order_relaxed);
+
+    FCpuTraceEvent& Event = Thread->Events[Head & (RingCapacity - 1)];
+    Event.Name = Name;
+    Event.StartCycles = StartCycles;
+    Event.EndCycles = EndCycles;
+
+    Thread->Head.store(Head + 1, std::memory_order_release);
+}
+
+inline void FCpuTrace::AddCounter(ECpuTraceCounter Counter, uint64 Amount)
+{
+    // Only the owning thread writes, a relaxed load and store is enough.
+    std::atomic<uint64>& Value = GetThread()->Counters[(int32)Counter];
+    Value.store(Value.load(std::memory_order_relaxed) + Amount, std::memory_order_relaxed);
+}
+
+inline void FCpuTrace::SetThreadName(const char* Name)
+{
+    FThread* Thread = GetThread();
+    std::lock_guard<std::mutex> Lock(GetGlobal().Mutex);
+    strncpy(Thread->Name, Name, sizeof(Thread->Name) - 1);
+    Thread->Name[sizeof(Thread->Name) - 1] = 0;
+}
+
+inline FCpuTrace::FThread* FCpuTrace::RegisterThread()
+{
+    FThread* Thread = new FThread();
+    Thread->Head.store(0, std::memory_order_relaxed);
+    for (int32 i=0; i<(int32)ECpuTraceCounter::Num; i++)
+    {
+        Thread->Counters[i].store(0, std::memory_order_relaxed);
+    }
+
+    FGlobal& Global = GetGlobal();
+    std::lock_guard<std::mutex> Lock(Global.Mutex);
+    Thread->ThreadIndex = (uint32)Global.Threads.size();
+    snprintf(Thread->Name, sizeof(Thread->Name), "Thread %u", Thread->ThreadIndex);
+    Global.Threads.push_back(Thread);
+    return Thread;
+}
+
+inline void FCpuTrace::EndFrame()
+{
+    FGlobal& Global = GetGlobal();
+    uint64 Now = ReadCycles();
+
+    std::lock_guard<std::mutex> Lock(Global.Mutex);
+
+    FCpuTraceFrame Frame;
+    Frame.StartCycles = Global.FrameStartCycles;
+    Frame.EndCycles = Now;
+
+    for (int32 i=0; i<(int32)ECpuTraceCounter::Num; i++)
+    {
+        uint64 Total = 0;
+        for (FThread* Thread : Global.Threads)
+        {
+            Total += Thread->Counters[i].load(std::memory_order_relaxed);
+        }
+        Frame.Counters[i] = Total - Global.LastTotals[i];
+        Global.LastTotals[i] = Total;
+    }
+
+    Global.Frames[Global.NumFrames % FrameCapacity] = Frame;
+    Global.NumFrames++;
+    Global.FrameStartCycles = Now;
+
+    Calibrate(Global);
+}
+
+inline FCpuTraceFrame FCpuTrace::GetLastFrame()
+{
+    FGlobal& Global = GetGlobal();
+    std::lock_guard<std::mutex> Lock(Global.Mutex);
+
+    FCpuTraceFrame Frame;
+    memset(&Frame, 0, sizeof(Frame));
+    if (Global.NumFrames > 0)
+    {
+        Frame = Global.Frames[(Global.NumFrames - 1) % FrameCapacity];
+    }
+    return Frame;
+}
+
+inline void FCpuTrace::WriteEscaped(FILE* File, const char* String)
+{
+    for (const char* C = String; *C; C++)
+    {
+        if (*C == '"' || *C == '\\')
+        {
+            fputc('\\', File);
+        }
+        fputc(*C, File);
+    }
+}
+
+inline bool FCpuTrace::ExportChromeTrace(const char* Path)
+{
+    static const char* CounterNames[(int32)ECpuTraceCounter::Num] = { "DrawCalls", "Dispatches", "Binds", "Allocations" };
+
+    struct FThreadSnapshot
+    {
+        uint32 ThreadIndex;
+        char Name[32];
+        std::vector<FCpuTraceEvent> Events;
+    };
+
+    // Copy under the lock, the file is written after releasing it so EndFrame and new threads
+    // never wait for the disk.
+    std::vector<FThreadSnapshot> Threads;
+    std::vector<FCpuTraceFrame> Frames;
+    double Scale;
+    uint64 BaseCycles;
+    {
+        FGlobal& Global = GetGlobal();
+        std::lock_guard<std::mutex> Lock(Global.Mutex);
+
+        Calibrate(Global);
+        Scale = 1.0 / Global.CyclesPerMicrosecond;
+        BaseCycles = Global.BaseCycles;
+
+        Threads.resize(Global.Threads.size());
+        for (size_t t=0; t<Global.Threads.size(); t++)
+        {
+            FThread* Thread = Global.Threads[t];
+            FThreadSnapshot& Snapshot = Threads[t];
+            Snapshot.ThreadIndex = Thread->ThreadIndex;
+            memcpy(Snapshot.Name, Thread->Name, sizeof(Snapshot.Name));
+
+            uint64 Head = Thread->Head.load(std::memory_order_acquire);
+            uint64 First = Head > RingCapacity ? Head - RingCapacity : 0;
+
+            std::vector<FCpuTraceEvent> Events(Thread->Events + 0, Thread->Events + RingCapacity);
+
+            // Slots the writer reached while they were copied may be torn, drop them. That includes
+            // the slot of event HeadAfter, which may be half written.
+            uint64 HeadAfter = Thread->Head.load(std::memory_order_acquire);
+            if (HeadAfter + 1 > RingCapacity && HeadAfter + 1 - RingCapacity > First)
+            {
+                First = HeadAfter + 1 - RingCapacity;
+            }
+
+            for (uint64 i=First; i<Head; i++)
+            {
+                Snapshot.Events.push_back(Events[i & (RingCapacity - 1)]);
+            }
+        }
+
+        uint64 FirstFrame = Global.NumFrames > FrameCapacity ? Global.NumFrames - FrameCapacity : 0;
+        for (uint64 f=FirstFrame; f<Global.NumFrames; f++)
+        {
+            Frames.push_back(Global.Frames[f % FrameCapacity]);
+        }
+    }
+
+    FILE* File = fopen(Path, "w");
+    if (File == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(File, "{\"traceEvents\":[\n");
+    fprintf(File, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Frames\"}}", (uint32)FrameCounterThreadId);
+
+    for (const FThreadSnapshot& Thread : Threads)
+    {
+        fprintf(File, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", Thread.ThreadIndex);
+        WriteEscaped(File, Thread.Name);
+        fprintf(File, "\"}}");
+
+        for (const FCpuTraceEvent& Event : Thread.Events)
+        {
+            fprintf(File, ",\n{\"name\":\"");
+            WriteEscaped(File, Event.Name);
+            fprintf(File, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                Thread.ThreadIndex,
+                (double)(int64)(Event.StartCycles - BaseCycles) * Scale,
+                (double)(Event.EndCycles - Event.StartCycles) * Scale);
+        }
+    }
+
+    for (const FCpuTraceFrame& Frame : Frames)
+    {
+        fprintf(File, ",\n{\"name\":\"FrameCounters\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{",
+            (uint32)FrameCounterThreadId, (double)(int64)(Frame.EndCycles - BaseCycles) * Scale);
+
+        for (int32 i=0; i<(int32)ECpuTraceCounter::Num; i++)
+        {
+            fprintf(File, "%s\"%s\":%llu", i == 0 ? "" : ",", CounterNames[i], (unsigned long long)Frame.Counters[i]);
+        }
+        fprintf(File, "}}");
+    }
+
+    fprintf(File, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(File);
+    return true;
+}
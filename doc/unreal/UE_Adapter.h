@@ -1,5 +1,29 @@
 
 
+struct FAdapterDesc
+{
+    FString Description;
+    uint32 AdapterIndex;
+    uint32 VendorId;
+    uint64 DedicatedVideoMemory;
+    uint64 SharedSystemMemory;
+    D3D_FEATURE_LEVEL MaxSupportedFeatureLevel;
+    bool bSoftwareAdapter;
+    // Number of nodes for linked adapters, each node becomes one FDevice.
+    uint32 NumDeviceNodes;
+};
+
+// Where adapters come from. The DXGI implementation wraps IDXGIFactory::EnumAdapters, startup
+// tests use a stub that returns canned descs and adapters that create no D3D objects.
+class IAdapterFactory
+{
+public:
+    virtual ~IAdapterFactory() {}
+
+    virtual void EnumerateAdapters(TArray<FAdapterDesc>& OutDescs) = 0;
+    virtual TSharedPtr<FAdapter> CreateAdapter(const FAdapterDesc& Desc) = 0;
+};
+
 class FAdapter
 {
 private:
@@ -12,14 +36,42 @@ private:
 
 public:
     FAdapter();
-    ~FAdapter();
+    explicit FAdapter(const FAdapterDesc& InDesc) : Desc(InDesc) {}
+    virtual ~FAdapter();
 
-    void Initialize() {
+    virtual void Initialize() {
         __CreateRootDevice();
     }
 
-    // Initialize all devices.
-    void InitializeDevices();
+    // GPU indices are global over all chosen adapters, the nodes of this adapter are
+    // [FirstGPUIndex, FirstGPUIndex + NumDeviceNodes). Set before InitializeDevices.
+    void SetFirstGPUIndex(uint32 InFirstGPUIndex) { FirstGPUIndex = InFirstGPUIndex; }
+    uint32 GetFirstGPUIndex() const { return FirstGPUIndex; }
+
+    FRHIGPUMask GetNodeGPUMask(uint32 NodeIndex) const { return FRHIGPUMask::FromIndex(FirstGPUIndex + NodeIndex); }
+
+    // Initialize all devices. Each node creates its three command queues and descriptor heaps,
+    // nodes are independent so they are created in parallel on the task graph.
+    virtual void InitializeDevices()
+    {
+        Devices.SetNum(Desc.NumDeviceNodes);
+
+        ParallelFor(Desc.NumDeviceNodes, [this](int32 NodeIndex)
+        {
+            FStartupTraceScope Scope(TEXT("CreateDevice"), Desc.AdapterIndex);
+
+            Devices[NodeIndex] = new FDevice(GetNodeGPUMask(NodeIndex), this);
+
+            // Creating a command queue blocks in the driver for a while, overlap the three.
+            ParallelFor(3, [this, NodeIndex](int32 QueueIndex)
+            {
+                FStartupTraceScope QueueScope(TEXT("CreateCommandQueue"), Desc.AdapterIndex);
+                Devices[NodeIndex]->CreateCommandQueue((ED3D12CommandQueueType)QueueIndex);
+            });
+
+            Devices[NodeIndex]->InitDescriptorHeaps();
+        });
+    }
 
 
     void __CreateRootDevice() {
@@ -27,14 +79,112 @@ public:
 
     }
 
+    // Buffer objects outlive a frame, so they come from a per type pool with a per thread cache
+    // instead of the frame arena: creating one is a pop from a thread local free list and never
+    // contends on the global heap. Single frame CPU scratch (culling results, transforms, command
+    // packets) uses the frame arena, see core/memory/framearena.h and FRHICommandBufferArena.
+    template<class BufferType>
+    static TLockFreeClassAllocator_TLSCache<BufferType, PLATFORM_CACHE_LINE_SIZE>& GetBufferAllocator()
+    {
+        static TLockFreeClassAllocator_TLSCache<BufferType, PLATFORM_CACHE_LINE_SIZE> Allocator;
+        return Allocator;
+    }
+
     template<class BufferType>
     BufferType* CreateRHIBuffer()
     {
-        BufferType* BufferOut = new BufferType();
+        CPU_TRACE_COUNTER(Allocations, 1);
+        BufferType* BufferOut = new(GetBufferAllocator<BufferType>().Allocate()) BufferType();
 
         AllocateBuffer(BufferOut);
 
         return BufferOut;
     }
+
+    template<class BufferType>
+    void ReleaseRHIBuffer(BufferType* Buffer)
+    {
+        Buffer->~BufferType();
+        GetBufferAllocator<BufferType>().Free(Buffer);
+    }
     void AllocateBuffer(FDevice *Device, DESC， uint32 Size, uint32 InUsage, uint32 Alignment);
+
+    const FAdapterDesc& GetDesc() const { return Desc; }
+
+    // Device of a global GPU index owned by this adapter.
+    FDevice* GetDevice(uint32 GPUIndex) const { return Devices[GPUIndex - FirstGPUIndex]; }
+
+protected:
+    FAdapterDesc Desc;
+    TArray<FDevice*> Devices;
+    uint32 FirstGPUIndex = 0;
+};
+
+// Adapter that creates no D3D objects, the startup tests use it to check adapter selection, GPU
+// index assignment and how much of the startup runs in parallel. The driver time of each step is
+// simulated with a sleep.
+class FStubAdapter : public FAdapter
+{
+public:
+    FStubAdapter(const FAdapterDesc& InDesc, float InCreateSeconds)
+        : FAdapter(InDesc)
+        , CreateSeconds(InCreateSeconds)
+    {
+    }
+
+    virtual void Initialize() override
+    {
+        FPlatformProcess::Sleep(CreateSeconds);
+    }
+
+    virtual void InitializeDevices() override
+    {
+        NodeGPUMasks.SetNum(Desc.NumDeviceNodes);
+
+        ParallelFor(Desc.NumDeviceNodes, [this](int32 NodeIndex)
+        {
+            FStartupTraceScope Scope(TEXT("CreateDevice"), Desc.AdapterIndex);
+            FPlatformProcess::Sleep(CreateSeconds);
+            NodeGPUMasks[NodeIndex] = GetNodeGPUMask(NodeIndex).GetNative();
+        });
+    }
+
+    // Masks the devices of each node would have been created with.
+    const TArray<uint32>& GetNodeGPUMasks() const { return NodeGPUMasks; }
+
+private:
+    float CreateSeconds;
+    TArray<uint32> NodeGPUMasks;
+};
+
+// Canned adapter descs, CreateAdapter hands out FStubAdapter.
+class FStubAdapterFactory : public IAdapterFactory
+{
+public:
+    explicit FStubAdapterFactory(float InCreateSeconds = 0.0f) : CreateSeconds(InCreateSeconds) {}
+
+    void AddAdapter(const FAdapterDesc& Desc)
+    {
+        Descs.Add(Desc);
+        Descs.Last().AdapterIndex = Descs.Num() - 1;
+    }
+
+    virtual void EnumerateAdapters(TArray<FAdapterDesc>& OutDescs) override
+    {
+        OutDescs = Descs;
+    }
+
+    virtual TSharedPtr<FAdapter> CreateAdapter(const FAdapterDesc& Desc) override
+    {
+        TSharedPtr<FStubAdapter> Adapter = MakeShared<FStubAdapter>(Desc, CreateSeconds);
+        Created.Add(Adapter);
+        return Adapter;
+    }
+
+    const TArray<TSharedPtr<FStubAdapter>>& GetCreatedAdapters() const { return Created; }
+
+private:
+    float CreateSeconds;
+    TArray<FAdapterDesc> Descs;
+    TArray<TSharedPtr<FStubAdapter>> Created;
 };
\ No newline at end of file
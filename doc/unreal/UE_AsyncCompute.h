@@ -0,0 +1,282 @@
+
+// Frame task graph over the three queues of FDevice (CommandListManager, AsyncCommandListManager,
+// CopyCommandListManager). Passes are declared in submission order with their queue and the
+// resources they read and write, the scheduler then works out which cross-queue fence waits are
+// actually needed so copy and compute work can overlap graphics work.
+
+enum class ERHIPipeline : uint8
+{
+    Graphics,
+    AsyncCompute,
+    Copy,
+
+    Num
+};
+
+static const uint32 NumRHIPipelines = (uint32)ERHIPipeline::Num;
+
+// Wait on another queue's fence before the pass starts.
+struct FCrossQueueWait
+{
+    ERHIPipeline Pipeline;
+    // Position of the producer on its queue, see FFramePass::FenceValue.
+    uint64 FenceValue;
+    int32 ProducerPass;
+};
+
+struct FFramePass
+{
+    const TCHAR* Name;
+    ERHIPipeline Pipeline;
+
+    TArray<FResource*> Reads;
+    TArray<FResource*> Writes;
+
+    TFunction<void(FRHICommandList&)> Execute;
+
+    // Estimated GPU time in microseconds, only used by the simulated backend.
+    float EstimatedCost = 0.0f;
+
+    // Filled by FFrameGraphScheduler::Compile. FenceValue is the 1 based position of the pass on
+    // its queue within the frame, the fence itself only advances for passes with bSignalFence.
+    uint64 FenceValue = 0;
+    bool bSignalFence = false;
+    TArray<FCrossQueueWait> Waits;
+
+    // Filled by FFrameGraphScheduler::Execute, the fence value signalled after the pass or 0.
+    uint64 SignaledFence = 0;
+};
+
+class FFrameGraphScheduler
+{
+public:
+    int32 AddPass(FFramePass&& Pass)
+    {
+        return Passes.Add(MoveTemp(Pass));
+    }
+
+    // Resolve dependencies and insert the minimal set of fence waits.
+    //
+    // Work on the same queue is ordered implicitly. For every queue we keep a vector clock of the
+    // highest fence value of each other queue it is already synchronized with, directly or through
+    // a chain of waits. A dependency is only turned into a wait when the clock does not cover it.
+    void Compile()
+    {
+        uint64 NextFenceValue[NumRHIPipelines] = {};
+        uint64 QueueClock[NumRHIPipelines][NumRHIPipelines] = {};
+
+        // Clock of the signalling queue at the time each pass finished.
+        TArray<TStaticArray<uint64, NumRHIPipelines>> PassClock;
+        PassClock.SetNum(Passes.Num());
+
+        struct FResourceAccessState
+        {
+            int32 LastWriter = INDEX_NONE;
+            TArray<int32> ReadersSinceWrite;
+        };
+        TMap<FResource*, FResourceAccessState> AccessStates;
+
+        TArray<int32> Dependencies;
+        int32 LastPass[NumRHIPipelines];
+        for (uint32 Queue = 0; Queue < NumRHIPipelines; Queue++)
+        {
+            LastPass[Queue] = INDEX_NONE;
+        }
+
+        for (int32 PassIndex = 0; PassIndex < Passes.Num(); PassIndex++)
+        {
+            FFramePass& Pass = Passes[PassIndex];
+            const uint32 Queue = (uint32)Pass.Pipeline;
+
+            Pass.FenceValue = ++NextFenceValue[Queue];
+            Pass.bSignalFence = false;
+            Pass.Waits.Reset();
+            LastPass[Queue] = PassIndex;
+
+            // Read after write.
+            Dependencies.Reset();
+            for (FResource* Resource : Pass.Reads)
+            {
+                FResourceAccessState& State = AccessStates.FindOrAdd(Resource);
+                if (State.LastWriter != INDEX_NONE)
+                {
+                    Dependencies.Add(State.LastWriter);
+                }
+            }
+
+            // Write after write, write after read.
+            for (FResource* Resource : Pass.Writes)
+            {
+                FResourceAccessState& State = AccessStates.FindOrAdd(Resource);
+                if (State.LastWriter != INDEX_NONE)
+                {
+                    Dependencies.Add(State.LastWriter);
+                }
+                Dependencies.Append(State.ReadersSinceWrite);
+            }
+
+            // Only the latest producer per queue matters, older ones are covered by queue order.
+            uint64 Required[NumRHIPipelines] = {};
+            int32 RequiredPass[NumRHIPipelines];
+            for (uint32 Other = 0; Other < NumRHIPipelines; Other++)
+            {
+                RequiredPass[Other] = INDEX_NONE;
+            }
+            for (int32 Dependency : Dependencies)
+            {
+                const FFramePass& Producer = Passes[Dependency];
+                const uint32 ProducerQueue = (uint32)Producer.Pipeline;
+                if (ProducerQueue != Queue && Producer.FenceValue > Required[ProducerQueue])
+                {
+                    Required[ProducerQueue] = Producer.FenceValue;
+                    RequiredPass[ProducerQueue] = Dependency;
+                }
+            }
+
+            for (uint32 Other = 0; Other < NumRHIPipelines; Other++)
+            {
+                if (RequiredPass[Other] == INDEX_NONE || QueueClock[Queue][Other] >= Required[Other])
+                {
+                    continue;
+                }
+
+                Passes[RequiredPass[Other]].bSignalFence = true;
+                Pass.Waits.Add({ (ERHIPipeline)Other, Required[Other], RequiredPass[Other] });
+
+                // Waiting on the producer also synchronizes with everything it waited on.
+                const TStaticArray<uint64, NumRHIPipelines>& ProducerClock = PassClock[RequiredPass[Other]];
+                for (uint32 Transitive = 0; Transitive < NumRHIPipelines; Transitive++)
+                {
+                    QueueClock[Queue][Transitive] = FMath::Max(QueueClock[Queue][Transitive], ProducerClock[Transitive]);
+                }
+            }
+
+            QueueClock[Queue][Queue] = Pass.FenceValue;
+            for (uint32 Other = 0; Other < NumRHIPipelines; Other++)
+            {
+                PassClock[PassIndex][Other] = QueueClock[Queue][Other];
+            }
+
+            for (FResource* Resource : Pass.Reads)
+            {
+                AccessStates.FindChecked(Resource).ReadersSinceWrite.AddUnique(PassIndex);
+            }
+            for (FResource* Resource : Pass.Writes)
+            {
+                FResourceAccessState& State = AccessStates.FindChecked(Resource);
+                State.LastWriter = PassIndex;
+                State.ReadersSinceWrite.Reset();
+            }
+        }
+
+        // The end of the frame on every queue is signalled, CPU waits and deferred deletes of the
+        // frame need a value the queue actually reaches.
+        for (uint32 Queue = 0; Queue < NumRHIPipelines; Queue++)
+        {
+            if (LastPass[Queue] != INDEX_NONE)
+            {
+                Passes[LastPass[Queue]].bSignalFence = true;
+            }
+        }
+    }
+
+    // Record and submit on the device queues. Each pass gets its own command list so fence waits
+    // and signals can be placed between ExecuteCommandLists calls.
+    void Execute(FDevice* Device)
+    {
+        FCommandListManager* Managers[NumRHIPipelines] =
+        {
+            &Device->GetCommandListManager(),
+            &Device->GetAsyncCommandListManager(),
+            &Device->GetCopyCommandListManager(),
+        };
+
+        // Other code submits to the same queues (the streaming uploader, cross GPU transfers), so
+        // the values are whatever the fence hands out when the producer signals. Producers come
+        // before their consumers in submission order and are resolved by then.
+        for (FFramePass& Pass : Passes)
+        {
+            FCommandListManager* Manager = Managers[(uint32)Pass.Pipeline];
+
+            for (const FCrossQueueWait& Wait : Pass.Waits)
+            {
+                const FFramePass& Producer = Passes[Wait.ProducerPass];
+                check(Producer.SignaledFence != 0);
+                Manager->GetD3DCommandQueue()->Wait(Managers[(uint32)Wait.Pipeline]->GetFence().GetFenceCore(), Producer.SignaledFence);
+            }
+
+            FRHICommandList& CommandList = Manager->ObtainCommandList();
+            Pass.Execute(CommandList);
+            Manager->ExecuteCommandList(CommandList);
+
+            // Signal advances the fence and returns the new value, passes without a signal leave
+            // it alone so it never claims a value the queue does not reach.
+            Pass.SignaledFence = Pass.bSignalFence ? Manager->GetFence().Signal(Manager->GetD3DCommandQueue()) : 0;
+        }
+    }
+
+    uint32 GetNumWaits() const
+    {
+        uint32 NumWaits = 0;
+        for (const FFramePass& Pass : Passes)
+        {
+            NumWaits += Pass.Waits.Num();
+        }
+        return NumWaits;
+    }
+
+    const TArray<FFramePass>& GetPasses() const { return Passes; }
+
+    void Reset() { Passes.Reset(); }
+
+private:
+    TArray<FFramePass> Passes;
+};
+
+// CPU stand-in for the GPU queues. Every queue runs its passes in order, a pass starts when its
+// queue is idle and every fence it waits on is signalled. Used to check the scheduler and to
+// measure how much overlap a frame gets.
+class FSimulatedQueueBackend
+{
+public:
+    struct FResult
+    {
+        // Time at which the last pass on any queue finishes.
+        float CriticalPath = 0.0f;
+        // Time if everything ran back to back on the graphics queue.
+        float Serial = 0.0f;
+        float QueueBusy[NumRHIPipelines] = {};
+    };
+
+    static FResult Run(const FFrameGraphScheduler& Scheduler)
+    {
+        FResult Result;
+
+        float QueueTime[NumRHIPipelines] = {};
+        // Finish time of each fence value, indexed by FenceValue - 1.
+        TArray<float> SignalTime[NumRHIPipelines];
+
+        for (const FFramePass& Pass : Scheduler.GetPasses())
+        {
+            const uint32 Queue = (uint32)Pass.Pipeline;
+
+            float Start = QueueTime[Queue];
+            for (const FCrossQueueWait& Wait : Pass.Waits)
+            {
+                // Passes are submitted in dependency order, so the producer has been simulated.
+                check(Wait.FenceValue <= (uint64)SignalTime[(uint32)Wait.Pipeline].Num());
+                Start = FMath::Max(Start, SignalTime[(uint32)Wait.Pipeline][Wait.FenceValue - 1]);
+            }
+
+            const float Finish = Start + Pass.EstimatedCost;
+            QueueTime[Queue] = Finish;
+            SignalTime[Queue].Add(Finish);
+
+            Result.QueueBusy[Queue] += Pass.EstimatedCost;
+            Result.Serial += Pass.EstimatedCost;
+            Result.CriticalPath = FMath::Max(Result.CriticalPath, Finish);
+        }
+
+        return Result;
+    }
+};
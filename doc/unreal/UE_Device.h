@@ -23,7 +23,14 @@ protected:
 class FRHICommandList
 {
     /** A mask where each bit is a GPU index. Can not be empty so that non SLI platforms can optimize it to be always 1.  */
-    FRHIGPUMask GPUMask;
+    FRHIGPUMask GPUMask = FRHIGPUMask::GPU0();
+
+    // Recorded packets, see UE_RHICommandList.h.
+    FRHICommandBufferArena Arena;
+    uint32 NumCommands = 0;
+
+    // Order of this list when lists recorded in parallel are merged.
+    uint64 SortKey = 0;
 
 public:
     void Flush();
@@ -33,6 +40,80 @@ public:
     FComputeShaderRHIRef CreateComputeShader();
 
     FGPUFenceRHIRef CreateComputeFence();
+
+public:
+    // Recording, nothing here touches the context.
+    void SetGraphicsPipelineState(FRHIGraphicsPipelineState* PipelineState)
+    {
+        Record<FRHICommandSetGraphicsPipelineState>({ PipelineState });
+    }
+
+    void SetStreamSource(uint32 StreamIndex, FRHIBuffer* VertexBuffer, uint32 Offset)
+    {
+        Record<FRHICommandSetStreamSource>({ VertexBuffer, StreamIndex, Offset });
+    }
+
+    void SetShaderTexture(FRHIShader* Shader, uint32 TextureIndex, FRHITexture* Texture)
+    {
+        Record<FRHICommandSetShaderTexture>({ Shader, Texture, TextureIndex });
+    }
+
+    void SetShaderUniformBuffer(FRHIShader* Shader, uint32 BufferIndex, FRHIUniformBuffer* UniformBuffer)
+    {
+        Record<FRHICommandSetShaderUniformBuffer>({ Shader, UniformBuffer, BufferIndex });
+    }
+
+    void TransitionResource(FResource* Resource, uint32 Subresource, D3D12_RESOURCE_STATES After)
+    {
+        Record<FRHICommandTransitionResource>({ Resource, Subresource, After });
+    }
+
+    void DrawPrimitive(uint32 BaseVertexIndex, uint32 NumPrimitives, uint32 NumInstances)
+    {
+        Record<FRHICommandDrawPrimitive>({ BaseVertexIndex, NumPrimitives, NumInstances });
+    }
+
+    void DispatchComputeShader(uint32 ThreadGroupCountX, uint32 ThreadGroupCountY, uint32 ThreadGroupCountZ)
+    {
+        Record<FRHICommandDispatchComputeShader>({ ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ });
+    }
+
+    // Devices the list is replayed on, see FMultiGPUScheduler::Submit.
+    void SetGPUMask(FRHIGPUMask InGPUMask) { GPUMask = InGPUMask; }
+    FRHIGPUMask GetGPUMask() const { return GPUMask; }
+
+    void SetSortKey(uint64 InSortKey) { SortKey = InSortKey; }
+    uint64 GetSortKey() const { return SortKey; }
+
+    uint32 GetNumCommands() const { return NumCommands; }
+    const FRHICommandBufferArena& GetArena() const { return Arena; }
+
+    void Reset()
+    {
+        Arena.Reset();
+        NumCommands = 0;
+    }
+
+private:
+    template<typename TCommand>
+    void Record(const TCommand& Command)
+    {
+        static_assert(TIsPODType<TCommand>::Value, "RHI commands must be POD, they are replayed from raw memory.");
+
+        static_assert(alignof(TCommand) <= RHI_COMMAND_ALIGNMENT, "Packets only start RHI_COMMAND_ALIGNMENT aligned.");
+
+        // Sizes are a multiple of the alignment, so the next packet starts aligned as well.
+        const uint32 PayloadOffset = FRHICommandHeader::GetPayloadOffset<TCommand>();
+        const uint32 Size = Align(PayloadOffset + sizeof(TCommand), RHI_COMMAND_ALIGNMENT);
+        uint8* Memory = (uint8*)Arena.Alloc(Size);
+
+        FRHICommandHeader* Header = (FRHICommandHeader*)Memory;
+        Header->Type = TCommand::Type;
+        Header->Size = (uint16)Size;
+        FMemory::Memcpy(Memory + PayloadOffset, &Command, sizeof(TCommand));
+
+        NumCommands++;
+    }
 };
 
 class FRHICommandContext
@@ -51,14 +132,116 @@ public:
 
 public:
     // Refresh the state cache.
-    void RHISetShaderTexture();
-    void RHISetShaderUniformBuffer();
+    void RHISetGraphicsPipelineState(FRHIGraphicsPipelineState* PipelineState);
+    void RHISetStreamSource(uint32 StreamIndex, FRHIBuffer* VertexBuffer, uint32 Offset);
+    void RHISetShaderTexture(FRHIShader* Shader, uint32 TextureIndex, FRHITexture* Texture);
+    void RHISetShaderUniformBuffer(FRHIShader* Shader, uint32 BufferIndex, FRHIUniformBuffer* UniformBuffer);
+    void RHISetScissorRect(bool bEnable, uint32 MinX, uint32 MinY, uint32 MaxX, uint32 MaxY);
 
 
     // Aplly the state cache, and submit the command to command list of device, conditional refresh command list.
-    void RHIDrawPrimitive();
+    void RHIDrawPrimitive(uint32 BaseVertexIndex, uint32 NumPrimitives, uint32 NumInstances);
+    void RHIDispatchComputeShader(uint32 ThreadGroupCountX, uint32 ThreadGroupCountY, uint32 ThreadGroupCountZ);
+
+    // Queue a transition, it is recorded with the other pending barriers by the next draw or dispatch.
+    // The first transition of a resource on the list is resolved against the global state when the
+    // command list manager submits the list, see FResourceBarrierBatcher::ResolvePendingBarriers.
+    void RHITransitionResource(FResource* Resource, uint32 Subresource, D3D12_RESOURCE_STATES After)
+    {
+        BarrierBatcher.AddTransition(Resource, Subresource, After);
+    }
+
+    const FResourceBarrierStats& GetBarrierStats() const { return BarrierBatcher.GetStats(); }
+
+protected:
+    // Flush pending barriers as one batch, called at the top of RHIDrawPrimitive and RHIDispatchComputeShader.
+    void FlushResourceBarriers()
+    {
+        BarrierBatcher.Flush(CommandList);
+    }
+
+    ID3D12GraphicsCommandList* CommandList;
+    FResourceBarrierBatcher BarrierBatcher;
 };
 
+// Frame phases are timed with CPU_TRACE_SCOPE and draws, dispatches and binds are counted per
+// frame, see core/profiling/cputrace.h. All of it compiles out unless CPU_TRACE_ENABLED is set.
+inline void FRHICommandContext::RHIBeginFrame()
+{
+    // Registers the render thread before its first scope, afterwards a thread local check.
+    CPU_TRACE_STARTUP();
+    CPU_TRACE_SCOPE("RHIBeginFrame");
+    // Reset the per frame state and open the first command list.
+}
+
+inline void FRHICommandContext::RHIEndFrame()
+{
+    {
+        CPU_TRACE_SCOPE("RHIEndFrame");
+        // Close and submit the last command list.
+    }
+    CPU_TRACE_END_FRAME();
+}
+
+inline void FRHICommandContext::RHIBeginDrawingViewport()
+{
+    CPU_TRACE_SCOPE("RHIBeginDrawingViewport");
+    // Wait for the back buffer and transition it to render target.
+}
+
+inline void FRHICommandContext::RHIEndDrawingViewport()
+{
+    CPU_TRACE_SCOPE("RHIEndDrawingViewport");
+    // Transition the back buffer to present and present.
+}
+
+inline void FRHICommandContext::RHISetGraphicsPipelineState(FRHIGraphicsPipelineState* PipelineState)
+{
+    CPU_TRACE_COUNTER(Binds, 1);
+    // Refresh the state cache.
+}
+
+inline void FRHICommandContext::RHISetStreamSource(uint32 StreamIndex, FRHIBuffer* VertexBuffer, uint32 Offset)
+{
+    CPU_TRACE_COUNTER(Binds, 1);
+    // Refresh the state cache.
+}
+
+inline void FRHICommandContext::RHISetShaderTexture(FRHIShader* Shader, uint32 TextureIndex, FRHITexture* Texture)
+{
+    CPU_TRACE_COUNTER(Binds, 1);
+    // Refresh the state cache.
+}
+
+inline void FRHICommandContext::RHISetShaderUniformBuffer(FRHIShader* Shader, uint32 BufferIndex, FRHIUniformBuffer* UniformBuffer)
+{
+    CPU_TRACE_COUNTER(Binds, 1);
+    // Refresh the state cache.
+}
+
+inline void FRHICommandContext::RHISetScissorRect(bool bEnable, uint32 MinX, uint32 MinY, uint32 MaxX, uint32 MaxY)
+{
+    // Refresh the state cache, the rect is applied with the next draw.
+}
+
+inline void FRHICommandContext::RHIDrawPrimitive(uint32 BaseVertexIndex, uint32 NumPrimitives, uint32 NumInstances)
+{
+    CPU_TRACE_SCOPE("RHIDrawPrimitive");
+    CPU_TRACE_COUNTER(DrawCalls, 1);
+
+    FlushResourceBarriers();
+    // Apply the state cache and record the draw.
+}
+
+inline void FRHICommandContext::RHIDispatchComputeShader(uint32 ThreadGroupCountX, uint32 ThreadGroupCountY, uint32 ThreadGroupCountZ)
+{
+    CPU_TRACE_SCOPE("RHIDispatchComputeShader");
+    CPU_TRACE_COUNTER(Dispatches, 1);
+
+    FlushResourceBarriers();
+    // Apply the compute state cache and record the dispatch.
+}
+
 class FCommandContext : public FRHICommandContext
 {
     
@@ -85,18 +268,77 @@ class FResourceAllocator
 class FBucketAllocator : public FResourceAllocator
 {
 public:
+    FBucketAllocator()
+    {
+        for (uint32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+        {
+            AvailableBlocks[Bucket] = MakeUnique<TMPMCQueue<FBlockAllocatorPrivateData>>(GetFreeListCapacity(Bucket));
+        }
+    }
+
     void Allocate(uint32 SizeInBytes, uint32 Alignment, FResourceLocation& ResourceLocation)
     {
         // Find free position, otherwise create one.
 
     }
 
+    // Any thread. Returns a block of the bucket to its free list.
+    void ReleaseBlock(uint32 Bucket, const FBlockAllocatorPrivateData& Block)
+    {
+        if (!AvailableBlocks[Bucket]->Enqueue(Block))
+        {
+            // The bounded list is full, keep the block on the locked overflow instead of leaking it.
+            FScopeLock Lock(&OverflowCS);
+            OverflowBlocks[Bucket].Add(Block);
+            NumOverflowBlocks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread. Takes a free block of the bucket, false if there is none and a new one has to be created.
+    bool TryGetFreeBlock(uint32 Bucket, FBlockAllocatorPrivateData& OutBlock)
+    {
+        if (AvailableBlocks[Bucket]->Dequeue(OutBlock))
+        {
+            return true;
+        }
+        if (NumOverflowBlocks.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+
+        FScopeLock Lock(&OverflowCS);
+        if (OverflowBlocks[Bucket].Num() == 0)
+        {
+            return false;
+        }
+        OutBlock = OverflowBlocks[Bucket].Pop(false);
+        NumOverflowBlocks.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
 protected:
     static const uint32 BucketShift = 6;
 	static const uint32 NumBuckets = 22; // bucket resource sizes range from 64 to 2^28 
+    static const uint32 BucketResourceSize = 4 * 1024 * 1024;
+
+    // Enough slots for every block one bucket resource holds, so the overflow is only reached
+    // once a bucket grows past its first resource.
+    static uint32 GetFreeListCapacity(uint32 Bucket)
+    {
+        const uint64 BlockSize = 1ull << (Bucket + BucketShift);
+        return (uint32)FMath::Clamp<uint64>(BucketResourceSize / BlockSize, 16, 64 * 1024);
+    }
+
+    // Free blocks are taken and returned by any thread. Expired blocks are released from any
+    // thread but only the cleanup on the render thread drains them (core/container/threadsafequeue.h).
+    TUniquePtr<TMPMCQueue<FBlockAllocatorPrivateData>> AvailableBlocks[NumBuckets];
+    TMPSCQueue<FBlockAllocatorPrivateData> ExpiredBlocks;
 
-    FThreadSafeQueue<FBlockAllocatorPrivateData> AvailableBlocks[NumBuckets];
-    FThreadSafeQueue<FBlockAllocatorPrivateData> ExpiredBlocks;
+    // Free blocks that did not fit in the bounded lists, NumOverflowBlocks lets TryGetFreeBlock
+    // skip the lock while it is empty.
+    FCriticalSection OverflowCS;
+    TArray<FBlockAllocatorPrivateData> OverflowBlocks[NumBuckets];
+    std::atomic<uint32> NumOverflowBlocks{0};
     TArray<FResource*> SubAllocatedResources;
 };
 
@@ -0,0 +1,282 @@
+
+// Draw sorting and automatic instancing ahead of RHIDrawPrimitive. Mesh passes add one packet per
+// draw from any thread during the frame, Finish sorts them by a 64 bit key, merges neighbours that
+// share pipeline state, material and mesh into one instanced draw, and packs the world transforms
+// of all packets into the instance buffer of the frame in sorted order. Submit then only records
+// a state change where the state actually changes, and one draw per merged run.
+//
+// The sort is FRadixSort::SortParallel (core/algo/radixsort.h) on the job system, the transforms
+// go up through FStreamingUploader (UE_StreamingUploader.h).
+
+struct FDrawSortKey
+{
+    // High to low: layer, pipeline state, material, mesh, depth. Opaque draws sort by state first
+    // and front to back within a state. Translucent draws need back to front, depth moves up
+    // right below the layer and state only breaks ties.
+    static const uint32 DepthBits = 20;
+    static const uint32 MeshBits = 14;
+    static const uint32 MaterialBits = 14;
+    static const uint32 PipelineBits = 14;
+    static const uint32 LayerBits = 2;
+
+    enum class ELayer : uint8
+    {
+        Opaque,
+        Masked,
+        Translucent,
+    };
+
+    static uint64 Make(ELayer Layer, uint32 PipelineIndex, uint32 MaterialIndex, uint32 MeshIndex, float ViewDepth, float MaxDepth)
+    {
+        uint64 Depth = QuantizeDepth(ViewDepth, MaxDepth);
+        uint64 State = ((uint64)(PipelineIndex & Mask(PipelineBits)) << (MaterialBits + MeshBits))
+                     | ((uint64)(MaterialIndex & Mask(MaterialBits)) << MeshBits)
+                     | (uint64)(MeshIndex & Mask(MeshBits));
+
+        uint64 Key = (uint64)Layer << (64 - LayerBits);
+        if (Layer == ELayer::Translucent)
+        {
+            Key |= (Mask(DepthBits) - Depth) << (PipelineBits + MaterialBits + MeshBits);
+            Key |= State;
+        }
+        else
+        {
+            Key |= State << DepthBits;
+            Key |= Depth;
+        }
+        return Key;
+    }
+
+private:
+    static uint64 Mask(uint32 Bits) { return (1ull << Bits) - 1; }
+
+    static uint64 QuantizeDepth(float ViewDepth, float MaxDepth)
+    {
+        const float Depth01 = FMath::Clamp(ViewDepth / MaxDepth, 0.0f, 1.0f);
+        return (uint64)(Depth01 * (float)Mask(DepthBits));
+    }
+};
+
+struct FDrawMesh
+{
+    FRHIBuffer* VertexBuffer;
+    uint32 BaseVertexIndex;
+    uint32 NumPrimitives;
+};
+
+struct FDrawPacket
+{
+    uint64 SortKey;
+    FRHIGraphicsPipelineState* PipelineState;
+    FRHIShader* PixelShader;
+    FRHIUniformBuffer* Material;
+    const FDrawMesh* Mesh;
+    FMatrix LocalToWorld;
+};
+
+// One float4x4 per instance, created with BUF_StructuredBuffer | BUF_VertexBuffer: the vertex
+// factory reads it as the per instance stream, the offset of a run selects its transforms.
+struct FInstanceBuffer
+{
+    FRHIBuffer* Buffer;
+    FResource* Resource;
+    uint32 MaxInstances;
+};
+
+// One instance buffer per frame in flight. The copy of frame N lands on the copy queue while the
+// graphics queue may still draw frames N-1 and N-2 from their buffers, so every frame writes its
+// own. The render thread never runs more than MaxFramesInFlight frames ahead of the GPU, a
+// buffer is only reused once the frame that read it has completed.
+struct FInstanceBufferRing
+{
+    static const uint32 MaxFramesInFlight = 3;
+
+    FInstanceBuffer Buffers[MaxFramesInFlight];
+
+    const FInstanceBuffer& GetFrameBuffer(uint64 FrameNumber) const { return Buffers[FrameNumber % MaxFramesInFlight]; }
+};
+
+class FDrawSortMerge
+{
+public:
+    struct FStats
+    {
+        int32 NumPackets = 0;
+        int32 NumDraws = 0;
+        int32 NumStateChanges = 0;
+    };
+
+    // Packets beyond MaxPackets are a check failure, size it for the densest view.
+    void BeginFrame(int32 MaxPackets)
+    {
+        Packets.SetNumUninitialized(MaxPackets, false);
+        NumPackets.Reset();
+        Runs.Reset();
+    }
+
+    // Any thread, between BeginFrame and Finish.
+    void AddDraw(const FDrawPacket& Packet)
+    {
+        const int32 Index = NumPackets.Increment() - 1;
+        checkf(Index < Packets.Num(), TEXT("More draws than reserved in BeginFrame."));
+        Packets[Index] = Packet;
+    }
+
+    // Render thread, after every pass added its packets. FrameNumber selects the instance buffer
+    // of this frame in InstanceBuffers.
+    void Finish(FStreamingUploader& Uploader, const FInstanceBufferRing& InstanceBuffers, uint64 FrameNumber)
+    {
+        const FInstanceBuffer& InstanceBuffer = InstanceBuffers.GetFrameBuffer(FrameNumber);
+        const int32 Num = NumPackets.GetValue();
+        Stats = FStats();
+        Stats.NumPackets = Num;
+        if (Num == 0)
+        {
+            return;
+        }
+        checkf((uint32)Num <= InstanceBuffer.MaxInstances, TEXT("Instance buffer too small for the frame."));
+
+        Keys.SetNumUninitialized(Num, false);
+        Order.SetNumUninitialized(Num, false);
+        for (int32 Index = 0; Index < Num; Index++)
+        {
+            Keys[Index] = Packets[Index].SortKey;
+            Order[Index] = Index;
+        }
+
+        FRadixSort::SortParallel(Keys.GetData(), Order.GetData(), Num);
+
+        BuildRuns(Num);
+
+        // Instance i of the frame is the packet at sorted position i, a run's instances are
+        // contiguous and start at its first sorted position. The transforms go up in chunks: the
+        // whole frame may not fit the part of the ring that is free, and waiting for it to fit can
+        // wait forever on space other threads hold in allocations they have not enqueued yet.
+        int32 ChunkInstances = FMath::Min(Num, (int32)(Uploader.GetCapacity() / sizeof(FMatrix)));
+        FUploadTicket Ticket;
+        for (int32 First = 0; First < Num; )
+        {
+            const int32 Count = FMath::Min(ChunkInstances, Num - First);
+            FUploadAllocation Allocation = Uploader.TryAlloc(Count * sizeof(FMatrix), 16);
+            if (!Allocation.IsValid() && Count > MinUploadInstances)
+            {
+                // A smaller chunk may fit what is free right now, without waiting for the GPU.
+                ChunkInstances = FMath::Max(Count / 2, MinUploadInstances);
+                continue;
+            }
+            if (!Allocation.IsValid())
+            {
+                // Waits for submitted batches. Still invalid while other threads hold the rest of the
+                // ring in allocations they are writing; Finish keeps none open itself, and owners
+                // enqueue or release theirs right after writing them, so this is short.
+                const double WaitStartTime = FPlatformTime::Seconds();
+                Allocation = Uploader.Alloc(Count * sizeof(FMatrix), 16);
+                while (!Allocation.IsValid())
+                {
+                    checkf(FPlatformTime::Seconds() - WaitStartTime < MaxOpenAllocationWaitSeconds, TEXT("Staging ring held by an upload allocation that is never enqueued or released."));
+                    FPlatformProcess::Yield();
+                    Allocation = Uploader.Alloc(Count * sizeof(FMatrix), 16);
+                }
+            }
+
+            FMatrix* Transforms = (FMatrix*)Allocation.Data;
+            ParallelFor(Count, [this, Transforms, First](int32 Index)
+            {
+                Transforms[Index] = Packets[Order[First + Index]].LocalToWorld;
+            });
+
+            // Batches signal increasing fence values, the ticket of the last chunk covers all.
+            Ticket = Uploader.EnqueueBufferCopy(Allocation, InstanceBuffer.Resource, First * sizeof(FMatrix));
+            First += Count;
+        }
+        Uploader.WaitOnQueue(Ticket, ERHIPipeline::Graphics);
+        InstanceStream = InstanceBuffer.Buffer;
+    }
+
+    void Submit(FRHICommandList& CommandList)
+    {
+        FRHIGraphicsPipelineState* PipelineState = nullptr;
+        FRHIUniformBuffer* Material = nullptr;
+        FRHIShader* PixelShader = nullptr;
+        const FDrawMesh* Mesh = nullptr;
+
+        for (const FDrawRun& Run : Runs)
+        {
+            const FDrawPacket& Packet = Packets[Order[Run.FirstInstance]];
+
+            if (Packet.PipelineState != PipelineState)
+            {
+                PipelineState = Packet.PipelineState;
+                CommandList.SetGraphicsPipelineState(PipelineState);
+                // A new pipeline state drops the shader bindings.
+                Material = nullptr;
+                Stats.NumStateChanges++;
+            }
+            if (Packet.Material != Material || Packet.PixelShader != PixelShader)
+            {
+                Material = Packet.Material;
+                PixelShader = Packet.PixelShader;
+                CommandList.SetShaderUniformBuffer(PixelShader, MaterialBufferIndex, Material);
+                Stats.NumStateChanges++;
+            }
+            if (Packet.Mesh != Mesh)
+            {
+                Mesh = Packet.Mesh;
+                CommandList.SetStreamSource(0, Mesh->VertexBuffer, 0);
+                Stats.NumStateChanges++;
+            }
+
+            CommandList.SetStreamSource(InstanceStreamIndex, InstanceStream, Run.FirstInstance * sizeof(FMatrix));
+            CommandList.DrawPrimitive(Mesh->BaseVertexIndex, Mesh->NumPrimitives, Run.NumInstances);
+        }
+
+        Stats.NumDraws = Runs.Num();
+    }
+
+    const FStats& GetStats() const { return Stats; }
+
+private:
+    struct FDrawRun
+    {
+        int32 FirstInstance;
+        int32 NumInstances;
+    };
+
+    static const uint32 MaterialBufferIndex = 0;
+    static const uint32 InstanceStreamIndex = 1;
+    // Smallest chunk of transforms Finish splits its upload into before it waits for the GPU.
+    static const int32 MinUploadInstances = 256;
+    // Longer than any upload allocation stays open, past it one has leaked.
+    static constexpr double MaxOpenAllocationWaitSeconds = 1.0;
+
+    // Depth only orders draws within a state, so equal state is always adjacent after the sort
+    // for opaque and masked draws. The comparison is on the objects, the key fields are indices
+    // that may alias once they wrap.
+    static bool CanMerge(const FDrawPacket& A, const FDrawPacket& B)
+    {
+        return A.PipelineState == B.PipelineState && A.PixelShader == B.PixelShader && A.Material == B.Material && A.Mesh == B.Mesh;
+    }
+
+    void BuildRuns(int32 Num)
+    {
+        int32 First = 0;
+        for (int32 Index = 1; Index <= Num; Index++)
+        {
+            if (Index == Num || !CanMerge(Packets[Order[First]], Packets[Order[Index]]))
+            {
+                Runs.Add({ First, Index - First });
+                First = Index;
+            }
+        }
+    }
+
+    TArray<FDrawPacket> Packets;
+    FThreadSafeCounter NumPackets;
+
+    TArray<uint64> Keys;
+    TArray<uint32> Order;
+    TArray<FDrawRun> Runs;
+
+    FRHIBuffer* InstanceStream = nullptr;
+    FStats Stats;
+};
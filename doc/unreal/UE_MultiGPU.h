@@ -0,0 +1,562 @@
+
+// Explicit multi-GPU. Every FRHICommandList carries an FRHIGPUMask, the scheduler picks the mask
+// for the frame and routes the list to the device of each GPU in it. Resources are either mirrored
+// on every GPU or owned by one, and data produced on one GPU but consumed on another is moved with
+// cross-adapter copies on the copy queue. The devices are behind IMultiGPUBackend, so the scheduler
+// also runs on N simulated CPU adapters.
+
+#define MAX_NUM_GPUS 8
+
+struct FRHIGPUMask
+{
+public:
+    static FRHIGPUMask FromIndex(uint32 GPUIndex)
+    {
+        check(GPUIndex < MAX_NUM_GPUS);
+        return FRHIGPUMask(1u << GPUIndex);
+    }
+
+    static FRHIGPUMask All(uint32 NumGPUs)
+    {
+        check(NumGPUs > 0 && NumGPUs <= MAX_NUM_GPUS);
+        return FRHIGPUMask((1u << NumGPUs) - 1);
+    }
+
+    static FRHIGPUMask GPU0() { return FRHIGPUMask(1); }
+
+    bool Contains(uint32 GPUIndex) const { return (Mask & (1u << GPUIndex)) != 0; }
+    bool HasSingleIndex() const { return (Mask & (Mask - 1)) == 0; }
+    uint32 GetFirstIndex() const { return FMath::CountTrailingZeros(Mask); }
+    uint32 GetNumActive() const { return FMath::CountBits(Mask); }
+    uint32 GetNative() const { return Mask; }
+
+    bool operator==(const FRHIGPUMask& Other) const { return Mask == Other.Mask; }
+    FRHIGPUMask operator&(const FRHIGPUMask& Other) const { return FRHIGPUMask(Mask & Other.Mask); }
+    FRHIGPUMask operator|(const FRHIGPUMask& Other) const { return FRHIGPUMask(Mask | Other.Mask); }
+
+    // Iterate the GPU indices of the mask, for (uint32 GPUIndex : Mask).
+    struct FIterator
+    {
+        uint32 Remaining;
+
+        uint32 operator*() const { return FMath::CountTrailingZeros(Remaining); }
+        void operator++() { Remaining &= Remaining - 1; }
+        bool operator!=(const FIterator& Other) const { return Remaining != Other.Remaining; }
+    };
+    FIterator begin() const { return { Mask }; }
+    FIterator end() const { return { 0 }; }
+
+private:
+    // Can not be empty.
+    explicit FRHIGPUMask(uint32 InMask) : Mask(InMask) { check(Mask != 0); }
+
+    uint32 Mask;
+};
+
+enum class EMultiGPUMode : uint8
+{
+    // Everything on GPU0.
+    Single,
+    // Frame N renders entirely on GPU N % NumGPUs.
+    AlternateFrame,
+    // Every GPU renders a horizontal band of the same frame.
+    SplitFrame,
+};
+
+enum class EMultiGPUResourcePolicy : uint8
+{
+    // One copy per GPU, writes are broadcast to all of them.
+    Mirrored,
+    // Only exists on the owning GPU, other GPUs receive it through cross-adapter copies.
+    Partitioned,
+};
+
+// Per-GPU instances of one logical resource.
+struct FMultiGPUResource
+{
+    EMultiGPUResourcePolicy Policy;
+    FResourceDesc Desc;
+    FRHIGPUMask GPUMask = FRHIGPUMask::GPU0();
+    // Partitioned resources only write on the owner, other GPUs hold received copies.
+    uint32 OwnerGPUIndex = 0;
+    FResource* PerGPU[MAX_NUM_GPUS] = {};
+
+    FResource* Get(uint32 GPUIndex) const
+    {
+        check(GPUMask.Contains(GPUIndex));
+        return PerGPU[GPUIndex];
+    }
+};
+
+struct FCrossGPUTransfer
+{
+    FMultiGPUResource* Resource;
+    uint32 SrcGPUIndex;
+    uint32 DstGPUIndex;
+    // Region to copy, the full resource when empty. Split frame only moves the band of the source GPU.
+    FIntRect Rect;
+};
+
+// One cross-adapter copy with both instances resolved.
+struct FCrossGPUCopy
+{
+    FResource* Src;
+    FResource* Dst;
+    uint32 DstGPUIndex;
+    FIntRect Rect;
+};
+
+// The devices the scheduler drives. FD3D12MultiGPUBackend for the chosen adapters,
+// FSimulatedMultiGPUBackend for N CPU adapters in tests.
+class IMultiGPUBackend
+{
+public:
+    virtual ~IMultiGPUBackend() {}
+
+    virtual uint32 GetNumGPUs() const = 0;
+
+    // Create the instance of GPUIndex, visible to the other GPUs so it can be the source or
+    // destination of a cross-adapter copy.
+    virtual FResource* CreateResource(const FResourceDesc& Desc, uint32 GPUIndex) = 0;
+
+    // Replay the list on the device of GPUIndex. Recorded resources go through Resolver, a non
+    // empty ScissorRect restricts rasterization to that band of the view.
+    virtual void Replay(const FRHICommandList& CommandList, uint32 GPUIndex, const IRHIResourceResolver& Resolver, const FIntRect& ScissorRect) = 0;
+
+    // Copy on the copy queue of SrcGPUIndex, the graphics queue of every destination waits for
+    // the copies before its next submission.
+    virtual void SubmitTransfers(uint32 SrcGPUIndex, const TArray<FCrossGPUCopy>& Copies) = 0;
+};
+
+class FMultiGPUScheduler
+{
+public:
+    FMultiGPUScheduler(IMultiGPUBackend* InBackend, EMultiGPUMode InMode)
+        : Backend(InBackend)
+        , Mode(InMode)
+        , NumGPUs(InBackend->GetNumGPUs())
+    {
+        if (NumGPUs == 1)
+        {
+            Mode = EMultiGPUMode::Single;
+        }
+        for (uint32 GPUIndex = 0; GPUIndex < MAX_NUM_GPUS; GPUIndex++)
+        {
+            SplitWeights[GPUIndex] = 1.0f;
+        }
+    }
+
+    // Mask for the command lists of the frame.
+    FRHIGPUMask GetFrameMask(uint64 FrameNumber) const
+    {
+        switch (Mode)
+        {
+        case EMultiGPUMode::AlternateFrame:
+            return FRHIGPUMask::FromIndex((uint32)(FrameNumber % NumGPUs));
+        case EMultiGPUMode::SplitFrame:
+            return FRHIGPUMask::All(NumGPUs);
+        default:
+            return FRHIGPUMask::GPU0();
+        }
+    }
+
+    // Band of the view rendered by GPUIndex in split frame mode. Bands are sized by the weights,
+    // which are rebalanced from the GPU times of the previous frame.
+    FIntRect GetViewRect(const FIntRect& ViewRect, uint32 GPUIndex) const
+    {
+        if (Mode != EMultiGPUMode::SplitFrame)
+        {
+            return ViewRect;
+        }
+
+        float TotalWeight = 0.0f;
+        float WeightBefore = 0.0f;
+        for (uint32 Index = 0; Index < NumGPUs; Index++)
+        {
+            if (Index < GPUIndex)
+            {
+                WeightBefore += SplitWeights[Index];
+            }
+            TotalWeight += SplitWeights[Index];
+        }
+
+        const int32 Height = ViewRect.Height();
+        FIntRect Result = ViewRect;
+        Result.Min.Y = ViewRect.Min.Y + FMath::RoundToInt(Height * WeightBefore / TotalWeight);
+        Result.Max.Y = (GPUIndex == NumGPUs - 1) ? ViewRect.Max.Y : ViewRect.Min.Y + FMath::RoundToInt(Height * (WeightBefore + SplitWeights[GPUIndex]) / TotalWeight);
+        return Result;
+    }
+
+    // A band that took longer than average shrinks next frame.
+    void UpdateSplitWeights(const float* GPUFrameTimes)
+    {
+        float AverageTimePerWeight = 0.0f;
+        for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+        {
+            AverageTimePerWeight += GPUFrameTimes[GPUIndex] / SplitWeights[GPUIndex];
+        }
+        AverageTimePerWeight /= NumGPUs;
+
+        for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+        {
+            const float TimePerWeight = GPUFrameTimes[GPUIndex] / SplitWeights[GPUIndex];
+            // Damped so the split does not oscillate.
+            const float Target = SplitWeights[GPUIndex] * AverageTimePerWeight / FMath::Max(TimePerWeight, 1e-3f);
+            SplitWeights[GPUIndex] = FMath::Clamp(FMath::Lerp(SplitWeights[GPUIndex], Target, 0.25f), 0.1f, 10.0f);
+        }
+    }
+
+    // Create the per-GPU instances. Partitioned resources live on OwnerGPUIndex only, the scheduler
+    // owns the result.
+    FMultiGPUResource* CreateResource(const FResourceDesc& Desc, EMultiGPUResourcePolicy Policy, uint32 OwnerGPUIndex = 0)
+    {
+        FMultiGPUResource* Resource = Resources.Add_GetRef(MakeUnique<FMultiGPUResource>()).Get();
+        Resource->Policy = Policy;
+        Resource->Desc = Desc;
+        Resource->OwnerGPUIndex = OwnerGPUIndex;
+        Resource->GPUMask = (Policy == EMultiGPUResourcePolicy::Mirrored) ? FRHIGPUMask::All(NumGPUs) : FRHIGPUMask::FromIndex(OwnerGPUIndex);
+
+        for (uint32 GPUIndex : Resource->GPUMask)
+        {
+            AddInstance(Resource, GPUIndex);
+        }
+        return Resource;
+    }
+
+    // Replay the list on the device of every GPU in its mask. With the linear command stream a
+    // broadcast is just executing the same packets again on another context, the resources it
+    // recorded are swapped for the instances of each GPU. In split frame mode every GPU only
+    // rasterizes its band of ViewRect.
+    void Submit(FRHICommandList& CommandList, const FIntRect& ViewRect = FIntRect())
+    {
+        for (uint32 GPUIndex : CommandList.GetGPUMask())
+        {
+            const FGPUResourceResolver Resolver(*this, GPUIndex);
+            const bool bSplit = Mode == EMultiGPUMode::SplitFrame && !ViewRect.IsEmpty();
+            Backend->Replay(CommandList, GPUIndex, Resolver, bSplit ? GetViewRect(ViewRect, GPUIndex) : FIntRect());
+        }
+        CommandList.Reset();
+    }
+
+    // Data written on SrcGPUIndex that another GPU reads. Queued until EndFrame.
+    void AddTransfer(FMultiGPUResource* Resource, uint32 SrcGPUIndex, uint32 DstGPUIndex, const FIntRect& Rect = FIntRect())
+    {
+        if (SrcGPUIndex == DstGPUIndex)
+        {
+            return;
+        }
+        PendingTransfers.Add({ Resource, SrcGPUIndex, DstGPUIndex, Rect });
+    }
+
+    // Queue the transfers a mode needs at the end of a frame:
+    //  - alternate frame, temporal history has to follow to the GPU of the next frame.
+    //  - split frame, every band is gathered on GPU0 for present.
+    void AddFrameEndTransfers(uint64 FrameNumber, const TArray<FMultiGPUResource*>& TemporalResources, FMultiGPUResource* SceneColor, const FIntRect& ViewRect)
+    {
+        if (Mode == EMultiGPUMode::AlternateFrame)
+        {
+            const uint32 SrcGPUIndex = (uint32)(FrameNumber % NumGPUs);
+            const uint32 DstGPUIndex = (uint32)((FrameNumber + 1) % NumGPUs);
+            for (FMultiGPUResource* Resource : TemporalResources)
+            {
+                AddTransfer(Resource, SrcGPUIndex, DstGPUIndex);
+            }
+        }
+        else if (Mode == EMultiGPUMode::SplitFrame)
+        {
+            for (uint32 GPUIndex = 1; GPUIndex < NumGPUs; GPUIndex++)
+            {
+                AddTransfer(SceneColor, GPUIndex, 0, GetViewRect(ViewRect, GPUIndex));
+            }
+        }
+    }
+
+    // Submit the cross-adapter copies, one batch per source GPU.
+    void FlushTransfers()
+    {
+        if (PendingTransfers.Num() == 0)
+        {
+            return;
+        }
+
+        // Group by source so each source GPU submits once.
+        PendingTransfers.Sort([](const FCrossGPUTransfer& A, const FCrossGPUTransfer& B)
+        {
+            return A.SrcGPUIndex < B.SrcGPUIndex;
+        });
+
+        TArray<FCrossGPUCopy> Copies;
+        int32 Begin = 0;
+        while (Begin < PendingTransfers.Num())
+        {
+            const uint32 SrcGPUIndex = PendingTransfers[Begin].SrcGPUIndex;
+
+            Copies.Reset();
+            int32 End = Begin;
+            for (; End < PendingTransfers.Num() && PendingTransfers[End].SrcGPUIndex == SrcGPUIndex; End++)
+            {
+                const FCrossGPUTransfer& Transfer = PendingTransfers[End];
+                FMultiGPUResource* Resource = Transfer.Resource;
+
+                // A partitioned resource gets an instance on the receiving GPU with its first
+                // transfer there, it is kept for the transfers of later frames.
+                if (!Resource->GPUMask.Contains(Transfer.DstGPUIndex))
+                {
+                    check(Resource->Policy == EMultiGPUResourcePolicy::Partitioned);
+                    AddInstance(Resource, Transfer.DstGPUIndex);
+                }
+
+                Copies.Add({ Resource->Get(Transfer.SrcGPUIndex), Resource->Get(Transfer.DstGPUIndex), Transfer.DstGPUIndex, Transfer.Rect });
+            }
+
+            Backend->SubmitTransfers(SrcGPUIndex, Copies);
+
+            NumTransfersThisFrame += End - Begin;
+            Begin = End;
+        }
+
+        PendingTransfers.Reset();
+    }
+
+    // Submit the transfers queued for the frame and start counting the next one.
+    void EndFrame()
+    {
+        FlushTransfers();
+        NumTransfersLastFrame = NumTransfersThisFrame;
+        NumTransfersThisFrame = 0;
+    }
+
+    // Instance of GPUIndex for a resource recorded into a broadcast list, resources that are not
+    // multi GPU are returned as they are.
+    FResource* ResolveResource(FResource* Resource, uint32 GPUIndex) const
+    {
+        FMultiGPUResource* const* Linked = LinkedResources.Find(Resource);
+        if (Linked == nullptr)
+        {
+            return Resource;
+        }
+        checkf((*Linked)->GPUMask.Contains(GPUIndex), TEXT("Resource is used on a GPU it was never transferred to."));
+        return (*Linked)->PerGPU[GPUIndex];
+    }
+
+    EMultiGPUMode GetMode() const { return Mode; }
+    uint32 GetNumGPUs() const { return NumGPUs; }
+    uint32 GetNumTransfersLastFrame() const { return NumTransfersLastFrame; }
+
+private:
+    class FGPUResourceResolver : public IRHIResourceResolver
+    {
+    public:
+        FGPUResourceResolver(const FMultiGPUScheduler& InScheduler, uint32 InGPUIndex) : Scheduler(InScheduler), GPUIndex(InGPUIndex) {}
+
+        virtual FResource* Resolve(FResource* Resource) const override
+        {
+            return Scheduler.ResolveResource(Resource, GPUIndex);
+        }
+
+    private:
+        const FMultiGPUScheduler& Scheduler;
+        uint32 GPUIndex;
+    };
+
+    void AddInstance(FMultiGPUResource* Resource, uint32 GPUIndex)
+    {
+        FResource* Instance = Backend->CreateResource(Resource->Desc, GPUIndex);
+        Resource->PerGPU[GPUIndex] = Instance;
+        Resource->GPUMask = Resource->GPUMask | FRHIGPUMask::FromIndex(GPUIndex);
+        // Any instance may be the one a list recorded.
+        LinkedResources.Add(Instance, Resource);
+    }
+
+    IMultiGPUBackend* Backend;
+    EMultiGPUMode Mode;
+    uint32 NumGPUs;
+
+    float SplitWeights[MAX_NUM_GPUS];
+
+    TArray<TUniquePtr<FMultiGPUResource>> Resources;
+    TMap<FResource*, FMultiGPUResource*> LinkedResources;
+
+    TArray<FCrossGPUTransfer> PendingTransfers;
+    uint32 NumTransfersThisFrame = 0;
+    uint32 NumTransfersLastFrame = 0;
+};
+
+class FD3D12MultiGPUBackend : public IMultiGPUBackend
+{
+public:
+    explicit FD3D12MultiGPUBackend(FDynamicRHI* InRHI) : RHI(InRHI) {}
+
+    virtual uint32 GetNumGPUs() const override { return RHI->GetNumGPUs(); }
+
+    virtual FResource* CreateResource(const FResourceDesc& Desc, uint32 GPUIndex) override
+    {
+        return RHI->GetRHIDevice(GPUIndex)->CreateResource(Desc, FRHIGPUMask::FromIndex(GPUIndex), FRHIGPUMask::All(GetNumGPUs()));
+    }
+
+    virtual void Replay(const FRHICommandList& CommandList, uint32 GPUIndex, const IRHIResourceResolver& Resolver, const FIntRect& ScissorRect) override
+    {
+        FRHICommandContext& Context = RHI->GetRHIDevice(GPUIndex)->GetDefaultCommandContext();
+        if (!ScissorRect.IsEmpty())
+        {
+            // The viewport stays the full view so the projection is the same on every GPU.
+            Context.RHISetScissorRect(true, ScissorRect.Min.X, ScissorRect.Min.Y, ScissorRect.Max.X, ScissorRect.Max.Y);
+        }
+        FRHICommandListExecutor::Execute(CommandList, Context, &Resolver);
+    }
+
+    virtual void SubmitTransfers(uint32 SrcGPUIndex, const TArray<FCrossGPUCopy>& Copies) override
+    {
+        FCommandListManager& CopyManager = RHI->GetRHIDevice(SrcGPUIndex)->GetCopyCommandListManager();
+        FCommandListHandle CopyList = CopyManager.ObtainCommandList();
+
+        uint32 DstMask = 0;
+        for (const FCrossGPUCopy& Copy : Copies)
+        {
+            if (Copy.Rect.IsEmpty())
+            {
+                CopyList->CopyResource(Copy.Dst->GetResource(), Copy.Src->GetResource());
+            }
+            else
+            {
+                CopyList.CopyTextureRegion(Copy.Dst, Copy.Src, Copy.Rect);
+            }
+            DstMask |= 1u << Copy.DstGPUIndex;
+        }
+
+        const uint64 FenceValue = CopyManager.ExecuteCommandList(CopyList);
+
+        // Shared fence, the destination queues wait on it through their own handle.
+        for (; DstMask != 0; DstMask &= DstMask - 1)
+        {
+            const uint32 DstGPUIndex = FMath::CountTrailingZeros(DstMask);
+            RHI->GetRHIDevice(DstGPUIndex)->GetCommandListManager().WaitForCrossAdapterFence(SrcGPUIndex, CopyManager.GetFence(), FenceValue);
+        }
+    }
+
+private:
+    FDynamicRHI* RHI;
+};
+
+// N CPU adapters for tests. Resources are plain memory, 4 bytes per texel in rows of Desc.Width,
+// transfers copy that memory when they are submitted. Replay goes through the real executor into
+// a context per adapter that records what reached it, and fails on any resource that belongs to
+// another adapter.
+class FSimulatedMultiGPUBackend : public IMultiGPUBackend
+{
+public:
+    static const uint32 BytesPerTexel = 4;
+
+    struct FSimulatedAdapter;
+
+    class FSimulatedContext
+    {
+    public:
+        void RHISetGraphicsPipelineState(FRHIGraphicsPipelineState* PipelineState) {}
+        void RHISetStreamSource(uint32 StreamIndex, FRHIBuffer* VertexBuffer, uint32 Offset) {}
+        void RHISetShaderTexture(FRHIShader* Shader, uint32 TextureIndex, FRHITexture* Texture) {}
+        void RHISetShaderUniformBuffer(FRHIShader* Shader, uint32 BufferIndex, FRHIUniformBuffer* UniformBuffer) {}
+
+        void RHISetScissorRect(bool bEnable, uint32 MinX, uint32 MinY, uint32 MaxX, uint32 MaxY)
+        {
+            ScissorRect = bEnable ? FIntRect(MinX, MinY, MaxX, MaxY) : FIntRect();
+        }
+
+        void RHITransitionResource(FResource* Resource, uint32 Subresource, D3D12_RESOURCE_STATES After)
+        {
+            checkf(Adapter->Memory.Contains(Resource), TEXT("Replayed a resource of another GPU."));
+            Transitions.Add(Resource);
+        }
+
+        void RHIDrawPrimitive(uint32 BaseVertexIndex, uint32 NumPrimitives, uint32 NumInstances) { NumDraws++; }
+        void RHIDispatchComputeShader(uint32 ThreadGroupCountX, uint32 ThreadGroupCountY, uint32 ThreadGroupCountZ) { NumDispatches++; }
+
+        FIntRect ScissorRect;
+        TArray<FResource*> Transitions;
+        uint32 NumDraws = 0;
+        uint32 NumDispatches = 0;
+
+    private:
+        friend class FSimulatedMultiGPUBackend;
+        const FSimulatedAdapter* Adapter = nullptr;
+    };
+
+    struct FSimulatedAdapter
+    {
+        TMap<FResource*, TArray<uint8>> Memory;
+        TMap<FResource*, FResourceDesc> Descs;
+        FSimulatedContext Context;
+        // Copy batches from other GPUs the graphics queue waited on.
+        uint32 NumTransferWaits = 0;
+    };
+
+    explicit FSimulatedMultiGPUBackend(uint32 InNumGPUs)
+    {
+        check(InNumGPUs > 0 && InNumGPUs <= MAX_NUM_GPUS);
+        Adapters.SetNum(InNumGPUs);
+        for (FSimulatedAdapter& Adapter : Adapters)
+        {
+            Adapter.Context.Adapter = &Adapter;
+        }
+    }
+
+    virtual uint32 GetNumGPUs() const override { return Adapters.Num(); }
+
+    virtual FResource* CreateResource(const FResourceDesc& Desc, uint32 GPUIndex) override
+    {
+        // Stand-in resources, only their address is used.
+        FResource* Resource = Resources.Add_GetRef(MakeUnique<FResource>()).Get();
+        FSimulatedAdapter& Adapter = Adapters[GPUIndex];
+        Adapter.Memory.Add(Resource).SetNumZeroed(Desc.Width * Desc.Height * BytesPerTexel);
+        Adapter.Descs.Add(Resource, Desc);
+        return Resource;
+    }
+
+    virtual void Replay(const FRHICommandList& CommandList, uint32 GPUIndex, const IRHIResourceResolver& Resolver, const FIntRect& ScissorRect) override
+    {
+        FSimulatedContext& Context = Adapters[GPUIndex].Context;
+        if (!ScissorRect.IsEmpty())
+        {
+            Context.RHISetScissorRect(true, ScissorRect.Min.X, ScissorRect.Min.Y, ScissorRect.Max.X, ScissorRect.Max.Y);
+        }
+        FRHICommandListExecutor::Execute(CommandList, Context, &Resolver);
+    }
+
+    virtual void SubmitTransfers(uint32 SrcGPUIndex, const TArray<FCrossGPUCopy>& Copies) override
+    {
+        uint32 DstMask = 0;
+        for (const FCrossGPUCopy& Copy : Copies)
+        {
+            const TArray<uint8>& Src = Adapters[SrcGPUIndex].Memory.FindChecked(Copy.Src);
+            FSimulatedAdapter& DstAdapter = Adapters[Copy.DstGPUIndex];
+            TArray<uint8>& Dst = DstAdapter.Memory.FindChecked(Copy.Dst);
+            check(Src.Num() == Dst.Num());
+
+            const FResourceDesc& Desc = DstAdapter.Descs.FindChecked(Copy.Dst);
+            const FIntRect Rect = Copy.Rect.IsEmpty() ? FIntRect(0, 0, (int32)Desc.Width, (int32)Desc.Height) : Copy.Rect;
+            const uint64 RowPitch = (uint64)Desc.Width * BytesPerTexel;
+            for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; Y++)
+            {
+                const uint64 Offset = Y * RowPitch + (uint64)Rect.Min.X * BytesPerTexel;
+                FMemory::Memcpy(Dst.GetData() + Offset, Src.GetData() + Offset, (uint64)Rect.Width() * BytesPerTexel);
+            }
+            DstMask |= 1u << Copy.DstGPUIndex;
+        }
+
+        for (; DstMask != 0; DstMask &= DstMask - 1)
+        {
+            Adapters[FMath::CountTrailingZeros(DstMask)].NumTransferWaits++;
+        }
+        NumTransferBatches++;
+    }
+
+    FSimulatedAdapter& GetAdapter(uint32 GPUIndex) { return Adapters[GPUIndex]; }
+
+    TArray<uint8>& GetMemory(FResource* Resource, uint32 GPUIndex) { return Adapters[GPUIndex].Memory.FindChecked(Resource); }
+
+    uint32 NumTransferBatches = 0;
+
+private:
+    TArray<FSimulatedAdapter> Adapters;
+    TArray<TUniquePtr<FResource>> Resources;
+};
@@ -2,15 +2,201 @@
 
 
 
+// Wall time of each startup phase per adapter, dumped to the log once the RHI is created.
+class FStartupTrace
+{
+public:
+    struct FEvent
+    {
+        const TCHAR* Phase;
+        int32 AdapterIndex;
+        uint32 ThreadId;
+        double StartTime;
+        double EndTime;
+    };
+
+    static FStartupTrace& Get()
+    {
+        static FStartupTrace Instance;
+        return Instance;
+    }
+
+    void Add(const FEvent& Event)
+    {
+        FScopeLock Lock(&CS);
+        Events.Add(Event);
+    }
+
+    void Dump() const
+    {
+        FScopeLock Lock(&CS);
+        for (const FEvent& Event : Events)
+        {
+            UE_LOG(LogRHI, Log, TEXT("Startup %-24s adapter %2d thread %6u %8.2f ms (at %8.2f ms)"),
+                Event.Phase, Event.AdapterIndex, Event.ThreadId,
+                (Event.EndTime - Event.StartTime) * 1000.0, (Event.StartTime - StartTime) * 1000.0);
+        }
+    }
+
+    // Copy of the events so far, for the startup tests.
+    TArray<FEvent> GetEvents() const
+    {
+        FScopeLock Lock(&CS);
+        return Events;
+    }
+
+    // Tests that run the startup more than once start each run from an empty trace.
+    void Reset()
+    {
+        FScopeLock Lock(&CS);
+        Events.Reset();
+        StartTime = FPlatformTime::Seconds();
+    }
+
+    double GetStartTime() const { return StartTime; }
+
+private:
+    FStartupTrace() : StartTime(FPlatformTime::Seconds()) {}
+
+    mutable FCriticalSection CS;
+    TArray<FEvent> Events;
+    double StartTime;
+};
+
+class FStartupTraceScope
+{
+public:
+    FStartupTraceScope(const TCHAR* InPhase, int32 InAdapterIndex = INDEX_NONE)
+        : Phase(InPhase), AdapterIndex(InAdapterIndex), StartTime(FPlatformTime::Seconds())
+    {
+    }
+
+    ~FStartupTraceScope()
+    {
+        FStartupTrace::Get().Add({ Phase, AdapterIndex, FPlatformTLS::GetCurrentThreadId(), StartTime, FPlatformTime::Seconds() });
+    }
+
+private:
+    const TCHAR* Phase;
+    int32 AdapterIndex;
+    double StartTime;
+};
+
+// Higher is better, negative means the adapter can not be used. Feature level dominates, dedicated
+// memory breaks ties between adapters of the same level.
+inline int64 ScoreAdapter(const FAdapterDesc& Desc, D3D_FEATURE_LEVEL MinFeatureLevel)
+{
+    if (Desc.bSoftwareAdapter || Desc.MaxSupportedFeatureLevel < MinFeatureLevel)
+    {
+        return -1;
+    }
+
+    const int64 FeatureLevelScore = (int64)(Desc.MaxSupportedFeatureLevel - MinFeatureLevel + 1) << 40;
+    const int64 MemoryScore = (int64)(Desc.DedicatedVideoMemory >> 20) + (int64)(Desc.SharedSystemMemory >> 24);
+    return FeatureLevelScore + MemoryScore;
+}
+
+// Indices into Descs of the adapters to use, best first. With bAllowMultiGPU every adapter that
+// matches the best one (same vendor and feature level) is chosen too. Empty if none qualifies.
+inline TArray<int32> ChooseAdapters(const TArray<FAdapterDesc>& Descs, D3D_FEATURE_LEVEL MinFeatureLevel, bool bAllowMultiGPU)
+{
+    TArray<TPair<int64, int32>> Scored;
+    for (int32 Index = 0; Index < Descs.Num(); Index++)
+    {
+        const int64 Score = ScoreAdapter(Descs[Index], MinFeatureLevel);
+        if (Score >= 0)
+        {
+            Scored.Add({ Score, Index });
+        }
+    }
+
+    TArray<int32> Chosen;
+    if (Scored.Num() == 0)
+    {
+        return Chosen;
+    }
+
+    Scored.Sort([](const TPair<int64, int32>& A, const TPair<int64, int32>& B) { return A.Key > B.Key; });
+
+    const FAdapterDesc& Best = Descs[Scored[0].Value];
+    for (const TPair<int64, int32>& Entry : Scored)
+    {
+        const FAdapterDesc& Desc = Descs[Entry.Value];
+        if (Entry.Value == Scored[0].Value
+            || (bAllowMultiGPU && Desc.VendorId == Best.VendorId && Desc.MaxSupportedFeatureLevel == Best.MaxSupportedFeatureLevel))
+        {
+            Chosen.Add(Entry.Value);
+        }
+    }
+    return Chosen;
+}
+
+// Root devices, then the devices and queues under them, for all adapters at once.
+inline void InitializeChosenAdapters(TArray<TSharedPtr<FAdapter>>& Adapters)
+{
+    FStartupTraceScope Scope(TEXT("InitializeAdapters"));
+
+    // Global GPU indices, in the order the adapters were chosen, so a device's mask routes
+    // GetRHIDevice(GPUIndex) back to it.
+    uint32 NumGPUs = 0;
+    for (TSharedPtr<FAdapter>& Adapter : Adapters)
+    {
+        Adapter->SetFirstGPUIndex(NumGPUs);
+        NumGPUs += Adapter->GetDesc().NumDeviceNodes;
+    }
+    checkf(NumGPUs <= MAX_NUM_GPUS, TEXT("%u GPUs, at most %u are supported."), NumGPUs, MAX_NUM_GPUS);
+
+    ParallelFor(Adapters.Num(), [&Adapters](int32 Index)
+    {
+        FAdapter& Adapter = *Adapters[Index];
+        {
+            FStartupTraceScope RootScope(TEXT("CreateRootDevice"), Adapter.GetDesc().AdapterIndex);
+            Adapter.Initialize();
+        }
+        Adapter.InitializeDevices();
+    });
+}
+
 FDynamicRHIModule
 {
 private:
-    TArray<TSharePtr<FAdapter>> ChosenAdapters;
+    TArray<TSharedPtr<FAdapter>> ChosenAdapters;
+
+    IAdapterFactory* AdapterFactory;
+
+    // Enumrates all adapters, pick the most suitable one, see ChooseAdapters.
+    void FindAdapter(D3D_FEATURE_LEVEL MinFeatureLevel, bool bAllowMultiGPU)
+    {
+        FStartupTraceScope Scope(TEXT("FindAdapter"));
 
-    // Enumrates all adapters, pick the most suitable one.
-    void FindAdapter();
+        TArray<FAdapterDesc> Descs;
+        {
+            FStartupTraceScope EnumScope(TEXT("EnumerateAdapters"));
+            AdapterFactory->EnumerateAdapters(Descs);
+        }
+
+        const TArray<int32> Chosen = ChooseAdapters(Descs, MinFeatureLevel, bAllowMultiGPU);
+        if (Chosen.Num() == 0)
+        {
+            UE_LOG(LogRHI, Fatal, TEXT("No adapter supports the required feature level."));
+            return;
+        }
+
+        for (int32 Index : Chosen)
+        {
+            ChosenAdapters.Add(AdapterFactory->CreateAdapter(Descs[Index]));
+        }
+    }
+
+    void InitializeAdapters()
+    {
+        InitializeChosenAdapters(ChosenAdapters);
+    }
 
 public:
+    // The factory is DXGI by default, startup tests pass a stub.
+    void SetAdapterFactory(IAdapterFactory* InAdapterFactory) { AdapterFactory = InAdapterFactory; }
+
     FDynamicRHI* CreateRHI(FeatureLevel);
 }
 
@@ -18,12 +204,15 @@ public:
 class FDynamicRHI
 {
 protected:
-    TArray<TSharePtr<FAdapter>> ChosenAdapters;
+    TArray<TSharedPtr<FAdapter>> ChosenAdapters;
 
 public:
     FAdapter& GetAdapter(int Index);
     int GetNumAdapters() const;
+    // Devices of all chosen adapters, GPU indices count them across adapters.
+    uint32 GetNumGPUs() const;
 
+    // The adapter whose [FirstGPUIndex, FirstGPUIndex + NumDeviceNodes) holds GPUIndex, its device of that node.
     FDevice* GetRHIDevice(uint32 6GPUIndex);
 
 public: 
@@ -44,5 +233,7 @@ public:
     RHICreateTransition();
     RHIReleaseTransition();
 
+    // Does not record a barrier, forwards to RHITransitionResource of the context that owns the
+    // command list so the transition can be batched (see UE_ResourceBarrier.h).
     void TransitionResource(CommandList, View, After);
 }
\ No newline at end of file
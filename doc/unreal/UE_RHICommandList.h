@@ -0,0 +1,393 @@
+
+// FRHICommandList does not call into the context while recording. Every command is a POD packet
+// written inline into a linear byte stream, so recording is a bump allocation plus a copy. The
+// stream is translated later by FRHICommandListExecutor, either on the RHI thread or after the
+// command lists recorded in parallel were merged by sort key.
+
+// Packets start 8 byte aligned and never span two pages. The payload follows the header at the
+// alignment of its command, every command holds pointers so that is 8 bytes on 64 bit targets.
+#define RHI_COMMAND_ALIGNMENT 8
+#define RHI_COMMAND_PAGE_SIZE (64 * 1024)
+
+// Pages are recycled through a free list instead of going back to the heap.
+class FRHICommandBufferArena
+{
+public:
+    struct FPage
+    {
+        FPage* Next;
+        uint32 Used;
+        alignas(16) uint8 Data[RHI_COMMAND_PAGE_SIZE];
+    };
+
+    ~FRHICommandBufferArena()
+    {
+        Reset();
+        while (FreePages != nullptr)
+        {
+            FPage* Page = FreePages;
+            FreePages = Page->Next;
+            delete Page;
+        }
+    }
+
+    void* Alloc(uint32 Size)
+    {
+        check(Size <= RHI_COMMAND_PAGE_SIZE);
+
+        if (Tail == nullptr || Tail->Used + Size > RHI_COMMAND_PAGE_SIZE)
+        {
+            FPage* Page = AllocPage();
+            if (Tail == nullptr)
+            {
+                Head = Page;
+            }
+            else
+            {
+                Tail->Next = Page;
+            }
+            Tail = Page;
+        }
+
+        void* Result = Tail->Data + Tail->Used;
+        Tail->Used += Size;
+        return Result;
+    }
+
+    // Return all pages to the free list, keeping them for the next frame.
+    void Reset()
+    {
+        if (Tail != nullptr)
+        {
+            Tail->Next = FreePages;
+            FreePages = Head;
+        }
+        Head = Tail = nullptr;
+    }
+
+    const FPage* GetHead() const { return Head; }
+
+private:
+    FPage* AllocPage()
+    {
+        FPage* Page = FreePages;
+        if (Page != nullptr)
+        {
+            FreePages = Page->Next;
+        }
+        else
+        {
+            Page = new FPage;
+        }
+        Page->Next = nullptr;
+        Page->Used = 0;
+        return Page;
+    }
+
+    FPage* Head = nullptr;
+    FPage* Tail = nullptr;
+    FPage* FreePages = nullptr;
+};
+
+enum class ERHICommandType : uint16
+{
+    SetGraphicsPipelineState,
+    SetStreamSource,
+    SetShaderTexture,
+    SetShaderUniformBuffer,
+    TransitionResource,
+    DrawPrimitive,
+    DispatchComputeShader,
+
+    Num
+};
+
+struct FRHICommandHeader
+{
+    ERHICommandType Type;
+    // Size of header and payload, including the alignment padding.
+    uint16 Size;
+
+    // The payload starts at the first offset past the header aligned for TCommand.
+    template<typename TCommand>
+    static constexpr uint32 GetPayloadOffset()
+    {
+        return (sizeof(FRHICommandHeader) + alignof(TCommand) - 1) & ~(uint32)(alignof(TCommand) - 1);
+    }
+};
+
+struct FRHICommandSetGraphicsPipelineState
+{
+    static const ERHICommandType Type = ERHICommandType::SetGraphicsPipelineState;
+
+    FRHIGraphicsPipelineState* PipelineState;
+};
+
+struct FRHICommandSetStreamSource
+{
+    static const ERHICommandType Type = ERHICommandType::SetStreamSource;
+
+    FRHIBuffer* VertexBuffer;
+    uint32 StreamIndex;
+    uint32 Offset;
+};
+
+struct FRHICommandSetShaderTexture
+{
+    static const ERHICommandType Type = ERHICommandType::SetShaderTexture;
+
+    FRHIShader* Shader;
+    FRHITexture* Texture;
+    uint32 TextureIndex;
+};
+
+struct FRHICommandSetShaderUniformBuffer
+{
+    static const ERHICommandType Type = ERHICommandType::SetShaderUniformBuffer;
+
+    FRHIShader* Shader;
+    FRHIUniformBuffer* UniformBuffer;
+    uint32 BufferIndex;
+};
+
+struct FRHICommandTransitionResource
+{
+    static const ERHICommandType Type = ERHICommandType::TransitionResource;
+
+    FResource* Resource;
+    uint32 Subresource;
+    D3D12_RESOURCE_STATES After;
+};
+
+struct FRHICommandDrawPrimitive
+{
+    static const ERHICommandType Type = ERHICommandType::DrawPrimitive;
+
+    uint32 BaseVertexIndex;
+    uint32 NumPrimitives;
+    uint32 NumInstances;
+};
+
+struct FRHICommandDispatchComputeShader
+{
+    static const ERHICommandType Type = ERHICommandType::DispatchComputeShader;
+
+    uint32 ThreadGroupCountX;
+    uint32 ThreadGroupCountY;
+    uint32 ThreadGroupCountZ;
+};
+
+// Maps the resources recorded in a list to the ones of the device it is replayed on. A list
+// broadcast to several GPUs records the instance of one of them, see FMultiGPUScheduler::Submit.
+class IRHIResourceResolver
+{
+public:
+    virtual ~IRHIResourceResolver() {}
+
+    virtual FResource* Resolve(FResource* Resource) const = 0;
+};
+
+class FRHICommandListExecutor
+{
+public:
+    // Translate one command list. A switch over the packet type, no virtual call per command.
+    // ContextType is FRHICommandContext, or a simulated context with the same RHI methods.
+    template<typename ContextType>
+    static void Execute(const FRHICommandList& CommandList, ContextType& Context, const IRHIResourceResolver* Resolver = nullptr)
+    {
+        for (const FRHICommandBufferArena::FPage* Page = CommandList.GetArena().GetHead(); Page != nullptr; Page = Page->Next)
+        {
+            const uint8* Cursor = Page->Data;
+            const uint8* End = Page->Data + Page->Used;
+
+            while (Cursor < End)
+            {
+                const FRHICommandHeader* Header = (const FRHICommandHeader*)Cursor;
+
+                switch (Header->Type)
+                {
+                case ERHICommandType::SetGraphicsPipelineState:
+                {
+                    const FRHICommandSetGraphicsPipelineState& Cmd = GetPayload<FRHICommandSetGraphicsPipelineState>(Cursor);
+                    Context.RHISetGraphicsPipelineState(Cmd.PipelineState);
+                    break;
+                }
+                case ERHICommandType::SetStreamSource:
+                {
+                    const FRHICommandSetStreamSource& Cmd = GetPayload<FRHICommandSetStreamSource>(Cursor);
+                    Context.RHISetStreamSource(Cmd.StreamIndex, Cmd.VertexBuffer, Cmd.Offset);
+                    break;
+                }
+                case ERHICommandType::SetShaderTexture:
+                {
+                    const FRHICommandSetShaderTexture& Cmd = GetPayload<FRHICommandSetShaderTexture>(Cursor);
+                    Context.RHISetShaderTexture(Cmd.Shader, Cmd.TextureIndex, Cmd.Texture);
+                    break;
+                }
+                case ERHICommandType::SetShaderUniformBuffer:
+                {
+                    const FRHICommandSetShaderUniformBuffer& Cmd = GetPayload<FRHICommandSetShaderUniformBuffer>(Cursor);
+                    Context.RHISetShaderUniformBuffer(Cmd.Shader, Cmd.BufferIndex, Cmd.UniformBuffer);
+                    break;
+                }
+                case ERHICommandType::TransitionResource:
+                {
+                    const FRHICommandTransitionResource& Cmd = GetPayload<FRHICommandTransitionResource>(Cursor);
+                    Context.RHITransitionResource(Resolver != nullptr ? Resolver->Resolve(Cmd.Resource) : Cmd.Resource, Cmd.Subresource, Cmd.After);
+                    break;
+                }
+                case ERHICommandType::DrawPrimitive:
+                {
+                    const FRHICommandDrawPrimitive& Cmd = GetPayload<FRHICommandDrawPrimitive>(Cursor);
+                    Context.RHIDrawPrimitive(Cmd.BaseVertexIndex, Cmd.NumPrimitives, Cmd.NumInstances);
+                    break;
+                }
+                case ERHICommandType::DispatchComputeShader:
+                {
+                    const FRHICommandDispatchComputeShader& Cmd = GetPayload<FRHICommandDispatchComputeShader>(Cursor);
+                    Context.RHIDispatchComputeShader(Cmd.ThreadGroupCountX, Cmd.ThreadGroupCountY, Cmd.ThreadGroupCountZ);
+                    break;
+                }
+                default:
+                    checkNoEntry();
+                }
+
+                Cursor += Header->Size;
+            }
+        }
+    }
+
+private:
+    template<typename TCommand>
+    static const TCommand& GetPayload(const uint8* Cursor)
+    {
+        return *(const TCommand*)(Cursor + FRHICommandHeader::GetPayloadOffset<TCommand>());
+    }
+
+public:
+    // Command lists recorded in parallel are merged by their sort key, the stable sort keeps
+    // submission order between lists with the same key.
+    static void MergeAndExecute(TArray<FRHICommandList*>& CommandLists, FRHICommandContext& Context)
+    {
+        CommandLists.StableSort([](const FRHICommandList& A, const FRHICommandList& B)
+        {
+            return A.GetSortKey() < B.GetSortKey();
+        });
+
+        for (FRHICommandList* CommandList : CommandLists)
+        {
+            Execute(*CommandList, Context);
+            CommandList->Reset();
+        }
+    }
+};
+
+// Translates recorded command lists on a dedicated thread so the game and render threads only
+// pay for recording.
+class FRHIThread : public FRunnable
+{
+public:
+    FRHIThread(FRHICommandContext& InContext)
+        : Context(InContext)
+    {
+        WorkEvent = FPlatformProcess::GetSynchEventFromPool();
+        Thread = FRunnableThread::Create(this, TEXT("RHIThread"));
+    }
+
+    // Called on the render thread, ownership of the command list moves to the RHI thread.
+    void Enqueue(FRHICommandList* CommandList)
+    {
+        PendingCommandLists.Enqueue(CommandList);
+        WorkEvent->Trigger();
+    }
+
+    virtual uint32 Run() override
+    {
+        while (!bStop)
+        {
+            WorkEvent->Wait();
+
+            FRHICommandList* CommandList;
+            while (PendingCommandLists.Dequeue(CommandList))
+            {
+                FRHICommandListExecutor::Execute(*CommandList, Context);
+                CommandList->Reset();
+                CompletedCommandLists.Enqueue(CommandList);
+            }
+        }
+        return 0;
+    }
+
+    virtual void Stop() override
+    {
+        bStop = true;
+        WorkEvent->Trigger();
+    }
+
+    // Executed command lists come back to the render thread for reuse.
+    bool RecycleCommandList(FRHICommandList*& OutCommandList)
+    {
+        return CompletedCommandLists.Dequeue(OutCommandList);
+    }
+
+private:
+    FRHICommandContext& Context;
+    FRunnableThread* Thread;
+    FEvent* WorkEvent;
+    TAtomic<bool> bStop { false };
+
+    TQueue<FRHICommandList*, EQueueMode::Spsc> PendingCommandLists;
+    TQueue<FRHICommandList*, EQueueMode::Spsc> CompletedCommandLists;
+};
+
+// Records one pass over several worker threads. The draw range is split into contiguous pieces,
+// every piece records into its own command list whose sort key keeps the piece order, and
+// MergeAndExecute replays them in that order. Recording touches no shared state, so it scales
+// with the threads of FJobSystem (core/job/jobsystem.h); the lists and their arena pages are kept
+// for the next frame.
+class FParallelCommandListSet
+{
+public:
+    // RecordFunction(FRHICommandList& CommandList, int32 DrawBegin, int32 DrawEnd) is called
+    // concurrently, once per list.
+    template<typename RecordFunctionType>
+    void Record(int32 NumDraws, int32 MinDrawsPerList, uint64 BaseSortKey, RecordFunctionType RecordFunction)
+    {
+        const int32 MaxLists = FJobSystem::Get().GetNumThreads();
+        const int32 NumLists = FMath::Clamp(FMath::DivideAndRoundUp(NumDraws, FMath::Max(MinDrawsPerList, 1)), 1, MaxLists);
+        const int32 DrawsPerList = FMath::DivideAndRoundUp(NumDraws, NumLists);
+
+        const int32 FirstList = CommandLists.Num();
+        for (int32 Index = 0; Index < NumLists; Index++)
+        {
+            if (FirstList + Index >= Pool.Num())
+            {
+                Pool.Add(MakeUnique<FRHICommandList>());
+            }
+            FRHICommandList* CommandList = Pool[FirstList + Index].Get();
+            CommandList->SetSortKey(BaseSortKey + Index);
+            CommandLists.Add(CommandList);
+        }
+
+        FJobSystem::Get().ParallelFor(NumLists, [this, FirstList, DrawsPerList, NumDraws, &RecordFunction](int32 ListBegin, int32 ListEnd)
+        {
+            for (int32 Index = ListBegin; Index < ListEnd; Index++)
+            {
+                const int32 DrawBegin = Index * DrawsPerList;
+                const int32 DrawEnd = FMath::Min(DrawBegin + DrawsPerList, NumDraws);
+                RecordFunction(*CommandLists[FirstList + Index], DrawBegin, DrawEnd);
+            }
+        });
+    }
+
+    // Replays every list recorded since the last submit, in sort key order.
+    void Submit(FRHICommandContext& Context)
+    {
+        FRHICommandListExecutor::MergeAndExecute(CommandLists, Context);
+        CommandLists.Reset();
+    }
+
+private:
+    TArray<TUniquePtr<FRHICommandList>> Pool;
+    TArray<FRHICommandList*> CommandLists;
+};
@@ -0,0 +1,320 @@
+
+// Resource barriers are not recorded when TransitionResource is called. They are queued on the
+// command list, redundant ones are dropped, and the whole batch is submitted with a single
+// ResourceBarrier() right before the next draw or dispatch.
+//
+// Command lists are recorded in parallel and submitted later, so the state a resource is in when a
+// list starts executing is not known while it records. The first transition of a subresource on a
+// list is kept as a pending barrier with only its After state, the command list manager resolves
+// those against the global state of the resource at submit time, in submission order.
+
+#define RESOURCE_BARRIER_ALL_SUBRESOURCES D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES
+
+// Tracked state of a subresource the command list has not transitioned yet.
+#define RESOURCE_STATE_UNKNOWN ((D3D12_RESOURCE_STATES)-1)
+
+struct FResourceBarrierStats
+{
+    // Transitions requested through TransitionResource.
+    uint32 NumRequested = 0;
+    // Dropped because the subresource is already in the target state.
+    uint32 NumSkipped = 0;
+    // First use on the command list, resolved against the global state at submit.
+    uint32 NumPending = 0;
+    // Folded into a pending barrier on the same subresource (A->B, B->C becomes A->C).
+    uint32 NumMerged = 0;
+    // Barriers actually handed to ID3D12GraphicsCommandList::ResourceBarrier.
+    uint32 NumSubmitted = 0;
+    // Number of ResourceBarrier calls.
+    uint32 NumBatches = 0;
+
+    void Accumulate(const FResourceBarrierStats& Other)
+    {
+        NumRequested += Other.NumRequested;
+        NumSkipped   += Other.NumSkipped;
+        NumPending   += Other.NumPending;
+        NumMerged    += Other.NumMerged;
+        NumSubmitted += Other.NumSubmitted;
+        NumBatches   += Other.NumBatches;
+    }
+};
+
+// State of every subresource of one resource. Most resources keep all subresources in the
+// same state, so only a single state is stored until a subresource diverges.
+class FResourceState
+{
+public:
+    void Initialize(uint32 InSubresourceCount, D3D12_RESOURCE_STATES InitialState)
+    {
+        SubresourceCount = InSubresourceCount;
+        ResourceState = InitialState;
+        bAllSubresourcesSame = true;
+        SubresourceStates.Reset();
+    }
+
+    bool AreAllSubresourcesSame() const { return bAllSubresourcesSame; }
+    uint32 GetSubresourceCount() const { return SubresourceCount; }
+
+    D3D12_RESOURCE_STATES GetSubresourceState(uint32 SubresourceIndex) const
+    {
+        if (bAllSubresourcesSame || SubresourceIndex == RESOURCE_BARRIER_ALL_SUBRESOURCES)
+        {
+            return ResourceState;
+        }
+        return SubresourceStates[SubresourceIndex];
+    }
+
+    void SetSubresourceState(uint32 SubresourceIndex, D3D12_RESOURCE_STATES State)
+    {
+        if (SubresourceIndex == RESOURCE_BARRIER_ALL_SUBRESOURCES || SubresourceCount == 1)
+        {
+            ResourceState = State;
+            bAllSubresourcesSame = true;
+            return;
+        }
+
+        // Expand to per-subresource tracking on first divergence.
+        if (bAllSubresourcesSame)
+        {
+            if (State == ResourceState)
+            {
+                return;
+            }
+            SubresourceStates.Init(ResourceState, SubresourceCount);
+            bAllSubresourcesSame = false;
+        }
+        SubresourceStates[SubresourceIndex] = State;
+    }
+
+private:
+    D3D12_RESOURCE_STATES ResourceState;
+    TArray<D3D12_RESOURCE_STATES> SubresourceStates;
+    uint32 SubresourceCount = 1;
+    bool bAllSubresourcesSame = true;
+};
+
+// First transition of a subresource on a command list, the Before state is the global state of
+// the resource when the list is submitted.
+struct FPendingResourceBarrier
+{
+    FResource* Resource;
+    uint32 Subresource;
+    D3D12_RESOURCE_STATES After;
+};
+
+// Accumulates the pending barriers of one command list. FResource::GetResourceState() is the
+// global FResourceState of the resource, only the command list manager reads or writes it, at
+// submit time.
+class FResourceBarrierBatcher
+{
+public:
+    // Queue a transition of Subresource from its tracked state to After. Returns false when the
+    // transition is redundant and nothing was queued.
+    bool AddTransition(FResource* Resource, uint32 Subresource, D3D12_RESOURCE_STATES After)
+    {
+        Stats.NumRequested++;
+
+        FResourceState& State = GetTrackedState(Resource);
+
+        // A whole-resource transition with diverged subresources has to be split per subresource.
+        if (Subresource == RESOURCE_BARRIER_ALL_SUBRESOURCES && !State.AreAllSubresourcesSame())
+        {
+            bool bAdded = false;
+            for (uint32 Index = 0; Index < Resource->GetSubresourceCount(); Index++)
+            {
+                bAdded |= AddTransitionInternal(Resource, State, Index, After);
+            }
+            State.SetSubresourceState(RESOURCE_BARRIER_ALL_SUBRESOURCES, After);
+            return bAdded;
+        }
+
+        const bool bAdded = AddTransitionInternal(Resource, State, Subresource, After);
+        State.SetSubresourceState(Subresource, After);
+        return bAdded;
+    }
+
+    // UAV barriers are never redundant, but two in a row on the same resource are.
+    void AddUAV(FResource* Resource)
+    {
+        Stats.NumRequested++;
+
+        if (Barriers.Num() > 0)
+        {
+            const D3D12_RESOURCE_BARRIER& Last = Barriers.Last();
+            if (Last.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV && Last.UAV.pResource == Resource->GetResource())
+            {
+                Stats.NumMerged++;
+                return;
+            }
+        }
+
+        D3D12_RESOURCE_BARRIER& Barrier = Barriers.AddZeroed_GetRef();
+        Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+        Barrier.UAV.pResource = Resource->GetResource();
+    }
+
+    // Submit every pending barrier in one call. Called before each draw and dispatch.
+    void Flush(ID3D12GraphicsCommandList* CommandList)
+    {
+        if (Barriers.Num() == 0)
+        {
+            return;
+        }
+
+        CommandList->ResourceBarrier(Barriers.Num(), Barriers.GetData());
+
+        Stats.NumSubmitted += Barriers.Num();
+        Stats.NumBatches++;
+        Barriers.Reset();
+    }
+
+    // Called by the command list manager when it submits the closed command list, under its
+    // submission lock so the lists of all threads see the global states in queue order. Appends
+    // the barriers the pending ones need, to be executed on a small list right before this one,
+    // and writes the final tracked states back to the resources.
+    void ResolvePendingBarriers(TArray<D3D12_RESOURCE_BARRIER>& OutBarriers)
+    {
+        for (const FPendingResourceBarrier& Pending : PendingBarriers)
+        {
+            const FResourceState& Global = Pending.Resource->GetResourceState();
+            if (Pending.Subresource == RESOURCE_BARRIER_ALL_SUBRESOURCES && !Global.AreAllSubresourcesSame())
+            {
+                for (uint32 Index = 0; Index < Global.GetSubresourceCount(); Index++)
+                {
+                    AddResolvedBarrier(OutBarriers, Pending.Resource, Index, Global.GetSubresourceState(Index), Pending.After);
+                }
+            }
+            else
+            {
+                AddResolvedBarrier(OutBarriers, Pending.Resource, Pending.Subresource, Global.GetSubresourceState(Pending.Subresource), Pending.After);
+            }
+        }
+
+        for (const TPair<FResource*, FResourceState>& Pair : TrackedStates)
+        {
+            FResourceState& Global = Pair.Key->GetResourceState();
+            const FResourceState& Tracked = Pair.Value;
+            if (Tracked.AreAllSubresourcesSame())
+            {
+                if (Tracked.GetSubresourceState(RESOURCE_BARRIER_ALL_SUBRESOURCES) != RESOURCE_STATE_UNKNOWN)
+                {
+                    Global.SetSubresourceState(RESOURCE_BARRIER_ALL_SUBRESOURCES, Tracked.GetSubresourceState(RESOURCE_BARRIER_ALL_SUBRESOURCES));
+                }
+                continue;
+            }
+            for (uint32 Index = 0; Index < Tracked.GetSubresourceCount(); Index++)
+            {
+                // Subresources the list never touched keep their global state.
+                if (Tracked.GetSubresourceState(Index) != RESOURCE_STATE_UNKNOWN)
+                {
+                    Global.SetSubresourceState(Index, Tracked.GetSubresourceState(Index));
+                }
+            }
+        }
+    }
+
+    // Forget everything, after the command list manager resolved the list.
+    void Reset()
+    {
+        Barriers.Reset();
+        PendingBarriers.Reset();
+        TrackedStates.Reset();
+    }
+
+    uint32 NumPending() const { return Barriers.Num(); }
+
+    const TArray<FPendingResourceBarrier>& GetPendingBarriers() const { return PendingBarriers; }
+
+    const TMap<FResource*, FResourceState>& GetTrackedStates() const { return TrackedStates; }
+
+    const FResourceBarrierStats& GetStats() const { return Stats; }
+    void ResetStats() { Stats = FResourceBarrierStats(); }
+
+private:
+    FResourceState& GetTrackedState(FResource* Resource)
+    {
+        FResourceState* State = TrackedStates.Find(Resource);
+        if (State == nullptr)
+        {
+            // First use on this command list. The global state may still change before this list
+            // runs, so nothing is known until submit.
+            State = &TrackedStates.Add(Resource);
+            State->Initialize(Resource->GetSubresourceCount(), RESOURCE_STATE_UNKNOWN);
+        }
+        return *State;
+    }
+
+    static void AddResolvedBarrier(TArray<D3D12_RESOURCE_BARRIER>& OutBarriers, FResource* Resource, uint32 Subresource, D3D12_RESOURCE_STATES Before, D3D12_RESOURCE_STATES After)
+    {
+        if (Before == After)
+        {
+            return;
+        }
+
+        D3D12_RESOURCE_BARRIER& Barrier = OutBarriers.AddZeroed_GetRef();
+        Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        Barrier.Transition.pResource = Resource->GetResource();
+        Barrier.Transition.Subresource = Subresource;
+        Barrier.Transition.StateBefore = Before;
+        Barrier.Transition.StateAfter = After;
+    }
+
+    bool AddTransitionInternal(FResource* Resource, const FResourceState& State, uint32 Subresource, D3D12_RESOURCE_STATES After)
+    {
+        const D3D12_RESOURCE_STATES Before = State.GetSubresourceState(Subresource);
+
+        if (Before == RESOURCE_STATE_UNKNOWN)
+        {
+            // Only the first transition of a subresource on the list can get here, the ones after
+            // it start from its After state.
+            PendingBarriers.Add({ Resource, Subresource, After });
+            Stats.NumPending++;
+            return true;
+        }
+
+        if (Before == After)
+        {
+            Stats.NumSkipped++;
+            return false;
+        }
+
+        // Fold into a pending barrier on the same subresource, searching back to the last UAV
+        // barrier since barriers can not be reordered across it.
+        for (int32 Index = Barriers.Num() - 1; Index >= 0; Index--)
+        {
+            D3D12_RESOURCE_BARRIER& Pending = Barriers[Index];
+            if (Pending.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+            {
+                break;
+            }
+            if (Pending.Transition.pResource == Resource->GetResource() && Pending.Transition.Subresource == Subresource)
+            {
+                Stats.NumMerged++;
+                if (Pending.Transition.StateBefore == After)
+                {
+                    // A->B followed by B->A cancels out.
+                    Barriers.RemoveAt(Index);
+                }
+                else
+                {
+                    Pending.Transition.StateAfter = After;
+                }
+                return true;
+            }
+        }
+
+        D3D12_RESOURCE_BARRIER& Barrier = Barriers.AddZeroed_GetRef();
+        Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        Barrier.Transition.pResource = Resource->GetResource();
+        Barrier.Transition.Subresource = Subresource;
+        Barrier.Transition.StateBefore = Before;
+        Barrier.Transition.StateAfter = After;
+        return true;
+    }
+
+private:
+    TArray<D3D12_RESOURCE_BARRIER> Barriers;
+    TArray<FPendingResourceBarrier> PendingBarriers;
+    TMap<FResource*, FResourceState> TrackedStates;
+    FResourceBarrierStats Stats;
+};
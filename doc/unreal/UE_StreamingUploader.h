@@ -0,0 +1,599 @@
+
+// Streaming uploads through one persistently mapped staging ring. Callers get a pointer straight
+// into the upload heap and write vertex or texel data there, no intermediate copy. The copies into
+// the destination resources are queued and go to the copy queue of FDevice in one command list per
+// flush, adjacent buffer copies merged. Every flush signals the upload fence, a fence of its own on
+// the copy queue: the frame graph and cross GPU transfers submit to the same queue, so the copy
+// queue's own fence values are not the uploader's to predict. Consumers wait on that value on their
+// own queue, and ring space is only reused once the fence of the batch that read it has passed.
+// When the ring is full the allocating thread waits for the oldest batch, with the lock released.
+
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+static const uint32 UploadTextureRowAlignment = 256;
+static const uint32 UploadTexturePlacementAlignment = 512;
+
+// Ring space handed to a caller. Data stays mapped, write it before the copy is enqueued.
+struct FUploadAllocation
+{
+    uint8* Data = nullptr;
+    uint64 Offset = 0;
+    uint64 Size = 0;
+    // Textures only, bytes between rows in Data.
+    uint32 RowPitch = 0;
+    // Position in the ring, only grows, Offset is Position modulo the ring size.
+    uint64 Position = 0;
+
+    bool IsValid() const { return Data != nullptr; }
+};
+
+// Upload fence value of the batch an upload goes out in.
+struct FUploadTicket
+{
+    uint64 FenceValue = 0;
+};
+
+struct FUploadBufferCopy
+{
+    FResource* Dst;
+    uint64 DstOffset;
+    uint64 SrcOffset;
+    uint64 Size;
+};
+
+struct FUploadTextureCopy
+{
+    FResource* Dst;
+    uint32 Subresource;
+    uint32 DstX;
+    uint32 DstY;
+    uint32 Width;
+    uint32 Height;
+    uint32 BytesPerPixel;
+    uint64 SrcOffset;
+    uint32 SrcRowPitch;
+};
+
+// Where the uploader gets its staging memory and submits its copies. FD3D12UploadBackend for the
+// device, FSimulatedUploadBackend to run the uploader without a GPU.
+class IUploadBackend
+{
+public:
+    virtual ~IUploadBackend() {}
+
+    // Create the staging buffer and map it for the lifetime of the backend.
+    virtual uint8* MapStagingBuffer(uint64 Size) = 0;
+
+    // Record all copies into one command list on the copy queue, then signal the upload fence to
+    // FenceValue. Only the uploader signals that fence, the values are consecutive.
+    virtual void Submit(const TArray<FUploadBufferCopy>& BufferCopies, const TArray<FUploadTextureCopy>& TextureCopies, uint64 FenceValue) = 0;
+
+    // Fence functions are on the upload fence.
+    virtual uint64 GetCompletedFence() = 0;
+    virtual void WaitForFence(uint64 FenceValue) = 0;
+
+    // Make the Consumer queue wait for FenceValue before its next submission.
+    virtual void WaitOnQueue(ERHIPipeline Consumer, uint64 FenceValue) = 0;
+};
+
+class FStreamingUploader
+{
+public:
+    FStreamingUploader(IUploadBackend* InBackend, uint64 InCapacity, int32 InMaxCopiesPerBatch = 1024)
+        : Backend(InBackend)
+        , Capacity(InCapacity)
+        , MaxCopiesPerBatch(InMaxCopiesPerBatch)
+    {
+        checkf(FMath::IsPowerOfTwo(Capacity), TEXT("The staging ring size must be a power of two."));
+        RingData = Backend->MapStagingBuffer(Capacity);
+        check(RingData != nullptr);
+    }
+
+    // Reserve Size bytes of staging memory. Blocks while the ring is full of submitted batches.
+    // Returns an invalid allocation when the space is held by allocations that are not enqueued
+    // yet, it only comes back once their owners enqueue them: retry then, after enqueueing any
+    // allocation of the calling thread. Owners enqueue or release an allocation as soon as it is
+    // written and never hold one across a wait, so such retries are short.
+    FUploadAllocation Alloc(uint64 Size, uint64 Alignment = 16)
+    {
+        FScopeLock Lock(&CS);
+        return AllocLocked(Size, Alignment, true);
+    }
+
+    // Reserve staging memory for a Width x Height region in the copy queue's row layout, see Alloc.
+    FUploadAllocation AllocTexture(uint32 Width, uint32 Height, uint32 BytesPerPixel)
+    {
+        FScopeLock Lock(&CS);
+        return AllocTextureLocked(Width, Height, BytesPerPixel, true);
+    }
+
+    // Never waits, an invalid allocation when the space is not free right now.
+    FUploadAllocation TryAlloc(uint64 Size, uint64 Alignment = 16)
+    {
+        FScopeLock Lock(&CS);
+        return AllocLocked(Size, Alignment, false);
+    }
+
+    FUploadAllocation TryAllocTexture(uint32 Width, uint32 Height, uint32 BytesPerPixel)
+    {
+        FScopeLock Lock(&CS);
+        return AllocTextureLocked(Width, Height, BytesPerPixel, false);
+    }
+
+    // Staging bytes of a texture region including the row padding, what AllocTexture reserves
+    // apart from the placement alignment.
+    static uint64 GetTextureAllocSize(uint32 Width, uint32 Height, uint32 BytesPerPixel)
+    {
+        return Align(Width * BytesPerPixel, UploadTextureRowAlignment) * Height;
+    }
+
+    // Give back an allocation that is not going to be enqueued. The space is reused once the
+    // batches before it retired.
+    void Release(const FUploadAllocation& Allocation)
+    {
+        FScopeLock Lock(&CS);
+        OpenAllocations.RemoveSingle(Allocation.Position);
+    }
+
+    FUploadTicket EnqueueBufferCopy(const FUploadAllocation& Src, FResource* Dst, uint64 DstOffset)
+    {
+        FScopeLock Lock(&CS);
+        PendingBufferCopies.Add({ Dst, DstOffset, Src.Offset, Src.Size });
+        return EnqueuedLocked(Src);
+    }
+
+    FUploadTicket EnqueueTextureCopy(const FUploadAllocation& Src, FResource* Dst, uint32 Subresource, uint32 DstX, uint32 DstY, uint32 Width, uint32 Height, uint32 BytesPerPixel)
+    {
+        check(Src.RowPitch >= Width * BytesPerPixel);
+
+        FScopeLock Lock(&CS);
+        PendingTextureCopies.Add({ Dst, Subresource, DstX, DstY, Width, Height, BytesPerPixel, Src.Offset, Src.RowPitch });
+        return EnqueuedLocked(Src);
+    }
+
+    // Submit everything enqueued so far as one batch. Called once per streaming tick, and by the
+    // uploader itself when a batch gets large or the ring runs out of space. Copies of one batch
+    // are not ordered against each other, their destinations must not overlap.
+    void Flush()
+    {
+        FScopeLock Lock(&CS);
+        FlushLocked();
+    }
+
+    bool IsComplete(const FUploadTicket& Ticket)
+    {
+        return Ticket.FenceValue <= Backend->GetCompletedFence();
+    }
+
+    // GPU side wait, the consumer queue does not read the destination before the copy finished.
+    void WaitOnQueue(const FUploadTicket& Ticket, ERHIPipeline Consumer)
+    {
+        {
+            FScopeLock Lock(&CS);
+            if (Ticket.FenceValue > LastSubmittedFence)
+            {
+                FlushLocked();
+            }
+        }
+        Backend->WaitOnQueue(Consumer, Ticket.FenceValue);
+    }
+
+    // CPU side wait.
+    void Wait(const FUploadTicket& Ticket)
+    {
+        {
+            FScopeLock Lock(&CS);
+            if (Ticket.FenceValue > LastSubmittedFence)
+            {
+                FlushLocked();
+            }
+        }
+        Backend->WaitForFence(Ticket.FenceValue);
+    }
+
+    uint64 GetCapacity() const { return Capacity; }
+    uint64 GetBytesInFlight() const { return Head - Tail; }
+    uint32 GetNumBatches() const { return NumBatches; }
+    uint32 GetNumCopiesMerged() const { return NumCopiesMerged; }
+    uint32 GetNumFullRingWaits() const { return NumFullRingWaits; }
+    uint32 GetNumFailedAllocs() const { return NumFailedAllocs; }
+
+private:
+    // Ring space a submitted batch reads, free once its fence passed.
+    struct FInFlightBatch
+    {
+        uint64 FenceValue;
+        uint64 End;
+    };
+
+    static uint64 Align(uint64 Value, uint64 Alignment)
+    {
+        return (Value + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    FUploadAllocation AllocTextureLocked(uint32 Width, uint32 Height, uint32 BytesPerPixel, bool bWait)
+    {
+        FUploadAllocation Allocation = AllocLocked(GetTextureAllocSize(Width, Height, BytesPerPixel), UploadTexturePlacementAlignment, bWait);
+        Allocation.RowPitch = Allocation.IsValid() ? Align(Width * BytesPerPixel, UploadTextureRowAlignment) : 0;
+        return Allocation;
+    }
+
+    // Head and Tail only grow, the ring position is the value modulo Capacity. Called with CS held,
+    // the wait for the GPU releases it so other threads keep allocating, enqueueing and flushing.
+    FUploadAllocation AllocLocked(uint64 Size, uint64 Alignment, bool bWait)
+    {
+        check(Size <= Capacity);
+
+        RetireBatches(Backend->GetCompletedFence());
+
+        for (;;)
+        {
+            uint64 Position = Align(Head, Alignment);
+            if (Position % Capacity + Size > Capacity)
+            {
+                // Does not fit before the end, skip the tail of the ring.
+                Position = Align(Head, Capacity);
+            }
+
+            if (Position + Size - Tail <= Capacity)
+            {
+                Head = Position + Size;
+                OpenAllocations.Add(Position);
+
+                FUploadAllocation Allocation;
+                Allocation.Data = RingData + Position % Capacity;
+                Allocation.Offset = Position % Capacity;
+                Allocation.Size = Size;
+                Allocation.Position = Position;
+                return Allocation;
+            }
+
+            if (InFlight.Num() == 0)
+            {
+                // Copies that were never submitted hold the ring, send them so their batch frees it.
+                FlushLocked();
+            }
+
+            if (InFlight.Num() == 0)
+            {
+                if (OpenAllocations.Num() == 0)
+                {
+                    // Nothing is live, start over at the beginning of the ring.
+                    Head = Tail = Align(Head, Capacity);
+                    continue;
+                }
+
+                // The space is held by allocations still being written, possibly by the calling
+                // thread itself, waiting here could wait forever.
+                NumFailedAllocs++;
+                return FUploadAllocation();
+            }
+
+            if (!bWait)
+            {
+                return FUploadAllocation();
+            }
+
+            // Back-pressure, wait for the oldest batch to give its space back. Another thread may
+            // retire it first, the fence is read again after the wait.
+            NumFullRingWaits++;
+            const uint64 OldestFence = InFlight[0].FenceValue;
+            {
+                FScopeUnlock Unlock(&CS);
+                Backend->WaitForFence(OldestFence);
+            }
+            RetireBatches(Backend->GetCompletedFence());
+        }
+    }
+
+    FUploadTicket EnqueuedLocked(const FUploadAllocation& Src)
+    {
+        OpenAllocations.RemoveSingle(Src.Position);
+
+        // Batches signal consecutive upload fence values, so the value of the next one is known now.
+        FUploadTicket Ticket;
+        Ticket.FenceValue = LastSubmittedFence + 1;
+
+        if (PendingBufferCopies.Num() + PendingTextureCopies.Num() >= MaxCopiesPerBatch)
+        {
+            FlushLocked();
+        }
+        return Ticket;
+    }
+
+    void FlushLocked()
+    {
+        if (PendingBufferCopies.Num() + PendingTextureCopies.Num() == 0)
+        {
+            return;
+        }
+
+        MergeBufferCopies();
+
+        const uint64 FenceValue = LastSubmittedFence + 1;
+        Backend->Submit(PendingBufferCopies, PendingTextureCopies, FenceValue);
+        LastSubmittedFence = FenceValue;
+
+        // Space of allocations still being written is not covered, a later batch frees it.
+        InFlight.Add({ FenceValue, OpenAllocations.Num() > 0 ? OpenAllocations[0] : Head });
+        NumBatches++;
+
+        PendingBufferCopies.Reset();
+        PendingTextureCopies.Reset();
+    }
+
+    // Streaming usually writes a resource front to back in several allocations that end up next
+    // to each other in the ring, those become a single CopyBufferRegion.
+    void MergeBufferCopies()
+    {
+        if (PendingBufferCopies.Num() < 2)
+        {
+            return;
+        }
+
+        PendingBufferCopies.Sort([](const FUploadBufferCopy& A, const FUploadBufferCopy& B)
+        {
+            return A.Dst != B.Dst ? A.Dst < B.Dst : A.DstOffset < B.DstOffset;
+        });
+
+        int32 Last = 0;
+        for (int32 Index = 1; Index < PendingBufferCopies.Num(); Index++)
+        {
+            FUploadBufferCopy& Prev = PendingBufferCopies[Last];
+            const FUploadBufferCopy& Copy = PendingBufferCopies[Index];
+
+            if (Copy.Dst == Prev.Dst && Copy.DstOffset == Prev.DstOffset + Prev.Size && Copy.SrcOffset == Prev.SrcOffset + Prev.Size)
+            {
+                Prev.Size += Copy.Size;
+                NumCopiesMerged++;
+            }
+            else
+            {
+                PendingBufferCopies[++Last] = Copy;
+            }
+        }
+        PendingBufferCopies.SetNum(Last + 1, false);
+    }
+
+    void RetireBatches(uint64 CompletedFence)
+    {
+        int32 NumRetired = 0;
+        while (NumRetired < InFlight.Num() && InFlight[NumRetired].FenceValue <= CompletedFence)
+        {
+            Tail = InFlight[NumRetired].End;
+            NumRetired++;
+        }
+        InFlight.RemoveAt(0, NumRetired, false);
+    }
+
+    IUploadBackend* Backend;
+    uint8* RingData = nullptr;
+    uint64 Capacity;
+    int32 MaxCopiesPerBatch;
+
+    uint64 Head = 0;
+    uint64 Tail = 0;
+    uint64 LastSubmittedFence = 0;
+
+    TArray<FUploadBufferCopy> PendingBufferCopies;
+    TArray<FUploadTextureCopy> PendingTextureCopies;
+    TArray<FInFlightBatch> InFlight;
+    // Positions of allocations not enqueued yet, ascending.
+    TArray<uint64> OpenAllocations;
+
+    uint32 NumBatches = 0;
+    uint32 NumCopiesMerged = 0;
+    uint32 NumFullRingWaits = 0;
+    uint32 NumFailedAllocs = 0;
+
+    FCriticalSection CS;
+};
+
+class FD3D12UploadBackend : public IUploadBackend
+{
+public:
+    FD3D12UploadBackend(FDynamicRHI* InRHI, FDevice* InDevice, ID3D12Device* D3DDevice) : RHI(InRHI), Device(InDevice)
+    {
+        VERIFYD3D12RESULT(D3DDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(UploadFence.GetInitReference())));
+        FenceEvent = CreateEvent(nullptr, false, false, nullptr);
+    }
+
+    virtual ~FD3D12UploadBackend()
+    {
+        CloseHandle(FenceEvent);
+    }
+
+    virtual uint8* MapStagingBuffer(uint64 Size) override
+    {
+        // Upload heap, mapping it once is allowed and the CPU writes go straight to it.
+        StagingBuffer = RHI->RHICreateStagingBuffer(Size, EStagingBufferUsage::Upload);
+        void* Data = nullptr;
+        VERIFYD3D12RESULT(StagingBuffer->GetResource()->Map(0, nullptr, &Data));
+        return (uint8*)Data;
+    }
+
+    virtual void Submit(const TArray<FUploadBufferCopy>& BufferCopies, const TArray<FUploadTextureCopy>& TextureCopies, uint64 FenceValue) override
+    {
+        FCommandListManager& CopyManager = Device->GetCopyCommandListManager();
+        FCommandListHandle CopyList = CopyManager.ObtainCommandList();
+        ID3D12Resource* Staging = StagingBuffer->GetResource();
+
+        for (const FUploadBufferCopy& Copy : BufferCopies)
+        {
+            CopyList->CopyBufferRegion(Copy.Dst->GetResource(), Copy.DstOffset, Staging, Copy.SrcOffset, Copy.Size);
+        }
+
+        for (const FUploadTextureCopy& Copy : TextureCopies)
+        {
+            D3D12_TEXTURE_COPY_LOCATION Src = {};
+            Src.pResource = Staging;
+            Src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+            Src.PlacedFootprint.Offset = Copy.SrcOffset;
+            Src.PlacedFootprint.Footprint.Format = Copy.Dst->GetDesc().Format;
+            Src.PlacedFootprint.Footprint.Width = Copy.Width;
+            Src.PlacedFootprint.Footprint.Height = Copy.Height;
+            Src.PlacedFootprint.Footprint.Depth = 1;
+            Src.PlacedFootprint.Footprint.RowPitch = Copy.SrcRowPitch;
+
+            D3D12_TEXTURE_COPY_LOCATION Dst = {};
+            Dst.pResource = Copy.Dst->GetResource();
+            Dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            Dst.SubresourceIndex = Copy.Subresource;
+
+            CopyList->CopyTextureRegion(&Dst, Copy.DstX, Copy.DstY, 0, &Src, nullptr);
+        }
+
+        CopyManager.ExecuteCommandList(CopyList);
+        VERIFYD3D12RESULT(CopyManager.GetD3DCommandQueue()->Signal(UploadFence, FenceValue));
+    }
+
+    virtual uint64 GetCompletedFence() override
+    {
+        return UploadFence->GetCompletedValue();
+    }
+
+    // Several threads can wait at once now that the uploader waits without its lock, they take
+    // turns on the one event.
+    virtual void WaitForFence(uint64 FenceValue) override
+    {
+        FScopeLock Lock(&WaitCS);
+        if (UploadFence->GetCompletedValue() < FenceValue)
+        {
+            VERIFYD3D12RESULT(UploadFence->SetEventOnCompletion(FenceValue, FenceEvent));
+            WaitForSingleObject(FenceEvent, INFINITE);
+        }
+    }
+
+    virtual void WaitOnQueue(ERHIPipeline Consumer, uint64 FenceValue) override
+    {
+        FCommandListManager& Manager = Consumer == ERHIPipeline::AsyncCompute ? Device->GetAsyncCommandListManager() : Device->GetCommandListManager();
+        Manager.GetD3DCommandQueue()->Wait(UploadFence, FenceValue);
+    }
+
+private:
+    FDynamicRHI* RHI;
+    FDevice* Device;
+    FStagingBufferRHIRef StagingBuffer;
+
+    // Signalled by the uploader's batches only.
+    TRefCountPtr<ID3D12Fence> UploadFence;
+    HANDLE FenceEvent;
+    FCriticalSection WaitCS;
+};
+
+// CPU stand-in for the copy queue. Batches stay queued until the test advances the simulated GPU,
+// the copies are only done then, so ring space reused before its batch finished shows up as wrong
+// data in the destination.
+class FSimulatedUploadBackend : public IUploadBackend
+{
+public:
+    // Destination memory of a simulated resource, textures are linear with RowPitch.
+    struct FSimulatedResource
+    {
+        TArray<uint8> Data;
+        uint32 RowPitch = 0;
+    };
+
+    FSimulatedResource& AddResource(FResource* Resource, uint32 Subresource, uint64 Size, uint32 RowPitch = 0)
+    {
+        FSimulatedResource& Simulated = Resources.FindOrAdd(MakeTuple(Resource, Subresource));
+        Simulated.Data.SetNumZeroed(Size);
+        Simulated.RowPitch = RowPitch;
+        return Simulated;
+    }
+
+    virtual uint8* MapStagingBuffer(uint64 Size) override
+    {
+        Staging.SetNumZeroed(Size);
+        return Staging.GetData();
+    }
+
+    virtual void Submit(const TArray<FUploadBufferCopy>& BufferCopies, const TArray<FUploadTextureCopy>& TextureCopies, uint64 FenceValue) override
+    {
+        check(FenceValue == SubmittedFence + 1);
+
+        FBatch& Batch = Queued.AddDefaulted_GetRef();
+        Batch.BufferCopies = BufferCopies;
+        Batch.TextureCopies = TextureCopies;
+        Batch.FenceValue = SubmittedFence = FenceValue;
+
+        NumSubmits++;
+        NumCopies += BufferCopies.Num() + TextureCopies.Num();
+    }
+
+    virtual uint64 GetCompletedFence() override { return CompletedFence; }
+
+    // The simulated GPU only makes progress when someone waits on it.
+    virtual void WaitForFence(uint64 FenceValue) override
+    {
+        check(FenceValue <= SubmittedFence);
+        while (CompletedFence < FenceValue)
+        {
+            ExecuteNextBatch();
+        }
+    }
+
+    virtual void WaitOnQueue(ERHIPipeline Consumer, uint64 FenceValue) override
+    {
+        QueueWaits.Add({ Consumer, FenceValue });
+    }
+
+    // Run up to NumBatches queued batches.
+    void Advance(int32 NumBatches = MAX_int32)
+    {
+        for (; NumBatches > 0 && Queued.Num() > 0; NumBatches--)
+        {
+            ExecuteNextBatch();
+        }
+    }
+
+    const FSimulatedResource* FindResource(FResource* Resource, uint32 Subresource = 0) const
+    {
+        return Resources.Find(MakeTuple(Resource, Subresource));
+    }
+
+    uint32 NumSubmits = 0;
+    uint32 NumCopies = 0;
+    TArray<FCrossQueueWait> QueueWaits;
+
+private:
+    struct FBatch
+    {
+        TArray<FUploadBufferCopy> BufferCopies;
+        TArray<FUploadTextureCopy> TextureCopies;
+        uint64 FenceValue;
+    };
+
+    void ExecuteNextBatch()
+    {
+        check(Queued.Num() > 0);
+        const FBatch& Batch = Queued[0];
+
+        for (const FUploadBufferCopy& Copy : Batch.BufferCopies)
+        {
+            FSimulatedResource& Dst = Resources.FindChecked(MakeTuple(Copy.Dst, 0u));
+            check(Copy.DstOffset + Copy.Size <= (uint64)Dst.Data.Num());
+            FMemory::Memcpy(Dst.Data.GetData() + Copy.DstOffset, Staging.GetData() + Copy.SrcOffset, Copy.Size);
+        }
+
+        for (const FUploadTextureCopy& Copy : Batch.TextureCopies)
+        {
+            FSimulatedResource& Dst = Resources.FindChecked(MakeTuple(Copy.Dst, Copy.Subresource));
+            const uint32 RowSize = Copy.Width * Copy.BytesPerPixel;
+            for (uint32 Row = 0; Row < Copy.Height; Row++)
+            {
+                const uint64 DstOffset = (uint64)(Copy.DstY + Row) * Dst.RowPitch + Copy.DstX * Copy.BytesPerPixel;
+                check(DstOffset + RowSize <= (uint64)Dst.Data.Num());
+                FMemory::Memcpy(Dst.Data.GetData() + DstOffset, Staging.GetData() + Copy.SrcOffset + (uint64)Row * Copy.SrcRowPitch, RowSize);
+            }
+        }
+
+        CompletedFence = Batch.FenceValue;
+        Queued.RemoveAt(0);
+    }
+
+    TArray<uint8> Staging;
+    TMap<TTuple<FResource*, uint32>, FSimulatedResource> Resources;
+    TArray<FBatch> Queued;
+    uint64 SubmittedFence = 0;
+    uint64 CompletedFence = 0;
+};
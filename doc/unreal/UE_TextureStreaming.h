@@ -0,0 +1,588 @@
+
+// Mip streaming for textures that do not fit in memory all at once. The render thread only
+// publishes the view, everything else runs on the texture streaming thread: per texture screen
+// sizes from one batched distance pass, a priority queue of mip loads, async reads straight into
+// the staging ring of FStreamingUploader (UE_StreamingUploader.h), and the copy of each mip on the
+// copy queue. Residency is kept within a budget by evicting the resident mips with the lowest
+// priority, a load only evicts mips that are worth less than itself.
+//
+// Mips load one at a time from the smallest resident mip upwards, so the mips of a texture in
+// memory are always the tail [FirstResidentMip, NumMips).
+
+struct FStreamingMip
+{
+    uint64 FileOffset;
+    uint32 Width;
+    uint32 Height;
+    uint64 Size;
+};
+
+struct FStreamingTexture
+{
+    FResource* Resource = nullptr;
+    FStreamingFile* File = nullptr;
+    // Index 0 is the largest mip.
+    TArray<FStreamingMip> Mips;
+    uint32 BytesPerPixel = 4;
+    float Radius = 0.0f;
+
+    int32 FirstResidentMip = 0;
+    int32 WantedFirstMip = 0;
+    // Projected size in pixels, a mip is needed while it is not larger than this.
+    float ScreenSize = 0.0f;
+    bool bLoading = false;
+
+    // Mips that are always resident, never evicted.
+    int32 NumTailMips = 1;
+
+    int32 GetNumMips() const { return Mips.Num(); }
+
+    // Above 1 a mip adds detail that is visible on screen.
+    float GetMipPriority(int32 MipIndex) const { return ScreenSize / (float)Mips[MipIndex].Width; }
+
+    bool CanEvict() const { return !bLoading && FirstResidentMip < GetNumMips() - NumTailMips; }
+};
+
+// One read into mapped memory. Rows are RowSize bytes in the file and DestPitch apart in Dest.
+struct FStreamingRead
+{
+    FStreamingFile* File;
+    uint64 Offset;
+    uint32 RowSize;
+    uint32 NumRows;
+    uint8* Dest;
+    uint32 DestPitch;
+    uint64 UserData;
+};
+
+class IStreamingFileReader
+{
+public:
+    virtual ~IStreamingFileReader() {}
+
+    virtual void Submit(const FStreamingRead& Read) = 0;
+
+    // Append the UserData of finished reads, never blocks.
+    virtual void PollCompleted(TArray<uint64>& OutUserData) = 0;
+};
+
+#if PLATFORM_LINUX
+// Reads through io_uring, one SQE per contiguous span. Staging rows are padded to the copy pitch,
+// so a mip whose rows are narrower than the pitch needs a read per row.
+class FIoUringFileReader : public IStreamingFileReader
+{
+public:
+    explicit FIoUringFileReader(uint32 QueueDepth = 256)
+    {
+        verify(io_uring_queue_init(QueueDepth, &Ring, 0) == 0);
+    }
+
+    ~FIoUringFileReader()
+    {
+        io_uring_queue_exit(&Ring);
+    }
+
+    virtual void Submit(const FStreamingRead& Read) override
+    {
+        const bool bContiguous = Read.RowSize == Read.DestPitch;
+        const uint32 NumSpans = bContiguous ? 1 : Read.NumRows;
+        RemainingSpans.Add(Read.UserData, NumSpans);
+
+        for (uint32 Span = 0; Span < NumSpans; Span++)
+        {
+            io_uring_sqe* Sqe = io_uring_get_sqe(&Ring);
+            while (Sqe == nullptr)
+            {
+                // Submission queue full, hand what we have to the kernel and retry.
+                io_uring_submit(&Ring);
+                Sqe = io_uring_get_sqe(&Ring);
+            }
+
+            const uint32 Size = bContiguous ? Read.RowSize * Read.NumRows : Read.RowSize;
+            io_uring_prep_read(Sqe, Read.File->GetHandle(), Read.Dest + (uint64)Span * Read.DestPitch, Size, Read.Offset + (uint64)Span * Read.RowSize);
+            io_uring_sqe_set_data64(Sqe, Read.UserData);
+        }
+        io_uring_submit(&Ring);
+    }
+
+    virtual void PollCompleted(TArray<uint64>& OutUserData) override
+    {
+        io_uring_cqe* Cqe = nullptr;
+        while (io_uring_peek_cqe(&Ring, &Cqe) == 0)
+        {
+            const uint64 UserData = io_uring_cqe_get_data64(Cqe);
+            checkf(Cqe->res >= 0, TEXT("Texture streaming read failed: %d"), Cqe->res);
+            io_uring_cqe_seen(&Ring, Cqe);
+
+            uint32& Remaining = RemainingSpans.FindChecked(UserData);
+            if (--Remaining == 0)
+            {
+                RemainingSpans.Remove(UserData);
+                OutUserData.Add(UserData);
+            }
+        }
+    }
+
+private:
+    io_uring Ring;
+    TMap<uint64, uint32> RemainingSpans;
+};
+#endif
+
+// Maps the whole file once. The copy out of the mapping takes the page faults, on the streaming
+// thread, so it is still off the render thread but not asynchronous to the streaming thread.
+class FMappedFileReader : public IStreamingFileReader
+{
+public:
+    virtual void Submit(const FStreamingRead& Read) override
+    {
+        IMappedFileHandle*& Mapping = Mappings.FindOrAdd(Read.File);
+        if (Mapping == nullptr)
+        {
+            Mapping = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(Read.File->GetPath());
+            check(Mapping != nullptr);
+        }
+
+        TUniquePtr<IMappedFileRegion> Region(Mapping->MapRegion(Read.Offset, (int64)Read.RowSize * Read.NumRows));
+        for (uint32 Row = 0; Row < Read.NumRows; Row++)
+        {
+            FMemory::Memcpy(Read.Dest + (uint64)Row * Read.DestPitch, Region->GetMappedPtr() + (uint64)Row * Read.RowSize, Read.RowSize);
+        }
+        Completed.Add(Read.UserData);
+    }
+
+    virtual void PollCompleted(TArray<uint64>& OutUserData) override
+    {
+        OutUserData.Append(Completed);
+        Completed.Reset();
+    }
+
+private:
+    TMap<FStreamingFile*, IMappedFileHandle*> Mappings;
+    TArray<uint64> Completed;
+};
+
+// Local file stand-in for tests, reads synchronously on Submit and reports on the next poll.
+class FLocalFileReader : public IStreamingFileReader
+{
+public:
+    virtual void Submit(const FStreamingRead& Read) override
+    {
+        FILE* File = fopen(TCHAR_TO_UTF8(Read.File->GetPath()), "rb");
+        check(File != nullptr);
+        fseek(File, (long)Read.Offset, SEEK_SET);
+        for (uint32 Row = 0; Row < Read.NumRows; Row++)
+        {
+            verify(fread(Read.Dest + (uint64)Row * Read.DestPitch, 1, Read.RowSize, File) == Read.RowSize);
+        }
+        fclose(File);
+        Completed.Add(Read.UserData);
+    }
+
+    virtual void PollCompleted(TArray<uint64>& OutUserData) override
+    {
+        OutUserData.Append(Completed);
+        Completed.Reset();
+    }
+
+private:
+    TArray<uint64> Completed;
+};
+
+// Which mips of a texture the GPU may sample. Reserved resources on D3D12, a mip level gets heap
+// memory mapped before its copy and the SRV MinLOD clamp moves once it is in place; eviction
+// raises the clamp first and releases the memory once the frames that may still sample it retired.
+class ITextureResidency
+{
+public:
+    virtual ~ITextureResidency() {}
+
+    virtual void MapMip(FStreamingTexture& Texture, int32 MipIndex) = 0;
+    virtual void SetFirstResidentMip(FStreamingTexture& Texture, int32 MipIndex) = 0;
+    virtual void EvictMip(FStreamingTexture& Texture, int32 MipIndex) = 0;
+};
+
+struct FTextureStreamingView
+{
+    FVector Origin;
+    // Viewport height over tan(FOV / 2), turns radius over distance into pixels.
+    float ScreenScale;
+};
+
+class FTextureStreamingManager
+{
+public:
+    // InMaxStagingBytes caps the staging ring space taken by loads in flight, 0 for half the ring.
+    // The ring is shared with other uploads, and every load holds its space from the read until
+    // its copy finished.
+    FTextureStreamingManager(FStreamingUploader* InUploader, IStreamingFileReader* InReader, ITextureResidency* InResidency, uint64 InBudget, uint64 InMaxStagingBytes = 0)
+        : Uploader(InUploader)
+        , Reader(InReader)
+        , Residency(InResidency)
+        , Budget(InBudget)
+        , MaxStagingBytes(InMaxStagingBytes != 0 ? InMaxStagingBytes : InUploader->GetCapacity() / 2)
+    {
+    }
+
+    // Textures start with only their tail mips resident.
+    int32 AddTexture(const FStreamingTexture& Texture, const FVector& Center)
+    {
+        const int32 Index = Textures.Add(Texture);
+        FStreamingTexture& Added = Textures[Index];
+        Added.FirstResidentMip = Added.GetNumMips() - Added.NumTailMips;
+        Added.WantedFirstMip = Added.FirstResidentMip;
+
+        for (int32 Mip = Added.FirstResidentMip; Mip < Added.GetNumMips(); Mip++)
+        {
+            ResidentBytes += Added.Mips[Mip].Size;
+        }
+
+        CenterX.Add(Center.X);
+        CenterY.Add(Center.Y);
+        CenterZ.Add(Center.Z);
+        return Index;
+    }
+
+    // Render thread, a copy under a short lock. Nothing on the render thread waits for IO or
+    // the copy queue.
+    void SetView(const FTextureStreamingView& InView)
+    {
+        FScopeLock Lock(&ViewCS);
+        View = InView;
+    }
+
+    // Streaming thread, once per streaming tick.
+    void Tick()
+    {
+        FTextureStreamingView CurrentView;
+        {
+            FScopeLock Lock(&ViewCS);
+            CurrentView = View;
+        }
+
+        UpdatePriorities(CurrentView);
+        CompleteReads();
+        CompleteUploads();
+        IssueLoads();
+
+        // All copies of the tick go out in one batch.
+        Uploader->Flush();
+    }
+
+    uint64 GetResidentBytes() const { return ResidentBytes; }
+    uint64 GetBudget() const { return Budget; }
+    uint32 GetNumEvicted() const { return NumEvicted; }
+    uint32 GetNumLoaded() const { return NumLoaded; }
+    uint64 GetStagingBytesInFlight() const { return StagingBytesInFlight; }
+    const FStreamingTexture& GetTexture(int32 Index) const { return Textures[Index]; }
+
+private:
+    struct FMipRequest
+    {
+        int32 TextureIndex;
+        int32 MipIndex;
+        float Priority;
+    };
+
+    struct FPendingLoad
+    {
+        int32 TextureIndex;
+        int32 MipIndex;
+        FUploadAllocation Allocation;
+        FUploadTicket Ticket;
+    };
+
+    void UpdatePriorities(const FTextureStreamingView& CurrentView)
+    {
+        const int32 Num = Textures.Num();
+        DistanceSquared.SetNumUninitialized(Num, false);
+
+        // |C - V|^2 for every texture in one pass.
+        const FVectorExprBatch Centers = FVectorExpr::Batch(CenterX.GetData(), CenterY.GetData(), CenterZ.GetData());
+        const FVectorExprConstant ViewOrigin = FVectorExpr::Constant(CurrentView.Origin);
+        FVectorExpr::Evaluate(DistanceSquared.GetData(), Num, FVectorExpr::Dot(Centers - ViewOrigin, Centers - ViewOrigin));
+
+        Requests.Reset();
+        for (int32 Index = 0; Index < Num; Index++)
+        {
+            FStreamingTexture& Texture = Textures[Index];
+            Texture.ScreenSize = Texture.Radius * CurrentView.ScreenScale * FMath::InvSqrt(FMath::Max(DistanceSquared[Index], 1.0f));
+
+            // Largest mip not wider than the texture covers on screen.
+            const float Ratio = (float)Texture.Mips[0].Width / FMath::Max(Texture.ScreenSize, 1.0f);
+            const int32 MaxFirstMip = Texture.GetNumMips() - Texture.NumTailMips;
+            Texture.WantedFirstMip = FMath::Clamp(FMath::FloorToInt(FMath::Log2(FMath::Max(Ratio, 1.0f))), 0, MaxFirstMip);
+
+            if (!Texture.bLoading && Texture.FirstResidentMip > Texture.WantedFirstMip)
+            {
+                const int32 MipIndex = Texture.FirstResidentMip - 1;
+                Requests.HeapPush({ Index, MipIndex, Texture.GetMipPriority(MipIndex) }, FHigherPriority());
+            }
+        }
+    }
+
+    void IssueLoads()
+    {
+        TArray<FMipRequest> Evictable;
+        bool bEvictableBuilt = false;
+
+        while (Requests.Num() > 0 && PendingLoads.Num() < MaxPendingLoads)
+        {
+            FMipRequest Request;
+            Requests.HeapPop(Request, FHigherPriority(), false);
+
+            FStreamingTexture& Texture = Textures[Request.TextureIndex];
+            const FStreamingMip& Mip = Texture.Mips[Request.MipIndex];
+
+            // Reads fill their staging space before any of it is copied, so loads are limited by
+            // the space they hold too. A single mip above the limit still goes when nothing else
+            // is in flight.
+            const uint64 StagingSize = FStreamingUploader::GetTextureAllocSize(Mip.Width, Mip.Height, Texture.BytesPerPixel);
+            if (StagingBytesInFlight > 0 && StagingBytesInFlight + StagingSize > MaxStagingBytes)
+            {
+                break;
+            }
+
+            // Never waits, a full ring ends the round and the request comes back next tick.
+            FUploadAllocation Allocation = Uploader->TryAllocTexture(Mip.Width, Mip.Height, Texture.BytesPerPixel);
+            if (!Allocation.IsValid())
+            {
+                break;
+            }
+
+            if (ResidentBytes + Mip.Size > Budget)
+            {
+                if (!bEvictableBuilt)
+                {
+                    BuildEvictable(Evictable);
+                    bEvictableBuilt = true;
+                }
+                if (!EvictFor(Evictable, Request, Mip.Size))
+                {
+                    // Everything left in memory is worth more than the best request, so is
+                    // everything after it in the queue.
+                    Uploader->Release(Allocation);
+                    break;
+                }
+            }
+
+            StartLoad(Request, Allocation);
+        }
+    }
+
+    // Lowest priority on top, one entry per texture for its largest resident mip.
+    void BuildEvictable(TArray<FMipRequest>& Evictable)
+    {
+        Evictable.Reset();
+        for (int32 Index = 0; Index < Textures.Num(); Index++)
+        {
+            const FStreamingTexture& Texture = Textures[Index];
+            if (Texture.CanEvict())
+            {
+                Evictable.HeapPush({ Index, Texture.FirstResidentMip, Texture.GetMipPriority(Texture.FirstResidentMip) }, FLowerPriority());
+            }
+        }
+    }
+
+    // Evict lower priority mips until Size more bytes fit. Nothing is evicted when that is not
+    // possible, a half made room would only be streamed back in.
+    bool EvictFor(TArray<FMipRequest>& Evictable, const FMipRequest& Request, uint64 Size)
+    {
+        TArray<FMipRequest, TInlineAllocator<16>> Victims;
+        uint64 Freed = 0;
+
+        while (ResidentBytes - Freed + Size > Budget)
+        {
+            // Entries of textures that started loading or already lost this mip are stale.
+            while (Evictable.Num() > 0 && !IsVictim(Evictable.HeapTop(), Request, Victims))
+            {
+                Evictable.HeapPopDiscard(FLowerPriority(), false);
+            }
+
+            if (Evictable.Num() == 0 || Evictable.HeapTop().Priority >= Request.Priority)
+            {
+                for (const FMipRequest& Victim : Victims)
+                {
+                    Evictable.HeapPush(Victim, FLowerPriority());
+                }
+                return false;
+            }
+
+            FMipRequest& Victim = Victims.AddDefaulted_GetRef();
+            Evictable.HeapPop(Victim, FLowerPriority(), false);
+            Freed += Textures[Victim.TextureIndex].Mips[Victim.MipIndex].Size;
+
+            // The next mip of the same texture only goes after this one.
+            const FStreamingTexture& Texture = Textures[Victim.TextureIndex];
+            if (Victim.MipIndex + 1 < Texture.GetNumMips() - Texture.NumTailMips)
+            {
+                Evictable.HeapPush({ Victim.TextureIndex, Victim.MipIndex + 1, Texture.GetMipPriority(Victim.MipIndex + 1) }, FLowerPriority());
+            }
+        }
+
+        for (const FMipRequest& Victim : Victims)
+        {
+            FStreamingTexture& Texture = Textures[Victim.TextureIndex];
+            Residency->EvictMip(Texture, Victim.MipIndex);
+            Texture.FirstResidentMip = Victim.MipIndex + 1;
+            ResidentBytes -= Texture.Mips[Victim.MipIndex].Size;
+            NumEvicted++;
+        }
+        return true;
+    }
+
+    // A texture's largest resident mip, or the next one of a texture already picked this round.
+    template<typename VictimArrayType>
+    bool IsVictim(const FMipRequest& Entry, const FMipRequest& Request, const VictimArrayType& Victims) const
+    {
+        const FStreamingTexture& Texture = Textures[Entry.TextureIndex];
+        if (Entry.TextureIndex == Request.TextureIndex || Texture.bLoading)
+        {
+            return false;
+        }
+
+        bool bPicked = false;
+        bool bPreviousPicked = false;
+        for (const FMipRequest& Victim : Victims)
+        {
+            if (Victim.TextureIndex == Entry.TextureIndex)
+            {
+                bPicked |= Victim.MipIndex == Entry.MipIndex;
+                bPreviousPicked |= Victim.MipIndex == Entry.MipIndex - 1;
+            }
+        }
+        return !bPicked && (Entry.MipIndex == Texture.FirstResidentMip || bPreviousPicked);
+    }
+
+    void StartLoad(const FMipRequest& Request, const FUploadAllocation& Allocation)
+    {
+        FStreamingTexture& Texture = Textures[Request.TextureIndex];
+        const FStreamingMip& Mip = Texture.Mips[Request.MipIndex];
+
+        // Counted from the start, the budget covers loads in flight.
+        Residency->MapMip(Texture, Request.MipIndex);
+        ResidentBytes += Mip.Size;
+        Texture.bLoading = true;
+
+        FPendingLoad Load;
+        Load.TextureIndex = Request.TextureIndex;
+        Load.MipIndex = Request.MipIndex;
+        Load.Allocation = Allocation;
+        StagingBytesInFlight += Allocation.Size;
+
+        const uint64 LoadId = NextLoadId++;
+        PendingLoads.Add(LoadId, Load);
+
+        FStreamingRead Read;
+        Read.File = Texture.File;
+        Read.Offset = Mip.FileOffset;
+        Read.RowSize = Mip.Width * Texture.BytesPerPixel;
+        Read.NumRows = Mip.Height;
+        Read.Dest = Load.Allocation.Data;
+        Read.DestPitch = Load.Allocation.RowPitch;
+        Read.UserData = LoadId;
+        Reader->Submit(Read);
+    }
+
+    void CompleteReads()
+    {
+        CompletedReads.Reset();
+        Reader->PollCompleted(CompletedReads);
+
+        for (uint64 LoadId : CompletedReads)
+        {
+            FPendingLoad& Load = PendingLoads.FindChecked(LoadId);
+            const FStreamingTexture& Texture = Textures[Load.TextureIndex];
+            const FStreamingMip& Mip = Texture.Mips[Load.MipIndex];
+
+            Load.Ticket = Uploader->EnqueueTextureCopy(Load.Allocation, Texture.Resource, Load.MipIndex, 0, 0, Mip.Width, Mip.Height, Texture.BytesPerPixel);
+            Uploading.Add(LoadId);
+        }
+    }
+
+    void CompleteUploads()
+    {
+        for (int32 Index = 0; Index < Uploading.Num(); Index++)
+        {
+            const uint64 LoadId = Uploading[Index];
+            const FPendingLoad& Load = PendingLoads.FindChecked(LoadId);
+            if (!Uploader->IsComplete(Load.Ticket))
+            {
+                continue;
+            }
+
+            FStreamingTexture& Texture = Textures[Load.TextureIndex];
+            Texture.FirstResidentMip = Load.MipIndex;
+            Texture.bLoading = false;
+            StagingBytesInFlight -= Load.Allocation.Size;
+            Residency->SetFirstResidentMip(Texture, Load.MipIndex);
+            NumLoaded++;
+
+            PendingLoads.Remove(LoadId);
+            Uploading.RemoveAtSwap(Index--, 1, false);
+        }
+    }
+
+    struct FHigherPriority
+    {
+        bool operator()(const FMipRequest& A, const FMipRequest& B) const { return A.Priority > B.Priority; }
+    };
+
+    struct FLowerPriority
+    {
+        bool operator()(const FMipRequest& A, const FMipRequest& B) const { return A.Priority < B.Priority; }
+    };
+
+    FStreamingUploader* Uploader;
+    IStreamingFileReader* Reader;
+    ITextureResidency* Residency;
+    uint64 Budget;
+    uint64 ResidentBytes = 0;
+
+    int32 MaxPendingLoads = 64;
+    uint64 MaxStagingBytes;
+    uint64 StagingBytesInFlight = 0;
+
+    TArray<FStreamingTexture> Textures;
+    // Bounding sphere centers, SoA for the distance pass.
+    TArray<float> CenterX;
+    TArray<float> CenterY;
+    TArray<float> CenterZ;
+    TArray<float> DistanceSquared;
+
+    TArray<FMipRequest> Requests;
+    TMap<uint64, FPendingLoad> PendingLoads;
+    TArray<uint64> CompletedReads;
+    TArray<uint64> Uploading;
+    uint64 NextLoadId = 0;
+
+    uint32 NumEvicted = 0;
+    uint32 NumLoaded = 0;
+
+    FCriticalSection ViewCS;
+    FTextureStreamingView View;
+};
+
+// CPU stand-in for reserved resources, tracks mapped bytes and the MinLOD clamp.
+class FSimulatedTextureResidency : public ITextureResidency
+{
+public:
+    virtual void MapMip(FStreamingTexture& Texture, int32 MipIndex) override
+    {
+        MappedBytes += Texture.Mips[MipIndex].Size;
+    }
+
+    virtual void SetFirstResidentMip(FStreamingTexture& Texture, int32 MipIndex) override
+    {
+        MinLOD.FindOrAdd(Texture.Resource) = MipIndex;
+    }
+
+    virtual void EvictMip(FStreamingTexture& Texture, int32 MipIndex) override
+    {
+        MinLOD.FindOrAdd(Texture.Resource) = MipIndex + 1;
+        MappedBytes -= Texture.Mips[MipIndex].Size;
+    }
+
+    uint64 MappedBytes = 0;
+    TMap<FResource*, int32> MinLOD;
+};
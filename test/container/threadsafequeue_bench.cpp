@@ -0,0 +1,267 @@
+// Benchmarks of the core/container/threadsafequeue.h queues with 1 to 64 producers, and checks
+// that every value arrives exactly once. TMPMCQueue is compared against a mutex and deque queue,
+// TMPSCQueue also checks that the values of each producer arrive in order.
+//   c++ -std=c++17 -O2 -pthread threadsafequeue_bench.cpp && ./a.out [NumValues]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "../../core/container/threadsafequeue.h"
+
+static const int32 BatchSize = 16;
+
+/** Bounded queue behind a mutex, the baseline for TMPMCQueue. */
+class FMutexQueue
+{
+public:
+    explicit FMutexQueue(uint32 InCapacity) : Capacity(InCapacity) {}
+
+    bool Enqueue(uint64 Value)
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (Values.size() >= Capacity)
+        {
+            return false;
+        }
+        Values.push_back(Value);
+        return true;
+    }
+
+    bool Dequeue(uint64& OutValue)
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (Values.empty())
+        {
+            return false;
+        }
+        OutValue = Values.front();
+        Values.pop_front();
+        return true;
+    }
+
+    int32 EnqueueBatch(const uint64* InValues, int32 Num)
+    {
+        int32 i = 0;
+        while (i < Num && Enqueue(InValues[i]))
+        {
+            i++;
+        }
+        return i;
+    }
+
+    int32 DequeueBatch(uint64* OutValues, int32 Num)
+    {
+        int32 i = 0;
+        while (i < Num && Dequeue(OutValues[i]))
+        {
+            i++;
+        }
+        return i;
+    }
+
+private:
+    std::mutex Mutex;
+    std::deque<uint64> Values;
+    size_t Capacity;
+};
+
+/** The Index-th value of Producer, the producer goes in the high bits. */
+static uint64 MakeValue(int32 Producer, int32 Index)
+{
+    return ((uint64)Producer << 32) | (uint32)Index;
+}
+
+static double GetMilliseconds(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+/**
+ * NumThreads producers and as many consumers share one queue. Every value is checked by sum and
+ * count, consumers may interleave so order is not checked.
+ */
+template<typename QueueType>
+static double RunMPMC(int32 NumThreads, int32 PerProducer, bool bBatch, bool& bOutValid)
+{
+    QueueType Queue(1024);
+    std::atomic<int64> Sum(0), Count(0);
+    std::atomic<bool> bGo(false);
+    std::vector<std::thread> Threads;
+    const int64 Total = (int64)NumThreads * PerProducer;
+
+    for (int32 Producer=0; Producer<NumThreads; Producer++)
+    {
+        Threads.emplace_back([&, Producer]()
+        {
+            while (!bGo.load())
+            {
+                std::this_thread::yield();
+            }
+            uint64 Batch[BatchSize];
+            for (int32 i=0; i<PerProducer; )
+            {
+                int32 Num = 0;
+                if (bBatch)
+                {
+                    int32 NumToEnqueue = PerProducer - i < BatchSize ? PerProducer - i : BatchSize;
+                    for (int32 k=0; k<NumToEnqueue; k++)
+                    {
+                        Batch[k] = MakeValue(Producer, i + k);
+                    }
+                    Num = Queue.EnqueueBatch(Batch, NumToEnqueue);
+                }
+                else
+                {
+                    Num = Queue.Enqueue(MakeValue(Producer, i)) ? 1 : 0;
+                }
+                i += Num;
+                if (Num == 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int32 Consumer=0; Consumer<NumThreads; Consumer++)
+    {
+        Threads.emplace_back([&]()
+        {
+            while (!bGo.load())
+            {
+                std::this_thread::yield();
+            }
+            uint64 Batch[BatchSize];
+            while (Count.load(std::memory_order_relaxed) < Total)
+            {
+                int32 Num = bBatch ? Queue.DequeueBatch(Batch, BatchSize) : (Queue.Dequeue(Batch[0]) ? 1 : 0);
+                if (Num == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                int64 BatchSum = 0;
+                for (int32 k=0; k<Num; k++)
+                {
+                    BatchSum += (int64)(Batch[k] & 0xffffffff) + (int64)(Batch[k] >> 32);
+                }
+                Sum += BatchSum;
+                Count += Num;
+            }
+        });
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    bGo = true;
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+    double Milliseconds = GetMilliseconds(Start);
+
+    int64 Expected = 0;
+    for (int32 Producer=0; Producer<NumThreads; Producer++)
+    {
+        Expected += (int64)PerProducer * (PerProducer - 1) / 2 + (int64)Producer * PerProducer;
+    }
+    bOutValid = Sum == Expected && Count == Total;
+    return Milliseconds;
+}
+
+/** NumThreads producers and the calling thread as the consumer, checks the order per producer. */
+static double RunMPSC(int32 NumThreads, int32 PerProducer, bool bBatch, bool& bOutValid)
+{
+    TMPSCQueue<uint64> Queue;
+    std::atomic<bool> bGo(false);
+    std::vector<std::thread> Threads;
+
+    for (int32 Producer=0; Producer<NumThreads; Producer++)
+    {
+        Threads.emplace_back([&, Producer]()
+        {
+            while (!bGo.load())
+            {
+                std::this_thread::yield();
+            }
+            uint64 Batch[BatchSize];
+            for (int32 i=0; i<PerProducer; )
+            {
+                if (bBatch)
+                {
+                    int32 Num = PerProducer - i < BatchSize ? PerProducer - i : BatchSize;
+                    for (int32 k=0; k<Num; k++)
+                    {
+                        Batch[k] = MakeValue(Producer, i + k);
+                    }
+                    Queue.EnqueueBatch(Batch, Num);
+                    i += Num;
+                }
+                else
+                {
+                    Queue.Enqueue(MakeValue(Producer, i++));
+                }
+            }
+        });
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    bGo = true;
+
+    std::vector<int64> NextIndex(NumThreads, 0);
+    const int64 Total = (int64)NumThreads * PerProducer;
+    int64 Count = 0;
+    bool bInOrder = true;
+    uint64 Batch[64];
+    while (Count < Total)
+    {
+        int32 Num = Queue.DequeueBatch(Batch, 64);
+        if (Num == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (int32 k=0; k<Num; k++)
+        {
+            int32 Producer = (int32)(Batch[k] >> 32);
+            bInOrder &= (int64)(Batch[k] & 0xffffffff) == NextIndex[Producer]++;
+        }
+        Count += Num;
+    }
+
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+    double Milliseconds = GetMilliseconds(Start);
+
+    bOutValid = bInOrder && Queue.IsEmpty();
+    return Milliseconds;
+}
+
+int main(int argc, char** argv)
+{
+    const int32 NumValues = argc > 1 ? atoi(argv[1]) : 200000;
+    bool bAllValid = true;
+
+    printf("%d values, %u hardware threads\n", NumValues, std::thread::hardware_concurrency());
+    const int32 ThreadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    for (int32 NumThreads : ThreadCounts)
+    {
+        const int32 PerProducer = NumValues / NumThreads;
+        bool bValid[5];
+        double Mutex = RunMPMC<FMutexQueue>(NumThreads, PerProducer, false, bValid[0]);
+        double MPMC = RunMPMC<TMPMCQueue<uint64>>(NumThreads, PerProducer, false, bValid[1]);
+        double MPMCBatch = RunMPMC<TMPMCQueue<uint64>>(NumThreads, PerProducer, true, bValid[2]);
+        double MPSC = RunMPSC(NumThreads, PerProducer, false, bValid[3]);
+        double MPSCBatch = RunMPSC(NumThreads, PerProducer, true, bValid[4]);
+
+        bool bRunValid = bValid[0] && bValid[1] && bValid[2] && bValid[3] && bValid[4];
+        bAllValid &= bRunValid;
+        printf("%2d threads  mutex %7.1f ms  mpmc %7.1f ms  batch %7.1f ms  |  mpsc %7.1f ms  batch %7.1f ms  %s\n",
+            NumThreads, Mutex, MPMC, MPMCBatch, MPSC, MPSCBatch, bRunValid ? "valid" : "INVALID");
+    }
+    return bAllValid ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// Benchmarks of the core/math/geometry2D.h batch kernels against the per point path, and checks
+// that both give the same result. ConvexHull compares one slice against one slice per thread.
+//   c++ -std=c++17 -O2 -mavx2 -pthread geometry2D_bench.cpp && ./a.out
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "../../core/math/geometry2D.h"
+
+/** Best of a few runs in milliseconds. */
+template<typename FunctionType>
+static double Measure(FunctionType Function)
+{
+    double Best = 1e30;
+    for (int32 Run=0; Run<5; Run++)
+    {
+        auto Start = std::chrono::high_resolution_clock::now();
+        Function();
+        auto End = std::chrono::high_resolution_clock::now();
+        double Milliseconds = std::chrono::duration<double, std::milli>(End - Start).count();
+        Best = Milliseconds < Best ? Milliseconds : Best;
+    }
+    return Best;
+}
+
+static bool bAllSame = true;
+
+static void Report(const char* Name, double Naive, double Batch, bool bSame)
+{
+    bAllSame &= bSame;
+    printf("%-22s naive %8.3f ms  batch %8.3f ms  x%5.2f  %s\n", Name, Naive, Batch, Naive / Batch, bSame ? "same" : "MISMATCH");
+}
+
+static bool GetBit(const std::vector<uint8>& Mask, int32 Index)
+{
+    return (Mask[Index >> 3] >> (Index & 7)) & 1;
+}
+
+static void BenchRotate(const std::vector<FVector2D>& Points)
+{
+    int32 Num = (int32)Points.size();
+    std::vector<FVector2D> Naive(Num), Batch(Num);
+
+    double NaiveTime = Measure([&]()
+    {
+        for (int32 i=0; i<Num; i++)
+        {
+            Naive[i] = Points[i].GetRotated(33.0f);
+        }
+    });
+    double BatchTime = Measure([&]()
+    {
+        FGeometry2D::RotatePoints(Points.data(), Batch.data(), Num, 33.0f);
+    });
+
+    bool bSame = true;
+    for (int32 i=0; i<Num; i++)
+    {
+        bSame &= FMath::Abs(Naive[i].X - Batch[i].X) < 1e-3f && FMath::Abs(Naive[i].Y - Batch[i].Y) < 1e-3f;
+    }
+    Report("RotatePoints", NaiveTime, BatchTime, bSame);
+}
+
+static void BenchPointsInPolygon(const std::vector<FVector2D>& Points)
+{
+    int32 Num = (int32)Points.size();
+
+    // Star shaped, concave polygon.
+    std::vector<FVector2D> Polygon;
+    for (int32 v=0; v<32; v++)
+    {
+        float S, C;
+        FMath::SinCos(v * (2.0f * PI / 32.0f), &S, &C);
+        float Radius = (v & 1) ? 400.0f : 900.0f;
+        Polygon.push_back(FVector2D(C * Radius, S * Radius));
+    }
+    int32 NumVertices = (int32)Polygon.size();
+
+    std::vector<float> X(Num), Y(Num);
+    for (int32 i=0; i<Num; i++)
+    {
+        X[i] = Points[i].X;
+        Y[i] = Points[i].Y;
+    }
+
+    std::vector<uint8> NaiveMask((Num + 7) / 8), BatchMask((Num + 7) / 8);
+
+    double NaiveTime = Measure([&]()
+    {
+        for (int32 i=0; i<Num; i++)
+        {
+            bool bInside = false;
+            for (int32 v=0, Prev=NumVertices-1; v<NumVertices; Prev=v++)
+            {
+                const FVector2D& A = Polygon[v];
+                const FVector2D& B = Polygon[Prev];
+                if ((A.Y > Y[i]) != (B.Y > Y[i]) && X[i] < (B.X - A.X) * (Y[i] - A.Y) / (B.Y - A.Y) + A.X)
+                {
+                    bInside = !bInside;
+                }
+            }
+            uint8 Bit = (uint8)(1 << (i & 7));
+            NaiveMask[i >> 3] = bInside ? (NaiveMask[i >> 3] | Bit) : (NaiveMask[i >> 3] & ~Bit);
+        }
+    });
+    double BatchTime = Measure([&]()
+    {
+        FGeometry2D::PointsInPolygon(Polygon.data(), NumVertices, { X.data(), Y.data() }, Num, BatchMask.data());
+    });
+
+    // Points within rounding of an edge may differ.
+    int32 NumDifferent = 0;
+    for (int32 i=0; i<Num; i++)
+    {
+        NumDifferent += GetBit(NaiveMask, i) != GetBit(BatchMask, i);
+    }
+    Report("PointsInPolygon", NaiveTime, BatchTime, NumDifferent * 10000 <= Num);
+}
+
+static void BenchSegmentIntersections(const std::vector<FVector2D>& Points)
+{
+    int32 Num = (int32)Points.size() / 2;
+
+    std::vector<float> StartX(Num), StartY(Num), EndX(Num), EndY(Num), NaiveT(Num), BatchT(Num);
+    for (int32 i=0; i<Num; i++)
+    {
+        StartX[i] = Points[2 * i].X;
+        StartY[i] = Points[2 * i].Y;
+        EndX[i] = Points[2 * i + 1].X;
+        EndY[i] = Points[2 * i + 1].Y;
+    }
+
+    FVector2D Start(-1000.0f, -300.0f), End(1000.0f, 500.0f);
+    std::vector<uint8> NaiveMask((Num + 7) / 8), BatchMask((Num + 7) / 8);
+
+    double NaiveTime = Measure([&]()
+    {
+        FVector2D D = End - Start;
+        for (int32 i=0; i<Num; i++)
+        {
+            FVector2D E(EndX[i] - StartX[i], EndY[i] - StartY[i]);
+            FVector2D W(StartX[i] - Start.X, StartY[i] - Start.Y);
+            float Denominator = D ^ E;
+            bool bHit = false;
+            if (Denominator != 0.0f)
+            {
+                float T = (W ^ E) / Denominator;
+                float U = (W ^ D) / Denominator;
+                bHit = T >= 0.0f && T <= 1.0f && U >= 0.0f && U <= 1.0f;
+                if (bHit)
+                {
+                    NaiveT[i] = T;
+                }
+            }
+            uint8 Bit = (uint8)(1 << (i & 7));
+            NaiveMask[i >> 3] = bHit ? (NaiveMask[i >> 3] | Bit) : (NaiveMask[i >> 3] & ~Bit);
+        }
+    });
+    double BatchTime = Measure([&]()
+    {
+        FGeometry2D::SegmentIntersections(Start, End, { StartX.data(), StartY.data(), EndX.data(), EndY.data() }, Num, BatchMask.data(), BatchT.data());
+    });
+
+    int32 NumDifferent = 0;
+    for (int32 i=0; i<Num; i++)
+    {
+        bool bHit = GetBit(NaiveMask, i);
+        NumDifferent += bHit != GetBit(BatchMask, i) || (bHit && FMath::Abs(NaiveT[i] - BatchT[i]) > 1e-4f);
+    }
+    Report("SegmentIntersections", NaiveTime, BatchTime, NumDifferent * 10000 <= Num);
+}
+
+static void BenchConvexHull(const std::vector<FVector2D>& Points)
+{
+    int32 Num = (int32)Points.size();
+    std::vector<FVector2D> Serial, Parallel;
+
+    double SerialTime = Measure([&]()
+    {
+        FGeometry2D::ConvexHull(Points.data(), Num, Serial, 1);
+    });
+    double ParallelTime = Measure([&]()
+    {
+        FGeometry2D::ConvexHull(Points.data(), Num, Parallel, 0);
+    });
+
+    bool bSame = Serial.size() == Parallel.size();
+    for (size_t i=0; bSame && i<Serial.size(); i++)
+    {
+        bSame = Serial[i].X == Parallel[i].X && Serial[i].Y == Parallel[i].Y;
+    }
+    Report("ConvexHull", SerialTime, ParallelTime, bSame);
+}
+
+int main()
+{
+    FMath::RandInit(11);
+
+    const int32 Sizes[] = { 10000, 1000000 };
+    for (int32 Num : Sizes)
+    {
+        std::vector<FVector2D> Points(Num);
+        for (FVector2D& P : Points)
+        {
+            P = FVector2D(FMath::RandRange(-1000.0f, 1000.0f), FMath::RandRange(-1000.0f, 1000.0f));
+        }
+
+        printf("%d points, %d threads\n", Num, FJobSystem::Get().GetNumThreads());
+        BenchRotate(Points);
+        BenchPointsInPolygon(Points);
+        BenchSegmentIntersections(Points);
+        BenchConvexHull(Points);
+    }
+    return bAllSame ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+// Checks the batch kernels of core/math/intersection.h against the scalar FVector functions.
+// Build once plain and once with -mavx2 so both the AVX and the remainder paths run:
+//   c++ -std=c++17 -O2 [-mavx2] intersection_test.cpp && ./a.out
+
+#include <stdio.h>
+#include <vector>
+
+#include "../../core/math/intersection.h"
+
+static int32 NumChecks = 0;
+static int32 NumFailures = 0;
+
+static void Expect(bool bCondition, const char* What, int32 Index)
+{
+    NumChecks++;
+    if (!bCondition)
+    {
+        printf("FAILED %s at %d\n", What, Index);
+        NumFailures++;
+    }
+}
+
+static bool GetHitBit(const std::vector<uint8>& HitMask, int32 Index)
+{
+    return (HitMask[Index >> 3] >> (Index & 7)) & 1;
+}
+
+/** Ray version of the scalar function, the smallest root not below 0. */
+static bool ScalarRaySphere(const FVector& Start, const FVector& End, const FVector& Origin, float Radius, float* OutT)
+{
+    float Root1, Root2;
+    if (!FVector::LineSphereIntersection(Start, End, Origin, Radius, &Root1, &Root2))
+    {
+        return false;
+    }
+
+    float Near = FMath::Min(Root1, Root2);
+    float Far = FMath::Max(Root1, Root2);
+    if (Far < 0.0f)
+    {
+        return false;
+    }
+    *OutT = Near >= 0.0f ? Near : Far;
+    return true;
+}
+
+static bool IsNear(float A, float B)
+{
+    return FMath::Abs(A - B) <= 1e-3f * FMath::Max(1.0f, FMath::Abs(B));
+}
+
+static void TestLineSpheres(int32 Num)
+{
+    std::vector<float> CenterX(Num), CenterY(Num), CenterZ(Num), Radius(Num), T(Num);
+    std::vector<uint8> HitMask((Num + 7) / 8);
+
+    for (int32 i=0; i<Num; i++)
+    {
+        CenterX[i] = FMath::RandRange(-8.0f, 8.0f);
+        CenterY[i] = FMath::RandRange(-2.0f, 2.0f);
+        CenterZ[i] = FMath::RandRange(-2.0f, 2.0f);
+        Radius[i] = FMath::RandRange(0.1f, 2.0f);
+    }
+
+    // Some spheres are behind the start, some contain it.
+    FVector Start(-1.0f, 0.2f, 0.1f);
+    FVector End(1.0f, -0.1f, 0.05f);
+    FIntersection::LineSpheres(Start, End, { CenterX.data(), CenterY.data(), CenterZ.data(), Radius.data() }, Num, HitMask.data(), T.data());
+
+    int32 Nearest = -1;
+    for (int32 i=0; i<Num; i++)
+    {
+        float Expected;
+        bool bHit = ScalarRaySphere(Start, End, FVector(CenterX[i], CenterY[i], CenterZ[i]), Radius[i], &Expected);
+        Expect(GetHitBit(HitMask, i) == bHit, "LineSpheres hit", i);
+        if (bHit)
+        {
+            Expect(T[i] >= 0.0f && IsNear(T[i], Expected), "LineSpheres t", i);
+            if (Nearest < 0 || Expected < T[Nearest])
+            {
+                Nearest = i;
+            }
+        }
+    }
+    Expect(FIntersection::FindNearestHit(HitMask.data(), T.data(), Num) == Nearest, "LineSpheres nearest", Nearest);
+}
+
+static void TestLinesSphere(int32 Num)
+{
+    std::vector<float> StartX(Num), StartY(Num), StartZ(Num), DirX(Num), DirY(Num), DirZ(Num), T(Num);
+    std::vector<uint8> HitMask((Num + 7) / 8);
+
+    FVector Origin(0.3f, 0.1f, -0.2f);
+    float Radius = 1.5f;
+
+    for (int32 i=0; i<Num; i++)
+    {
+        StartX[i] = FMath::RandRange(-4.0f, 4.0f);
+        StartY[i] = FMath::RandRange(-4.0f, 4.0f);
+        StartZ[i] = FMath::RandRange(-4.0f, 4.0f);
+        DirX[i] = FMath::RandRange(-1.0f, 1.0f);
+        DirY[i] = FMath::RandRange(-1.0f, 1.0f);
+        DirZ[i] = FMath::RandRange(-1.0f, 1.0f);
+    }
+
+    FLinesSoA Lines = { StartX.data(), StartY.data(), StartZ.data(), DirX.data(), DirY.data(), DirZ.data() };
+    FIntersection::LinesSphere(Lines, Num, Origin, Radius, HitMask.data(), T.data());
+
+    for (int32 i=0; i<Num; i++)
+    {
+        FVector Start(StartX[i], StartY[i], StartZ[i]);
+        FVector End = Start + FVector(DirX[i], DirY[i], DirZ[i]);
+
+        float Expected;
+        bool bHit = ScalarRaySphere(Start, End, Origin, Radius, &Expected);
+        Expect(GetHitBit(HitMask, i) == bHit, "LinesSphere hit", i);
+        if (bHit)
+        {
+            Expect(T[i] >= 0.0f && IsNear(T[i], Expected), "LinesSphere t", i);
+        }
+    }
+}
+
+static void TestPlanes(int32 Num)
+{
+    std::vector<float> NormalX(Num), NormalY(Num), NormalZ(Num), W(Num), T(Num);
+    std::vector<uint8> HitMask((Num + 7) / 8);
+
+    for (int32 i=0; i<Num; i++)
+    {
+        FVector Normal(FMath::RandRange(-1.0f, 1.0f), FMath::RandRange(-1.0f, 1.0f), FMath::RandRange(-1.0f, 1.0f));
+        // Every 16th plane is parallel to the ray.
+        if (i % 16 == 0)
+        {
+            Normal = FVector(0.0f, 0.0f, 1.0f);
+        }
+        NormalX[i] = Normal.X;
+        NormalY[i] = Normal.Y;
+        NormalZ[i] = Normal.Z;
+        W[i] = FMath::RandRange(-3.0f, 3.0f);
+    }
+
+    FVector Start(0.5f, -0.5f, 0.25f);
+    FVector End(1.5f, 0.5f, 0.25f);
+    FIntersection::LinePlanes(Start, End, { NormalX.data(), NormalY.data(), NormalZ.data(), W.data() }, Num, HitMask.data(), T.data());
+
+    for (int32 i=0; i<Num; i++)
+    {
+        FVector Normal(NormalX[i], NormalY[i], NormalZ[i]);
+        float Denominator = Normal | (End - Start);
+        if (Denominator == 0.0f)
+        {
+            Expect(!GetHitBit(HitMask, i), "LinePlanes parallel", i);
+            continue;
+        }
+
+        // The scalar function returns the point, compare positions and check the side of the start.
+        FVector PlaneOrigin = Normal * (W[i] / (Normal | Normal));
+        FVector Expected = FVector::LinePlaneIntersection(Start, End, PlaneOrigin, Normal);
+        bool bHit = ((Expected - Start) | (End - Start)) >= 0.0f;
+        Expect(GetHitBit(HitMask, i) == bHit, "LinePlanes hit", i);
+        if (bHit && GetHitBit(HitMask, i))
+        {
+            FVector Point = Start + (End - Start) * T[i];
+            Expect((Point - Expected).Size() <= 1e-3f * FMath::Max(1.0f, Expected.Size()), "LinePlanes t", i);
+        }
+    }
+
+    // Same planes through LinesPlane, one ray per element.
+    std::vector<float> StartX(Num, Start.X), StartY(Num, Start.Y), StartZ(Num, Start.Z);
+    std::vector<float> DirX(Num, End.X - Start.X), DirY(Num, End.Y - Start.Y), DirZ(Num, End.Z - Start.Z);
+    FLinesSoA Lines = { StartX.data(), StartY.data(), StartZ.data(), DirX.data(), DirY.data(), DirZ.data() };
+
+    std::vector<float> T2(Num);
+    std::vector<uint8> HitMask2((Num + 7) / 8);
+    for (int32 i=0; i<Num; i++)
+    {
+        FVector Normal(NormalX[i], NormalY[i], NormalZ[i]);
+        FVector PlaneOrigin = Normal * (W[i] / (Normal | Normal));
+        FIntersection::LinesPlane(Lines, Num, PlaneOrigin, Normal, HitMask2.data(), T2.data());
+        for (int32 j=0; j<Num; j++)
+        {
+            Expect(GetHitBit(HitMask2, j) == GetHitBit(HitMask, i), "LinesPlane hit", i);
+        }
+        if (GetHitBit(HitMask, i))
+        {
+            Expect(IsNear(T2[0], T[i]), "LinesPlane t", i);
+        }
+    }
+}
+
+static void TestEdgeCases()
+{
+    // Entirely behind the start.
+    float CenterX[8], CenterY[8], CenterZ[8], Radius[8], T[8];
+    for (int32 i=0; i<8; i++)
+    {
+        CenterX[i] = -10.0f - i;
+        CenterY[i] = 0.0f;
+        CenterZ[i] = 0.0f;
+        Radius[i] = 1.0f;
+    }
+    uint8 HitMask = 0xff;
+    FIntersection::LineSpheres(FVector(0.0f, 0.0f, 0.0f), FVector(1.0f, 0.0f, 0.0f), { CenterX, CenterY, CenterZ, Radius }, 8, &HitMask, T);
+    Expect(HitMask == 0, "spheres behind the start", 0);
+
+    // Start inside, the exit point is the hit.
+    CenterX[0] = 0.5f;
+    FIntersection::LineSpheres(FVector(0.0f, 0.0f, 0.0f), FVector(1.0f, 0.0f, 0.0f), { CenterX, CenterY, CenterZ, Radius }, 8, &HitMask, T);
+    Expect(HitMask == 1 && IsNear(T[0], 1.5f), "start inside a sphere", 0);
+    Expect(FIntersection::FindNearestHit(&HitMask, T, 8) == 0, "start inside a sphere nearest", 0);
+}
+
+int main()
+{
+    FMath::RandInit(7);
+
+    const int32 Sizes[] = { 0, 1, 7, 8, 9, 64, 1003 };
+    for (int32 Num : Sizes)
+    {
+        TestLineSpheres(Num);
+        TestLinesSphere(Num);
+        TestPlanes(Num);
+    }
+    TestEdgeCases();
+
+    printf("intersection_test: %d checks, %d failures\n", NumChecks, NumFailures);
+    return NumFailures == 0 ? 0 : 1;
+}
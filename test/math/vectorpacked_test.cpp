@@ -0,0 +1,167 @@
+// Checks that the batch kernels of core/math/vectorpacked.h give bit identical results to the
+// scalar conversions, and the octahedral error bound. Build plain, with the SIMD paths and with
+// FMA, the gnu dialect lets the compiler contract the scalar path on its own:
+//   c++ -std=c++17 -O2 [-mavx2 -mf16c] vectorpacked_test.cpp && ./a.out
+//   c++ -std=gnu++17 -O2 -mavx2 -mf16c -mfma vectorpacked_test.cpp && ./a.out
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../../core/math/vectorpacked.h"
+
+static int32 NumChecks = 0;
+static int32 NumFailures = 0;
+
+static void Expect(bool bCondition, const char* What, int32 Index)
+{
+    NumChecks++;
+    if (!bCondition)
+    {
+        if (NumFailures < 20)
+        {
+            printf("FAILED %s at %d\n", What, Index);
+        }
+        NumFailures++;
+    }
+}
+
+static bool IsSameBits(const FVector& A, const FVector& B)
+{
+    return memcmp(&A, &B, sizeof(FVector)) == 0;
+}
+
+static uint32 RandBits()
+{
+    return ((uint32)FMath::Rand() << 16) ^ (uint32)FMath::Rand();
+}
+
+static std::vector<FVector> MakeUnitVectors(int32 Num)
+{
+    std::vector<FVector> Vectors(Num);
+    for (int32 i=0; i<Num; i++)
+    {
+        FVector V;
+        do
+        {
+            V = FVector(FMath::RandRange(-1.0f, 1.0f), FMath::RandRange(-1.0f, 1.0f), FMath::RandRange(-1.0f, 1.0f));
+        }
+        while ((V | V) < 1e-4f);
+        Vectors[i] = V * FMath::InvSqrt(V | V);
+    }
+
+    // Axes, where the fold and the sign of zero matter.
+    const FVector Special[] = { FVector(1, 0, 0), FVector(-1, 0, 0), FVector(0, 1, 0), FVector(0, -1, 0), FVector(0, 0, 1), FVector(0, 0, -1), FVector(0.0f, -0.0f, -1.0f) };
+    for (int32 i=0; i<7 && i<Num; i++)
+    {
+        Vectors[i] = Special[i];
+    }
+    return Vectors;
+}
+
+static void TestHalf(int32 Num)
+{
+    std::vector<FVector> In(Num);
+    for (int32 i=0; i<Num; i++)
+    {
+        // Half range, with some values in the denormal range.
+        float Scale = (i & 3) == 0 ? 1e-5f : 6e4f;
+        In[i] = FVector(FMath::RandRange(-1.0f, 1.0f), FMath::RandRange(-1.0f, 1.0f), FMath::RandRange(-1.0f, 1.0f)) * Scale;
+    }
+
+    std::vector<FVectorHalf> Batch(Num);
+    std::vector<FVector> Out(Num);
+    FVectorHalf::Pack(In.data(), Batch.data(), Num);
+    FVectorHalf::Unpack(Batch.data(), Out.data(), Num);
+
+    for (int32 i=0; i<Num; i++)
+    {
+        FVectorHalf Scalar(In[i]);
+        Expect(memcmp(&Scalar, &Batch[i], sizeof(FVectorHalf)) == 0, "FVectorHalf Pack", i);
+        Expect(IsSameBits(Scalar.ToFVector(), Out[i]), "FVectorHalf Unpack", i);
+    }
+}
+
+template<typename QuantizedType>
+static void TestQuantized(int32 Num, const char* Name)
+{
+    std::vector<FVector> In(Num);
+    for (int32 i=0; i<Num; i++)
+    {
+        // A little outside the range to cover the clamp.
+        In[i] = FVector(FMath::RandRange(-1.1f, 1.1f), FMath::RandRange(-1.1f, 1.1f), FMath::RandRange(-1.1f, 1.1f));
+    }
+
+    std::vector<QuantizedType> Batch(Num);
+    std::vector<FVector> Out(Num);
+    QuantizedType::Pack(In.data(), Batch.data(), Num);
+    QuantizedType::Unpack(Batch.data(), Out.data(), Num);
+
+    for (int32 i=0; i<Num; i++)
+    {
+        QuantizedType Scalar(In[i]);
+        Expect(memcmp(&Scalar, &Batch[i], sizeof(QuantizedType)) == 0, Name, i);
+        Expect(IsSameBits(Scalar.ToFVector(), Out[i]), Name, i);
+    }
+}
+
+/** Angle between two unit vectors in double, acos of a float dot product cannot resolve 1e-4. */
+static float GetAngle(const FVector& A, const FVector& B)
+{
+    double CrossX = (double)A.Y * B.Z - (double)A.Z * B.Y;
+    double CrossY = (double)A.Z * B.X - (double)A.X * B.Z;
+    double CrossZ = (double)A.X * B.Y - (double)A.Y * B.X;
+    double Dot = (double)A.X * B.X + (double)A.Y * B.Y + (double)A.Z * B.Z;
+    return (float)atan2(sqrt(CrossX * CrossX + CrossY * CrossY + CrossZ * CrossZ), Dot);
+}
+
+static float TestOctahedral(int32 Num)
+{
+    std::vector<FVector> In = MakeUnitVectors(Num);
+    std::vector<FPackedOctahedralNormal> Batch(Num);
+    std::vector<FVector> Out(Num);
+    FPackedOctahedralNormal::Pack(In.data(), Batch.data(), Num);
+    FPackedOctahedralNormal::Unpack(Batch.data(), Out.data(), Num);
+
+    float MaxError = 0.0f;
+    for (int32 i=0; i<Num; i++)
+    {
+        Expect(FPackedOctahedralNormal::Encode(In[i]) == Batch[i].Packed, "FPackedOctahedralNormal Pack", i);
+        Expect(IsSameBits(FPackedOctahedralNormal::Decode(Batch[i].Packed), Out[i]), "FPackedOctahedralNormal Unpack", i);
+
+        MaxError = FMath::Max(MaxError, GetAngle(In[i], Out[i]));
+    }
+    Expect(MaxError < 1e-4f, "FPackedOctahedralNormal error", 0);
+
+    // Arbitrary bit patterns decode the same way too, -32768 included.
+    for (int32 i=0; i<Num; i++)
+    {
+        Batch[i].Packed = (i & 15) == 0 ? 0x80008000u : RandBits();
+    }
+    FPackedOctahedralNormal::Unpack(Batch.data(), Out.data(), Num);
+    for (int32 i=0; i<Num; i++)
+    {
+        Expect(IsSameBits(FPackedOctahedralNormal::Decode(Batch[i].Packed), Out[i]), "FPackedOctahedralNormal Unpack bits", i);
+    }
+    return MaxError;
+}
+
+int main()
+{
+    FMath::RandInit(5);
+
+    float MaxError = 0.0f;
+    const int32 Sizes[] = { 0, 1, 7, 8, 9, 100003 };
+    for (int32 Num : Sizes)
+    {
+        TestHalf(Num);
+        TestQuantized<FVectorSnorm8>(Num, "FVectorSnorm8");
+        TestQuantized<FVectorUnorm8>(Num, "FVectorUnorm8");
+        TestQuantized<FVectorSnorm16>(Num, "FVectorSnorm16");
+        TestQuantized<FVectorUnorm16>(Num, "FVectorUnorm16");
+        MaxError = FMath::Max(MaxError, TestOctahedral(Num));
+    }
+
+    printf("vectorpacked_test: %d checks, %d failures, octahedral error %.2e rad\n", NumChecks, NumFailures, MaxError);
+    return NumFailures == 0 ? 0 : 1;
+}
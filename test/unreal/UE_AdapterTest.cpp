@@ -0,0 +1,175 @@
+// Automation tests for adapter selection and startup (doc/unreal/UE_RHI.h, UE_Adapter.h) on
+// FStubAdapterFactory. Selection is checked on canned descs, the parallel initialization through
+// the GPU indices it assigns and the FStartupTrace breakdown it leaves behind.
+//   Automation RunTests System.RHI.Startup
+
+#include "Misc/AutomationTest.h"
+#include "../../doc/unreal/UE_Adapter.h"
+#include "../../doc/unreal/UE_RHI.h"
+
+namespace AdapterTest
+{
+    static FAdapterDesc MakeDesc(const TCHAR* Description, uint32 VendorId, D3D_FEATURE_LEVEL FeatureLevel, uint64 DedicatedMB, bool bSoftware = false, uint32 NumDeviceNodes = 1)
+    {
+        FAdapterDesc Desc = {};
+        Desc.Description = Description;
+        Desc.VendorId = VendorId;
+        Desc.DedicatedVideoMemory = DedicatedMB << 20;
+        Desc.SharedSystemMemory = 8192ull << 20;
+        Desc.MaxSupportedFeatureLevel = FeatureLevel;
+        Desc.bSoftwareAdapter = bSoftware;
+        Desc.NumDeviceNodes = NumDeviceNodes;
+        return Desc;
+    }
+
+    static TArray<FStartupTrace::FEvent> GetEvents(const TCHAR* Phase, int32 AdapterIndex)
+    {
+        TArray<FStartupTrace::FEvent> Result;
+        for (const FStartupTrace::FEvent& Event : FStartupTrace::Get().GetEvents())
+        {
+            if (FCString::Strcmp(Event.Phase, Phase) == 0 && Event.AdapterIndex == AdapterIndex)
+            {
+                Result.Add(Event);
+            }
+        }
+        return Result;
+    }
+
+    static const uint32 VendorA = 0x10de;
+    static const uint32 VendorB = 0x1002;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdapterSelectionTest, "System.RHI.Startup.AdapterSelection", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAdapterSelectionTest::RunTest(const FString& Parameters)
+{
+    using namespace AdapterTest;
+
+    FStubAdapterFactory Factory;
+    Factory.AddAdapter(MakeDesc(TEXT("Software"), VendorA, D3D_FEATURE_LEVEL_12_1, 0, true));
+    Factory.AddAdapter(MakeDesc(TEXT("A 11_0 16GB"), VendorA, D3D_FEATURE_LEVEL_11_0, 16384));
+    Factory.AddAdapter(MakeDesc(TEXT("A 12_0 8GB"), VendorA, D3D_FEATURE_LEVEL_12_0, 8192));
+    Factory.AddAdapter(MakeDesc(TEXT("A 12_1 4GB"), VendorA, D3D_FEATURE_LEVEL_12_1, 4096));
+    Factory.AddAdapter(MakeDesc(TEXT("B 12_1 6GB"), VendorB, D3D_FEATURE_LEVEL_12_1, 6144));
+    Factory.AddAdapter(MakeDesc(TEXT("A 12_1 8GB"), VendorA, D3D_FEATURE_LEVEL_12_1, 8192));
+
+    TArray<FAdapterDesc> Descs;
+    Factory.EnumerateAdapters(Descs);
+    for (int32 Index = 0; Index < Descs.Num(); Index++)
+    {
+        TestEqual(FString::Printf(TEXT("Adapter index of %s"), *Descs[Index].Description), (int32)Descs[Index].AdapterIndex, Index);
+    }
+
+    // Software adapters and those below the minimum are rejected whatever their memory.
+    const D3D_FEATURE_LEVEL MinFeatureLevel = D3D_FEATURE_LEVEL_12_0;
+    TestTrue(TEXT("Software adapter rejected"), ScoreAdapter(Descs[0], MinFeatureLevel) < 0);
+    TestTrue(TEXT("Old feature level rejected"), ScoreAdapter(Descs[1], MinFeatureLevel) < 0);
+
+    // Feature level dominates, then memory: 8GB 12_1 > 6GB 12_1 > 4GB 12_1 > 8GB 12_0.
+    const int32 ExpectedOrder[] = { 5, 4, 3, 2 };
+    for (int32 Rank = 1; Rank < (int32)UE_ARRAY_COUNT(ExpectedOrder); Rank++)
+    {
+        const FAdapterDesc& Better = Descs[ExpectedOrder[Rank - 1]];
+        const FAdapterDesc& Worse = Descs[ExpectedOrder[Rank]];
+        TestTrue(FString::Printf(TEXT("%s scores above %s"), *Better.Description, *Worse.Description), ScoreAdapter(Better, MinFeatureLevel) > ScoreAdapter(Worse, MinFeatureLevel));
+    }
+
+    const TArray<int32> Single = ChooseAdapters(Descs, MinFeatureLevel, false);
+    TestTrue(TEXT("Single GPU picks the best"), Single.Num() == 1 && Single[0] == 5);
+
+    // Multi GPU adds the adapters of the best one's vendor and feature level, best first.
+    const TArray<int32> Multi = ChooseAdapters(Descs, MinFeatureLevel, true);
+    TestTrue(TEXT("Multi GPU picks the matching adapters"), Multi.Num() == 2 && Multi[0] == 5 && Multi[1] == 3);
+
+    TArray<FAdapterDesc> Unusable = { Descs[0], Descs[1] };
+    TestEqual(TEXT("Nothing usable"), ChooseAdapters(Unusable, MinFeatureLevel, true).Num(), 0);
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdapterStartupTest, "System.RHI.Startup.ParallelInit", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAdapterStartupTest::RunTest(const FString& Parameters)
+{
+    using namespace AdapterTest;
+
+    // Every root device and every node device takes 20 ms in the stub driver.
+    const float CreateSeconds = 0.02f;
+    const uint32 NumNodes[] = { 2, 1, 2 };
+
+    FStubAdapterFactory Factory(CreateSeconds);
+    for (uint32 Nodes : NumNodes)
+    {
+        Factory.AddAdapter(MakeDesc(TEXT("Linked"), VendorA, D3D_FEATURE_LEVEL_12_1, 8192, false, Nodes));
+    }
+
+    TArray<FAdapterDesc> Descs;
+    Factory.EnumerateAdapters(Descs);
+    const TArray<int32> Chosen = ChooseAdapters(Descs, D3D_FEATURE_LEVEL_12_0, true);
+    TestEqual(TEXT("Chosen adapters"), Chosen.Num(), (int32)UE_ARRAY_COUNT(NumNodes));
+
+    // In enumeration order so the expected GPU indices are easy to follow.
+    TArray<TSharedPtr<FAdapter>> Adapters;
+    for (const FAdapterDesc& Desc : Descs)
+    {
+        Adapters.Add(Factory.CreateAdapter(Desc));
+    }
+
+    FStartupTrace::Get().Reset();
+    InitializeChosenAdapters(Adapters);
+
+    // GPU indices run over the nodes of all adapters.
+    uint32 ExpectedGPUIndex = 0;
+    const TArray<TSharedPtr<FStubAdapter>>& Created = Factory.GetCreatedAdapters();
+    for (int32 AdapterIndex = 0; AdapterIndex < Created.Num(); AdapterIndex++)
+    {
+        const FStubAdapter& Adapter = *Created[AdapterIndex];
+        TestEqual(FString::Printf(TEXT("First GPU of adapter %d"), AdapterIndex), Adapter.GetFirstGPUIndex(), ExpectedGPUIndex);
+        if (TestEqual(FString::Printf(TEXT("Nodes of adapter %d"), AdapterIndex), Adapter.GetNodeGPUMasks().Num(), (int32)NumNodes[AdapterIndex]))
+        {
+            for (uint32 NodeIndex = 0; NodeIndex < NumNodes[AdapterIndex]; NodeIndex++)
+            {
+                TestEqual(FString::Printf(TEXT("Mask of adapter %d node %d"), AdapterIndex, NodeIndex), Adapter.GetNodeGPUMasks()[NodeIndex], 1u << ExpectedGPUIndex);
+                ExpectedGPUIndex++;
+            }
+        }
+    }
+
+    // One scope for the whole phase, one root device per adapter and one device per node, all
+    // inside it and each at least as long as the stub driver call.
+    const TArray<FStartupTrace::FEvent> Phase = GetEvents(TEXT("InitializeAdapters"), INDEX_NONE);
+    if (!TestEqual(TEXT("InitializeAdapters events"), Phase.Num(), 1))
+    {
+        return false;
+    }
+    const double PhaseSeconds = Phase[0].EndTime - Phase[0].StartTime;
+
+    double SerialSeconds = 0.0;
+    TArray<uint32> ThreadIds;
+    for (int32 AdapterIndex = 0; AdapterIndex < Created.Num(); AdapterIndex++)
+    {
+        TArray<FStartupTrace::FEvent> Events = GetEvents(TEXT("CreateRootDevice"), AdapterIndex);
+        TestEqual(FString::Printf(TEXT("Root devices of adapter %d"), AdapterIndex), Events.Num(), 1);
+        const TArray<FStartupTrace::FEvent> Devices = GetEvents(TEXT("CreateDevice"), AdapterIndex);
+        TestEqual(FString::Printf(TEXT("Devices of adapter %d"), AdapterIndex), Devices.Num(), (int32)NumNodes[AdapterIndex]);
+        Events.Append(Devices);
+
+        for (const FStartupTrace::FEvent& Event : Events)
+        {
+            TestTrue(FString::Printf(TEXT("%s of adapter %d inside the phase"), Event.Phase, AdapterIndex), Event.StartTime >= Phase[0].StartTime && Event.EndTime <= Phase[0].EndTime);
+            TestTrue(FString::Printf(TEXT("%s of adapter %d duration"), Event.Phase, AdapterIndex), Event.EndTime - Event.StartTime >= CreateSeconds);
+            SerialSeconds += Event.EndTime - Event.StartTime;
+            ThreadIds.AddUnique(Event.ThreadId);
+        }
+    }
+
+    // Run one after the other this would take 160 ms, in parallel it is bound by the root device
+    // and the device of one adapter, 40 ms. The margin keeps a loaded machine from failing it.
+    if (FApp::ShouldUseThreadingForPerformance() && FTaskGraphInterface::Get().GetNumWorkerThreads() > 1)
+    {
+        TestTrue(FString::Printf(TEXT("Parallel startup, %.1f ms for %.1f ms of driver work"), PhaseSeconds * 1000.0, SerialSeconds * 1000.0), PhaseSeconds < 0.75 * SerialSeconds);
+        TestTrue(TEXT("Startup ran on several threads"), ThreadIds.Num() > 1);
+    }
+
+    return true;
+}
@@ -0,0 +1,108 @@
+// Automation test for FFrameGraphScheduler (doc/unreal/UE_AsyncCompute.h). A small frame over the
+// graphics, async compute and copy queues is compiled, the waits are checked against the minimal
+// set worked out by hand and FSimulatedQueueBackend measures the critical path.
+//   Automation RunTests System.RHI.AsyncCompute
+
+#include "Misc/AutomationTest.h"
+#include "../../doc/unreal/UE_AsyncCompute.h"
+
+namespace AsyncComputeTest
+{
+    // The scheduler only compares resource pointers, these are never dereferenced.
+    static FResource* GetResource(int32 Index)
+    {
+        static uint8 Storage[16];
+        return (FResource*)&Storage[Index];
+    }
+
+    static FFramePass MakePass(const TCHAR* Name, ERHIPipeline Pipeline, TArray<FResource*> Reads, TArray<FResource*> Writes, float EstimatedCost)
+    {
+        FFramePass Pass;
+        Pass.Name = Name;
+        Pass.Pipeline = Pipeline;
+        Pass.Reads = MoveTemp(Reads);
+        Pass.Writes = MoveTemp(Writes);
+        Pass.EstimatedCost = EstimatedCost;
+        return Pass;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFrameGraphSchedulerTest, "System.RHI.AsyncCompute.Scheduler", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FFrameGraphSchedulerTest::RunTest(const FString& Parameters)
+{
+    using namespace AsyncComputeTest;
+
+    FResource* Instances = GetResource(0);
+    FResource* Depth = GetResource(1);
+    FResource* AO = GetResource(2);
+    FResource* Shadow = GetResource(3);
+    FResource* Particles = GetResource(4);
+    FResource* SceneColor = GetResource(5);
+    FResource* Readback = GetResource(6);
+
+    const ERHIPipeline Graphics = ERHIPipeline::Graphics;
+    const ERHIPipeline Compute = ERHIPipeline::AsyncCompute;
+    const ERHIPipeline Copy = ERHIPipeline::Copy;
+
+    FFrameGraphScheduler Scheduler;
+    Scheduler.AddPass(MakePass(TEXT("UploadInstances"), Copy,     {},                                     { Instances },  50.0f));
+    Scheduler.AddPass(MakePass(TEXT("DepthPrepass"),    Graphics, { Instances },                          { Depth },     100.0f));
+    Scheduler.AddPass(MakePass(TEXT("SSAO"),            Compute,  { Depth },                              { AO },        200.0f));
+    Scheduler.AddPass(MakePass(TEXT("Shadows"),         Graphics, {},                                     { Shadow },    300.0f));
+    // Reads the upload too, the SSAO wait already covers it through the depth prepass.
+    Scheduler.AddPass(MakePass(TEXT("Particles"),       Compute,  { Instances },                          { Particles },  50.0f));
+    // Depends on SSAO and Particles, only the later of the two needs a wait.
+    Scheduler.AddPass(MakePass(TEXT("Lighting"),        Graphics, { Depth, AO, Shadow, Particles },       { SceneColor }, 150.0f));
+    Scheduler.AddPass(MakePass(TEXT("Readback"),        Copy,     { SceneColor },                         { Readback },   20.0f));
+    // Write after read of the depth buffer, queue order on graphics already covers it.
+    Scheduler.AddPass(MakePass(TEXT("Decals"),          Graphics, {},                                     { Depth },      30.0f));
+
+    Scheduler.Compile();
+
+    struct FExpectedWait
+    {
+        int32 Pass;
+        ERHIPipeline Pipeline;
+        uint64 FenceValue;
+        int32 ProducerPass;
+    };
+    const FExpectedWait ExpectedWaits[] =
+    {
+        { 1, Copy,     1, 0 },
+        { 2, Graphics, 1, 1 },
+        { 5, Compute,  2, 4 },
+        { 6, Graphics, 3, 5 },
+    };
+
+    const TArray<FFramePass>& Passes = Scheduler.GetPasses();
+    TestEqual(TEXT("Number of waits"), Scheduler.GetNumWaits(), (uint32)UE_ARRAY_COUNT(ExpectedWaits));
+    for (const FExpectedWait& Expected : ExpectedWaits)
+    {
+        const FFramePass& Pass = Passes[Expected.Pass];
+        if (TestEqual(FString::Printf(TEXT("Waits of %s"), Pass.Name), Pass.Waits.Num(), 1))
+        {
+            TestEqual(FString::Printf(TEXT("Wait queue of %s"), Pass.Name), (uint32)Pass.Waits[0].Pipeline, (uint32)Expected.Pipeline);
+            TestEqual(FString::Printf(TEXT("Wait fence of %s"), Pass.Name), Pass.Waits[0].FenceValue, Expected.FenceValue);
+            TestEqual(FString::Printf(TEXT("Wait producer of %s"), Pass.Name), Pass.Waits[0].ProducerPass, Expected.ProducerPass);
+        }
+    }
+
+    // Producers of a wait and the last pass of every queue signal, nothing else does.
+    const bool ExpectedSignals[] = { true, true, false, false, true, true, true, true };
+    for (int32 PassIndex = 0; PassIndex < Passes.Num(); PassIndex++)
+    {
+        TestEqual(FString::Printf(TEXT("Signal of %s"), Passes[PassIndex].Name), Passes[PassIndex].bSignalFence, ExpectedSignals[PassIndex]);
+    }
+
+    // Copy 0-50, depth prepass 50-150, SSAO 150-350 beside shadows 150-450, particles 350-400,
+    // lighting 450-600, readback 600-620 beside decals 600-630.
+    const FSimulatedQueueBackend::FResult Result = FSimulatedQueueBackend::Run(Scheduler);
+    TestEqual(TEXT("Critical path"), Result.CriticalPath, 630.0f);
+    TestEqual(TEXT("Serial time"), Result.Serial, 900.0f);
+    TestEqual(TEXT("Graphics busy"), Result.QueueBusy[(uint32)Graphics], 580.0f);
+    TestEqual(TEXT("Compute busy"), Result.QueueBusy[(uint32)Compute], 250.0f);
+    TestEqual(TEXT("Copy busy"), Result.QueueBusy[(uint32)Copy], 70.0f);
+
+    return true;
+}
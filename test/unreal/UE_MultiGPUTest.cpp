@@ -0,0 +1,170 @@
+// Automation tests for FMultiGPUScheduler (doc/unreal/UE_MultiGPU.h) on three FSimulatedMultiGPUBackend
+// adapters. Command lists go through the real executor, so routing, the per-GPU resource swap of a
+// broadcast and the cross-adapter copies are checked on what actually reached every adapter.
+//   Automation RunTests System.RHI.MultiGPU
+
+#include "Misc/AutomationTest.h"
+#include "../../doc/unreal/UE_RHICommandList.h"
+#include "../../doc/unreal/UE_Device.h"
+#include "../../doc/unreal/UE_MultiGPU.h"
+
+namespace MultiGPUTest
+{
+    static const uint32 NumGPUs = 3;
+
+    static FResourceDesc MakeDesc(uint32 Width, uint32 Height)
+    {
+        FResourceDesc Desc;
+        Desc.Width = Width;
+        Desc.Height = Height;
+        return Desc;
+    }
+
+    // Stands in for rendering, every row of the instance is filled with Value.
+    static void Fill(FSimulatedMultiGPUBackend& Backend, FResource* Resource, uint32 GPUIndex, uint8 Value)
+    {
+        TArray<uint8>& Memory = Backend.GetMemory(Resource, GPUIndex);
+        FMemory::Memset(Memory.GetData(), Value, Memory.Num());
+    }
+
+    // Value of the first byte of every row.
+    static uint8 GetRow(FSimulatedMultiGPUBackend& Backend, FResource* Resource, uint32 GPUIndex, uint32 Width, int32 Y)
+    {
+        return Backend.GetMemory(Resource, GPUIndex)[Y * Width * FSimulatedMultiGPUBackend::BytesPerTexel];
+    }
+
+    static void RecordPass(FRHICommandList& CommandList, FRHIGPUMask GPUMask, FResource* Resource)
+    {
+        CommandList.SetGPUMask(GPUMask);
+        CommandList.TransitionResource(Resource, 0, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        CommandList.DrawPrimitive(0, 2, 1);
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiGPUAlternateFrameTest, "System.RHI.MultiGPU.AlternateFrame", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMultiGPUAlternateFrameTest::RunTest(const FString& Parameters)
+{
+    using namespace MultiGPUTest;
+
+    FSimulatedMultiGPUBackend Backend(NumGPUs);
+    FMultiGPUScheduler Scheduler(&Backend, EMultiGPUMode::AlternateFrame);
+
+    // The list records the instance of GPU0, the replay on every other GPU has to swap it.
+    FMultiGPUResource* SceneColor = Scheduler.CreateResource(MakeDesc(16, 8), EMultiGPUResourcePolicy::Mirrored);
+    TestEqual(TEXT("Mirrored instances"), SceneColor->GPUMask.GetNumActive(), NumGPUs);
+
+    // Temporal history starts on GPU0 and follows the frames around.
+    FMultiGPUResource* History = Scheduler.CreateResource(MakeDesc(16, 8), EMultiGPUResourcePolicy::Partitioned);
+    TestTrue(TEXT("Partitioned starts on the owner only"), History->GPUMask == FRHIGPUMask::GPU0());
+
+    FRHICommandList CommandList;
+    for (uint64 FrameNumber = 0; FrameNumber < 2 * NumGPUs; FrameNumber++)
+    {
+        const uint32 FrameGPU = (uint32)(FrameNumber % NumGPUs);
+        const FRHIGPUMask FrameMask = Scheduler.GetFrameMask(FrameNumber);
+        TestTrue(FString::Printf(TEXT("Frame %d mask"), (int32)FrameNumber), FrameMask == FRHIGPUMask::FromIndex(FrameGPU));
+
+        RecordPass(CommandList, FrameMask, SceneColor->Get(0));
+        Scheduler.Submit(CommandList);
+
+        // Only the GPU of the frame saw the list, with its own instance.
+        for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+        {
+            const uint32 ExpectedDraws = (uint32)(FrameNumber / NumGPUs) + (GPUIndex <= FrameGPU ? 1 : 0);
+            TestEqual(FString::Printf(TEXT("Frame %d draws on GPU%d"), (int32)FrameNumber, GPUIndex), Backend.GetAdapter(GPUIndex).Context.NumDraws, ExpectedDraws);
+        }
+        const TArray<FResource*>& Transitions = Backend.GetAdapter(FrameGPU).Context.Transitions;
+        TestTrue(FString::Printf(TEXT("Frame %d resolved instance"), (int32)FrameNumber), Transitions.Num() > 0 && Transitions.Last() == SceneColor->Get(FrameGPU));
+
+        Fill(Backend, History->Get(FrameGPU), FrameGPU, (uint8)(FrameNumber + 1));
+        Scheduler.AddFrameEndTransfers(FrameNumber, { History }, SceneColor, FIntRect());
+        Scheduler.EndFrame();
+
+        // The next GPU received the history, the first transfer there created its instance.
+        const uint32 NextGPU = (uint32)((FrameNumber + 1) % NumGPUs);
+        TestEqual(FString::Printf(TEXT("Frame %d transfers"), (int32)FrameNumber), Scheduler.GetNumTransfersLastFrame(), 1u);
+        if (TestTrue(FString::Printf(TEXT("Frame %d history on GPU%d"), (int32)FrameNumber, NextGPU), History->GPUMask.Contains(NextGPU)))
+        {
+            TestTrue(FString::Printf(TEXT("Frame %d history copied"), (int32)FrameNumber), Backend.GetMemory(History->Get(NextGPU), NextGPU) == Backend.GetMemory(History->Get(FrameGPU), FrameGPU));
+        }
+    }
+
+    TestTrue(TEXT("History on every GPU"), History->GPUMask == FRHIGPUMask::All(NumGPUs));
+    TestEqual(TEXT("Transfer batches"), Backend.NumTransferBatches, 2 * NumGPUs);
+    for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+    {
+        TestEqual(FString::Printf(TEXT("Transfer waits on GPU%d"), GPUIndex), Backend.GetAdapter(GPUIndex).NumTransferWaits, 2u);
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiGPUSplitFrameTest, "System.RHI.MultiGPU.SplitFrame", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMultiGPUSplitFrameTest::RunTest(const FString& Parameters)
+{
+    using namespace MultiGPUTest;
+
+    const uint32 Width = 16;
+    const uint32 Height = 48;
+    const FIntRect ViewRect(0, 0, Width, Height);
+
+    FSimulatedMultiGPUBackend Backend(NumGPUs);
+    FMultiGPUScheduler Scheduler(&Backend, EMultiGPUMode::SplitFrame);
+
+    FMultiGPUResource* SceneColor = Scheduler.CreateResource(MakeDesc(Width, Height), EMultiGPUResourcePolicy::Mirrored);
+
+    const FRHIGPUMask FrameMask = Scheduler.GetFrameMask(0);
+    TestTrue(TEXT("Frame mask"), FrameMask == FRHIGPUMask::All(NumGPUs));
+
+    // Equal weights, three bands of 16 rows.
+    for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+    {
+        const FIntRect Band = Scheduler.GetViewRect(ViewRect, GPUIndex);
+        TestEqual(FString::Printf(TEXT("Band %d top"), GPUIndex), Band.Min.Y, (int32)(GPUIndex * 16));
+        TestEqual(FString::Printf(TEXT("Band %d bottom"), GPUIndex), Band.Max.Y, (int32)((GPUIndex + 1) * 16));
+        TestEqual(FString::Printf(TEXT("Band %d width"), GPUIndex), Band.Width(), (int32)Width);
+    }
+
+    // One broadcast list, every GPU draws with its own instance and the scissor of its band.
+    FRHICommandList CommandList;
+    RecordPass(CommandList, FrameMask, SceneColor->Get(0));
+    Scheduler.Submit(CommandList, ViewRect);
+    for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+    {
+        const FSimulatedMultiGPUBackend::FSimulatedContext& Context = Backend.GetAdapter(GPUIndex).Context;
+        TestEqual(FString::Printf(TEXT("Draws on GPU%d"), GPUIndex), Context.NumDraws, 1u);
+        TestTrue(FString::Printf(TEXT("Instance on GPU%d"), GPUIndex), Context.Transitions.Num() == 1 && Context.Transitions[0] == SceneColor->Get(GPUIndex));
+        TestTrue(FString::Printf(TEXT("Scissor on GPU%d"), GPUIndex), Context.ScissorRect == Scheduler.GetViewRect(ViewRect, GPUIndex));
+
+        Fill(Backend, SceneColor->Get(GPUIndex), GPUIndex, (uint8)(GPUIndex + 1));
+    }
+
+    // The gather moves the band of every other GPU to GPU0 and nothing outside it.
+    Scheduler.AddFrameEndTransfers(0, {}, SceneColor, ViewRect);
+    Scheduler.EndFrame();
+    TestEqual(TEXT("Gather transfers"), Scheduler.GetNumTransfersLastFrame(), NumGPUs - 1);
+    TestEqual(TEXT("Gather batches"), Backend.NumTransferBatches, NumGPUs - 1);
+    TestEqual(TEXT("Gather waits on GPU0"), Backend.GetAdapter(0).NumTransferWaits, NumGPUs - 1);
+    for (int32 Y = 0; Y < (int32)Height; Y++)
+    {
+        TestEqual(FString::Printf(TEXT("Gathered row %d"), Y), GetRow(Backend, SceneColor->Get(0), 0, Width, Y), (uint8)(Y / 16 + 1));
+    }
+    TestEqual(TEXT("GPU1 keeps its own rows"), GetRow(Backend, SceneColor->Get(1), 1, Width, 0), (uint8)2);
+
+    // GPU0 took twice as long, its band shrinks and the bands still tile the view.
+    const float GPUFrameTimes[NumGPUs] = { 20.0f, 10.0f, 10.0f };
+    Scheduler.UpdateSplitWeights(GPUFrameTimes);
+    int32 Top = 0;
+    for (uint32 GPUIndex = 0; GPUIndex < NumGPUs; GPUIndex++)
+    {
+        const FIntRect Band = Scheduler.GetViewRect(ViewRect, GPUIndex);
+        TestEqual(FString::Printf(TEXT("Rebalanced band %d top"), GPUIndex), Band.Min.Y, Top);
+        Top = Band.Max.Y;
+    }
+    TestEqual(TEXT("Rebalanced bands cover the view"), Top, (int32)Height);
+    TestTrue(TEXT("Slow band shrinks"), Scheduler.GetViewRect(ViewRect, 0).Height() < 16);
+
+    return true;
+}
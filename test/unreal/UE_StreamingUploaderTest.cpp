@@ -0,0 +1,132 @@
+// Automation tests for FStreamingUploader (doc/unreal/UE_StreamingUploader.h) on FSimulatedUploadBackend.
+// The simulated copy queue only copies when it is advanced, so staging space handed out again
+// before the batch that read it finished shows up as wrong bytes in the destination.
+//   Automation RunTests System.RHI.StreamingUploader
+
+#include "Misc/AutomationTest.h"
+#include "../../doc/unreal/UE_StreamingUploader.h"
+
+namespace StreamingUploaderTest
+{
+    static const uint64 RingSize = 4096;
+    static const uint64 ChunkSize = 1024;
+
+    // Every chunk of the destination holds its own byte value.
+    static bool IsChunkFilled(const FSimulatedUploadBackend& Backend, FResource* Resource, uint64 Offset, uint8 Value)
+    {
+        const FSimulatedUploadBackend::FSimulatedResource* Simulated = Backend.FindResource(Resource);
+        for (uint64 Index = Offset; Index < Offset + ChunkSize; Index++)
+        {
+            if (Simulated->Data[Index] != Value)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStreamingUploaderRingReuseTest, "System.RHI.StreamingUploader.RingReuse", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FStreamingUploaderRingReuseTest::RunTest(const FString& Parameters)
+{
+    using namespace StreamingUploaderTest;
+
+    FResource Resource;
+    FSimulatedUploadBackend Backend;
+    Backend.AddResource(&Resource, 0, 2 * RingSize);
+    FStreamingUploader Uploader(&Backend, RingSize);
+
+    // Four batches fill the ring, none of them has run on the simulated GPU yet.
+    const uint32 NumChunks = RingSize / ChunkSize;
+    for (uint32 Chunk = 0; Chunk < NumChunks; Chunk++)
+    {
+        FUploadAllocation Allocation = Uploader.Alloc(ChunkSize);
+        TestEqual(FString::Printf(TEXT("Offset of chunk %d"), Chunk), Allocation.Offset, Chunk * ChunkSize);
+        FMemory::Memset(Allocation.Data, (uint8)(Chunk + 1), ChunkSize);
+        const FUploadTicket Ticket = Uploader.EnqueueBufferCopy(Allocation, &Resource, Chunk * ChunkSize);
+        TestEqual(FString::Printf(TEXT("Fence of chunk %d"), Chunk), Ticket.FenceValue, (uint64)(Chunk + 1));
+        Uploader.Flush();
+    }
+    TestEqual(TEXT("Batches"), Backend.NumSubmits, NumChunks);
+    TestEqual(TEXT("Bytes in flight"), Uploader.GetBytesInFlight(), RingSize);
+
+    // TryAlloc does not wait for the GPU.
+    TestFalse(TEXT("TryAlloc on a full ring"), Uploader.TryAlloc(ChunkSize).IsValid());
+    TestEqual(TEXT("No wait for TryAlloc"), Uploader.GetNumFullRingWaits(), 0u);
+    TestEqual(TEXT("GPU untouched by TryAlloc"), Backend.GetCompletedFence(), (uint64)0);
+
+    // Alloc waits for the oldest batch only, then hands out the space that batch read.
+    FUploadAllocation Reused = Uploader.Alloc(ChunkSize);
+    TestTrue(TEXT("Alloc after the wait"), Reused.IsValid());
+    TestEqual(TEXT("Full ring waits"), Uploader.GetNumFullRingWaits(), 1u);
+    TestEqual(TEXT("Waited for the oldest batch"), Backend.GetCompletedFence(), (uint64)1);
+    TestEqual(TEXT("Reused offset"), Reused.Offset, (uint64)0);
+    FMemory::Memset(Reused.Data, (uint8)(NumChunks + 1), ChunkSize);
+    const FUploadTicket Last = Uploader.EnqueueBufferCopy(Reused, &Resource, RingSize);
+
+    TestFalse(TEXT("Last upload pending"), Uploader.IsComplete(Last));
+    Uploader.Wait(Last);
+    TestTrue(TEXT("Last upload complete"), Uploader.IsComplete(Last));
+
+    // The first chunk was copied before its staging space was written again.
+    for (uint32 Chunk = 0; Chunk <= NumChunks; Chunk++)
+    {
+        TestTrue(FString::Printf(TEXT("Data of chunk %d"), Chunk), IsChunkFilled(Backend, &Resource, Chunk * ChunkSize, (uint8)(Chunk + 1)));
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStreamingUploaderOpenAllocationsTest, "System.RHI.StreamingUploader.OpenAllocations", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FStreamingUploaderOpenAllocationsTest::RunTest(const FString& Parameters)
+{
+    using namespace StreamingUploaderTest;
+
+    FResource Resource;
+    FSimulatedUploadBackend Backend;
+    Backend.AddResource(&Resource, 0, RingSize);
+    FStreamingUploader Uploader(&Backend, RingSize);
+
+    // Both halves are handed out but not enqueued, no batch can free them: waiting would never end.
+    FUploadAllocation First = Uploader.Alloc(RingSize / 2);
+    FUploadAllocation Second = Uploader.Alloc(RingSize / 2);
+    TestTrue(TEXT("Halves allocated"), First.IsValid() && Second.IsValid());
+
+    TestFalse(TEXT("Alloc held by open allocations"), Uploader.Alloc(ChunkSize).IsValid());
+    TestEqual(TEXT("Failed allocs"), Uploader.GetNumFailedAllocs(), 1u);
+    TestEqual(TEXT("No wait on open allocations"), Uploader.GetNumFullRingWaits(), 0u);
+    TestEqual(TEXT("Nothing submitted"), Backend.NumSubmits, 0u);
+
+    // Once the owners enqueue, the uploader submits them itself and the retry waits on that batch.
+    FMemory::Memset(First.Data, 1, First.Size);
+    FMemory::Memset(Second.Data, 2, Second.Size);
+    Uploader.EnqueueBufferCopy(First, &Resource, 0);
+    Uploader.EnqueueBufferCopy(Second, &Resource, RingSize / 2);
+
+    FUploadAllocation Retry = Uploader.Alloc(ChunkSize);
+    TestTrue(TEXT("Retry after enqueue"), Retry.IsValid());
+    TestEqual(TEXT("Flushed by the retry"), Backend.NumSubmits, 1u);
+    TestEqual(TEXT("Adjacent copies merged"), Uploader.GetNumCopiesMerged(), 1u);
+    TestEqual(TEXT("Retry waited"), Uploader.GetNumFullRingWaits(), 1u);
+    TestEqual(TEXT("Retry failed allocs"), Uploader.GetNumFailedAllocs(), 1u);
+
+    const FSimulatedUploadBackend::FSimulatedResource* Simulated = Backend.FindResource(&Resource);
+    TestTrue(TEXT("Halves copied"), Simulated->Data[0] == 1 && Simulated->Data[RingSize - 1] == 2);
+
+    // A released allocation gives its space back without any batch.
+    Uploader.Release(Retry);
+    FUploadAllocation Whole = Uploader.Alloc(RingSize);
+    TestTrue(TEXT("Whole ring after release"), Whole.IsValid() && Whole.Offset == 0);
+    TestEqual(TEXT("Release needs no batch"), Backend.NumSubmits, 1u);
+
+    // A consumer queue wait flushes the batch it waits on.
+    FMemory::Memset(Whole.Data, 3, Whole.Size);
+    const FUploadTicket Ticket = Uploader.EnqueueBufferCopy(Whole, &Resource, 0);
+    Uploader.WaitOnQueue(Ticket, ERHIPipeline::Graphics);
+    TestEqual(TEXT("Queue wait flushed"), Backend.NumSubmits, 2u);
+    TestTrue(TEXT("Queue wait recorded"), Backend.QueueWaits.Num() == 1 && Backend.QueueWaits[0].FenceValue == Ticket.FenceValue);
+
+    return true;
+}
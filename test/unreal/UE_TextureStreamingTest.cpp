@@ -0,0 +1,283 @@
+// Automation tests for FTextureStreamingManager (doc/unreal/UE_TextureStreaming.h) on top of
+// FSimulatedUploadBackend and FSimulatedTextureResidency. Reads are held by a test reader until the
+// test completes them, so the loads in flight of a tick can be inspected.
+//   Automation RunTests System.RHI.TextureStreaming
+
+#include "Misc/AutomationTest.h"
+#include "../../doc/unreal/UE_StreamingUploader.h"
+#include "../../doc/unreal/UE_TextureStreaming.h"
+
+namespace TextureStreamingTest
+{
+    // Square mips of 64, 32, 16 and 8 texels, the last one is the tail.
+    static const int32 NumMips = 4;
+    static const uint32 TopMipWidth = 64;
+
+    static uint64 GetMipSize(int32 MipIndex)
+    {
+        const uint64 Width = TopMipWidth >> MipIndex;
+        return Width * Width * 4;
+    }
+
+    // Fills every row of a read with the low byte of its file offset, the offsets tell the mips apart.
+    class FHeldFileReader : public IStreamingFileReader
+    {
+    public:
+        virtual void Submit(const FStreamingRead& Read) override
+        {
+            Held.Add(Read);
+            Submitted.Add(Read.Offset);
+        }
+
+        virtual void PollCompleted(TArray<uint64>& OutUserData) override
+        {
+            OutUserData.Append(Completed);
+            Completed.Reset();
+        }
+
+        void CompleteAll()
+        {
+            for (const FStreamingRead& Read : Held)
+            {
+                for (uint32 Row = 0; Row < Read.NumRows; Row++)
+                {
+                    FMemory::Memset(Read.Dest + (uint64)Row * Read.DestPitch, (uint8)Read.Offset, Read.RowSize);
+                }
+                Completed.Add(Read.UserData);
+            }
+            Held.Reset();
+        }
+
+        TArray<FStreamingRead> Held;
+        // File offsets of all reads, in submission order.
+        TArray<uint64> Submitted;
+
+    private:
+        TArray<uint64> Completed;
+    };
+
+    struct FFixture
+    {
+        FSimulatedUploadBackend Backend;
+        FStreamingUploader Uploader;
+        FHeldFileReader Reader;
+        FSimulatedTextureResidency Residency;
+        FTextureStreamingManager Manager;
+        FResource Resources[16];
+
+        FFixture(uint64 RingSize, uint64 Budget, uint64 MaxStagingBytes = 0)
+            : Uploader(&Backend, RingSize)
+            , Manager(&Uploader, &Reader, &Residency, Budget, MaxStagingBytes)
+        {
+        }
+
+        // File offsets are 16 * texture + mip + 1, unique in their low byte.
+        int32 AddTexture(const FVector& Center, float Radius)
+        {
+            const int32 TextureIndex = Added++;
+            FStreamingTexture Texture;
+            Texture.Resource = &Resources[TextureIndex];
+            Texture.Radius = Radius;
+            for (int32 MipIndex = 0; MipIndex < NumMips; MipIndex++)
+            {
+                const uint32 Width = TopMipWidth >> MipIndex;
+                Texture.Mips.Add({ (uint64)(16 * TextureIndex + MipIndex + 1), Width, Width, GetMipSize(MipIndex) });
+                Backend.AddResource(Texture.Resource, MipIndex, GetMipSize(MipIndex), Width * 4);
+            }
+            return Manager.AddTexture(Texture, Center);
+        }
+
+        // One streaming tick, then the reads and copies it started finish. Copies of reads that
+        // finished go out on the next tick and are seen complete on the one after.
+        void Tick(const FVector& ViewOrigin)
+        {
+            FTextureStreamingView View;
+            View.Origin = ViewOrigin;
+            View.ScreenScale = 64.0f;
+            Manager.SetView(View);
+            Manager.Tick();
+            Reader.CompleteAll();
+            Backend.Advance();
+        }
+
+        bool IsMipLoaded(int32 TextureIndex, int32 MipIndex) const
+        {
+            const FStreamingTexture& Texture = Manager.GetTexture(TextureIndex);
+            const FSimulatedUploadBackend::FSimulatedResource* Simulated = Backend.FindResource(Texture.Resource, MipIndex);
+            return Simulated->Data[0] == (uint8)Texture.Mips[MipIndex].FileOffset && Simulated->Data.Last() == (uint8)Texture.Mips[MipIndex].FileOffset;
+        }
+
+        int32 Added = 0;
+    };
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTextureStreamingPriorityTest, "System.RHI.TextureStreaming.Priority", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTextureStreamingPriorityTest::RunTest(const FString& Parameters)
+{
+    using namespace TextureStreamingTest;
+
+    FFixture Fixture(256 * 1024, 1024 * 1024);
+
+    // Radius over distance picks the wanted mip: 64 texels over 53, 26, 13 and 3 on screen.
+    const float Distances[] = { 1.2f, 2.5f, 5.0f, 20.0f };
+    const int32 ExpectedFirstMip[] = { 0, 1, 2, 3 };
+    for (float Distance : Distances)
+    {
+        Fixture.AddTexture(FVector(Distance, 0.0f, 0.0f), 1.0f);
+    }
+    const FVector ViewOrigin(0.0f, 0.0f, 0.0f);
+
+    // Every texture below its wanted mip asks for the next one, the closest first.
+    Fixture.Tick(ViewOrigin);
+    const uint64 ExpectedReads[] = { 16 * 0 + 3, 16 * 1 + 3, 16 * 2 + 3 };
+    if (TestEqual(TEXT("Reads of the first tick"), Fixture.Reader.Submitted.Num(), (int32)UE_ARRAY_COUNT(ExpectedReads)))
+    {
+        for (int32 Index = 0; Index < (int32)UE_ARRAY_COUNT(ExpectedReads); Index++)
+        {
+            TestEqual(FString::Printf(TEXT("Read %d"), Index), Fixture.Reader.Submitted[Index], ExpectedReads[Index]);
+        }
+    }
+
+    for (int32 Tick = 0; Tick < 8; Tick++)
+    {
+        Fixture.Tick(ViewOrigin);
+    }
+
+    uint64 ExpectedResident = 0;
+    for (int32 TextureIndex = 0; TextureIndex < (int32)UE_ARRAY_COUNT(Distances); TextureIndex++)
+    {
+        const FStreamingTexture& Texture = Fixture.Manager.GetTexture(TextureIndex);
+        TestEqual(FString::Printf(TEXT("Wanted mip of texture %d"), TextureIndex), Texture.WantedFirstMip, ExpectedFirstMip[TextureIndex]);
+        TestEqual(FString::Printf(TEXT("Resident mip of texture %d"), TextureIndex), Texture.FirstResidentMip, ExpectedFirstMip[TextureIndex]);
+        for (int32 MipIndex = ExpectedFirstMip[TextureIndex]; MipIndex < NumMips - 1; MipIndex++)
+        {
+            TestTrue(FString::Printf(TEXT("Data of texture %d mip %d"), TextureIndex, MipIndex), Fixture.IsMipLoaded(TextureIndex, MipIndex));
+        }
+        if (ExpectedFirstMip[TextureIndex] < NumMips - 1)
+        {
+            const int32* MinLOD = Fixture.Residency.MinLOD.Find(Texture.Resource);
+            TestTrue(FString::Printf(TEXT("MinLOD of texture %d"), TextureIndex), MinLOD != nullptr && *MinLOD == ExpectedFirstMip[TextureIndex]);
+        }
+        for (int32 MipIndex = ExpectedFirstMip[TextureIndex]; MipIndex < NumMips; MipIndex++)
+        {
+            ExpectedResident += GetMipSize(MipIndex);
+        }
+    }
+    TestEqual(TEXT("Resident bytes"), Fixture.Manager.GetResidentBytes(), ExpectedResident);
+    TestEqual(TEXT("Loaded mips"), Fixture.Manager.GetNumLoaded(), 3u + 2u + 1u);
+    TestEqual(TEXT("Nothing evicted"), Fixture.Manager.GetNumEvicted(), 0u);
+    TestEqual(TEXT("Staging released"), Fixture.Manager.GetStagingBytesInFlight(), (uint64)0);
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTextureStreamingBudgetTest, "System.RHI.TextureStreaming.Budget", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTextureStreamingBudgetTest::RunTest(const FString& Parameters)
+{
+    using namespace TextureStreamingTest;
+
+    // Room for one texture with all its mips and the other down to mip 1.
+    const uint64 FullTexture = GetMipSize(0) + GetMipSize(1) + GetMipSize(2) + GetMipSize(3);
+    const uint64 Budget = FullTexture + GetMipSize(1) + GetMipSize(2) + GetMipSize(3);
+    FFixture Fixture(256 * 1024, Budget);
+
+    const int32 Left = Fixture.AddTexture(FVector(-10.0f, 0.0f, 0.0f), 10.0f);
+    const int32 Right = Fixture.AddTexture(FVector(10.0f, 0.0f, 0.0f), 8.0f);
+
+    // Both want their top mip, the larger one on screen gets it. The other's request is worth
+    // less than anything it could evict, so it stays at mip 1 and nothing is evicted.
+    const FVector Between(0.0f, 2.0f, 0.0f);
+    for (int32 Tick = 0; Tick < 12; Tick++)
+    {
+        Fixture.Tick(Between);
+        TestTrue(FString::Printf(TEXT("Within budget at tick %d"), Tick), Fixture.Manager.GetResidentBytes() <= Budget);
+    }
+    TestEqual(TEXT("Both want the top mip"), Fixture.Manager.GetTexture(Right).WantedFirstMip, 0);
+    TestEqual(TEXT("Left top mip"), Fixture.Manager.GetTexture(Left).FirstResidentMip, 0);
+    TestEqual(TEXT("Right held at mip 1"), Fixture.Manager.GetTexture(Right).FirstResidentMip, 1);
+    TestEqual(TEXT("No eviction for a lower priority"), Fixture.Manager.GetNumEvicted(), 0u);
+
+    // Next to the right texture its top mip is worth more than the left one's, which is evicted.
+    const FVector NearRight(12.0f, 0.0f, 0.0f);
+    for (int32 Tick = 0; Tick < 12; Tick++)
+    {
+        Fixture.Tick(NearRight);
+        TestTrue(FString::Printf(TEXT("Within budget near the right at tick %d"), Tick), Fixture.Manager.GetResidentBytes() <= Budget);
+    }
+    TestEqual(TEXT("Right top mip"), Fixture.Manager.GetTexture(Right).FirstResidentMip, 0);
+    TestTrue(TEXT("Right top mip data"), Fixture.IsMipLoaded(Right, 0));
+    TestEqual(TEXT("Left evicted to mip 1"), Fixture.Manager.GetTexture(Left).FirstResidentMip, 1);
+    TestEqual(TEXT("Evicted mips"), Fixture.Manager.GetNumEvicted(), 1u);
+
+    const int32* LeftMinLOD = Fixture.Residency.MinLOD.Find(Fixture.Manager.GetTexture(Left).Resource);
+    TestTrue(TEXT("Left MinLOD raised"), LeftMinLOD != nullptr && *LeftMinLOD == 1);
+    TestEqual(TEXT("Resident bytes"), Fixture.Manager.GetResidentBytes(), Budget);
+    TestEqual(TEXT("Mapped bytes match"), Fixture.Residency.MappedBytes, Budget - 2 * GetMipSize(NumMips - 1));
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTextureStreamingStagingLimitTest, "System.RHI.TextureStreaming.StagingLimit", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTextureStreamingStagingLimitTest::RunTest(const FString& Parameters)
+{
+    using namespace TextureStreamingTest;
+
+    const int32 NumTextures = 8;
+    const FVector ViewOrigin(0.0f, 0.0f, 0.0f);
+    // Every texture first asks for mip 2, 16 rows at the 256 byte copy pitch.
+    const uint64 StagingPerLoad = FStreamingUploader::GetTextureAllocSize(16, 16, 4);
+
+    // The staging limit ends the round after two loads while their reads are still out.
+    {
+        FFixture Fixture(256 * 1024, 1024 * 1024, 2 * StagingPerLoad + StagingPerLoad / 2);
+        for (int32 Index = 0; Index < NumTextures; Index++)
+        {
+            Fixture.AddTexture(FVector(1.2f, (float)Index * 0.01f, 0.0f), 1.0f);
+        }
+
+        FTextureStreamingView View;
+        View.Origin = ViewOrigin;
+        View.ScreenScale = 64.0f;
+        Fixture.Manager.SetView(View);
+        Fixture.Manager.Tick();
+        TestEqual(TEXT("Loads within the staging limit"), Fixture.Reader.Held.Num(), 2);
+        TestEqual(TEXT("Staging bytes in flight"), Fixture.Manager.GetStagingBytesInFlight(), 2 * StagingPerLoad);
+
+        // Reads that never finish hold their space, the next tick still returns at once.
+        Fixture.Manager.Tick();
+        TestEqual(TEXT("No loads past the limit"), Fixture.Reader.Held.Num(), 2);
+        TestEqual(TEXT("No ring waits"), Fixture.Uploader.GetNumFullRingWaits(), 0u);
+    }
+
+    // A ring that only fits four loads ends the round without waiting, the rest come later.
+    {
+        FFixture Fixture(4 * StagingPerLoad, 1024 * 1024, 1024 * 1024);
+        for (int32 Index = 0; Index < NumTextures; Index++)
+        {
+            Fixture.AddTexture(FVector(1.2f, (float)Index * 0.01f, 0.0f), 1.0f);
+        }
+
+        FTextureStreamingView View;
+        View.Origin = ViewOrigin;
+        View.ScreenScale = 64.0f;
+        Fixture.Manager.SetView(View);
+        Fixture.Manager.Tick();
+        TestEqual(TEXT("Loads that fit the ring"), Fixture.Reader.Held.Num(), 4);
+
+        // A load takes three ticks: read, copy, completion. The top mips need the whole ring each.
+        for (int32 Tick = 0; Tick < 48; Tick++)
+        {
+            Fixture.Tick(ViewOrigin);
+        }
+        TestEqual(TEXT("Ring never waited"), Fixture.Uploader.GetNumFullRingWaits(), 0u);
+        for (int32 Index = 0; Index < NumTextures; Index++)
+        {
+            TestEqual(FString::Printf(TEXT("Texture %d streamed in"), Index), Fixture.Manager.GetTexture(Index).FirstResidentMip, 0);
+        }
+    }
+
+    return true;
+}